@@ -6,6 +6,7 @@
 
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include <thread>
 #include <mutex>
 #include <functional>
@@ -206,6 +207,36 @@ namespace mango
         void wait();
     };
 
+    // Splits the rows [0, count) into bands and calls func(y0, y1) for each band from a
+    // ConcurrentQueue. The number of bands is limited by the thread count and by work / grain,
+    // where work is the cost of all rows and grain the smallest cost worth a task. A single band
+    // is processed on the calling thread.
+    template <typename Func>
+    void processBands(int count, size_t work, size_t grain, Func func)
+    {
+        const int threads = ThreadPool::getInstanceSize();
+        const int N = int(std::max(size_t(1), std::min(size_t(std::min(threads, count)), work / grain)));
+
+        if (N == 1)
+        {
+            func(0, count);
+            return;
+        }
+
+        const int section = count / N;
+
+        ConcurrentQueue queue("bands", Priority::HIGH);
+
+        for (int i = 0; i < N; ++i)
+        {
+            const int y0 = i * section;
+            const int y1 = i == N - 1 ? count : y0 + section;
+            queue.enqueue([=] { func(y0, y1); });
+        }
+
+        queue.wait();
+    }
+
     class Task
     {
     public:
@@ -202,7 +202,7 @@ namespace mango
         };
 
         typedef void (*DecodeFunc)(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-        typedef void (*EncodeFunc)(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
+        typedef void (*EncodeFunc)(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
 
         int width; // block width
         int height; // block height
@@ -217,7 +217,16 @@ namespace mango
         TextureCompressionInfo(int width, int height, int bytes, const Format& format, DecodeFunc decode, EncodeFunc encode, TextureCompression compression);
 
         void decompress(const Surface& surface, Memory memory) const;
-        void compress(Memory memory, const Surface& surface) const;
+
+        // quality is in range [0.0, 1.0]: below 1/3 selects the real-time encoders,
+        // above 2/3 the slowest, most exhaustive search the encoder has to offer.
+        // BC6H and BC7 are expensive at every tier but the lowest: per core, BC7 encodes
+        // about 4 Mpix/s below 1/6, 0.05 below 1/3, 0.01 at the default and 0.002 above
+        // 2/3, which is tens of seconds for a 256 x 256 image; BC6H is similar.
+        void compress(Memory memory, const Surface& surface, float quality = 0.5f) const;
+
+        // encoding function compress() uses for the quality
+        EncodeFunc getEncodeFunc(float quality) const;
 
         CompressionFormat getCompressionFormat() const
         {
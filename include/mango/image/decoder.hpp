@@ -5,6 +5,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <functional>
 #include "../core/object.hpp"
 #include "format.hpp"
 #include "compression.hpp"
@@ -14,6 +16,22 @@
 namespace mango
 {
 
+    enum class YCbCrLayout
+    {
+        PLANAR, // Y, Cb and Cr in separate 8 bit planes
+        NV12,   // Y plane followed by interleaved CbCr plane
+    };
+
+    struct YCbCrHeader
+    {
+        int planes = 0;  // number of planes in the image, zero if YCbCr decoding is not supported
+        int width[3] = { 0, 0, 0 };
+        int height[3] = { 0, 0, 0 };
+    };
+
+    // Receives the partially decoded image, for example after each progressive scan
+    using ImageDecodeCallback = std::function<void(const Surface& surface)>;
+
     class ImageDecoderInterface : protected NonCopyable
     {
     public:
@@ -26,12 +44,17 @@ namespace mango
         // optional interface
         virtual Exif exif();
         virtual Memory memory(int level, int depth, int face);
+        virtual YCbCrHeader ycbcr();
+        virtual bool decodeYCbCr(Surface* planes, YCbCrLayout layout);
+        virtual void setCallback(ImageDecodeCallback callback);
+        virtual bool setCompression(TextureCompression compression);
     };
 
     class ImageDecoder : protected NonCopyable
     {
     protected:
         ImageDecoderInterface* m_interface;
+        bool m_orientation;
 
     public:
         typedef ImageDecoderInterface* (*CreateFunc)(Memory memory);
@@ -45,9 +68,39 @@ namespace mango
         Exif exif();
         Memory memory(int level, int depth, int face);
         void decode(Surface& dest, Palette* palette, int level, int depth, int face);
+
+        // Decode the image without color conversion or chroma upsampling. The planes
+        // must have the dimensions reported by ycbcr(); NV12 layout uses two planes and
+        // requires 4:2:0 chroma sampling. Returns false for unsupported sampling.
+        YCbCrHeader ycbcr();
+        bool decodeYCbCr(Surface* planes, YCbCrLayout layout);
+
+        // Progressive preview; the callback is invoked from decode() as the image is refined.
+        void setCallback(ImageDecodeCallback callback);
+
+        // Apply the Exif orientation in decode(); header() reports the oriented dimensions.
+        void setOrientation(bool enable);
+
+        // Select the block compression universal textures are transcoded into; header() reports
+        // it and memory() returns the transcoded blocks. Returns false if the decoder cannot
+        // produce the compression. NONE restores the default of decoding only with decode().
+        bool setCompression(TextureCompression compression);
     };
 
     void registerImageDecoder(ImageDecoder::CreateFunc func, const std::string& extension);
     bool isImageDecoder(const std::string& extension);
 
+    // ----------------------------------------------------------------------------
+    // JPEG batch decoding
+    // ----------------------------------------------------------------------------
+
+    // Receives the result of each image as soon as it is decoded; the callback is
+    // invoked concurrently from the ThreadPool and must be thread-safe.
+    using JPEGBatchCallback = std::function<void(int index, bool success)>;
+
+    // Decodes inputs[i] into *outputs[i] and returns when every image is done. Small images
+    // are decoded in parallel, one per task, with recycled parsers; large images are split
+    // across the ThreadPool internally. Returns false if any of the images failed to decode.
+    bool decodeJPEG(const std::vector<Memory>& inputs, const std::vector<Surface*>& outputs, JPEGBatchCallback callback = nullptr);
+
 } // namespace mango
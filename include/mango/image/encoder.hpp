@@ -14,10 +14,17 @@
 namespace mango
 {
 
+    struct ImageEncodeOptions
+    {
+        float quality = 0.90f;
+        bool optimize = false;     // two-pass encoding with optimized entropy coding tables
+        bool progressive = false;  // progressive encoding (JPEG)
+    };
+
     class ImageEncoder : protected NonCopyable
     {
     public:
-        typedef void (*CreateFunc)(Stream& output, const Surface& source, float quality);
+        typedef void (*CreateFunc)(Stream& output, const Surface& source, const ImageEncodeOptions& options);
 
         ImageEncoder(const std::string& extension);
         ~ImageEncoder();
@@ -25,6 +32,7 @@ namespace mango
         bool isEncoder() const;
 
         void encode(Stream& output, const Surface& source, float quality);
+        void encode(Stream& output, const Surface& source, const ImageEncodeOptions& options);
 
     protected:
         CreateFunc m_encode;
@@ -33,4 +41,36 @@ namespace mango
     void registerImageEncoder(ImageEncoder::CreateFunc func, const std::string& extension);
     bool isImageEncoder(const std::string& extension);
 
+    // ----------------------------------------------------------------------------
+    // JPEG lossless transcoding
+    // ----------------------------------------------------------------------------
+
+    enum class JPEGTransform
+    {
+        NONE,
+        FLIP_HORIZONTAL,
+        FLIP_VERTICAL,
+        TRANSPOSE,  // mirror over the main diagonal
+        TRANSVERSE, // mirror over the anti-diagonal
+        ROTATE_90,  // clockwise
+        ROTATE_180,
+        ROTATE_270,
+    };
+
+    struct JPEGTranscodeOptions
+    {
+        JPEGTransform transform = JPEGTransform::NONE;
+
+        // crop rectangle in source image coordinates; the origin is aligned down to MCU boundary
+        // and zero width or height selects the whole image.
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Rearranges the quantized DCT coefficients and re-encodes them with optimized huffman
+    // tables, without decoding the image. Partial MCUs on edges which would move are trimmed.
+    bool transcodeJPEG(Stream& output, Memory input, const JPEGTranscodeOptions& options);
+
 } // namespace mango
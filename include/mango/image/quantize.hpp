@@ -0,0 +1,28 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include "color.hpp"
+#include "surface.hpp"
+
+namespace mango
+{
+
+    struct QuantizeOptions
+    {
+        int colors = 256;    // number of palette entries (2..256)
+        int iterations = 4;  // k-means refinement passes after the median cut
+        bool dither = false; // Floyd-Steinberg error diffusion when the indices are mapped
+    };
+
+    // Computes a palette for the source surface with median cut, refines it with k-means and
+    // maps the source into palette indices. The dest surface must have 8 bit samples; the
+    // indices are written into the area common to both surfaces.
+    void quantize(Surface& dest, Palette& palette, const Surface& source, const QuantizeOptions& options = QuantizeOptions());
+
+    // Maps the source into indices of an existing palette.
+    void quantize(Surface& dest, const Palette& palette, const Surface& source, bool dither = false);
+
+} // namespace mango
@@ -0,0 +1,56 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include "surface.hpp"
+#include "compression.hpp"
+
+namespace mango
+{
+
+    enum class ResampleFilter
+    {
+        BOX,
+        BILINEAR,
+        MITCHELL,
+        LANCZOS
+    };
+
+    struct ResampleOptions
+    {
+        ResampleFilter filter = ResampleFilter::LANCZOS;
+        bool linear = false;        // sRGB encoded color is filtered in linear light
+        bool premultiplied = false; // color is already premultiplied with alpha
+    };
+
+    // Resamples the source surface to the size of the destination surface. The filter is
+    // separable, the passes are distributed to the ThreadPool and conversion into the
+    // destination format is done when the filtered scanlines are stored.
+    void resample(Surface& dest, const Surface& source, const ResampleOptions& options = ResampleOptions());
+
+    // ----------------------------------------------------------------------------
+    // mipmaps
+    // ----------------------------------------------------------------------------
+
+    struct MipmapOptions
+    {
+        bool linear = false;        // sRGB encoded color is filtered in linear light
+        bool premultiplied = false; // color is already premultiplied with alpha
+        float quality = 0.5f;       // compression quality, see TextureCompressionInfo::compress()
+    };
+
+    // Number of levels in a complete mipmap chain, including the base level.
+    int getMipmapLevels(int width, int height);
+
+    // Generates the levels 1..levels of the source surface into dest[0..levels-1] with a 2x2
+    // box filter. The chain is computed in cache sized tiles on the ThreadPool.
+    void generateMipmaps(Surface* dest, int levels, const Surface& source, const MipmapOptions& options = MipmapOptions());
+
+    // Generates and compresses the mipmap chain; output[0] receives the compressed source and
+    // output[i] the level i. The blocks are encoded from the tiles as soon as they are finished.
+    // Throws if an output level is too small for the blocks of the level.
+    void compressMipmaps(Memory* output, int levels, const TextureCompressionInfo& info, const Surface& source, const MipmapOptions& options = MipmapOptions());
+
+} // namespace mango
@@ -8,12 +8,38 @@
 #include <string>
 #include "../core/configure.hpp"
 #include "../core/object.hpp"
+#include "../core/bits.hpp"
 #include "../filesystem/file.hpp"
 #include "format.hpp"
 
 namespace mango
 {
 
+    struct ImageEncodeOptions;
+
+    enum class BlendMode
+    {
+        OVER,    // Porter-Duff source over destination
+        ADD,
+        MULTIPLY
+    };
+
+    struct BlendOptions
+    {
+        BlendMode mode = BlendMode::OVER;
+        float opacity = 1.0f;       // multiplier for the source
+        bool linear = false;        // sRGB encoded color is blended in linear light
+        bool premultiplied = false; // color is premultiplied with alpha in both surfaces
+    };
+
+    enum class Dither
+    {
+        NONE,
+        BAYER,          // 8x8 ordered dither matrix
+        BLUE_NOISE,     // 64x64 void-and-cluster threshold map
+        FLOYD_STEINBERG // serpentine error diffusion
+    };
+
     class Surface
     {
     protected:
@@ -38,8 +64,15 @@ namespace mango
         }
 
         void save(const std::string& filename, float quality = 1.0f);
+        void save(const std::string& filename, const ImageEncodeOptions& options);
         void clear(float red, float green, float blue, float alpha);
+        void clear(int x, int y, int width, int height, float red, float green, float blue, float alpha);
+        void fill(const Surface& pattern); // repeats the pattern surface from the top-left corner
         void blit(int x, int y, const Surface& source);
+        void blit(int x, int y, const Surface& source, Dither dither);
+        void blend(int x, int y, const Surface& source, const BlendOptions& options = BlendOptions());
+        void premultiply();
+        void unpremultiply();
         void xflip();
         void yflip();
     };
@@ -60,4 +93,75 @@ namespace mango
         Bitmap& operator = (Bitmap&& bitmap);
     };
 
+    // ----------------------------------------------------------------------------
+    // transforms
+    // ----------------------------------------------------------------------------
+
+    // Stores the transformed source into dest, converting the pixel format if required. The
+    // dest dimensions are swapped when the transform transposes the image. Rotation is clockwise.
+    void transpose(Surface& dest, const Surface& source);
+    void rotate90(Surface& dest, const Surface& source);
+    void rotate180(Surface& dest, const Surface& source);
+    void rotate270(Surface& dest, const Surface& source);
+
+    // Exif orientation values 1..8
+    void applyOrientation(Surface& dest, const Surface& source, int orientation);
+    bool isOrientationTransposed(int orientation);
+
+    // ----------------------------------------------------------------------------
+    // TiledBitmap
+    // ----------------------------------------------------------------------------
+
+    enum class TileLayout
+    {
+        LINEAR, // scanlines are linear inside a tile
+        MORTON  // pixels are in Z-order inside a tile
+    };
+
+    // Image storage where square tiles are contiguous in memory, so that 2D access patterns
+    // stay within a few pages. With LINEAR tile layout every tile is also a Surface.
+    class TiledBitmap : private NonCopyable
+    {
+    protected:
+        int     tileShift;
+
+    public:
+        int     width;
+        int     height;
+        Format  format;
+        TileLayout layout;
+        int     tileSize; // power of two
+        int     xtiles;
+        int     ytiles;
+        uint8*  image;
+
+        TiledBitmap(int width, int height, const Format& format, TileLayout layout = TileLayout::LINEAR, int tileSize = 64);
+        TiledBitmap(TiledBitmap&& bitmap);
+        ~TiledBitmap();
+
+        template <typename SampleType>
+        SampleType* address(int x, int y) const
+        {
+            const int mask = tileSize - 1;
+            const size_t tile = size_t((y >> tileShift) * xtiles + (x >> tileShift)) << (tileShift * 2);
+            const size_t offset = layout == TileLayout::MORTON ?
+                u32_interleave_bits(x & mask, y & mask) : ((y & mask) << tileShift) | (x & mask);
+            uint8* sample = image + (tile + offset) * format.bytes();
+            return reinterpret_cast<SampleType*>(sample);
+        }
+
+        uint8* tileAddress(int tx, int ty) const
+        {
+            const size_t tile = size_t(ty * xtiles + tx) << (tileShift * 2);
+            return image + tile * format.bytes();
+        }
+
+        // view of a tile clipped to the image; the tile layout must be LINEAR
+        Surface tile(int tx, int ty) const;
+
+        // conversion from and to linear surfaces
+        void blit(const Surface& source);
+        void copy(Surface& dest) const;
+    };
+
 } // namespace mango
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <cassert>
+#include <limits>
 #include "math.hpp"
 
 namespace mango
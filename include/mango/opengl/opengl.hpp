@@ -6,8 +6,11 @@
 
 #include <set>
 #include <string>
+#include <vector>
 #include "../core/configure.hpp"
+#include "../core/object.hpp"
 #include "../image/compression.hpp"
+#include "../image/decoder.hpp"
 #include "../gui/window.hpp"
 
 // -----------------------------------------------------------------------
@@ -223,5 +226,41 @@ namespace opengl {
     bool isCompressedTextureSupported(TextureCompression compression);
     const InternalFormat* getInternalFormat(GLenum internalFormat);
 
+	// -------------------------------------------------------------------
+    // compressed texture upload ; require active context
+	// -------------------------------------------------------------------
+
+    // The compressed levels are uploaded straight from ImageDecoder::memory(). The DDS, KTX,
+    // PVR and ASTC decoders return the levels inside the container, so with a memory mapped
+    // file the pages are copied only once on the way to the GPU.
+
+    // Uploads the levels of the face into the texture bound to target. Returns false if the
+    // image is not compressed, the context does not support the compression or the decoder
+    // does not provide the compressed memory.
+    bool uploadCompressedTexture(GLenum target, ImageDecoder& decoder, int face = 0);
+
+    // Uploads through a ring of pixel unpack buffers: the level is copied from the mapping into
+    // a buffer and the driver transfers it asynchronously. A buffer is reused when the fence of
+    // its previous upload is signaled. Levels larger than a buffer are uploaded directly.
+    class PixelUnpackRing : protected NonCopyable
+    {
+    protected:
+        struct Slot
+        {
+            GLuint buffer;
+            GLsync fence;
+        };
+
+        std::vector<Slot> m_slots;
+        size_t m_size;
+        size_t m_next;
+
+    public:
+        PixelUnpackRing(size_t size, int count = 3);
+        ~PixelUnpackRing();
+
+        bool upload(GLenum target, ImageDecoder& decoder, int face = 0);
+    };
+
 } // namespace opengl
 } // namespace mango
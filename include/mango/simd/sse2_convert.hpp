@@ -362,14 +362,11 @@ namespace detail {
     template <>
     inline float32x4 convert<float32x4>(uint32x4 s)
     {
-        // conversion could be done by subtracting 0x80000000 from the value before signed conversion and
-        // adding float(0x80000000) to the result after conversion but this would reduce precision on the LSBs.
+        // the 16 bit halves are converted exactly; the magic number trick for the high half would
+        // be folded away by the compiler with -ffast-math
         const __m128i mask = _mm_set1_epi32(0x0000ffff);
-        const __m128i onep39 = _mm_set1_epi32(0x53000000);
-        const __m128i x0 = _mm_or_si128(_mm_srli_epi32(s, 16), onep39);
-        const __m128i x1 = _mm_and_si128(s, mask);
-        const __m128 f1 = _mm_cvtepi32_ps(x1);
-        const __m128 f0 = _mm_sub_ps(_mm_castsi128_ps(x0), _mm_castsi128_ps(onep39));
+        const __m128 f0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(s, 16)), _mm_set1_ps(65536.0f));
+        const __m128 f1 = _mm_cvtepi32_ps(_mm_and_si128(s, mask));
         return _mm_add_ps(f0, f1);
     }
 
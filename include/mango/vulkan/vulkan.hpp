@@ -8,6 +8,7 @@
 #include "../core/configure.hpp"
 #include "../core/dynamic_library.hpp"
 #include "../image/compression.hpp"
+#include "../image/decoder.hpp"
 #include "../gui/window.hpp"
 
 // -----------------------------------------------------------------------
@@ -149,6 +150,48 @@ namespace vulkan {
 		}
 	};
 
+	// Uploads compressed textures from ImageDecoder::memory() through a ring of host visible
+	// staging memory. The levels are copied once from the (memory mapped) container into the
+	// staging memory and copied into the image on the queue. The ring is divided into segments;
+	// a segment is reused when the fence of its previous submission is signaled.
+	class TextureUploader
+	{
+	protected:
+		struct Segment
+		{
+			VkCommandBuffer commandBuffer { VK_NULL_HANDLE };
+			VkFence fence { VK_NULL_HANDLE };
+			bool pending { false };
+		};
+
+		VkDevice m_device;
+		VkQueue m_queue;
+		VkCommandPool m_commandPool { VK_NULL_HANDLE };
+		VkBuffer m_buffer { VK_NULL_HANDLE };
+		VkDeviceMemory m_memory { VK_NULL_HANDLE };
+		uint8* m_address { nullptr };
+		VkDeviceSize m_segmentSize;
+		std::vector<Segment> m_segments;
+		size_t m_next { 0 };
+
+		Segment& acquire(VkDeviceSize& offset);
+		void release();
+
+	public:
+		TextureUploader(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamilyIndex,
+			VkDeviceSize size, uint32_t segments = 3);
+		~TextureUploader();
+
+		// The image must have the format vulkan::getTextureFormat() of the compression, the
+		// levels of the header and VK_IMAGE_USAGE_TRANSFER_DST_BIT; it is left in the
+		// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL layout. Returns false if the decoder does not
+		// provide the compressed memory or a level does not fit into a segment.
+		bool upload(VkImage image, ImageDecoder& decoder, uint32_t layer = 0);
+
+		// waits until the submitted uploads are completed
+		void wait();
+	};
+
 	class Context : public Window
 	{
 	private:
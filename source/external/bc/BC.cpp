@@ -1167,7 +1167,7 @@ namespace
             for (int x = 0; x < 4; ++x)
             {
                 const int32x4 v = simd::unpack(image[x]);
-                temp[y * 4 + x] = convert<float32x4>(v);
+                temp[y * 4 + x] = convert<float32x4>(v) * (1.0f / 255.0f);
             }
         }
     }
@@ -1196,33 +1196,37 @@ namespace mango
         DirectX::D3DXDecodeBC3(output, stride, input);
     }
 
-    void encode_block_bc1(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc1(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
+        MANGO_UNREFERENCED_PARAMETER(quality);
         float4 temp[16];
         convert_block(temp, input, stride);
         DirectX::D3DXEncodeBC1(output, temp, 0.0f, DirectX::BC_FLAGS_NONE);
     }
 
-    void encode_block_bc1a(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc1a(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
+        MANGO_UNREFERENCED_PARAMETER(quality);
         float4 temp[16];
         convert_block(temp, input, stride);
-        DirectX::D3DXEncodeBC1(output, temp, 1.0f, DirectX::BC_FLAGS_NONE);
+        DirectX::D3DXEncodeBC1(output, temp, 0.5f, DirectX::BC_FLAGS_NONE);
     }
 
-    void encode_block_bc2(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc2(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
+        MANGO_UNREFERENCED_PARAMETER(quality);
         float4 temp[16];
         convert_block(temp, input, stride);
         DirectX::D3DXEncodeBC2(output, temp, DirectX::BC_FLAGS_NONE);
     }
 
-    void encode_block_bc3(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc3(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
+        MANGO_UNREFERENCED_PARAMETER(quality);
         float4 temp[16];
         convert_block(temp, input, stride);
         DirectX::D3DXEncodeBC3(output, temp, DirectX::BC_FLAGS_NONE);
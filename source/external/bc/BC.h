@@ -72,6 +72,25 @@ enum BC_FLAGS
     BC_FLAGS_UNIFORM    = 0x40000,  // By default, uses perceptual weighting for BC1-3; this flag makes it a uniform weighting
 };
 
+// BC6H and BC7 encoder search effort
+enum BC_SPEED
+{
+    BC_SPEED_ULTRAFAST, // BC7: mode 6, BC6H: the one region modes; no endpoint optimization
+    BC_SPEED_FAST,      // BC7: modes 1, 3, 5 and 6; the partition with the lowest rough error
+    BC_SPEED_BASIC,     // BC7: no three subset modes; the best eighth of the partitions
+    BC_SPEED_SLOW,      // all modes and the best quarter of the partitions
+};
+
+struct BCSpeedInfo
+{
+    uint16_t uModeMask;     // modes searched, one bit per mode
+    uint8_t uShapeShift;    // refine the (partitions >> uShapeShift) partitions with the lowest rough error, at least one
+    bool bOptimize;         // optimize the quantized endpoints
+    bool bExhaustive;       // BC7: finish with an exhaustive search around the optimized endpoints
+    bool bRoughCull;        // stop refining partitions once the rough error is not below the best error
+    float fErrorThreshold;  // stop searching once the block error is below this
+};
+
 //-------------------------------------------------------------------------------------
 // Structures
 //-------------------------------------------------------------------------------------
@@ -518,7 +537,7 @@ class D3DX_BC6H : private CBits< 16 >
 {
 public:
     void Decode(bool bSigned, uint8* output, int stride) const;
-    void Encode(bool bSigned, const HDRColorA* const pIn);
+    void Encode(bool bSigned, const HDRColorA* const pIn, BC_SPEED speed = BC_SPEED_SLOW);
 
 private:
     enum EField : uint8_t
@@ -563,13 +582,15 @@ private:
         uint8_t uMode;
         uint8_t uShape;
         const HDRColorA* const aHDRPixels;
+        const BCSpeedInfo& speed;
         INTEndPntPair aUnqEndPts[BC6H_MAX_SHAPES][BC6H_MAX_REGIONS];
         INTColor aIPixels[NUM_PIXELS_PER_BLOCK];
 
-        EncodeParams(const HDRColorA* const aOriginal, bool bSignedFormat) :
+        EncodeParams(const HDRColorA* const aOriginal, bool bSignedFormat, const BCSpeedInfo& speedInfo) :
             fBestErr(FLT_MAX),
             bSigned(bSignedFormat),
-            aHDRPixels(aOriginal)
+            aHDRPixels(aOriginal),
+            speed(speedInfo)
         {
             for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
             {
@@ -609,6 +630,7 @@ private:
     const static ModeDescriptor ms_aDesc[][82];
     const static ModeInfo ms_aInfo[];
     const static int ms_aModeToInfo[];
+    const static BCSpeedInfo ms_aSpeedInfo[];
 };
 
 // BC67 compression (16b bits per texel)
@@ -616,7 +638,7 @@ class D3DX_BC7 : private CBits< 16 >
 {
 public:
     void Decode(uint8* output, int stride) const;
-    void Encode(const HDRColorA* const pIn);
+    void Encode(const HDRColorA* const pIn, BC_SPEED speed = BC_SPEED_SLOW);
 
 private:
     struct ModeInfo
@@ -639,8 +661,9 @@ private:
         LDREndPntPair aEndPts[BC7_MAX_SHAPES][BC7_MAX_REGIONS];
         LDRColorA aLDRPixels[NUM_PIXELS_PER_BLOCK];
         const HDRColorA* const aHDRPixels;
+        const BCSpeedInfo& speed;
 
-        EncodeParams(const HDRColorA* const aOriginal) : aHDRPixels(aOriginal) {}
+        EncodeParams(const HDRColorA* const aOriginal, const BCSpeedInfo& speedInfo) : aHDRPixels(aOriginal), speed(speedInfo) {}
     };
 
     static uint8_t Quantize(uint8_t comp, uint8_t uPrec)
@@ -693,6 +716,7 @@ private:
                            const float orig_err[],
                            const LDREndPntPair orig_endpts[],
                            LDREndPntPair opt_endpts[]) const;
+    void ResolvePBits(const EncodeParams* pEP, LDREndPntPair aEndPts[]) const;
     void AssignIndices(const EncodeParams* pEP, size_t uShape, size_t uIndexMode,
                        LDREndPntPair endpts[],
                        size_t aIndices[], size_t aIndices2[],
@@ -709,6 +733,7 @@ private:
 
 private:
     const static ModeInfo ms_aInfo[];
+    const static BCSpeedInfo ms_aSpeedInfo[];
 };
 
 //-------------------------------------------------------------------------------------
@@ -852,17 +877,17 @@ namespace mango
     void decode_block_bc6hs(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
     void decode_block_bc7  (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
 
-    void encode_block_bc1  (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc1a (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc2  (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc3  (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc4u (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc4s (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc5u (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc5s (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc6hu(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc6hs(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-    void encode_block_bc7  (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
+    void encode_block_bc1  (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc1a (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc2  (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc3  (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc4u (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc4s (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc5u (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc5s (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc6hu(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc6hs(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc7  (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
 
 } // namespace mango
 
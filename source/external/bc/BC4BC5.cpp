@@ -421,9 +421,10 @@ namespace mango
     	}
     }
 
-    void encode_block_bc4u(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc4u(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
+        MANGO_UNREFERENCED_PARAMETER(quality);
         assert( output && input );
         static_assert( sizeof(BC4_UNORM) == 8, "BC4_UNORM should be 8 bytes" );
 
@@ -447,9 +448,10 @@ namespace mango
         FindClosestUNORM(pBC4, theTexelsU);
     }
 
-    void encode_block_bc4s(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc4s(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
+        MANGO_UNREFERENCED_PARAMETER(quality);
         assert( output && input );
         static_assert( sizeof(BC4_SNORM) == 8, "BC4_SNORM should be 8 bytes" );
 
@@ -473,9 +475,10 @@ namespace mango
         FindClosestSNORM(pBC4, theTexelsU);
     }
 
-    void encode_block_bc5u(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc5u(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
+        MANGO_UNREFERENCED_PARAMETER(quality);
         assert( output && input );
         static_assert( sizeof(BC4_UNORM) == 8, "BC4_UNORM should be 8 bytes" );
 
@@ -511,9 +514,10 @@ namespace mango
         FindClosestUNORM(pBCG, theTexelsV);
     }
 
-    void encode_block_bc5s(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc5s(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
+        MANGO_UNREFERENCED_PARAMETER(quality);
         assert( output && input );
         static_assert( sizeof(BC4_SNORM) == 8, "BC4_SNORM should be 8 bytes" );
 
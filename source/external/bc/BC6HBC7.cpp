@@ -552,6 +552,24 @@ const D3DX_BC7::ModeInfo D3DX_BC7::ms_aInfo[] =
         // Mode 7: Color+Alpha, 2 Subsets, RGBAP 55551 (unique P-bit), 2-bit indices, 64 partitions
 };
 
+// Speed: uModeMask, uShapeShift, bOptimize, bExhaustive, bRoughCull, fErrorThreshold
+const BCSpeedInfo D3DX_BC6H::ms_aSpeedInfo[] =
+{
+    { 0x3c00, 5, false, false, true,  0.0f }, // BC_SPEED_ULTRAFAST: one region modes 10-13
+    { 0x3fff, 5, true,  false, true,  0.0f }, // BC_SPEED_FAST
+    { 0x3fff, 3, true,  false, true,  0.0f }, // BC_SPEED_BASIC
+    { 0x3fff, 2, true,  false, false, 0.0f }, // BC_SPEED_SLOW
+};
+
+// The BC7 error is the sum of squared 8 bit differences over the block
+const BCSpeedInfo D3DX_BC7::ms_aSpeedInfo[] =
+{
+    { 0x40, 6, false, false, true,  0.0f  }, // BC_SPEED_ULTRAFAST: mode 6
+    { 0x6a, 6, true,  false, true,  16.0f }, // BC_SPEED_FAST: modes 1, 3, 5, 6
+    { 0xfa, 3, true,  true,  true,  4.0f  }, // BC_SPEED_BASIC: modes 1, 3, 4, 5, 6, 7
+    { 0xff, 2, true,  true,  false, 0.0f  }, // BC_SPEED_SLOW
+};
+
 
 //-------------------------------------------------------------------------------------
 // Helper functions
@@ -1010,66 +1028,93 @@ static float OptimizeRGBA(const HDRColorA* const pPoints,
 
 //-------------------------------------------------------------------------------------
 
+// Reduces the four lanes of a palette search to the lowest error; ties go to the lowest index
+static inline float SelectBestIndex(int32x4 error, int32x4 index, size_t* pBestIndex)
+{
+    int32_t nBestErr = error[0];
+    int32_t nBestIndex = index[0];
+    for(size_t i = 1; i < 4; i++)
+    {
+        if(error[i] < nBestErr || (error[i] == nBestErr && index[i] < nBestIndex))
+        {
+            nBestErr = error[i];
+            nBestIndex = index[i];
+        }
+    }
+    if(pBestIndex)
+        *pBestIndex = size_t(nBestIndex);
+    return float(nBestErr);
+}
+
+// The palette is searched four entries at a time with exact integer errors. The palette
+// sizes are 4, 8 or 16 entries and the whole palette is always searched; the original
+// search stopped when the error first increased, which is not guaranteed to find the minimum.
 static float ComputeError(const LDRColorA& pixel, const LDRColorA aPalette[],
                           uint8_t uIndexPrec, uint8_t uIndexPrec2, size_t* pBestIndex = nullptr, size_t* pBestIndex2 = nullptr)
 {
     const size_t uNumIndices = size_t(1) << uIndexPrec;
     const size_t uNumIndices2 = size_t(1) << uIndexPrec2;
-    float fTotalErr = 0;
-    float fBestErr = FLT_MAX;
+    assert( uNumIndices >= 4 );
 
-    if(pBestIndex)
-        *pBestIndex = 0;
-    if(pBestIndex2)
-        *pBestIndex2 = 0;
+    const int32x4 mask(0xff);
+    const int32x4 pr(pixel.r);
+    const int32x4 pg(pixel.g);
+    const int32x4 pb(pixel.b);
+    const int32x4 pa(pixel.a);
 
-    if(uIndexPrec2 == 0)
+    int32x4 index(0, 1, 2, 3);
+    int32x4 bestRGB(0x7fffffff);
+    int32x4 bestAlpha(0x7fffffff);
+    int32x4 indexRGB(0);
+    int32x4 indexAlpha(0);
+
+    // the alpha is searched in the same loop as rgb; the index counts can be different
+    const size_t uCount = std::max(uNumIndices, uIndexPrec2 ? uNumIndices2 : 0);
+
+    for(size_t i = 0; i < uCount; i += 4)
     {
-        for(size_t i = 0; i < uNumIndices && fBestErr > 0; i++)
+        const int32x4 v = simd::int32x4_uload(reinterpret_cast<const int32*>(aPalette + i));
+        const int32x4 dr = (v & mask) - pr;
+        const int32x4 dg = ((v >> 8) & mask) - pg;
+        const int32x4 db = ((v >> 16) & mask) - pb;
+        const int32x4 da = int32x4(simd::srli<24>(v)) - pa;
+
+        const int32x4 rgb = int32x4(simd::mullo(dr, dr)) + int32x4(simd::mullo(dg, dg)) + int32x4(simd::mullo(db, db));
+        const int32x4 alpha = simd::mullo(da, da);
+
+        if(uIndexPrec2 == 0)
         {
-            float fErr = ErrorMetric(pixel, aPalette[i]);
-            if(fErr > fBestErr)	// error increased, so we're done searching
-                break;
-            if(fErr < fBestErr)
-            {
-                fBestErr = fErr;
-                if(pBestIndex)
-                    *pBestIndex = i;
-            }
+            const int32x4 error = rgb + alpha;
+            const mask32x4 better = error < bestRGB;
+            bestRGB = select(better, error, bestRGB);
+            indexRGB = select(better, index, indexRGB);
         }
-        fTotalErr += fBestErr;
-    }
-    else
-    {
-        for(size_t i = 0; i < uNumIndices && fBestErr > 0; i++)
+        else
         {
-            float fErr = ErrorMetricRGB(pixel, aPalette[i]);
-            if(fErr > fBestErr)	// error increased, so we're done searching
-                break;
-            if(fErr < fBestErr)
+            if(i < uNumIndices)
             {
-                fBestErr = fErr;
-                if(pBestIndex)
-                    *pBestIndex = i;
+                const mask32x4 better = rgb < bestRGB;
+                bestRGB = select(better, rgb, bestRGB);
+                indexRGB = select(better, index, indexRGB);
             }
-        }
-        fTotalErr += fBestErr;
-        fBestErr = FLT_MAX;
-        for(size_t i = 0; i < uNumIndices2 && fBestErr > 0; i++)
-        {
-            float fErr = ErrorMetricAlpha(pixel, aPalette[i]);
-            if(fErr > fBestErr)	// error increased, so we're done searching
-                break;
-            if(fErr < fBestErr)
+            if(i < uNumIndices2)
             {
-                fBestErr = fErr;
-                if(pBestIndex2)
-                    *pBestIndex2 = i;
+                const mask32x4 better = alpha < bestAlpha;
+                bestAlpha = select(better, alpha, bestAlpha);
+                indexAlpha = select(better, index, indexAlpha);
             }
         }
-        fTotalErr += fBestErr;
+
+        index = index + int32x4(4);
     }
 
+    if(pBestIndex2)
+        *pBestIndex2 = 0;
+
+    float fTotalErr = SelectBestIndex(bestRGB, indexRGB, pBestIndex);
+    if(uIndexPrec2 != 0)
+        fTotalErr += SelectBestIndex(bestAlpha, indexAlpha, pBestIndex2);
+
     return fTotalErr;
 }
 
@@ -1088,10 +1133,10 @@ static inline void FillWithErrorColors(uint8* output, int stride)
 
 #ifdef _DEBUG
         // Use Magenta in debug as a highly-visible error color
-        pOut[i] = HDRColorA(1.0f, 0.0f, 1.0f, 1.0f);
+        *pOut = HDRColorA(1.0f, 0.0f, 1.0f, 1.0f);
 #else
         // In production use, default to black
-        pOut[i] = HDRColorA(0.0f, 0.0f, 0.0f, 1.0f);
+        *pOut = HDRColorA(0.0f, 0.0f, 0.0f, 1.0f);
 #endif
     }
 }
@@ -1244,18 +1289,21 @@ void D3DX_BC6H::Decode(bool bSigned, uint8* output, int stride) const
     }
 }
 
-void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn)
+void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn, BC_SPEED speed)
 {
     assert( pIn );
 
-    EncodeParams EP(pIn, bSigned);
+    EncodeParams EP(pIn, bSigned, ms_aSpeedInfo[speed]);
 
-    for(EP.uMode = 0; EP.uMode < ARRAYSIZE(ms_aInfo) && EP.fBestErr > 0; ++EP.uMode)
+    for(EP.uMode = 0; EP.uMode < ARRAYSIZE(ms_aInfo) && EP.fBestErr > EP.speed.fErrorThreshold; ++EP.uMode)
     {
+        if(!(EP.speed.uModeMask & (1 << EP.uMode)))
+            continue;
+
         const uint8_t uShapes = ms_aInfo[EP.uMode].uPartitions ? 32 : 1;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        const size_t uItems = std::max<size_t>(1, uShapes >> EP.speed.uShapeShift);
         float afRoughMSE[BC6H_MAX_SHAPES];
         uint8_t auShape[BC6H_MAX_SHAPES];
 
@@ -1282,6 +1330,8 @@ void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn)
 
         for(size_t i = 0; i < uItems && EP.fBestErr > 0; i++)
         {
+            if(EP.speed.bRoughCull && afRoughMSE[i] >= EP.fBestErr)
+                break;
             EP.uShape = auShape[i];
             Refine(&EP);
         }
@@ -1751,6 +1801,21 @@ void D3DX_BC6H::Refine(EncodeParams* pEP)
     if(bTransformed) TransformForward(aOrgEndPts);
     if(EndPointsFit(pEP, aOrgEndPts))
     {
+        if(!pEP->speed.bOptimize)
+        {
+            // the quantized endpoints are used as-is
+            float fOrgTotErr = 0.0f;
+            for(size_t p = 0; p <= uPartitions; ++p)
+                fOrgTotErr += aOrgErr[p];
+
+            if(fOrgTotErr < pEP->fBestErr)
+            {
+                pEP->fBestErr = fOrgTotErr;
+                EmitBlock(pEP, aOrgEndPts, aOrgIdx);
+            }
+            return;
+        }
+
         if(bTransformed) TransformInverse(aOrgEndPts, ms_aInfo[pEP->uMode].RGBAPrec[0][0], pEP->bSigned);
         OptimizeEndPoints(pEP, aOrgErr, aOrgEndPts, aOptEndPts);
         AssignIndices(pEP, aOptEndPts, aOptIdx, aOptErr);
@@ -2100,12 +2165,12 @@ void D3DX_BC7::Decode(uint8* output, int stride) const
     }
 }
 
-void D3DX_BC7::Encode(const HDRColorA* const pIn)
+void D3DX_BC7::Encode(const HDRColorA* const pIn, BC_SPEED speed)
 {
     assert( pIn );
 
     D3DX_BC7 final = *this;
-    EncodeParams EP(pIn);
+    EncodeParams EP(pIn, ms_aSpeedInfo[speed]);
     float fMSEBest = FLT_MAX;
 
     for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
@@ -2116,8 +2181,11 @@ void D3DX_BC7::Encode(const HDRColorA* const pIn)
         EP.aLDRPixels[i].a = uint8_t( std::max<float>( 0.0f, std::min<float>( 255.0f, pIn[i].a * 255.0f + 0.01f ) ) );
     }
 
-    for(EP.uMode = 0; EP.uMode < 8 && fMSEBest > 0; ++EP.uMode)
+    for(EP.uMode = 0; EP.uMode < 8 && fMSEBest > EP.speed.fErrorThreshold; ++EP.uMode)
     {
+        if(!(EP.speed.uModeMask & (1 << EP.uMode)))
+            continue;
+
         const size_t uShapes = size_t(1) << ms_aInfo[EP.uMode].uPartitionBits;
         assert( uShapes <= BC7_MAX_SHAPES );
 
@@ -2125,7 +2193,7 @@ void D3DX_BC7::Encode(const HDRColorA* const pIn)
         const size_t uNumIdxMode = size_t(1) << ms_aInfo[EP.uMode].uIndexModeBits;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        const size_t uItems = std::max<size_t>(1, uShapes >> EP.speed.uShapeShift);
         float afRoughMSE[BC7_MAX_SHAPES];
         size_t auShape[BC7_MAX_SHAPES];
 
@@ -2162,6 +2230,8 @@ void D3DX_BC7::Encode(const HDRColorA* const pIn)
 
                 for(size_t i = 0; i < uItems && fMSEBest > 0; i++)
                 {
+                    if(EP.speed.bRoughCull && afRoughMSE[i] >= fMSEBest)
+                        break;
                     float fMSE = Refine(&EP, auShape[i], r, im);
                     if(fMSE < fMSEBest)
                     {
@@ -2385,8 +2455,11 @@ void D3DX_BC7::OptimizeOne(const EncodeParams* pEP, const LDRColorA aColors[], s
     }
 
     // finally, do a small exhaustive search around what we think is the global minima to be sure
-    for(size_t ch = 0; ch < BC7_NUM_CHANNELS; ch++)
-        Exhaustive(pEP, aColors, np, uIndexMode, ch, fOptErr, opt);
+    if(pEP->speed.bExhaustive)
+    {
+        for(size_t ch = 0; ch < BC7_NUM_CHANNELS; ch++)
+            Exhaustive(pEP, aColors, np, uIndexMode, ch, fOptErr, opt);
+    }
 }
 
 void D3DX_BC7::OptimizeEndPoints(const EncodeParams* pEP, size_t uShape, size_t uIndexMode, const float afOrgErr[],
@@ -2410,6 +2483,53 @@ void D3DX_BC7::OptimizeEndPoints(const EncodeParams* pEP, size_t uShape, size_t
     }
 }
 
+// The channels of an endpoint are quantized independently but share the p-bit; the p-bit is
+// voted on when the block is emitted. Applying the same vote here makes the indices and error
+// computed for the endpoints match the encoded block.
+void D3DX_BC7::ResolvePBits(const EncodeParams* pEP, LDREndPntPair aEndPts[]) const
+{
+    assert( pEP );
+    const size_t uPBits = ms_aInfo[pEP->uMode].uPBits;
+    if(!uPBits)
+        return;
+
+    const uint8_t uPartitions = ms_aInfo[pEP->uMode].uPartitions;
+    const size_t uNumEP = size_t(1 + uPartitions) << 1;
+    const LDRColorA RGBAPrec = ms_aInfo[pEP->uMode].RGBAPrec;
+    const LDRColorA RGBAPrecWithP = ms_aInfo[pEP->uMode].RGBAPrecWithP;
+
+    uint8_t aPVote[BC7_MAX_REGIONS << 1] = {0,0,0,0,0,0};
+    uint8_t aCount[BC7_MAX_REGIONS << 1] = {0,0,0,0,0,0};
+    for(uint8_t ch = 0; ch < BC7_NUM_CHANNELS; ch++)
+    {
+        if(RGBAPrec[ch] == RGBAPrecWithP[ch])
+            continue;
+
+        for(size_t ep = 0; ep < uNumEP; ep++)
+        {
+            const LDREndPntPair& endPts = aEndPts[ep >> 1];
+            const size_t idx = ep * uPBits / uNumEP;
+            aPVote[idx] += ((ep & 1) ? endPts.B[ch] : endPts.A[ch]) & 0x01;
+            aCount[idx]++;
+        }
+    }
+
+    for(uint8_t ch = 0; ch < BC7_NUM_CHANNELS; ch++)
+    {
+        if(RGBAPrec[ch] == RGBAPrecWithP[ch])
+            continue;
+
+        for(size_t ep = 0; ep < uNumEP; ep++)
+        {
+            LDREndPntPair& endPts = aEndPts[ep >> 1];
+            const size_t idx = ep * uPBits / uNumEP;
+            const uint8_t p = aPVote[idx] > (aCount[idx] >> 1) ? 1 : 0;
+            uint8_t& c = (ep & 1) ? endPts.B[ch] : endPts.A[ch];
+            c = (c & 0xfe) | p;
+        }
+    }
+}
+
 void D3DX_BC7::AssignIndices(const EncodeParams* pEP, size_t uShape, size_t uIndexMode, LDREndPntPair endPts[], size_t aIndices[], size_t aIndices2[], float afTotErr[]) const
 {
     assert( pEP );
@@ -2592,8 +2712,21 @@ float D3DX_BC7::Refine(const EncodeParams* pEP, size_t uShape, size_t uRotation,
         aOrgEndPts[p].B = Quantize(aEndPts[p].B, ms_aInfo[pEP->uMode].RGBAPrecWithP);
     }
 
+    ResolvePBits(pEP, aOrgEndPts);
     AssignIndices(pEP, uShape, uIndexMode, aOrgEndPts, aOrgIdx, aOrgIdx2, aOrgErr);
+
+    if(!pEP->speed.bOptimize)
+    {
+        float fOrgTotErr = 0;
+        for(size_t p = 0; p <= uPartitions; p++)
+            fOrgTotErr += aOrgErr[p];
+
+        EmitBlock(pEP, uShape, uRotation, uIndexMode, aOrgEndPts, aOrgIdx, aOrgIdx2);
+        return fOrgTotErr;
+    }
+
     OptimizeEndPoints(pEP, uShape, uIndexMode, aOrgErr, aOrgEndPts, aOptEndPts);
+    ResolvePBits(pEP, aOptEndPts);
     AssignIndices(pEP, uShape, uIndexMode, aOptEndPts, aOptIdx, aOptIdx2, aOptErr);
 
     float fOrgTotErr = 0, fOptTotErr = 0;
@@ -2692,7 +2825,7 @@ float D3DX_BC7::RoughMSE(EncodeParams* pEP, size_t uShape, size_t uIndexMode)
         else
         {
             uint8_t uMinAlpha = 255, uMaxAlpha = 0;
-            for(size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            for(size_t i = 0; i < np; ++i)
             {
                 uMinAlpha = std::min<uint8_t>(uMinAlpha, pEP->aLDRPixels[auPixIdx[i]].a);
                 uMaxAlpha = std::max<uint8_t>(uMaxAlpha, pEP->aLDRPixels[auPixIdx[i]].a);
@@ -2742,29 +2875,29 @@ float D3DX_BC7::RoughMSE(EncodeParams* pEP, size_t uShape, size_t uIndexMode)
 // BC6H Compression
 //-------------------------------------------------------------------------------------
 
-static void D3DXEncodeBC6HU(uint8_t *output, const float32x4 *input)
+static void D3DXEncodeBC6HU(uint8_t *output, const float32x4 *input, BC_SPEED speed)
 {
     assert( output && input );
     static_assert( sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes" );
-    reinterpret_cast< D3DX_BC6H* >( output )->Encode(false, reinterpret_cast<const HDRColorA*>(input));
+    reinterpret_cast< D3DX_BC6H* >( output )->Encode(false, reinterpret_cast<const HDRColorA*>(input), speed);
 }
 
-static void D3DXEncodeBC6HS(uint8_t *output, const float32x4 *input)
+static void D3DXEncodeBC6HS(uint8_t *output, const float32x4 *input, BC_SPEED speed)
 {
     assert( output && input );
     static_assert( sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes" );
-    reinterpret_cast< D3DX_BC6H* >( output )->Encode(true, reinterpret_cast<const HDRColorA*>(input));
+    reinterpret_cast< D3DX_BC6H* >( output )->Encode(true, reinterpret_cast<const HDRColorA*>(input), speed);
 }
 
 //-------------------------------------------------------------------------------------
 // BC7 Compression
 //-------------------------------------------------------------------------------------
 
-static void D3DXEncodeBC7(uint8_t *output, const float32x4 *input)
+static void D3DXEncodeBC7(uint8_t *output, const float32x4 *input, BC_SPEED speed)
 {
     assert( output && input );
     static_assert( sizeof(D3DX_BC7) == 16, "D3DX_BC7 should be 16 bytes" );
-    reinterpret_cast< D3DX_BC7* >( output )->Encode(reinterpret_cast<const HDRColorA*>(input));
+    reinterpret_cast< D3DX_BC7* >( output )->Encode(reinterpret_cast<const HDRColorA*>(input), speed);
 }
 
 } // namespace DirectX
@@ -2787,6 +2920,18 @@ namespace
         }
     }
 
+    // the compress() quality tiers, with the real-time tier split in two
+    DirectX::BC_SPEED getSpeed(float quality)
+    {
+        if (quality < 1.0f / 6.0f)
+            return DirectX::BC_SPEED_ULTRAFAST;
+        if (quality < 1.0f / 3.0f)
+            return DirectX::BC_SPEED_FAST;
+        if (quality < 2.0f / 3.0f)
+            return DirectX::BC_SPEED_BASIC;
+        return DirectX::BC_SPEED_SLOW;
+    }
+
 } // namespace
 
 namespace mango
@@ -2817,28 +2962,28 @@ namespace mango
         reinterpret_cast< const D3DX_BC7* >( input )->Decode(output, stride);
     }
 
-    void encode_block_bc6hu(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc6hu(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
         float32x4 temp[16];
         convert_block(temp, input, stride);
-        D3DXEncodeBC6HU(output, temp);
+        D3DXEncodeBC6HU(output, temp, getSpeed(quality));
     }
 
-    void encode_block_bc6hs(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc6hs(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
         float32x4 temp[16];
         convert_block(temp, input, stride);
-        D3DXEncodeBC6HS(output, temp);
+        D3DXEncodeBC6HS(output, temp, getSpeed(quality));
     }
 
-    void encode_block_bc7(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_bc7(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
         float32x4 temp[16];
         convert_block(temp, input, stride);
-        D3DXEncodeBC7(output, temp);
+        D3DXEncodeBC7(output, temp, getSpeed(quality));
     }
 
 } // namespace mango
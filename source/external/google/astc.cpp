@@ -1529,10 +1529,10 @@ namespace mango
 
                 for (int x = 0; x < blockWidth; ++x)
                 {
-                    dest[0] = uint8(src[0] * 255);
-                    dest[1] = uint8(src[1] * 255);
-                    dest[2] = uint8(src[2] * 255);
-                    dest[3] = uint8(src[3] * 255);
+                    dest[0] = uint8(src[0] * 255 + 0.5f);
+                    dest[1] = uint8(src[1] * 255 + 0.5f);
+                    dest[2] = uint8(src[2] * 255 + 0.5f);
+                    dest[3] = uint8(src[3] * 255 + 0.5f);
                     dest += 4;
                     src += 4;
                 }
@@ -388,9 +388,10 @@ static void writeBigEndian(etc1_byte* pOut, etc1_uint32 d) {
 namespace mango
 {
 
-    void encode_block_etc1(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride)
+    void encode_block_etc1(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
     {
         MANGO_UNREFERENCED_PARAMETER(info);
+        MANGO_UNREFERENCED_PARAMETER(quality);
 
         etc1_byte colors[8];
         etc1_byte flippedColors[8];
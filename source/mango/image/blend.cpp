@@ -0,0 +1,163 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <mango/core/thread.hpp>
+#include <mango/image/image.hpp>
+#include "scan.hpp"
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // blend
+    // ----------------------------------------------------------------------------
+
+    // The scanlines are blended in premultiplied float RGBA. Porter-Duff over is the base
+    // operation; the other modes only change how the colors that overlap are combined.
+
+    void blend_over(float32x4* dest, const float32x4* src, int count)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            const float32x4 s = src[x];
+            dest[x] = s + dest[x] * (1.0f - s.wwww);
+        }
+    }
+
+    void blend_add(float32x4* dest, const float32x4* src, int count)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            dest[x] = min(src[x] + dest[x], float32x4(1.0f));
+        }
+    }
+
+    void blend_multiply(float32x4* dest, const float32x4* src, int count)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            const float32x4 s = src[x];
+            const float32x4 d = dest[x];
+
+            // color: s * d + s * (1 - da) + d * (1 - sa)
+            // alpha: sa + da - sa * da
+            float32x4 v = s * d + s * (1.0f - d.wwww) + d * (1.0f - s.wwww);
+            v.w = s.w + d.w - s.w * d.w;
+            dest[x] = v;
+        }
+    }
+
+    using BlendFunc = void (*)(float32x4* dest, const float32x4* src, int count);
+
+    BlendFunc getBlendFunc(BlendMode mode)
+    {
+        switch (mode)
+        {
+            case BlendMode::OVER:     return blend_over;
+            case BlendMode::ADD:      return blend_add;
+            case BlendMode::MULTIPLY: return blend_multiply;
+        }
+        return blend_over;
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void Surface::blend(int x, int y, const Surface& source, const BlendOptions& options)
+    {
+        if (!source.width || !source.height || !source.format.bits || !format.bits)
+            return;
+
+        Surface dest(*this, x, y, source.width, source.height);
+
+        if (!dest.width || !dest.height)
+            return;
+
+        // clipped source origin
+        const int sx = std::max(0, -x);
+        const int sy = std::max(0, -y);
+
+        const ScanConverter reader(source.format);
+        const ScanConverter writer(dest.format);
+        const BlendFunc func = getBlendFunc(options.mode);
+
+        const bool linear = options.linear;
+        const bool sourcePremultiply = !options.premultiplied && source.format.alpha();
+        const bool destPremultiply = !options.premultiplied && dest.format.alpha();
+        const float32x4 opacity(options.opacity);
+
+        processBands(dest.height, size_t(dest.width) * dest.height, 8192, [&] (int y0, int y1)
+        {
+            ScanBuffer src(dest.width);
+            ScanBuffer dst(dest.width);
+
+            for (int i = y0; i < y1; ++i)
+            {
+                reader.read(src.data(), source.address<uint8>(sx, sy + i), dest.width);
+                writer.read(dst.data(), dest.address<uint8>(0, i), dest.width);
+
+                decodeScan(src.data(), dest.width, linear, sourcePremultiply);
+                decodeScan(dst.data(), dest.width, linear, destPremultiply);
+
+                if (options.opacity != 1.0f)
+                {
+                    for (int j = 0; j < dest.width; ++j)
+                    {
+                        src[j] = src[j] * opacity;
+                    }
+                }
+
+                func(dst.data(), src.data(), dest.width);
+
+                encodeScan(dst.data(), dest.width, linear, destPremultiply);
+                writer.write(dest.address<uint8>(0, i), dst.data(), dest.width);
+            }
+        });
+    }
+
+    void Surface::premultiply()
+    {
+        if (!format.alpha())
+            return;
+
+        const ScanConverter converter(format);
+
+        processBands(height, size_t(width) * height, 8192, [&] (int y0, int y1)
+        {
+            ScanBuffer scan(width);
+
+            for (int y = y0; y < y1; ++y)
+            {
+                converter.read(scan.data(), address<uint8>(0, y), width);
+                decodeScan(scan.data(), width, false, true);
+                converter.write(address<uint8>(0, y), scan.data(), width);
+            }
+        });
+    }
+
+    void Surface::unpremultiply()
+    {
+        if (!format.alpha())
+            return;
+
+        const ScanConverter converter(format);
+
+        processBands(height, size_t(width) * height, 8192, [&] (int y0, int y1)
+        {
+            ScanBuffer scan(width);
+
+            for (int y = y0; y < y1; ++y)
+            {
+                converter.read(scan.data(), address<uint8>(0, y), width);
+                encodeScan(scan.data(), width, false, true);
+                converter.write(address<uint8>(0, y), scan.data(), width);
+            }
+        });
+    }
+
+} // namespace mango
@@ -589,6 +589,275 @@ namespace
     }
 #endif
 
+#if defined(MANGO_ENABLE_AVX512) || defined(MANGO_ENABLE_AVX2) || defined(MANGO_ENABLE_NEON)
+
+    // The wide conversion processes one component of N pixels at a time. The components are
+    // shifted down to the least significant bit first, so the float scaling is exact for
+    // components up to 24 bits and no signed conversion workarounds are required.
+
+    template <int N>
+    struct WideVector;
+
+    template <>
+    struct WideVector<4>
+    {
+        using IntType = int32x4;
+        using FloatType = float32x4;
+        static IntType load(const int32* p) { return simd::int32x4_uload(p); }
+        static void store(int32* p, IntType v) { simd::int32x4_ustore(p, v); }
+    };
+
+    template <>
+    struct WideVector<8>
+    {
+        using IntType = int32x8;
+        using FloatType = float32x8;
+        static IntType load(const int32* p) { return simd::int32x8_uload(p); }
+        static void store(int32* p, IntType v) { simd::int32x8_ustore(p, v); }
+    };
+
+    template <>
+    struct WideVector<16>
+    {
+        using IntType = int32x16;
+        using FloatType = float32x16;
+        static IntType load(const int32* p) { return simd::int32x16_uload(p); }
+        static void store(int32* p, IntType v) { simd::int32x16_ustore(p, v); }
+    };
+
+    // Moves N pixels between memory and the vector lanes. 32 bit pixels are loaded and stored
+    // directly, 8 and 16 bit pixels are widened and narrowed in registers at 4 and 8 lanes.
+    // The remaining cases go through memory with a constant trip count.
+
+    template <typename T, int N>
+    struct WidePixels
+    {
+        using IntType = typename WideVector<N>::IntType;
+
+        static IntType load(const T* p)
+        {
+            alignas(64) int32 temp[N];
+            for (int i = 0; i < N; ++i)
+            {
+                temp[i] = int32(uint32(p[i]));
+            }
+            return WideVector<N>::load(temp);
+        }
+
+        static void store(T* p, IntType v)
+        {
+            alignas(64) int32 temp[N];
+            WideVector<N>::store(temp, v);
+            for (int i = 0; i < N; ++i)
+            {
+                p[i] = T(uint32(temp[i]));
+            }
+        }
+    };
+
+    template <int N>
+    struct WidePixels<uint32, N>
+    {
+        using IntType = typename WideVector<N>::IntType;
+
+        static IntType load(const uint32* p)
+        {
+            return WideVector<N>::load(reinterpret_cast<const int32*>(p));
+        }
+
+        static void store(uint32* p, IntType v)
+        {
+            WideVector<N>::store(reinterpret_cast<int32*>(p), v);
+        }
+    };
+
+    template <>
+    struct WidePixels<uint16, 8>
+    {
+        static int32x8 load(const uint16* p)
+        {
+            simd::uint32x4 s = simd::uint32x4_uload(reinterpret_cast<const uint32*>(p));
+            simd::uint32x8 v = simd::extend32x8(simd::reinterpret<simd::uint16x8>(s));
+            return simd::reinterpret<simd::int32x8>(v);
+        }
+
+        static void store(uint16* p, int32x8 v)
+        {
+            simd::int32x8 w = v;
+            simd::uint32x4 lo = simd::reinterpret<simd::uint32x4>(simd::get_low(w));
+            simd::uint32x4 hi = simd::reinterpret<simd::uint32x4>(simd::get_high(w));
+            simd::uint16x8 s = simd::narrow(lo, hi);
+            simd::uint32x4_ustore(reinterpret_cast<uint32*>(p), simd::reinterpret<simd::uint32x4>(s));
+        }
+    };
+
+    template <>
+    struct WidePixels<uint8, 8>
+    {
+        static int32x8 load(const uint8* p)
+        {
+            simd::uint64x2 s = simd::uint64x2_set2(uload64(p), 0);
+            simd::uint16x8 v = simd::extend16x8(simd::reinterpret<simd::uint8x16>(s));
+            return simd::reinterpret<simd::int32x8>(simd::extend32x8(v));
+        }
+
+        static void store(uint8* p, int32x8 v)
+        {
+            simd::int32x8 w = v;
+            simd::uint32x4 lo = simd::reinterpret<simd::uint32x4>(simd::get_low(w));
+            simd::uint32x4 hi = simd::reinterpret<simd::uint32x4>(simd::get_high(w));
+            simd::uint16x8 s = simd::narrow(lo, hi);
+            simd::uint8x16 b = simd::narrow(s, s);
+            ustore64(p, simd::get_component<0>(simd::reinterpret<simd::uint64x2>(b)));
+        }
+    };
+
+    template <>
+    struct WidePixels<uint16, 4>
+    {
+        static int32x4 load(const uint16* p)
+        {
+            simd::uint64x2 s = simd::uint64x2_set2(uload64(reinterpret_cast<const uint8*>(p)), 0);
+            simd::uint32x4 v = simd::extend32x4(simd::reinterpret<simd::uint16x8>(s));
+            return simd::reinterpret<simd::int32x4>(v);
+        }
+
+        static void store(uint16* p, int32x4 v)
+        {
+            simd::uint32x4 w = simd::reinterpret<simd::uint32x4>(simd::int32x4(v));
+            simd::uint16x8 s = simd::narrow(w, w);
+            ustore64(reinterpret_cast<uint8*>(p), simd::get_component<0>(simd::reinterpret<simd::uint64x2>(s)));
+        }
+    };
+
+    template <>
+    struct WidePixels<uint8, 4>
+    {
+        static int32x4 load(const uint8* p)
+        {
+            simd::uint32x4 s = simd::uint32x4_set4(uload32(p), 0, 0, 0);
+            simd::uint32x4 v = simd::extend32x4(simd::reinterpret<simd::uint8x16>(s));
+            return simd::reinterpret<simd::int32x4>(v);
+        }
+
+        static void store(uint8* p, int32x4 v)
+        {
+            simd::uint32x4 w = simd::reinterpret<simd::uint32x4>(simd::int32x4(v));
+            simd::uint16x8 s = simd::narrow(w, w);
+            simd::uint8x16 b = simd::narrow(s, s);
+            ustore32(p, simd::get_component<0>(simd::reinterpret<simd::uint32x4>(b)));
+        }
+    };
+
+    template <typename DestType, typename SourceType, int N>
+    void convert_template_wide(const Blitter& blitter, const BlitRect& rect)
+    {
+        using IntType = typename WideVector<N>::IntType;
+        using FloatType = typename WideVector<N>::FloatType;
+
+        uint8* source = rect.srcImage;
+        uint8* dest = rect.destImage;
+
+        const int components = blitter.components;
+
+        int src_shift[4];
+        int dest_shift[4];
+        IntType src_max[4];
+        FloatType scale[4];
+
+        for (int i = 0; i < components; ++i)
+        {
+            const uint32 src_mask = blitter.component[i].srcMask;
+            const uint32 dest_mask = blitter.component[i].destMask;
+            src_shift[i] = u32_index_of_lsb(src_mask);
+            dest_shift[i] = u32_index_of_lsb(dest_mask);
+            src_max[i] = IntType(int32(src_mask >> src_shift[i]));
+            scale[i] = FloatType(float(dest_mask >> dest_shift[i]) / float(src_mask >> src_shift[i]));
+        }
+
+        const IntType init_mask(int32(blitter.initMask));
+        const IntType copy_mask(int32(blitter.copyMask));
+
+        auto compute = [&] (IntType s) -> IntType
+        {
+            IntType v = init_mask | (s & copy_mask);
+
+            for (int i = 0; i < components; ++i)
+            {
+                IntType c = (s >> src_shift[i]) & src_max[i];
+                c = convert<IntType>(convert<FloatType>(c) * scale[i]);
+                v = v | (c << dest_shift[i]);
+            }
+
+            return v;
+        };
+
+        alignas(64) int32 temp[N];
+
+        for (int y = 0; y < rect.height; ++y)
+        {
+            const SourceType* src = reinterpret_cast<const SourceType*>(source);
+            DestType* dst = reinterpret_cast<DestType*>(dest);
+
+            int x = 0;
+
+            for ( ; x <= rect.width - N; x += N)
+            {
+                IntType v = compute(WidePixels<SourceType, N>::load(src + x));
+                WidePixels<DestType, N>::store(dst + x, v);
+            }
+
+            const int count = rect.width - x;
+            if (count > 0)
+            {
+                for (int i = 0; i < count; ++i)
+                {
+                    temp[i] = int32(uint32(src[x + i]));
+                }
+
+                WideVector<N>::store(temp, compute(WideVector<N>::load(temp)));
+
+                for (int i = 0; i < count; ++i)
+                {
+                    dst[x + i] = DestType(uint32(temp[i]));
+                }
+            }
+
+            source += rect.srcStride;
+            dest += rect.destStride;
+        }
+    }
+
+    template <int N>
+    Blitter::ConvertFunc convert_wide(int modeMask)
+    {
+        Blitter::ConvertFunc func = NULL;
+
+        switch (modeMask)
+        {
+            case MAKE_MODEMASK( 8,  8): func = convert_template_wide<uint8, uint8, N>; break;
+            case MAKE_MODEMASK( 8, 16): func = convert_template_wide<uint8, uint16, N>; break;
+            case MAKE_MODEMASK( 8, 24): func = convert_template_wide<uint8, uint24, N>; break;
+            case MAKE_MODEMASK( 8, 32): func = convert_template_wide<uint8, uint32, N>; break;
+            case MAKE_MODEMASK(16,  8): func = convert_template_wide<uint16, uint8, N>; break;
+            case MAKE_MODEMASK(16, 16): func = convert_template_wide<uint16, uint16, N>; break;
+            case MAKE_MODEMASK(16, 24): func = convert_template_wide<uint16, uint24, N>; break;
+            case MAKE_MODEMASK(16, 32): func = convert_template_wide<uint16, uint32, N>; break;
+            case MAKE_MODEMASK(24,  8): func = convert_template_wide<uint24, uint8, N>; break;
+            case MAKE_MODEMASK(24, 16): func = convert_template_wide<uint24, uint16, N>; break;
+            case MAKE_MODEMASK(24, 24): func = convert_template_wide<uint24, uint24, N>; break;
+            case MAKE_MODEMASK(24, 32): func = convert_template_wide<uint24, uint32, N>; break;
+            case MAKE_MODEMASK(32,  8): func = convert_template_wide<uint32, uint8, N>; break;
+            case MAKE_MODEMASK(32, 16): func = convert_template_wide<uint32, uint16, N>; break;
+            case MAKE_MODEMASK(32, 24): func = convert_template_wide<uint32, uint24, N>; break;
+            case MAKE_MODEMASK(32, 32): func = convert_template_wide<uint32, uint32, N>; break;
+        }
+
+        return func;
+    }
+
+#endif
+
     void convert_custom(const Blitter& blitter, const BlitRect& rect)
     {
         uint8* src = rect.srcImage;
@@ -951,6 +1220,225 @@ namespace
         }
     }
 
+    // ----------------------------------------------------------------------------
+    // generated conversion functions
+    // ----------------------------------------------------------------------------
+
+    /*
+
+    The packed UNORM formats with 8, 16 or 32 bit storage are converted with kernels which are
+    instantiated at compile time for every pair of formats in PackedFormatList below. The masks,
+    shifts and scaling factors are constants so the compiler reduces each component into a few
+    shift, mask and multiply operations instead of the float scaling the generic loops do.
+
+    Components are scaled with round-to-nearest, which matches the generic conversion; missing
+    color defaults to 0 and missing alpha to 1. Destination components sharing the same bits
+    (luminance) are written once; color sources are weighted as in ntsc_luminance().
+
+    */
+
+    constexpr int mask_offset(uint32 mask)
+    {
+        int offset = 0;
+        while (mask && !(mask & 1))
+        {
+            mask >>= 1;
+            ++offset;
+        }
+        return offset;
+    }
+
+    constexpr int mask_size(uint32 mask)
+    {
+        int size = 0;
+        for ( ; mask; mask &= mask - 1)
+        {
+            ++size;
+        }
+        return size;
+    }
+
+    template <typename T, uint32 Red, uint32 Green, uint32 Blue, uint32 Alpha>
+    struct PackedFormat
+    {
+        using StorageType = T;
+
+        static constexpr uint32 mask(int component)
+        {
+            return component == 0 ? Red :
+                   component == 1 ? Green :
+                   component == 2 ? Blue : Alpha;
+        }
+
+        static Format format()
+        {
+            return Format(sizeof(T) * 8, Red, Green, Blue, Alpha);
+        }
+    };
+
+    template <typename Dest, typename Source, int Component>
+    inline uint32 convert_component(uint32 s)
+    {
+        constexpr uint32 dest_mask = Dest::mask(Component);
+        constexpr uint32 src_mask = Source::mask(Component);
+        constexpr int dest_offset = mask_offset(dest_mask);
+        constexpr int src_offset = mask_offset(src_mask);
+        constexpr uint32 dest_max = dest_mask >> dest_offset;
+        constexpr uint32 src_max = src_mask >> src_offset;
+
+        constexpr bool shared = (Component > 0 && dest_mask == Dest::mask(0)) ||
+                                (Component > 1 && dest_mask == Dest::mask(1));
+
+        if (!dest_mask || shared)
+        {
+            return 0;
+        }
+
+        if (!src_mask)
+        {
+            // alpha defaults to 1.0, color to 0.0
+            return Component == 3 ? dest_mask : 0;
+        }
+
+        uint32 v = (s >> src_offset) & src_max;
+
+        if (dest_max != src_max)
+        {
+            // components are at most 16 bits so the product fits in 32 bits
+            v = (v * dest_max + src_max / 2) / src_max;
+        }
+
+        return v << dest_offset;
+    }
+
+    template <uint32 DestMax, uint32 SourceMask>
+    inline uint32 scale_component(uint32 s)
+    {
+        constexpr int src_offset = mask_offset(SourceMask);
+        constexpr uint32 src_max = SourceMask >> src_offset;
+
+        if (!src_max)
+        {
+            return 0;
+        }
+
+        const uint32 v = (s >> src_offset) & src_max;
+        return DestMax == src_max ? v : (v * DestMax + src_max / 2) / src_max;
+    }
+
+    template <typename Format>
+    constexpr bool is_luminance()
+    {
+        return Format::mask(0) && Format::mask(0) == Format::mask(1) && Format::mask(1) == Format::mask(2);
+    }
+
+    template <typename Dest, typename Source>
+    inline uint32 convert_luminance(uint32 s)
+    {
+        constexpr uint32 dest_mask = Dest::mask(0);
+        constexpr int dest_offset = mask_offset(dest_mask);
+        constexpr uint32 dest_max = dest_mask >> dest_offset;
+
+        const uint32 r = scale_component<dest_max, Source::mask(0)>(s);
+        const uint32 g = scale_component<dest_max, Source::mask(1)>(s);
+        const uint32 b = scale_component<dest_max, Source::mask(2)>(s);
+
+        // ntsc_luminance() weights in 16 bit fixed point; the sum fits in 32 bits
+        const uint32 v = (r * 19595 + g * 38470 + b * 7471 + 32768) >> 16;
+        return v << dest_offset;
+    }
+
+    template <typename Dest, typename Source>
+    void blit_packed(uint8* dest, const uint8* src, int count)
+    {
+        using D = typename Dest::StorageType;
+        using S = typename Source::StorageType;
+        constexpr bool luminance = is_luminance<Dest>() && !is_luminance<Source>();
+        INIT_POINTERS(D, S);
+        for (int x = 0; x < count; ++x)
+        {
+            const uint32 v = s[x];
+            d[x] = D((luminance ? convert_luminance<Dest, Source>(v) : convert_component<Dest, Source, 0>(v)) |
+                     convert_component<Dest, Source, 1>(v) |
+                     convert_component<Dest, Source, 2>(v) |
+                     convert_component<Dest, Source, 3>(v));
+        }
+    }
+
+    // equal formats may have different offsets for components which are not present
+    Format canonical(const Format& format)
+    {
+        Format result = format;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (!result.size[i])
+                result.offset[i] = 0;
+        }
+        return result;
+    }
+
+    typedef std::map< std::pair<Format, Format>, Blitter::FastFunc > FastConversionMap;
+
+    template <typename... Formats>
+    struct PackedFormatList
+    {
+        template <typename Dest>
+        static int addConversions(FastConversionMap& map)
+        {
+            const Format dest = canonical(Dest::format());
+            const Format source[] = { canonical(Formats::format())... };
+            const Blitter::FastFunc func[] = { blit_packed<Dest, Formats>... };
+
+            for (size_t i = 0; i < sizeof...(Formats); ++i)
+            {
+                // the hand-written conversion functions have precedence
+                if (source[i] != dest)
+                {
+                    map.emplace(std::make_pair(dest, source[i]), func[i]);
+                }
+            }
+
+            return 0;
+        }
+
+        static void addConversions(FastConversionMap& map)
+        {
+            const int dummy[] = { addConversions<Formats>(map)... };
+            MANGO_UNREFERENCED_PARAMETER(dummy);
+        }
+    };
+
+    using GeneratedFormats = PackedFormatList<
+        // 8 bit
+        PackedFormat<uint8, 0xff, 0xff, 0xff, 0>,             // L8
+        PackedFormat<uint8, 0, 0, 0, 0xff>,                   // A8
+        PackedFormat<uint8, 0x0f, 0x0f, 0x0f, 0xf0>,          // L4A4
+        PackedFormat<uint8, 0xe0, 0x1c, 0x03, 0>,             // B2G3R3
+        // 16 bit
+        PackedFormat<uint16, 0x00ff, 0x00ff, 0x00ff, 0xff00>, // L8A8
+        PackedFormat<uint16, 0xffff, 0xffff, 0xffff, 0>,      // L16
+        PackedFormat<uint16, 0xf800, 0x07e0, 0x001f, 0>,      // B5G6R5
+        PackedFormat<uint16, 0x001f, 0x07e0, 0xf800, 0>,      // R5G6B5
+        PackedFormat<uint16, 0x7c00, 0x03e0, 0x001f, 0x8000>, // B5G5R5A1
+        PackedFormat<uint16, 0x7c00, 0x03e0, 0x001f, 0>,      // B5G5R5X1
+        PackedFormat<uint16, 0x001f, 0x03e0, 0x7c00, 0x8000>, // R5G5B5A1
+        PackedFormat<uint16, 0x0f00, 0x00f0, 0x000f, 0xf000>, // B4G4R4A4
+        PackedFormat<uint16, 0x000f, 0x00f0, 0x0f00, 0xf000>, // R4G4B4A4
+        PackedFormat<uint16, 0x00f0, 0x0f00, 0xf000, 0x000f>, // A4R4G4B4
+        PackedFormat<uint16, 0x00e0, 0x001c, 0x0003, 0xff00>, // B2G3R3A8
+        // 32 bit
+        PackedFormat<uint32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000>, // B8G8R8A8
+        PackedFormat<uint32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0>,          // B8G8R8X8
+        PackedFormat<uint32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000>, // R8G8B8A8
+        PackedFormat<uint32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0>,          // R8G8B8X8
+        PackedFormat<uint32, 0x0000ff00, 0x00ff0000, 0xff000000, 0x000000ff>, // A8R8G8B8
+        PackedFormat<uint32, 0xff000000, 0x00ff0000, 0x0000ff00, 0x000000ff>, // A8B8G8R8
+        PackedFormat<uint32, 0x000003ff, 0x000ffc00, 0x3ff00000, 0xc0000000>, // R10G10B10A2
+        PackedFormat<uint32, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000>, // B10G10R10A2
+        PackedFormat<uint32, 0x0000ffff, 0xffff0000, 0, 0>,                   // R16G16
+        PackedFormat<uint32, 0x0000ffff, 0x0000ffff, 0x0000ffff, 0xffff0000>  // L16A16
+    >;
+
     // ----------------------------------------------------------------------------
     // custom conversion function lookup
     // ----------------------------------------------------------------------------
@@ -1005,8 +1493,6 @@ namespace
         { FORMAT_RGBA32F,  FORMAT_RGBA16F,    0, blit_rgba32f_from_rgba16f },
     };
 
-    typedef std::map< std::pair<Format, Format>, Blitter::FastFunc > FastConversionMap;
-
     // initialize map of custom conversion functions
     FastConversionMap g_custom_func_map = [] {
         FastConversionMap map;
@@ -1021,10 +1507,12 @@ namespace
 
             if (!node.requireCpuFeature || (cpuFlags & node.requireCpuFeature) != 0)
             {
-                map[std::make_pair(node.dest, node.source)] = node.func;
+                map[std::make_pair(canonical(node.dest), canonical(node.source))] = node.func;
             }
         }
 
+        GeneratedFormats::addConversions(map);
+
         return map;
     } ();
 
@@ -1050,7 +1538,7 @@ namespace
         else
         {
             // find custom conversion function
-            auto i = g_custom_func_map.find(std::make_pair(dest, source));
+            auto i = g_custom_func_map.find(std::make_pair(canonical(dest), canonical(source)));
             if (i != g_custom_func_map.end())
             {
                 func = i->second;
@@ -1150,6 +1638,39 @@ namespace mango
 
         convertFunc = convert_fpu(modeMask);
 
+#if defined(MANGO_ENABLE_AVX512) || defined(MANGO_ENABLE_AVX2) || defined(MANGO_ENABLE_NEON)
+        // the wide conversion requires components small enough for exact float scaling
+        bool wide = components > 0;
+
+        for (int i = 0; i < components; ++i)
+        {
+            if (u32_count_bits(component[i].srcMask) > 24 || u32_count_bits(component[i].destMask) > 24)
+                wide = false;
+        }
+
+        if (wide)
+        {
+            ConvertFunc func = NULL;
+
+#if defined(MANGO_ENABLE_AVX512)
+            if (cpuFlags & CPU_AVX512F)
+                func = convert_wide<16>(modeMask);
+#elif defined(MANGO_ENABLE_AVX2)
+            if (cpuFlags & CPU_AVX2)
+                func = convert_wide<8>(modeMask);
+#elif defined(MANGO_ENABLE_NEON)
+            if (cpuFlags & CPU_NEON)
+                func = convert_wide<4>(modeMask);
+#endif
+
+            if (func)
+            {
+                convertFunc = func;
+                return;
+            }
+        }
+#endif
+
 #ifdef MANGO_ENABLE_SSE2
         if (sse2)
         {
@@ -5,6 +5,7 @@
 #include <map>
 #include <mango/core/core.hpp>
 #include <mango/image/image.hpp>
+#include "scan.hpp"
 #include "../../external/google/etc.hpp"
 #include "../../external/google/astc.hpp"
 #include "../../external/bc/BC.h"
@@ -19,6 +20,11 @@ namespace mango
     void decode_block_dxt5           (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride); // BC3
     void decode_block_3dc_x          (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride); // BC4U
     void decode_block_3dc_xy         (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride); // BC5U
+    void decode_blocks_dxt1          (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count);
+    void decode_blocks_dxt3          (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count);
+    void decode_blocks_dxt5          (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count);
+    void decode_blocks_3dc_x         (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count);
+    void decode_blocks_3dc_xy        (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count);
     void decode_block_uyvy           (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
     void decode_block_yuy2           (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
     void decode_block_grgb8          (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
@@ -27,8 +33,28 @@ namespace mango
     void decode_block_r11f_g11f_b10f (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
     void decode_block_r10f_g11f_b11f (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
     void decode_block_pvrtc          (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
-
-    void encode_block_etc1           (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride);
+    void encode_block_pvrtc          (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+
+    void encode_block_etc1           (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_etc2           (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_etc2_eac       (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_eac_r11        (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_eac_rg11       (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_astc           (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc1_fast       (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc1a_fast      (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc3_fast       (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc4u_fast      (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc4s_fast      (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc5u_fast      (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_block_bc5s_fast      (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality);
+    void encode_blocks_bc1_fast      (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality);
+    void encode_blocks_bc1a_fast     (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality);
+    void encode_blocks_bc3_fast      (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality);
+    void encode_blocks_bc4u_fast     (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality);
+    void encode_blocks_bc4s_fast     (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality);
+    void encode_blocks_bc5u_fast     (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality);
+    void encode_blocks_bc5s_fast     (const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality);
 
 } // namespace mango
 
@@ -78,66 +104,66 @@ namespace
 #endif
 
         // IMG_texture_compression_pvrtc
-        { 4, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, nullptr, TextureCompression::PVRTC_RGB_4BPP },
-        { 8, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, nullptr, TextureCompression::PVRTC_RGB_2BPP },
-        { 4, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, nullptr, TextureCompression::PVRTC_RGBA_4BPP },
-        { 8, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, nullptr, TextureCompression::PVRTC_RGBA_2BPP },
+        { 4, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, encode_block_pvrtc, TextureCompression::PVRTC_RGB_4BPP },
+        { 8, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, encode_block_pvrtc, TextureCompression::PVRTC_RGB_2BPP },
+        { 4, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, encode_block_pvrtc, TextureCompression::PVRTC_RGBA_4BPP },
+        { 8, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, encode_block_pvrtc, TextureCompression::PVRTC_RGBA_2BPP },
 
         // IMG_texture_compression_pvrtc2
         { 8, 4, 8, FORMAT_NONE, nullptr, nullptr, TextureCompression::PVRTC2_RGBA_2BPP },
         { 4, 4, 8, FORMAT_NONE, nullptr, nullptr, TextureCompression::PVRTC2_RGBA_4BPP },
 
         // EXT_pvrtc_sRGB
-        { 8, 8, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, nullptr, TextureCompression::PVRTC_SRGB_2BPP },
-        { 8, 8, 32, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, nullptr, TextureCompression::PVRTC_SRGB_4BPP },
-        { 8, 8, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, nullptr, TextureCompression::PVRTC_SRGB_ALPHA_2BPP },
-        { 8, 8, 32, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, nullptr, TextureCompression::PVRTC_SRGB_ALPHA_4BPP },
+        { 8, 8, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, encode_block_pvrtc, TextureCompression::PVRTC_SRGB_2BPP },
+        { 8, 8, 32, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, encode_block_pvrtc, TextureCompression::PVRTC_SRGB_4BPP },
+        { 8, 8, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, encode_block_pvrtc, TextureCompression::PVRTC_SRGB_ALPHA_2BPP },
+        { 8, 8, 32, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_pvrtc, encode_block_pvrtc, TextureCompression::PVRTC_SRGB_ALPHA_4BPP },
 
 #ifdef MANGO_ENABLE_LICENSE_APACHE
         // ETC2 / EAC
-        { 4, 4,  8, MAKE_FORMAT(16, UNORM, R, 16, 0, 0, 0), decode_block_eac_r11, nullptr, TextureCompression::EAC_R11 },
-        { 4, 4,  8, MAKE_FORMAT(16, SNORM, R, 16, 0, 0, 0), decode_block_eac_r11, nullptr, TextureCompression::EAC_SIGNED_R11 },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RG, 16, 16, 0, 0), decode_block_eac_rg11, nullptr, TextureCompression::EAC_RG11 },
-        { 4, 4, 16, MAKE_FORMAT(32, SNORM, RG, 16, 16, 0, 0), decode_block_eac_rg11, nullptr, TextureCompression::EAC_SIGNED_RG11 },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, nullptr, TextureCompression::ETC2_RGB },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, nullptr, TextureCompression::ETC2_SRGB },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, nullptr, TextureCompression::ETC2_RGB_ALPHA1 },
-        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, nullptr, TextureCompression::ETC2_SRGB_ALPHA1 },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2_eac, nullptr, TextureCompression::ETC2_RGBA },
-        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2_eac, nullptr, TextureCompression::ETC2_SRGB_ALPHA8 },
+        { 4, 4,  8, MAKE_FORMAT(16, UNORM, R, 16, 0, 0, 0), decode_block_eac_r11, encode_block_eac_r11, TextureCompression::EAC_R11 },
+        { 4, 4,  8, MAKE_FORMAT(16, SNORM, R, 16, 0, 0, 0), decode_block_eac_r11, encode_block_eac_r11, TextureCompression::EAC_SIGNED_R11 },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RG, 16, 16, 0, 0), decode_block_eac_rg11, encode_block_eac_rg11, TextureCompression::EAC_RG11 },
+        { 4, 4, 16, MAKE_FORMAT(32, SNORM, RG, 16, 16, 0, 0), decode_block_eac_rg11, encode_block_eac_rg11, TextureCompression::EAC_SIGNED_RG11 },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, encode_block_etc2, TextureCompression::ETC2_RGB },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, encode_block_etc2, TextureCompression::ETC2_SRGB },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, encode_block_etc2, TextureCompression::ETC2_RGB_ALPHA1 },
+        { 4, 4,  8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2, encode_block_etc2, TextureCompression::ETC2_SRGB_ALPHA1 },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2_eac, encode_block_etc2_eac, TextureCompression::ETC2_RGBA },
+        { 4, 4, 16, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc2_eac, encode_block_etc2_eac, TextureCompression::ETC2_SRGB_ALPHA8 },
 
         // OES_compressed_ETC1_RGB8_texture
         { 4, 4, 8, MAKE_FORMAT(32, UNORM, RGBA, 8, 8, 8, 8), decode_block_etc1, encode_block_etc1, TextureCompression::ETC1_RGB },
 
         // KHR_texture_compression_astc_ldr
-        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_4x4 },
-        {  5,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_5x4 },
-        {  5,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_5x5 },
-        {  6,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_6x5 },
-        {  6,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_6x6 },
-        {  8,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_8x5 },
-        {  8,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_8x6 },
-        {  8,  8, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_8x8 },
-        { 10,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_10x5 },
-        { 10,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_10x6 },
-        { 10,  8, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_10x8 },
-        { 10, 10, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_10x10 },
-        { 12, 10, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_12x10 },
-        { 12, 12, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_RGBA_12x12 },
-        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_4x4 },
-        {  5,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_5x4 },
-        {  5,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_5x5 },
-        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_6x5 },
-        {  6,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_6x6 },
-        {  8,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_8x5 },
-        {  8,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_8x6 },
-        {  8,  8, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_8x8 },
-        { 10,  5, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_10x5 },
-        { 10,  6, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_10x6 },
-        { 10,  8, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_10x8 },
-        { 10, 10, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_10x10 },
-        { 12, 10, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_12x10 },
-        { 12, 12, 16, FORMAT_ASTC, decode_block_astc, nullptr, TextureCompression::ASTC_SRGB_ALPHA_12x12 },
+        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_4x4 },
+        {  5,  4, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_5x4 },
+        {  5,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_5x5 },
+        {  6,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_6x5 },
+        {  6,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_6x6 },
+        {  8,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_8x5 },
+        {  8,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_8x6 },
+        {  8,  8, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_8x8 },
+        { 10,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_10x5 },
+        { 10,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_10x6 },
+        { 10,  8, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_10x8 },
+        { 10, 10, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_10x10 },
+        { 12, 10, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_12x10 },
+        { 12, 12, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_RGBA_12x12 },
+        {  4,  4, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_4x4 },
+        {  5,  4, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_5x4 },
+        {  5,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_5x5 },
+        {  6,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_6x5 },
+        {  6,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_6x6 },
+        {  8,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_8x5 },
+        {  8,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_8x6 },
+        {  8,  8, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_8x8 },
+        { 10,  5, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_10x5 },
+        { 10,  6, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_10x6 },
+        { 10,  8, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_10x8 },
+        { 10, 10, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_10x10 },
+        { 12, 10, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_12x10 },
+        { 12, 12, 16, FORMAT_ASTC, decode_block_astc, encode_block_astc, TextureCompression::ASTC_SRGB_ALPHA_12x12 },
 
         // KHR_texture_compression_astc_hdr
         { 3, 3, 16, FORMAT_NONE, nullptr, nullptr, TextureCompression::ASTC_RGBA_3x3x3 },
@@ -172,15 +198,59 @@ namespace
 		{ 2, 1, 4, FORMAT_R8G8B8A8, decode_block_yuy2, nullptr, TextureCompression::YUY2 },
     };
 
-    const TextureCompressionInfo* getTextureCompressionInfo(TextureCompression compression)
+    // ----------------------------------------------------------------------------
+    // lookup tables
+    // ----------------------------------------------------------------------------
+
+    // The compressions are direct-indexed with the format and index fields of the packed
+    // value; the flags do not take part in the key so the entry is compared to the query.
+    // The tables store the position of the entry plus one; zero means there is no entry.
+
+    constexpr int COMPRESSION_KEY_SIZE = 16 * 32;
+
+    constexpr int getCompressionKey(TextureCompression compression)
+    {
+        return int(((uint32(compression) & 0x0f) << 5) | ((uint32(compression) >> 8) & 0x1f));
+    }
+
+    template <int Size>
+    struct LookupTable
+    {
+        uint8 position[Size];
+
+        template <typename Node>
+        const Node* find(const Node* table, int key) const
+        {
+            if (key < 0 || key >= Size || !position[key])
+                return nullptr;
+            return table + position[key] - 1;
+        }
+    };
+
+    // The block table has non-literal members so its index is built when the table is initialized.
+    struct BlockLookupTable : LookupTable<COMPRESSION_KEY_SIZE>
     {
-        for (auto& node : g_blockTable)
+        BlockLookupTable()
+            : LookupTable<COMPRESSION_KEY_SIZE> {}
         {
-            if (node.compression == compression)
-                return &node;
+            const int count = int(sizeof(g_blockTable) / sizeof(g_blockTable[0]));
+            static_assert(sizeof(g_blockTable) / sizeof(g_blockTable[0]) < 256, "Block table does not fit the lookup table.");
+
+            for (int i = 0; i < count; ++i)
+            {
+                const int key = getCompressionKey(g_blockTable[i].compression);
+                if (!position[key])
+                    position[key] = uint8(i + 1);
+            }
         }
+    };
 
-        return nullptr;
+    const BlockLookupTable g_blockLookupTable;
+
+    const TextureCompressionInfo* getTextureCompressionInfo(TextureCompression compression)
+    {
+        const TextureCompressionInfo* node = g_blockLookupTable.find(g_blockTable, getCompressionKey(compression));
+        return node && node->compression == compression ? node : nullptr;
     }
 
 #define ET(opengl, vulkan, dxgi, compression) \
@@ -195,7 +265,7 @@ namespace
         const char* name;
     };
 
-    const CompressInfo g_compressionInfoTable[] =
+    constexpr CompressInfo g_compressionInfoTable[] =
     {
         ET( 0x8C92, 0,    0, ATC_RGB ),
         ET( 0x8C93, 0,    0, ATC_RGBA_EXPLICIT_ALPHA ),
@@ -300,73 +370,343 @@ namespace
         ET( 0,      0,   68, R8G8B8G8 )
 	};
 
-    void directBlockDecode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize)
+    constexpr int g_compressionInfoCount = int(sizeof(g_compressionInfoTable) / sizeof(g_compressionInfoTable[0]));
+    static_assert(g_compressionInfoCount < 256, "Compression table does not fit the lookup table.");
+
+    // keys of the API formats; the OpenGL formats are in range [0x83f0, 0x93ef]
+
+    constexpr int OPENGL_FORMAT_BASE = 0x83f0;
+    constexpr int OPENGL_KEY_SIZE = 0x1000;
+    constexpr int VULKAN_KEY_SIZE = 256;
+    constexpr int DXGI_KEY_SIZE = 128;
+
+    struct CompressionKey
     {
-        const int blockImageSize = block.width * surface.format.bytes();
-        const int blockImageStride = block.height * surface.stride;
+        static constexpr int get(const CompressInfo& node)
+        {
+            return getCompressionKey(node.compression);
+        }
+    };
 
-        const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
-        const uint8* data = memory.address;
+    struct OpenGLKey
+    {
+        static constexpr int get(const CompressInfo& node)
+        {
+            return node.format_opengl ? int(node.format_opengl) - OPENGL_FORMAT_BASE : -1;
+        }
+    };
+
+    struct VulkanKey
+    {
+        static constexpr int get(const CompressInfo& node)
+        {
+            return node.format_vulkan ? int(node.format_vulkan) : -1;
+        }
+    };
 
-        for (int y = 0; y < ysize; ++y)
+    struct DXGIKey
+    {
+        static constexpr int get(const CompressInfo& node)
         {
-            uint8* image = surface.image;
-            int stride = surface.stride;
+            return node.format_dxgi ? int(node.format_dxgi) : -1;
+        }
+    };
+
+    // The first entry of a key is used like in a linear search. A key out of range is
+    // an out of bounds write, which does not compile.
+    template <int Size, typename Key>
+    constexpr LookupTable<Size> makeLookupTable()
+    {
+        LookupTable<Size> table {};
 
-            if (origin)
+        for (int i = 0; i < g_compressionInfoCount; ++i)
+        {
+            const int key = Key::get(g_compressionInfoTable[i]);
+            if (key >= 0 && !table.position[key])
+                table.position[key] = uint8(i + 1);
+        }
+
+        return table;
+    }
+
+    constexpr bool isCompressionKeyUnique()
+    {
+        for (int i = 0; i < g_compressionInfoCount; ++i)
+        {
+            for (int j = i + 1; j < g_compressionInfoCount; ++j)
             {
-                image += (ysize - y) * blockImageStride;
-                image -= stride;
-                stride = -stride;
+                if (CompressionKey::get(g_compressionInfoTable[i]) == CompressionKey::get(g_compressionInfoTable[j]))
+                    return false;
             }
-            else
+        }
+
+        return true;
+    }
+
+    static_assert(isCompressionKeyUnique(), "The compressions must have unique format and index.");
+
+    constexpr LookupTable<COMPRESSION_KEY_SIZE> g_compressionLookupTable = makeLookupTable<COMPRESSION_KEY_SIZE, CompressionKey>();
+    constexpr LookupTable<OPENGL_KEY_SIZE> g_openglLookupTable = makeLookupTable<OPENGL_KEY_SIZE, OpenGLKey>();
+    constexpr LookupTable<VULKAN_KEY_SIZE> g_vulkanLookupTable = makeLookupTable<VULKAN_KEY_SIZE, VulkanKey>();
+    constexpr LookupTable<DXGI_KEY_SIZE> g_dxgiLookupTable = makeLookupTable<DXGI_KEY_SIZE, DXGIKey>();
+
+    const CompressInfo* getCompressInfo(TextureCompression compression)
+    {
+        const CompressInfo* node = g_compressionLookupTable.find(g_compressionInfoTable, getCompressionKey(compression));
+        return node && node->compression == compression ? node : nullptr;
+    }
+
+    // ----------------------------------------------------------------------------
+    // block decoding
+    // ----------------------------------------------------------------------------
+
+    // The block rows are decoded in bands on the ThreadPool. A row of blocks is decoded with
+    // one call to the batch decoder, which the common formats implement directly; the other
+    // formats loop over their block decoder.
+
+    using DecodeBlocksFunc = void (*)(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count);
+
+    void decode_blocks_generic(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count)
+    {
+        const int blockImageSize = info.width * info.format.bytes();
+
+        for (int x = 0; x < count; ++x)
+        {
+            info.decode(info, output, input, stride);
+            output += blockImageSize;
+            input += info.bytes;
+        }
+    }
+
+    DecodeBlocksFunc getDecodeBlocksFunc(const TextureCompressionInfo& info)
+    {
+        if (info.decode == decode_block_dxt1) return decode_blocks_dxt1;
+        if (info.decode == decode_block_dxt3) return decode_blocks_dxt3;
+        if (info.decode == decode_block_dxt5) return decode_blocks_dxt5;
+        if (info.decode == decode_block_3dc_x) return decode_blocks_3dc_x;
+        if (info.decode == decode_block_3dc_xy) return decode_blocks_3dc_xy;
+        return decode_blocks_generic;
+    }
+
+    void directBlockDecode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize)
+    {
+        const int blockImageStride = block.height * surface.stride;
+        const int blockDataStride = xsize * block.bytes;
+
+        const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
+        const DecodeBlocksFunc decode = getDecodeBlocksFunc(block);
+
+        processBands(ysize, size_t(xsize) * ysize, 256, [&] (int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
             {
-                image += y * blockImageStride;
+                uint8* image = surface.image;
+                int stride = surface.stride;
+
+                if (origin)
+                {
+                    image += (ysize - y) * blockImageStride;
+                    image -= stride;
+                    stride = -stride;
+                }
+                else
+                {
+                    image += y * blockImageStride;
+                }
+
+                decode(block, image, memory.address + y * blockDataStride, stride, xsize);
             }
+        });
+    }
 
-            for (int x = 0; x < xsize; ++x)
+    void clipConvertBlockDecode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize)
+    {
+        const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
+        const DecodeBlocksFunc decode = getDecodeBlocksFunc(block);
+
+        const int blockDataStride = xsize * block.bytes;
+        const int tempStride = xsize * block.width * block.format.bytes();
+
+        // the Blitter does not know the signed block formats; they are converted through
+        // the float RGBA work format
+        const bool scan = block.format.type == Format::SNORM;
+        const ScanConverter reader(block.format);
+        const ScanConverter writer(surface.format);
+
+        processBands(ysize, size_t(xsize) * ysize, 256, [&] (int y0, int y1)
+        {
+            Blitter blitter(surface.format, block.format);
+            Buffer temp(block.height * tempStride);
+            ScanBuffer buffer(scan ? surface.width : 0);
+
+            // decode a row of blocks and convert the visible part of it
+            for (int y = y0; y < y1; ++y)
             {
-                block.decode(block, image, data, stride);
-                image += blockImageSize;
-                data += block.bytes;
+                decode(block, temp, memory.address + y * blockDataStride, tempStride, xsize);
+
+                const int top = y * block.height;
+
+                BlitRect rect;
+                rect.srcImage = temp;
+                rect.srcStride = tempStride;
+                rect.destImage = surface.image + (origin ? surface.height - top - 1 : top) * surface.stride;
+                rect.destStride = origin ? -surface.stride : surface.stride;
+                rect.width = surface.width;
+                rect.height = std::min(top + block.height, surface.height) - top; // vertical clipping
+
+                if (scan)
+                {
+                    for (int i = 0; i < rect.height; ++i)
+                    {
+                        reader.read(buffer.data(), rect.srcImage + i * rect.srcStride, surface.width);
+                        writer.write(rect.destImage + i * rect.destStride, buffer.data(), surface.width);
+                    }
+                }
+                else
+                {
+                    blitter.convert(rect);
+                }
             }
+        });
+    }
+
+    // ----------------------------------------------------------------------------
+    // block encoding
+    // ----------------------------------------------------------------------------
+
+    // The mirror image of block decoding: the block rows are encoded in bands on the ThreadPool.
+    // A source surface in the encoder format is encoded in place, otherwise each row of blocks
+    // is converted once into a band buffer which is reused for the whole band. A row of blocks
+    // is encoded with one call to the batch encoder.
+
+    using EncodeBlocksFunc = void (*)(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality);
+
+    void encode_blocks_generic(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality)
+    {
+        const TextureCompressionInfo::EncodeFunc encode = info.getEncodeFunc(quality);
+        const int blockImageSize = info.width * info.format.bytes();
+
+        for (int x = 0; x < count; ++x)
+        {
+            encode(info, output, input, stride, quality);
+            output += info.bytes;
+            input += blockImageSize;
         }
     }
 
-    void clipConvertBlockDecode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize)
+    EncodeBlocksFunc getEncodeBlocksFunc(const TextureCompressionInfo& info, float quality)
     {
-        Blitter blitter(surface.format, block.format);
-        BlitRect rect;
+        const TextureCompressionInfo::EncodeFunc encode = info.getEncodeFunc(quality);
+        if (encode == encode_block_bc1_fast) return encode_blocks_bc1_fast;
+        if (encode == encode_block_bc1a_fast) return encode_blocks_bc1a_fast;
+        if (encode == encode_block_bc3_fast) return encode_blocks_bc3_fast;
+        if (encode == encode_block_bc4u_fast) return encode_blocks_bc4u_fast;
+        if (encode == encode_block_bc4s_fast) return encode_blocks_bc4s_fast;
+        if (encode == encode_block_bc5u_fast) return encode_blocks_bc5u_fast;
+        if (encode == encode_block_bc5s_fast) return encode_blocks_bc5s_fast;
+        return encode_blocks_generic;
+    }
+
+    void directBlockEncode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize, float quality)
+    {
+        const int blockImageStride = block.height * surface.stride;
+        const int blockDataStride = xsize * block.bytes;
 
         const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
-        const uint8* data = memory.address;
+        const EncodeBlocksFunc encode = getEncodeBlocksFunc(block, quality);
+
+        processBands(ysize, size_t(xsize) * ysize, 256, [&] (int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                const uint8* image = surface.image;
+                int stride = surface.stride;
+
+                if (origin)
+                {
+                    image += (ysize - y) * blockImageStride;
+                    image -= stride;
+                    stride = -stride;
+                }
+                else
+                {
+                    image += y * blockImageStride;
+                }
 
-        rect.destStride = origin ? -surface.stride : surface.stride;
-        rect.srcStride = block.width * block.format.bytes();
+                encode(block, memory.address + y * blockDataStride, image, stride, xsize, quality);
+            }
+        });
+    }
 
-        Buffer temp(block.height * rect.srcStride);
-        rect.srcImage = temp;
+    void clipConvertBlockEncode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize, float quality)
+    {
+        const bool origin = (block.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0;
+        const EncodeBlocksFunc encode = getEncodeBlocksFunc(block, quality);
 
-        const int pixelSize = block.width * surface.format.bytes();
+        const int blockDataStride = xsize * block.bytes;
+        const int bytesPerPixel = block.format.bytes();
+        const int tempStride = xsize * block.width * bytesPerPixel;
 
-        for (int y = 0; y < surface.height; y += block.height)
+        // the Blitter converts between unsigned integer formats only; the float and signed
+        // block formats are converted through the float RGBA work format
+        const bool scan = block.format.float_bits() != 0 || block.format.type == Format::SNORM;
+        const ScanConverter reader(surface.format);
+        const ScanConverter writer(block.format);
+
+        processBands(ysize, size_t(xsize) * ysize, 256, [&] (int y0, int y1)
         {
-            rect.destImage = surface.image + (origin ? surface.height - y - 1 : y) * surface.stride;
-            rect.height = std::min(y + block.height, surface.height) - y; // vertical clipping
+            Blitter blitter(block.format, surface.format);
+            Buffer temp(block.height * tempStride);
+            ScanBuffer buffer(scan ? surface.width : 0);
 
-            for (int x = 0; x < surface.width; x += block.width)
+            // convert the visible part of a row of blocks and encode it
+            for (int y = y0; y < y1; ++y)
             {
-                block.decode(block, temp, data, rect.srcStride);
+                const int top = y * block.height;
+                const int height = std::min(top + block.height, surface.height) - top; // vertical clipping
+
+                BlitRect rect;
+                rect.srcImage = surface.image + (origin ? surface.height - top - 1 : top) * surface.stride;
+                rect.srcStride = origin ? -surface.stride : surface.stride;
+                rect.destImage = temp;
+                rect.destStride = tempStride;
+                rect.width = surface.width;
+                rect.height = height;
+
+                if (scan)
+                {
+                    for (int i = 0; i < height; ++i)
+                    {
+                        reader.read(buffer.data(), rect.srcImage + i * rect.srcStride, surface.width);
+                        writer.write(rect.destImage + i * rect.destStride, buffer.data(), surface.width);
+                    }
+                }
+                else
+                {
+                    blitter.convert(rect);
+                }
+
+                // replicate the edge pixels into the clipped area so that it does not
+                // contribute new colors to the edge blocks
+                for (int i = 0; i < height; ++i)
+                {
+                    uint8* scan = temp + i * tempStride;
+                    const uint8* edge = scan + (surface.width - 1) * bytesPerPixel;
 
-                rect.width = std::min(x + block.width, surface.width) - x; // horizontal clipping
+                    for (int x = surface.width; x < xsize * block.width; ++x)
+                    {
+                        std::memcpy(scan + x * bytesPerPixel, edge, bytesPerPixel);
+                    }
+                }
 
-                // TODO: async conversion
-                blitter.convert(rect);
+                for (int i = height; i < block.height; ++i)
+                {
+                    std::memcpy(temp + i * tempStride, temp + (height - 1) * tempStride, tempStride);
+                }
 
-                rect.destImage += pixelSize;
-                data += block.bytes;
+                encode(block, memory.address + y * blockDataStride, temp, tempStride, xsize, quality);
             }
-        }
+        });
     }
 
     void directSurfaceDecode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize)
@@ -388,6 +728,45 @@ namespace
         Surface(surface).blit(0, 0, bitmap);
     }
 
+    void directSurfaceEncode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize, float quality)
+    {
+        TextureCompressionInfo temp = block;
+        temp.width = surface.width;
+        temp.height = surface.height;
+        temp.getEncodeFunc(quality)(temp, memory.address, surface.image, surface.stride, quality);
+    }
+
+    void clipConvertSurfaceEncode(const TextureCompressionInfo& block, const Surface& surface, Memory memory, int xsize, int ysize, float quality)
+    {
+        TextureCompressionInfo temp = block;
+        temp.width = xsize * block.width;
+        temp.height = ysize * block.height;
+
+        // the clipped area replicates the edge pixels like in block encoding
+        Bitmap bitmap(temp.width, temp.height, block.format);
+        bitmap.blit(0, 0, surface);
+
+        const int bytesPerPixel = block.format.bytes();
+
+        for (int y = 0; y < surface.height; ++y)
+        {
+            uint8* scan = bitmap.address<uint8>(0, y);
+            const uint8* edge = scan + (surface.width - 1) * bytesPerPixel;
+
+            for (int x = surface.width; x < temp.width; ++x)
+            {
+                std::memcpy(scan + x * bytesPerPixel, edge, bytesPerPixel);
+            }
+        }
+
+        for (int y = surface.height; y < temp.height; ++y)
+        {
+            std::memcpy(bitmap.address<uint8>(0, y), bitmap.address<uint8>(0, surface.height - 1), temp.width * bytesPerPixel);
+        }
+
+        temp.getEncodeFunc(quality)(temp, memory.address, bitmap.image, bitmap.stride, quality);
+    }
+
 } // namespace
 
 namespace mango
@@ -397,24 +776,14 @@ namespace mango
 	{
 		TextureCompression getTextureCompression(uint32 format)
 		{
-			for (auto& node : g_compressionInfoTable)
-			{
-				if (node.format_opengl == format)
-					return node.compression;
-			}
-
-			return TextureCompression::NONE;
+			const CompressInfo* node = format ? g_openglLookupTable.find(g_compressionInfoTable, int(format) - OPENGL_FORMAT_BASE) : nullptr;
+			return node ? node->compression : TextureCompression::NONE;
 		}
 
 		uint32 getTextureFormat(TextureCompression compression)
 		{
-			for (auto& node : g_compressionInfoTable)
-			{
-				if (node.compression == compression)
-					return node.format_opengl;
-			}
-
-			return 0;
+			const CompressInfo* node = getCompressInfo(compression);
+			return node ? node->format_opengl : 0;
 		}
 	} // namespace opengl
 
@@ -422,24 +791,14 @@ namespace mango
 	{
 		TextureCompression getTextureCompression(uint32 format)
 		{
-			for (auto& node : g_compressionInfoTable)
-			{
-				if (node.format_vulkan == format)
-					return node.compression;
-			}
-
-			return TextureCompression::NONE;
+			const CompressInfo* node = format ? g_vulkanLookupTable.find(g_compressionInfoTable, int(format)) : nullptr;
+			return node ? node->compression : TextureCompression::NONE;
 		}
 
 		uint32 getTextureFormat(TextureCompression compression)
 		{
-			for (auto& node : g_compressionInfoTable)
-			{
-				if (node.compression == compression)
-					return node.format_vulkan;
-			}
-
-			return 0;
+			const CompressInfo* node = getCompressInfo(compression);
+			return node ? node->format_vulkan : 0;
 		}
 	} // namespace vulkan
 
@@ -447,24 +806,14 @@ namespace mango
 	{
 		TextureCompression getTextureCompression(uint32 format)
 		{
-			for (auto& node : g_compressionInfoTable)
-			{
-				if (node.format_dxgi == format)
-					return node.compression;
-			}
-
-			return TextureCompression::NONE;
+			const CompressInfo* node = format ? g_dxgiLookupTable.find(g_compressionInfoTable, int(format)) : nullptr;
+			return node ? node->compression : TextureCompression::NONE;
 		}
 
 		uint32 getTextureFormat(TextureCompression compression)
 		{
-			for (auto& node : g_compressionInfoTable)
-			{
-				if (node.compression == compression)
-					return node.format_dxgi;
-			}
-
-			return 0;
+			const CompressInfo* node = getCompressInfo(compression);
+			return node ? node->format_dxgi : 0;
 		}
 	} // namespace directx
 
@@ -527,38 +876,59 @@ namespace mango
         }
     }
 
-    void TextureCompressionInfo::compress(Memory memory, const Surface& surface) const
+    TextureCompressionInfo::EncodeFunc TextureCompressionInfo::getEncodeFunc(float quality) const
+    {
+        // real-time tier; the other encoders select their effort from quality
+        if (quality < 1.0f / 3.0f)
+        {
+            if (encode == encode_block_bc1) return encode_block_bc1_fast;
+            if (encode == encode_block_bc1a) return encode_block_bc1a_fast;
+            if (encode == encode_block_bc3) return encode_block_bc3_fast;
+#ifdef MANGO_ENABLE_LICENSE_MICROSOFT
+            if (encode == encode_block_bc4u) return encode_block_bc4u_fast;
+            if (encode == encode_block_bc4s) return encode_block_bc4s_fast;
+            if (encode == encode_block_bc5u) return encode_block_bc5u_fast;
+            if (encode == encode_block_bc5s) return encode_block_bc5s_fast;
+#endif
+        }
+        return encode;
+    }
+
+    void TextureCompressionInfo::compress(Memory memory, const Surface& surface, float quality) const
     {
         if (!encode)
             return;
 
-        ConcurrentQueue queue;
-
-        uint8* address = memory.address;
+        const int xsize = round_to_next(surface.width, width);
+        const int ysize = round_to_next(surface.height, height);
 
-        const int xblocks = round_to_next(surface.width, width);
-        const int yblocks = round_to_next(surface.height, height);
+        const bool noclip = surface.width == (xsize * width) &&
+                            surface.height == (ysize * height);
+        const bool noconvert = surface.format == format;
+        const bool direct = noclip && noconvert;
 
-        for (int y = 0; y < yblocks; ++y)
+        if (getCompressionFlags() & TextureCompressionInfo::SURFACE)
         {
-            queue.enqueue([this, y, xblocks, &surface, address]
+            if (direct)
             {
-                Bitmap temp(width, height, format);
-                uint8* data = address + y * xblocks * bytes;
-
-                for (int x = 0; x < xblocks; ++x)
-                {
-                    Surface source(surface, x * width, y * height, width, height);
-                    temp.blit(0, 0, source);
-
-                    uint8* image = temp.address<uint8>();
-                    encode(*this, data, image, temp.stride);
-                    data += bytes;
-                }
-            });
+                directSurfaceEncode(*this, surface, memory, xsize, ysize, quality);
+            }
+            else
+            {
+                clipConvertSurfaceEncode(*this, surface, memory, xsize, ysize, quality);
+            }
+        }
+        else
+        {
+            if (direct)
+            {
+                directBlockEncode(*this, surface, memory, xsize, ysize, quality);
+            }
+            else
+            {
+                clipConvertBlockEncode(*this, surface, memory, xsize, ysize, quality);
+            }
         }
-
-        queue.wait();
     }
 
 } // namespace mango
@@ -0,0 +1,1585 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <mango/core/bits.hpp>
+#include <mango/math/math.hpp>
+#include <mango/image/compression.hpp>
+
+namespace
+{
+    using namespace mango;
+
+    // ------------------------------------------------------------
+    // ASTC LDR encoder
+    // ------------------------------------------------------------
+
+    // The encoder fits endpoint lines to the block (one or two partitions), ranks the
+    // legal block modes of the footprint with an error estimate and encodes the best
+    // ranked modes fully. The effort decides how many modes and partitionings are tried.
+
+    enum Effort
+    {
+        EFFORT_FAST,    // single partition, two best ranked modes
+        EFFORT_NORMAL,  // adds two partitions, dual plane alpha and an endpoint refit
+        EFFORT_HIGH     // more modes and partitionings and iterative refinement
+    };
+
+    Effort getEffort(float quality)
+    {
+        // same tiers as TextureCompressionInfo::compress() uses to select the BC encoders
+        if (quality < 1.0f / 3.0f)
+            return EFFORT_FAST;
+        if (quality < 2.0f / 3.0f)
+            return EFFORT_NORMAL;
+        return EFFORT_HIGH;
+    }
+
+    enum
+    {
+        MAX_TEXELS = 12 * 12,
+        MAX_WEIGHTS = 64
+    };
+
+    inline float hsum(float32x4 v)
+    {
+        return float(v.x) + float(v.y) + float(v.z) + float(v.w);
+    }
+
+    inline float dot4(float32x4 a, float32x4 b)
+    {
+        return float(dot(a, b).x);
+    }
+
+    // ------------------------------------------------------------
+    // integer sequence encoding
+    // ------------------------------------------------------------
+
+    struct ISE
+    {
+        int base; // 1: bits only, 3: trits, 5: quints
+        int bits;
+
+        int levels() const
+        {
+            return base << bits;
+        }
+
+        int size(int count) const
+        {
+            switch (base)
+            {
+                case 3: return (count * 8 + 4) / 5 + count * bits;
+                case 5: return (count * 7 + 2) / 3 + count * bits;
+                default: return count * bits;
+            }
+        }
+    };
+
+    // weight quantization levels: 2, 3, 4, 5, 6, 8, 10, 12, 16, 20, 24, 32
+    const ISE weightISE[12] =
+    {
+        { 1, 1 }, { 3, 0 }, { 1, 2 }, { 5, 0 }, { 3, 1 }, { 1, 3 },
+        { 5, 1 }, { 3, 2 }, { 1, 4 }, { 5, 2 }, { 3, 3 }, { 1, 5 }
+    };
+
+    // The largest color quantization that fits in the available bits; the search order
+    // must match the decoder.
+    ISE computeColorISE(int bits, int count)
+    {
+        int tritBits = 6;
+        int quintBits = 5;
+        int plainBits = 8;
+
+        for (;;)
+        {
+            const int tritRange = tritBits > 0 ? (3 << tritBits) - 1 : -1;
+            const int quintRange = quintBits > 0 ? (5 << quintBits) - 1 : -1;
+            const int plainRange = plainBits > 0 ? (1 << plainBits) - 1 : -1;
+            const int maxRange = std::max(std::max(tritRange, quintRange), plainRange);
+
+            if (maxRange == tritRange)
+            {
+                const ISE ise = { 3, tritBits };
+                if (ise.size(count) <= bits)
+                    return ise;
+                --tritBits;
+            }
+            else if (maxRange == quintRange)
+            {
+                const ISE ise = { 5, quintBits };
+                if (ise.size(count) <= bits)
+                    return ise;
+                --quintBits;
+            }
+            else
+            {
+                const ISE ise = { 1, plainBits };
+                if (ise.size(count) <= bits)
+                    return ise;
+                --plainBits;
+            }
+        }
+    }
+
+    inline int colorQuantIndex(const ISE& ise)
+    {
+        switch (ise.base)
+        {
+            case 3: return 7 + ise.bits;
+            case 5: return 13 + ise.bits;
+            default: return ise.bits - 1;
+        }
+    }
+
+    inline ISE colorQuantISE(int index)
+    {
+        return index < 8 ? ISE { 1, index + 1 } : index < 14 ? ISE { 3, index - 7 } : ISE { 5, index - 13 };
+    }
+
+    inline int bitReplicate(int value, int bits, int target)
+    {
+        int result = 0;
+        for (int shift = target - bits; shift > -bits; shift -= bits)
+        {
+            result |= shift >= 0 ? value << shift : value >> -shift;
+        }
+        return result;
+    }
+
+    int unquantizeColor(const ISE& ise, int value)
+    {
+        if (ise.base == 1)
+            return bitReplicate(value, ise.bits, 8);
+
+        static const int table[11] = { 204, 113, 93, 54, 44, 26, 22, 13, 11, 6, 5 };
+
+        const int m = value & ((1 << ise.bits) - 1);
+        const int tq = value >> ise.bits;
+        const int rangeCase = ise.bits * 2 - (ise.base == 3 ? 2 : 1);
+
+        const int a = (m >> 0) & 1;
+        const int b = (m >> 1) & 1;
+        const int c = (m >> 2) & 1;
+        const int d = (m >> 3) & 1;
+        const int e = (m >> 4) & 1;
+        const int f = (m >> 5) & 1;
+
+        int B = 0;
+        switch (rangeCase)
+        {
+            case 2:  B = (b << 8) | (b << 4) | (b << 2) | (b << 1); break;
+            case 3:  B = (b << 8) | (b << 3) | (b << 2); break;
+            case 4:  B = (c << 8) | (b << 7) | (c << 3) | (b << 2) | (c << 1) | (b << 0); break;
+            case 5:  B = (c << 8) | (b << 7) | (c << 2) | (b << 1) | (c << 0); break;
+            case 6:  B = (d << 8) | (c << 7) | (b << 6) | (d << 2) | (c << 1) | (b << 0); break;
+            case 7:  B = (d << 8) | (c << 7) | (b << 6) | (d << 1) | (c << 0); break;
+            case 8:  B = (e << 8) | (d << 7) | (c << 6) | (b << 5) | (e << 1) | (d << 0); break;
+            case 9:  B = (e << 8) | (d << 7) | (c << 6) | (b << 5) | (e << 0); break;
+            case 10: B = (f << 8) | (e << 7) | (d << 6) | (c << 5) | (b << 4) | (f << 0); break;
+            default: break;
+        }
+
+        const int A = a ? 0x1ff : 0;
+        return (((tq * table[rangeCase] + B) ^ A) >> 2) | (A & 0x80);
+    }
+
+    int unquantizeWeight(const ISE& ise, int value)
+    {
+        int result;
+
+        if (ise.base == 1)
+        {
+            result = bitReplicate(value, ise.bits, 6);
+        }
+        else
+        {
+            const int rangeCase = ise.bits * 2 + (ise.base == 5 ? 1 : 0);
+
+            if (rangeCase == 0)
+            {
+                static const int map[3] = { 0, 32, 63 };
+                result = map[value];
+            }
+            else if (rangeCase == 1)
+            {
+                static const int map[5] = { 0, 16, 32, 47, 63 };
+                result = map[value];
+            }
+            else
+            {
+                static const int table[5] = { 50, 28, 23, 13, 11 };
+
+                const int m = value & ((1 << ise.bits) - 1);
+                const int tq = value >> ise.bits;
+                const int a = (m >> 0) & 1;
+                const int b = (m >> 1) & 1;
+                const int c = (m >> 2) & 1;
+
+                int B = 0;
+                switch (rangeCase)
+                {
+                    case 4: B = (b << 6) | (b << 2) | (b << 0); break;
+                    case 5: B = (b << 6) | (b << 1); break;
+                    case 6: B = (c << 6) | (b << 5) | (c << 1) | (b << 0); break;
+                    default: break;
+                }
+
+                const int A = a ? 0x7f : 0;
+                result = (((tq * table[rangeCase - 2] + B) ^ A) >> 2) | (A & 0x20);
+            }
+        }
+
+        return result + (result > 32 ? 1 : 0);
+    }
+
+    void decodeTrits(int* t, int T)
+    {
+        int C;
+
+        if (((T >> 2) & 7) == 7)
+        {
+            C = (((T >> 5) & 7) << 2) | (T & 3);
+            t[4] = 2;
+            t[3] = 2;
+        }
+        else
+        {
+            C = T & 0x1f;
+            if (((T >> 5) & 3) == 3)
+            {
+                t[4] = 2;
+                t[3] = (T >> 7) & 1;
+            }
+            else
+            {
+                t[4] = (T >> 7) & 1;
+                t[3] = (T >> 5) & 3;
+            }
+        }
+
+        const int c0 = (C >> 0) & 1;
+        const int c1 = (C >> 1) & 1;
+        const int c2 = (C >> 2) & 1;
+        const int c3 = (C >> 3) & 1;
+
+        if ((C & 3) == 3)
+        {
+            t[2] = 2;
+            t[1] = (C >> 4) & 1;
+            t[0] = (c3 << 1) | (c2 & ~c3 & 1);
+        }
+        else if (((C >> 2) & 3) == 3)
+        {
+            t[2] = 2;
+            t[1] = 2;
+            t[0] = C & 3;
+        }
+        else
+        {
+            t[2] = (C >> 4) & 1;
+            t[1] = (C >> 2) & 3;
+            t[0] = (c1 << 1) | (c0 & ~c1 & 1);
+        }
+    }
+
+    void decodeQuints(int* q, int Q)
+    {
+        if (((Q >> 1) & 3) == 3 && ((Q >> 5) & 3) == 0)
+        {
+            const int q0 = Q & 1;
+            q[2] = (q0 << 2) | ((((Q >> 4) & 1) & ~q0 & 1) << 1) | (((Q >> 3) & 1) & ~q0 & 1);
+            q[1] = 4;
+            q[0] = 4;
+        }
+        else
+        {
+            int C;
+
+            if (((Q >> 1) & 3) == 3)
+            {
+                q[2] = 4;
+                C = (((Q >> 3) & 3) << 3) | ((~(Q >> 5) & 3) << 1) | (Q & 1);
+            }
+            else
+            {
+                q[2] = (Q >> 5) & 3;
+                C = Q & 0x1f;
+            }
+
+            if ((C & 7) == 5)
+            {
+                q[1] = 4;
+                q[0] = (C >> 3) & 3;
+            }
+            else
+            {
+                q[1] = (C >> 3) & 3;
+                q[0] = C & 7;
+            }
+        }
+    }
+
+    // Returns false for reserved and void extent modes.
+    bool decodeBlockMode(int mode, int& width, int& height, int& quant, bool& dual)
+    {
+        if ((mode & 0x1ff) == 0x1fc)
+            return false;
+
+        if (((mode & 3) == 0 && ((mode >> 6) & 7) == 7) || (mode & 15) == 0)
+            return false;
+
+        int r;
+
+        if ((mode & 3) == 0)
+        {
+            r = (((mode >> 2) & 3) << 1) | ((mode >> 4) & 1);
+            const int i78 = (mode >> 7) & 3;
+            const int a = (mode >> 5) & 3;
+
+            switch (i78)
+            {
+                case 0: width = 12; height = a + 2; break;
+                case 1: width = a + 2; height = 12; break;
+                case 2: width = a + 6; height = ((mode >> 9) & 3) + 6; break;
+                default:
+                    width = (mode & 0x20) ? 10 : 6;
+                    height = (mode & 0x20) ? 6 : 10;
+                    break;
+            }
+        }
+        else
+        {
+            r = ((mode & 3) << 1) | ((mode >> 4) & 1);
+            const int i23 = (mode >> 2) & 3;
+            const int a = (mode >> 5) & 3;
+
+            if (i23 == 3)
+            {
+                const int b = (mode >> 7) & 1;
+                if (mode & 0x100)
+                {
+                    width = b + 2;
+                    height = a + 2;
+                }
+                else
+                {
+                    width = a + 2;
+                    height = b + 6;
+                }
+            }
+            else
+            {
+                const int b = (mode >> 7) & 3;
+                switch (i23)
+                {
+                    case 0: width = b + 4; height = a + 2; break;
+                    case 1: width = b + 8; height = a + 2; break;
+                    default: width = a + 2; height = b + 8; break;
+                }
+            }
+        }
+
+        if (r < 2)
+            return false;
+
+        const bool zeroDH = (mode & 3) == 0 && ((mode >> 7) & 3) == 2;
+        const int h = zeroDH ? 0 : (mode >> 9) & 1;
+        dual = zeroDH ? false : ((mode >> 10) & 1) != 0;
+        quant = h * 6 + r - 2;
+
+        return true;
+    }
+
+    uint32 hash52(uint32 p)
+    {
+        p ^= p >> 15;  p -= p << 17;  p += p << 7;  p += p << 4;
+        p ^= p >>  5;  p += p << 16;  p ^= p >> 7;  p ^= p >> 3;
+        p ^= p <<  6;  p ^= p >> 17;
+        return p;
+    }
+
+    int computePartition(uint32 seed, uint32 x, uint32 y, int partitions, bool smallBlock)
+    {
+        if (smallBlock)
+        {
+            x <<= 1;
+            y <<= 1;
+        }
+
+        seed += 1024 * (partitions - 1);
+        const uint32 rnum = hash52(seed);
+
+        uint8 s[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            s[i] = (rnum >> (i * 4)) & 0xf;
+            s[i] *= s[i];
+        }
+
+        const int shA = (seed & 2) != 0 ? 4 : 5;
+        const int shB = partitions == 3 ? 6 : 5;
+        const int sh1 = (seed & 1) != 0 ? shA : shB;
+        const int sh2 = (seed & 1) != 0 ? shB : shA;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            s[i] >>= (i & 1) ? sh2 : sh1;
+        }
+
+        const int a = 0x3f & (s[0] * x + s[1] * y + (rnum >> 14));
+        const int b = 0x3f & (s[2] * x + s[3] * y + (rnum >> 10));
+        const int c = partitions >= 3 ? 0x3f & (s[4] * x + s[5] * y + (rnum >> 6)) : 0;
+        const int d = partitions >= 4 ? 0x3f & (s[6] * x + s[7] * y + (rnum >> 2)) : 0;
+
+        return a >= b && a >= c && a >= d ? 0 : b >= c && b >= d ? 1 : c >= d ? 2 : 3;
+    }
+
+    // ------------------------------------------------------------
+    // footprint tables
+    // ------------------------------------------------------------
+
+    struct Grid
+    {
+        int width;
+        int height;
+        uint8 index[MAX_TEXELS][4];
+        uint8 factor[MAX_TEXELS][4];
+    };
+
+    struct Mode
+    {
+        int grid;
+        int quant;
+        bool dual;
+        int bits;
+        int weightBits;
+    };
+
+    struct Pattern
+    {
+        int seed;
+        uint8 partition[MAX_TEXELS];
+        uint64 mask[3];
+    };
+
+    struct Footprint
+    {
+        int width;
+        int height;
+        int texels;
+        std::vector<Grid> grids;
+        std::vector<Mode> modes;
+        std::vector<Pattern> patterns; // unique two partition patterns
+    };
+
+    struct Tables
+    {
+        uint8 tritEncode[3][3][3][3][3];
+        uint8 quintEncode[5][5][5];
+        uint8 weightUnquantize[12][32];
+        uint8 weightQuantize[12][65];
+        uint8 colorUnquantize[19][256];
+        uint8 colorQuantize[19][256];
+        int16 blockMode[2][12][13][13]; // [dual][quant][width][height]
+        int8 colorQuant[128][19];       // [bits][values], -1 when the values don't fit
+        std::vector<Footprint> footprints;
+
+        Tables()
+        {
+            for (int T = 255; T >= 0; --T)
+            {
+                // the smallest encoding wins; it leaves the unused high bits zero
+                int t[5];
+                decodeTrits(t, T);
+                tritEncode[t[0]][t[1]][t[2]][t[3]][t[4]] = uint8(T);
+            }
+
+            for (int Q = 127; Q >= 0; --Q)
+            {
+                int q[3];
+                decodeQuints(q, Q);
+                quintEncode[q[0]][q[1]][q[2]] = uint8(Q);
+            }
+
+            for (int i = 0; i < 12; ++i)
+            {
+                const ISE& ise = weightISE[i];
+                const int levels = ise.levels();
+
+                for (int v = 0; v < levels; ++v)
+                {
+                    weightUnquantize[i][v] = uint8(unquantizeWeight(ise, v));
+                }
+
+                for (int x = 0; x <= 64; ++x)
+                {
+                    int best = 0;
+                    for (int v = 1; v < levels; ++v)
+                    {
+                        if (std::abs(weightUnquantize[i][v] - x) < std::abs(weightUnquantize[i][best] - x))
+                            best = v;
+                    }
+                    weightQuantize[i][x] = uint8(best);
+                }
+            }
+
+            for (int i = 0; i < 19; ++i)
+            {
+                const ISE ise = colorQuantISE(i);
+                const int levels = ise.levels();
+
+                for (int v = 0; v < levels; ++v)
+                {
+                    colorUnquantize[i][v] = uint8(unquantizeColor(ise, v));
+                }
+
+                for (int x = 0; x < 256; ++x)
+                {
+                    int best = 0;
+                    for (int v = 1; v < levels; ++v)
+                    {
+                        if (std::abs(colorUnquantize[i][v] - x) < std::abs(colorUnquantize[i][best] - x))
+                            best = v;
+                    }
+                    colorQuantize[i][x] = uint8(best);
+                }
+            }
+
+            for (int bits = 0; bits < 128; ++bits)
+            {
+                for (int values = 0; values < 19; ++values)
+                {
+                    const bool valid = values > 0 && bits >= (13 * values + 4) / 5;
+                    colorQuant[bits][values] = int8(valid ? colorQuantIndex(computeColorISE(bits, values)) : -1);
+                }
+            }
+
+            std::fill_n(&blockMode[0][0][0][0], 2 * 12 * 13 * 13, int16(-1));
+
+            for (int mode = 0; mode < 2048; ++mode)
+            {
+                int width;
+                int height;
+                int quant;
+                bool dual;
+
+                if (decodeBlockMode(mode, width, height, quant, dual))
+                {
+                    int16& value = blockMode[dual][quant][width][height];
+                    if (value < 0)
+                        value = int16(mode);
+                }
+            }
+
+            const int sizes[][2] =
+            {
+                { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+                { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 }
+            };
+
+            footprints.resize(14);
+            for (int i = 0; i < 14; ++i)
+            {
+                initFootprint(footprints[i], sizes[i][0], sizes[i][1]);
+            }
+        }
+
+        void initFootprint(Footprint& fp, int width, int height)
+        {
+            fp.width = width;
+            fp.height = height;
+            fp.texels = width * height;
+
+            // weight grids and their texel interpolation
+            for (int gw = 2; gw <= width; ++gw)
+            {
+                for (int gh = 2; gh <= height; ++gh)
+                {
+                    if (gw * gh > MAX_WEIGHTS)
+                        continue;
+
+                    Grid grid;
+                    grid.width = gw;
+                    grid.height = gh;
+
+                    const int scaleX = (1024 + width / 2) / (width - 1);
+                    const int scaleY = (1024 + height / 2) / (height - 1);
+
+                    for (int y = 0; y < height; ++y)
+                    {
+                        for (int x = 0; x < width; ++x)
+                        {
+                            const int gx = (scaleX * x * (gw - 1) + 32) >> 6;
+                            const int gy = (scaleY * y * (gh - 1) + 32) >> 6;
+                            const int jx = gx >> 4;
+                            const int jy = gy >> 4;
+                            const int fx = gx & 0xf;
+                            const int fy = gy & 0xf;
+                            const int w11 = (fx * fy + 8) >> 4;
+                            const int w10 = fy - w11;
+                            const int w01 = fx - w11;
+                            const int w00 = 16 - fx - fy + w11;
+                            const int v0 = jy * gw + jx;
+
+                            const int index[] = { v0, v0 + 1, v0 + gw, v0 + gw + 1 };
+                            const int factor[] = { w00, w01, w10, w11 };
+
+                            const int t = y * width + x;
+                            for (int k = 0; k < 4; ++k)
+                            {
+                                // zero factors may point outside of the grid
+                                grid.index[t][k] = uint8(factor[k] ? index[k] : v0);
+                                grid.factor[t][k] = uint8(factor[k]);
+                            }
+                        }
+                    }
+
+                    const int gridIndex = int(fp.grids.size());
+                    bool used = false;
+
+                    for (int dual = 0; dual < 2; ++dual)
+                    {
+                        const int weights = gw * gh * (dual + 1);
+                        if (weights > MAX_WEIGHTS)
+                            continue;
+
+                        for (int quant = 0; quant < 12; ++quant)
+                        {
+                            const int bits = blockMode[dual][quant][gw][gh];
+                            const int weightBits = weightISE[quant].size(weights);
+
+                            if (bits < 0 || weightBits < 24 || weightBits > 96)
+                                continue;
+
+                            Mode mode;
+                            mode.grid = gridIndex;
+                            mode.quant = quant;
+                            mode.dual = dual != 0;
+                            mode.bits = bits;
+                            mode.weightBits = weightBits;
+                            fp.modes.push_back(mode);
+                            used = true;
+                        }
+                    }
+
+                    if (used)
+                        fp.grids.push_back(grid);
+                }
+            }
+
+            // two partition patterns
+            const bool smallBlock = fp.texels < 31;
+
+            for (int seed = 0; seed < 1024; ++seed)
+            {
+                Pattern pattern;
+                pattern.seed = seed;
+                pattern.mask[0] = 0;
+                pattern.mask[1] = 0;
+                pattern.mask[2] = 0;
+
+                int count = 0;
+
+                for (int y = 0; y < height; ++y)
+                {
+                    for (int x = 0; x < width; ++x)
+                    {
+                        const int t = y * width + x;
+                        const int p = computePartition(seed, x, y, 2, smallBlock);
+                        pattern.partition[t] = uint8(p);
+                        pattern.mask[t >> 6] |= uint64(p) << (t & 63);
+                        count += p;
+                    }
+                }
+
+                if (count == 0 || count == fp.texels)
+                    continue;
+
+                bool duplicate = false;
+                for (const Pattern& other : fp.patterns)
+                {
+                    uint64 diff = 0;
+                    uint64 inverse = 0;
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        const uint64 valid = i * 64 + 64 <= fp.texels ? ~0ull : (1ull << std::max(0, fp.texels - i * 64)) - 1;
+                        diff |= (other.mask[i] ^ pattern.mask[i]) & valid;
+                        inverse |= (~other.mask[i] ^ pattern.mask[i]) & valid;
+                    }
+
+                    if (!diff || !inverse)
+                    {
+                        duplicate = true;
+                        break;
+                    }
+                }
+
+                if (!duplicate)
+                    fp.patterns.push_back(pattern);
+            }
+        }
+
+        const Footprint* getFootprint(int width, int height) const
+        {
+            for (const Footprint& fp : footprints)
+            {
+                if (fp.width == width && fp.height == height)
+                    return &fp;
+            }
+            return nullptr;
+        }
+    };
+
+    const Tables& getTables()
+    {
+        static const Tables* tables = new Tables();
+        return *tables;
+    }
+
+    // ------------------------------------------------------------
+    // block writer
+    // ------------------------------------------------------------
+
+    inline void writeBits(uint8* block, int position, int count, uint32 value)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            const int bit = position + i;
+            block[bit >> 3] |= uint8(((value >> i) & 1) << (bit & 7));
+        }
+    }
+
+    // The weights are stored in reverse bit order starting from the last bit of the block.
+    void writeSequence(uint8* block, int position, bool reverse, const ISE& ise, const uint8* values, int count)
+    {
+        const Tables& tables = getTables();
+        const int length = ise.size(count);
+        const int mask = (1 << ise.bits) - 1;
+        int offset = 0;
+
+        auto emit = [&] (int value, int bits)
+        {
+            for (int i = 0; i < bits && offset < length; ++i, ++offset)
+            {
+                const int bit = reverse ? position - offset : position + offset;
+                block[bit >> 3] |= uint8(((value >> i) & 1) << (bit & 7));
+            }
+        };
+
+        switch (ise.base)
+        {
+            case 3:
+                for (int i = 0; i < count; i += 5)
+                {
+                    int m[5] = { 0, 0, 0, 0, 0 };
+                    int t[5] = { 0, 0, 0, 0, 0 };
+
+                    for (int j = 0; j < 5 && i + j < count; ++j)
+                    {
+                        m[j] = values[i + j] & mask;
+                        t[j] = values[i + j] >> ise.bits;
+                    }
+
+                    const int T = tables.tritEncode[t[0]][t[1]][t[2]][t[3]][t[4]];
+                    emit(m[0], ise.bits);
+                    emit(T >> 0, 2);
+                    emit(m[1], ise.bits);
+                    emit(T >> 2, 2);
+                    emit(m[2], ise.bits);
+                    emit(T >> 4, 1);
+                    emit(m[3], ise.bits);
+                    emit(T >> 5, 2);
+                    emit(m[4], ise.bits);
+                    emit(T >> 7, 1);
+                }
+                break;
+
+            case 5:
+                for (int i = 0; i < count; i += 3)
+                {
+                    int m[3] = { 0, 0, 0 };
+                    int q[3] = { 0, 0, 0 };
+
+                    for (int j = 0; j < 3 && i + j < count; ++j)
+                    {
+                        m[j] = values[i + j] & mask;
+                        q[j] = values[i + j] >> ise.bits;
+                    }
+
+                    const int Q = tables.quintEncode[q[0]][q[1]][q[2]];
+                    emit(m[0], ise.bits);
+                    emit(Q >> 0, 3);
+                    emit(m[1], ise.bits);
+                    emit(Q >> 3, 2);
+                    emit(m[2], ise.bits);
+                    emit(Q >> 5, 2);
+                }
+                break;
+
+            default:
+                for (int i = 0; i < count; ++i)
+                {
+                    emit(values[i], ise.bits);
+                }
+                break;
+        }
+    }
+
+    // ------------------------------------------------------------
+    // block encoder
+    // ------------------------------------------------------------
+
+    struct Config
+    {
+        int partitions;
+        int cem;                // 0: L, 4: LA, 8: RGB, 12: RGBA
+        bool dual;              // alpha in the second weight plane
+        const Pattern* pattern; // two partitions
+
+        int values() const
+        {
+            return (cem / 4 + 1) * 2;
+        }
+
+        int configBits() const
+        {
+            return (partitions == 1 ? 17 : 29) + (dual ? 2 : 0);
+        }
+
+        int partition(int texel) const
+        {
+            return pattern ? pattern->partition[texel] : 0;
+        }
+    };
+
+    struct Endpoints
+    {
+        float32x4 e0[2];
+        float32x4 e1[2];
+    };
+
+    class BlockEncoder
+    {
+    protected:
+        const Tables& tables;
+        const Footprint& footprint;
+        Effort effort;
+
+        int count;
+        float32x4 color[MAX_TEXELS];
+        bool opaque;
+        bool grey;
+
+        float bestError;
+        uint8 bestBlock[16];
+
+        float32x4 channelMask(const Config& config, int plane) const
+        {
+            if (config.dual)
+                return plane ? float32x4(0.0f, 0.0f, 0.0f, 1.0f) : float32x4(1.0f, 1.0f, 1.0f, 0.0f);
+            else
+                return config.cem == 12 || config.cem == 4 ? float32x4(1.0f) : float32x4(1.0f, 1.0f, 1.0f, 0.0f);
+        }
+
+        void fitEndpoints(Endpoints& ep, const Config& config) const
+        {
+            const float32x4 mask = channelMask(config, 0);
+
+            for (int p = 0; p < config.partitions; ++p)
+            {
+                float32x4 mean(0.0f);
+                int n = 0;
+
+                for (int t = 0; t < count; ++t)
+                {
+                    if (config.partition(t) == p)
+                    {
+                        mean += color[t];
+                        ++n;
+                    }
+                }
+
+                mean = mean / float(std::max(1, n));
+
+                float32x4 c0(0.0f);
+                float32x4 c1(0.0f);
+                float32x4 c2(0.0f);
+                float32x4 c3(0.0f);
+                float32x4 low(255.0f);
+                float32x4 high(0.0f);
+
+                for (int t = 0; t < count; ++t)
+                {
+                    if (config.partition(t) == p)
+                    {
+                        const float32x4 d = (color[t] - mean) * mask;
+                        c0 += d * d.xxxx;
+                        c1 += d * d.yyyy;
+                        c2 += d * d.zzzz;
+                        c3 += d * d.wwww;
+                        low = min(low, color[t]);
+                        high = max(high, color[t]);
+                    }
+                }
+
+                // principal axis with power iteration from the bounding box diagonal
+                float32x4 axis = (high - low) * mask;
+
+                for (int i = 0; i < 6; ++i)
+                {
+                    const float32x4 next = c0 * axis.xxxx + c1 * axis.yyyy + c2 * axis.zzzz + c3 * axis.wwww;
+                    const float length2 = dot4(next, next);
+                    if (length2 < 1e-8f)
+                        break;
+                    axis = next * (1.0f / std::sqrt(length2));
+                }
+
+                const float length2 = dot4(axis, axis);
+                float tmin = 0.0f;
+                float tmax = 0.0f;
+
+                if (length2 > 1e-8f)
+                {
+                    axis = axis * (1.0f / std::sqrt(length2));
+                    tmin = 1e30f;
+                    tmax = -1e30f;
+
+                    for (int t = 0; t < count; ++t)
+                    {
+                        if (config.partition(t) == p)
+                        {
+                            const float s = dot4(color[t] - mean, axis);
+                            tmin = std::min(tmin, s);
+                            tmax = std::max(tmax, s);
+                        }
+                    }
+                }
+
+                ep.e0[p] = clamp(mean + axis * tmin, float32x4(0.0f), float32x4(255.0f));
+                ep.e1[p] = clamp(mean + axis * tmax, float32x4(0.0f), float32x4(255.0f));
+
+                if (config.dual)
+                {
+                    // the alpha plane spans the alpha range of the partition
+                    ep.e0[p].w = float(low.w);
+                    ep.e1[p].w = float(high.w);
+                }
+            }
+        }
+
+        // Quantizes the endpoints of one partition; returns the decoded endpoints.
+        void quantizeEndpoints(uint8* values, float32x4& q0, float32x4& q1, float32x4 e0, float32x4 e1, int cem, int quant) const
+        {
+            const uint8* quantize = tables.colorQuantize[quant];
+            const uint8* unquantize = tables.colorUnquantize[quant];
+
+            auto Q = [=] (float value) -> int
+            {
+                return quantize[std::max(0, std::min(255, int(value + 0.5f)))];
+            };
+
+            float a[4];
+            float b[4];
+            a[0] = e0.x; a[1] = e0.y; a[2] = e0.z; a[3] = e0.w;
+            b[0] = e1.x; b[1] = e1.y; b[2] = e1.z; b[3] = e1.w;
+
+            switch (cem)
+            {
+                case 0:
+                case 4:
+                {
+                    values[0] = uint8(Q((a[0] + a[1] + a[2]) / 3.0f));
+                    values[1] = uint8(Q((b[0] + b[1] + b[2]) / 3.0f));
+                    const float l0 = unquantize[values[0]];
+                    const float l1 = unquantize[values[1]];
+                    float a0 = 255.0f;
+                    float a1 = 255.0f;
+
+                    if (cem == 4)
+                    {
+                        values[2] = uint8(Q(a[3]));
+                        values[3] = uint8(Q(b[3]));
+                        a0 = unquantize[values[2]];
+                        a1 = unquantize[values[3]];
+                    }
+
+                    q0 = float32x4(l0, l0, l0, a0);
+                    q1 = float32x4(l1, l1, l1, a1);
+                    break;
+                }
+
+                default:
+                {
+                    const int channels = cem == 12 ? 4 : 3;
+                    int v0[4];
+                    int v1[4];
+                    int s0 = 0;
+                    int s1 = 0;
+
+                    for (int c = 0; c < channels; ++c)
+                    {
+                        v0[c] = Q(a[c]);
+                        v1[c] = Q(b[c]);
+                        if (c < 3)
+                        {
+                            s0 += unquantize[v0[c]];
+                            s1 += unquantize[v1[c]];
+                        }
+                    }
+
+                    if (s1 < s0)
+                    {
+                        // a smaller second endpoint selects blue contraction; swap the
+                        // endpoints instead, the weights are computed afterwards
+                        for (int c = 0; c < channels; ++c)
+                        {
+                            std::swap(v0[c], v1[c]);
+                        }
+                    }
+
+                    float d0[4] = { 0, 0, 0, 255 };
+                    float d1[4] = { 0, 0, 0, 255 };
+
+                    for (int c = 0; c < channels; ++c)
+                    {
+                        values[c * 2 + 0] = uint8(v0[c]);
+                        values[c * 2 + 1] = uint8(v1[c]);
+                        d0[c] = unquantize[v0[c]];
+                        d1[c] = unquantize[v1[c]];
+                    }
+
+                    q0 = float32x4(d0[0], d0[1], d0[2], d0[3]);
+                    q1 = float32x4(d1[0], d1[1], d1[2], d1[3]);
+                    break;
+                }
+            }
+        }
+
+        // Projects the texels on the endpoint lines; the weights are in the 0..64 range.
+        void idealWeights(float* weights, const Config& config, int plane, const float32x4* e0, const float32x4* e1) const
+        {
+            const float32x4 mask = channelMask(config, plane);
+            float32x4 axis[2];
+            float scale[2];
+
+            for (int p = 0; p < config.partitions; ++p)
+            {
+                axis[p] = (e1[p] - e0[p]) * mask;
+                const float length2 = dot4(axis[p], axis[p]);
+                scale[p] = length2 > 1e-8f ? 64.0f / length2 : 0.0f;
+            }
+
+            for (int t = 0; t < count; ++t)
+            {
+                const int p = config.partition(t);
+                const float w = dot4(color[t] - e0[p], axis[p]) * scale[p];
+                weights[t] = std::max(0.0f, std::min(64.0f, w));
+            }
+        }
+
+        void decimate(float* values, const float* weights, const Grid& grid, int iterations) const
+        {
+            const int size = grid.width * grid.height;
+
+            float sum[MAX_WEIGHTS];
+            float total[MAX_WEIGHTS];
+
+            std::fill_n(sum, size, 0.0f);
+            std::fill_n(total, size, 0.0f);
+
+            for (int t = 0; t < count; ++t)
+            {
+                for (int k = 0; k < 4; ++k)
+                {
+                    const float f = grid.factor[t][k];
+                    sum[grid.index[t][k]] += f * weights[t];
+                    total[grid.index[t][k]] += f;
+                }
+            }
+
+            for (int i = 0; i < size; ++i)
+            {
+                values[i] = total[i] > 0.0f ? sum[i] / total[i] : 0.0f;
+            }
+
+            for (int iteration = 0; iteration < iterations; ++iteration)
+            {
+                // back-project the interpolation residual
+                std::fill_n(sum, size, 0.0f);
+
+                for (int t = 0; t < count; ++t)
+                {
+                    const float residual = weights[t] - interpolate(values, grid, t);
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        sum[grid.index[t][k]] += grid.factor[t][k] * residual;
+                    }
+                }
+
+                for (int i = 0; i < size; ++i)
+                {
+                    values[i] = std::max(0.0f, std::min(64.0f, values[i] + (total[i] > 0.0f ? sum[i] / total[i] : 0.0f)));
+                }
+            }
+        }
+
+        static float interpolate(const float* values, const Grid& grid, int t)
+        {
+            float s = 0.0f;
+            for (int k = 0; k < 4; ++k)
+            {
+                s += grid.factor[t][k] * values[grid.index[t][k]];
+            }
+            return s * (1.0f / 16.0f);
+        }
+
+        // Least squares endpoints for the decoded weights.
+        void refitEndpoints(Endpoints& ep, const Config& config, const float* weights0, const float* weights1) const
+        {
+            for (int p = 0; p < config.partitions; ++p)
+            {
+                float32x4 s00(0.0f);
+                float32x4 s01(0.0f);
+                float32x4 s11(0.0f);
+                float32x4 r0(0.0f);
+                float32x4 r1(0.0f);
+
+                for (int t = 0; t < count; ++t)
+                {
+                    if (config.partition(t) != p)
+                        continue;
+
+                    const float w0 = weights0[t] * (1.0f / 64.0f);
+                    const float w1 = config.dual ? weights1[t] * (1.0f / 64.0f) : w0;
+                    const float32x4 w(w0, w0, w0, w1);
+                    const float32x4 iw = float32x4(1.0f) - w;
+
+                    s00 += iw * iw;
+                    s01 += iw * w;
+                    s11 += w * w;
+                    r0 += iw * color[t];
+                    r1 += w * color[t];
+                }
+
+                const float32x4 det = s00 * s11 - s01 * s01;
+                const mask32x4 valid = abs(det) > float32x4(1e-4f);
+                const float32x4 d = select(valid, det, float32x4(1.0f));
+
+                const float32x4 a = (r0 * s11 - r1 * s01) / d;
+                const float32x4 b = (r1 * s00 - r0 * s01) / d;
+
+                ep.e0[p] = select(valid, clamp(a, float32x4(0.0f), float32x4(255.0f)), ep.e0[p]);
+                ep.e1[p] = select(valid, clamp(b, float32x4(0.0f), float32x4(255.0f)), ep.e1[p]);
+            }
+        }
+
+        int colorQuant(const Config& config, const Mode& mode) const
+        {
+            const int bits = 128 - mode.weightBits - config.configBits();
+            return tables.colorQuant[bits][config.values() * config.partitions];
+        }
+
+        float encodeMode(const Config& config, const Mode& mode, Endpoints ep)
+        {
+            const Grid& grid = footprint.grids[mode.grid];
+            const int quant = colorQuant(config, mode);
+            const ISE ise = colorQuantISE(quant);
+            const int gridSize = grid.width * grid.height;
+            const int planes = config.dual ? 2 : 1;
+            const int passes = effort == EFFORT_HIGH ? 3 : effort == EFFORT_NORMAL ? 2 : 1;
+            const int iterations = effort == EFFORT_HIGH ? 2 : 0;
+
+            float error = 1e30f;
+
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                uint8 values[16];
+                float32x4 q0[2];
+                float32x4 q1[2];
+
+                for (int p = 0; p < config.partitions; ++p)
+                {
+                    quantizeEndpoints(values + p * config.values(), q0[p], q1[p], ep.e0[p], ep.e1[p], config.cem, quant);
+                }
+
+                uint8 weights[MAX_WEIGHTS];
+                float decoded[2][MAX_TEXELS];
+
+                for (int plane = 0; plane < planes; ++plane)
+                {
+                    float ideal[MAX_TEXELS];
+                    float values[MAX_WEIGHTS];
+                    int unquantized[MAX_WEIGHTS];
+
+                    idealWeights(ideal, config, plane, q0, q1);
+                    decimate(values, ideal, grid, iterations);
+
+                    for (int i = 0; i < gridSize; ++i)
+                    {
+                        const int index = tables.weightQuantize[mode.quant][int(values[i] + 0.5f)];
+                        weights[i * planes + plane] = uint8(index);
+                        unquantized[i] = tables.weightUnquantize[mode.quant][index];
+                    }
+
+                    for (int t = 0; t < count; ++t)
+                    {
+                        int s = 8;
+                        for (int k = 0; k < 4; ++k)
+                        {
+                            s += grid.factor[t][k] * unquantized[grid.index[t][k]];
+                        }
+                        decoded[plane][t] = float(s >> 4);
+                    }
+                }
+
+                float32x4 sum(0.0f);
+
+                for (int t = 0; t < count; ++t)
+                {
+                    const int p = config.partition(t);
+                    const float w0 = decoded[0][t] * (1.0f / 64.0f);
+                    const float w1 = config.dual ? decoded[1][t] * (1.0f / 64.0f) : w0;
+                    const float32x4 d = q0[p] + (q1[p] - q0[p]) * float32x4(w0, w0, w0, w1) - color[t];
+                    sum += d * d;
+                }
+
+                const float e = hsum(sum);
+
+                if (e < error)
+                {
+                    error = e;
+
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        std::memset(bestBlock, 0, 16);
+
+                        writeBits(bestBlock, 0, 11, mode.bits);
+                        writeBits(bestBlock, 11, 2, config.partitions - 1);
+
+                        int start;
+
+                        if (config.partitions == 1)
+                        {
+                            writeBits(bestBlock, 13, 4, config.cem);
+                            start = 17;
+                        }
+                        else
+                        {
+                            // the same endpoint mode for all partitions
+                            writeBits(bestBlock, 13, 10, config.pattern->seed);
+                            writeBits(bestBlock, 25, 4, config.cem);
+                            start = 29;
+                        }
+
+                        if (config.dual)
+                        {
+                            // the alpha channel uses the second plane
+                            writeBits(bestBlock, 128 - mode.weightBits - 2, 2, 3);
+                        }
+
+                        writeSequence(bestBlock, start, false, ise, values, config.values() * config.partitions);
+                        writeSequence(bestBlock, 127, true, weightISE[mode.quant], weights, gridSize * planes);
+                    }
+                }
+
+                if (pass + 1 < passes)
+                {
+                    refitEndpoints(ep, config, decoded[0], decoded[1]);
+                }
+            }
+
+            return error;
+        }
+
+        // Encodes the configuration with the best ranked modes.
+        void encodeConfig(const Config& config, int candidates)
+        {
+            Endpoints ep;
+            fitEndpoints(ep, config);
+
+            // squared lengths of the endpoint lines, per plane
+            float length2[2] = { 0.0f, 0.0f };
+            float ideal[2][MAX_TEXELS];
+            const int planes = config.dual ? 2 : 1;
+
+            for (int plane = 0; plane < planes; ++plane)
+            {
+                const float32x4 mask = channelMask(config, plane);
+                idealWeights(ideal[plane], config, plane, ep.e0, ep.e1);
+
+                for (int t = 0; t < count; ++t)
+                {
+                    const int p = config.partition(t);
+                    const float32x4 axis = (ep.e1[p] - ep.e0[p]) * mask;
+                    length2[plane] += dot4(axis, axis);
+                }
+            }
+
+            const int channels = config.cem == 4 || config.cem == 12 ? 4 : 3;
+            std::vector<float> gridLoss(footprint.grids.size() * 2, -1.0f);
+
+            struct Candidate
+            {
+                float score;
+                int mode;
+            };
+
+            std::vector<Candidate> ranked;
+
+            for (int i = 0; i < int(footprint.modes.size()); ++i)
+            {
+                const Mode& mode = footprint.modes[i];
+                const int quant = colorQuant(config, mode);
+                if (mode.dual != config.dual || quant < 0)
+                    continue;
+
+                const Grid& grid = footprint.grids[mode.grid];
+                const int levels = weightISE[mode.quant].levels();
+                float score = 0.0f;
+
+                for (int plane = 0; plane < planes; ++plane)
+                {
+                    float& loss = gridLoss[mode.grid * 2 + plane];
+
+                    if (loss < 0.0f)
+                    {
+                        // the error of representing the ideal weights with the grid
+                        float values[MAX_WEIGHTS];
+                        decimate(values, ideal[plane], grid, 0);
+
+                        loss = 0.0f;
+                        for (int t = 0; t < count; ++t)
+                        {
+                            const float d = (ideal[plane][t] - interpolate(values, grid, t)) * (1.0f / 64.0f);
+                            loss += d * d;
+                        }
+
+                        loss *= length2[plane] / count;
+                    }
+
+                    const float step = 1.0f / (levels - 1);
+                    score += loss + length2[plane] * step * step / 12.0f;
+                }
+
+                const float colorStep = 256.0f / colorQuantISE(quant).levels();
+                score += count * channels * colorStep * colorStep / 18.0f;
+
+                ranked.push_back({ score, i });
+            }
+
+            const int n = std::min(candidates, int(ranked.size()));
+            std::partial_sort(ranked.begin(), ranked.begin() + n, ranked.end(), [] (const Candidate& a, const Candidate& b)
+            {
+                return a.score < b.score;
+            });
+
+            for (int i = 0; i < n; ++i)
+            {
+                encodeMode(config, footprint.modes[ranked[i].mode], ep);
+            }
+        }
+
+        // Clusters the texels in two groups and returns the closest matching patterns.
+        void selectPatterns(std::vector<const Pattern*>& patterns, int maxPatterns) const
+        {
+            float32x4 center[2];
+
+            // initial split along the axis of the largest extent
+            float32x4 low(255.0f);
+            float32x4 high(0.0f);
+            for (int t = 0; t < count; ++t)
+            {
+                low = min(low, color[t]);
+                high = max(high, color[t]);
+            }
+
+            center[0] = low;
+            center[1] = high;
+
+            uint64 mask[3] = { 0, 0, 0 };
+
+            for (int iteration = 0; iteration < 4; ++iteration)
+            {
+                float32x4 sum[2] = { float32x4(0.0f), float32x4(0.0f) };
+                int n[2] = { 0, 0 };
+
+                mask[0] = mask[1] = mask[2] = 0;
+
+                for (int t = 0; t < count; ++t)
+                {
+                    const float32x4 d0 = color[t] - center[0];
+                    const float32x4 d1 = color[t] - center[1];
+                    const int k = dot4(d1, d1) < dot4(d0, d0) ? 1 : 0;
+                    sum[k] += color[t];
+                    ++n[k];
+                    mask[t >> 6] |= uint64(k) << (t & 63);
+                }
+
+                for (int k = 0; k < 2; ++k)
+                {
+                    if (n[k])
+                        center[k] = sum[k] / float(n[k]);
+                }
+            }
+
+            struct Match
+            {
+                int errors;
+                const Pattern* pattern;
+            };
+
+            std::vector<Match> matches;
+            matches.reserve(footprint.patterns.size());
+
+            for (const Pattern& pattern : footprint.patterns)
+            {
+                int errors = 0;
+                for (int i = 0; i < 3; ++i)
+                {
+                    errors += u64_count_bits(pattern.mask[i] ^ mask[i]);
+                }
+
+                // the partition labels can be swapped
+                errors = std::min(errors, count - errors);
+                matches.push_back({ errors, &pattern });
+            }
+
+            const int n = std::min(maxPatterns, int(matches.size()));
+            std::partial_sort(matches.begin(), matches.begin() + n, matches.end(), [] (const Match& a, const Match& b)
+            {
+                return a.errors < b.errors;
+            });
+
+            for (int i = 0; i < n; ++i)
+            {
+                patterns.push_back(matches[i].pattern);
+            }
+        }
+
+        void encodeVoidExtent(uint8* output) const
+        {
+            std::memset(output, 0, 16);
+
+            // LDR void extent without coordinates
+            writeBits(output, 0, 12, 0xdfc);
+            writeBits(output, 12, 26, 0x3ffffff);
+            writeBits(output, 38, 26, 0x3ffffff);
+
+            const float32x4 c = color[0];
+            const float components[] = { c.x, c.y, c.z, c.w };
+
+            for (int i = 0; i < 4; ++i)
+            {
+                const int value = int(components[i]);
+                writeBits(output, 64 + i * 16, 16, uint32(value * 257));
+            }
+        }
+
+    public:
+        BlockEncoder(const Footprint& footprint, const uint8* input, int stride, Effort effort)
+            : tables(getTables())
+            , footprint(footprint)
+            , effort(effort)
+            , count(footprint.texels)
+            , bestError(1e30f)
+        {
+            opaque = true;
+            grey = true;
+
+            for (int y = 0; y < footprint.height; ++y)
+            {
+                const uint8* scan = input + y * stride;
+
+                for (int x = 0; x < footprint.width; ++x)
+                {
+                    const uint8* s = scan + x * 4;
+                    color[y * footprint.width + x] = float32x4(s[0], s[1], s[2], s[3]);
+                    opaque &= s[3] == 255;
+                    grey &= s[0] == s[1] && s[1] == s[2];
+                }
+            }
+        }
+
+        void encode(uint8* output)
+        {
+            bool constant = true;
+            for (int t = 1; t < count && constant; ++t)
+            {
+                constant = dot4(color[t] - color[0], color[t] - color[0]) == 0.0f;
+            }
+
+            if (constant)
+            {
+                encodeVoidExtent(output);
+                return;
+            }
+
+            const int cem = grey ? (opaque ? 0 : 4) : (opaque ? 8 : 12);
+            const int candidates = effort == EFFORT_HIGH ? 12 : effort == EFFORT_NORMAL ? 4 : 2;
+
+            Config config;
+            config.partitions = 1;
+            config.cem = cem;
+            config.dual = false;
+            config.pattern = nullptr;
+
+            encodeConfig(config, candidates);
+
+            if (effort == EFFORT_FAST)
+            {
+                std::memcpy(output, bestBlock, 16);
+                return;
+            }
+
+            // the alpha varies independently from the color
+            if (!opaque)
+            {
+                config.dual = true;
+                encodeConfig(config, candidates);
+                config.dual = false;
+            }
+
+            // two partitions unless the block is already good enough
+            if (bestError > count * 4.0f)
+            {
+                std::vector<const Pattern*> patterns;
+                selectPatterns(patterns, effort == EFFORT_HIGH ? 8 : 2);
+
+                config.partitions = 2;
+
+                for (const Pattern* pattern : patterns)
+                {
+                    config.pattern = pattern;
+                    encodeConfig(config, candidates / 2);
+                }
+            }
+
+            std::memcpy(output, bestBlock, 16);
+        }
+    };
+
+} // namespace
+
+namespace mango
+{
+
+    void encode_block_astc(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
+    {
+        const Footprint* footprint = getTables().getFootprint(info.width, info.height);
+        if (!footprint)
+        {
+            std::memset(output, 0, info.bytes);
+            return;
+        }
+
+        BlockEncoder encoder(*footprint, input, stride, getEffort(quality));
+        encoder.encode(output);
+    }
+
+} // namespace mango
@@ -0,0 +1,435 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <mango/core/bits.hpp>
+#include <mango/core/endian.hpp>
+#include <mango/math/vector.hpp>
+#include <mango/image/compression.hpp>
+
+// ----------------------------------------------------------------------------
+// Real-time BC1 / BC3 / BC4 / BC5 encoders
+// ----------------------------------------------------------------------------
+
+/*
+    These trade quality for throughput: the endpoints are the bounding box of the
+    block colors with the diagonal chosen from the sign of the covariance (a cheap
+    approximation of the principal axis) and inset by 1/16th of the range to
+    compensate for the rounding bias of the interpolated palette entries. The
+    indices are computed with a single projection onto the endpoint axis instead
+    of searching the palette.
+
+    The DirectXTex encoders in external/bc are still used at normal and high quality.
+*/
+
+namespace
+{
+    using namespace mango;
+
+    // ------------------------------------------------------------
+    // color
+    // ------------------------------------------------------------
+
+    inline uint32 reduce_min(simd::uint8x16 v)
+    {
+        v = simd::min(v, simd::reinterpret<simd::uint8x16>(simd::shuffle<2, 3, 0, 1>(simd::reinterpret<simd::uint32x4>(v))));
+        v = simd::min(v, simd::reinterpret<simd::uint8x16>(simd::shuffle<1, 0, 3, 2>(simd::reinterpret<simd::uint32x4>(v))));
+        return simd::get_component<0>(simd::reinterpret<simd::uint32x4>(v));
+    }
+
+    inline uint32 reduce_max(simd::uint8x16 v)
+    {
+        v = simd::max(v, simd::reinterpret<simd::uint8x16>(simd::shuffle<2, 3, 0, 1>(simd::reinterpret<simd::uint32x4>(v))));
+        v = simd::max(v, simd::reinterpret<simd::uint8x16>(simd::shuffle<1, 0, 3, 2>(simd::reinterpret<simd::uint32x4>(v))));
+        return simd::get_component<0>(simd::reinterpret<simd::uint32x4>(v));
+    }
+
+    inline int reduce_add(int32x4 v)
+    {
+        return v[0] + v[1] + v[2] + v[3];
+    }
+
+    struct Color
+    {
+        int r, g, b;
+
+        uint16 pack() const
+        {
+            const int r5 = (r * 31 + 127) / 255;
+            const int g6 = (g * 63 + 127) / 255;
+            const int b5 = (b * 31 + 127) / 255;
+            return uint16((r5 << 11) | (g6 << 5) | b5);
+        }
+
+        static Color unpack(uint16 color)
+        {
+            const int r5 = (color >> 11) & 0x1f;
+            const int g6 = (color >> 5) & 0x3f;
+            const int b5 = (color >> 0) & 0x1f;
+            return Color { (r5 << 3) | (r5 >> 2), (g6 << 2) | (g6 >> 4), (b5 << 3) | (b5 >> 2) };
+        }
+    };
+
+    // project the pixels onto the axis from base to end; the result is scaled by
+    // the squared length of the axis which is returned in total.
+    inline void projectRows(int32x4* projection, int& total, const int32x4* pixels, const Color& base, const Color& end)
+    {
+        const int dr = end.r - base.r;
+        const int dg = end.g - base.g;
+        const int db = end.b - base.b;
+        total = dr * dr + dg * dg + db * db;
+
+        const int32x4 mask(0xff);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const int32x4 r = (pixels[i] >> 0) & mask;
+            const int32x4 g = (pixels[i] >> 8) & mask;
+            const int32x4 b = (pixels[i] >> 16) & mask;
+            projection[i] = int32x4(simd::mullo(r - int32x4(base.r), int32x4(dr))) +
+                            int32x4(simd::mullo(g - int32x4(base.g), int32x4(dg))) +
+                            int32x4(simd::mullo(b - int32x4(base.b), int32x4(db)));
+        }
+    }
+
+    void encodeColorBlock(uint8* output, const uint8* input, int stride, bool alpha)
+    {
+        int32x4 pixels[4];
+        uint32 transparent = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            pixels[i] = simd::int32x4_uload(reinterpret_cast<const int32*>(input + i * stride));
+            if (alpha)
+            {
+                // the shift is logical: alpha ends up in range [0, 255]
+                const int32x4 a = int32x4(simd::srli<24>(pixels[i]));
+                transparent |= maskToInt(a < int32x4(128)) << (i * 4);
+            }
+        }
+
+        if (transparent == 0xffff)
+        {
+            // three color mode with every pixel transparent
+            ustore32le(output + 0, 0);
+            ustore32le(output + 4, 0xffffffff);
+            return;
+        }
+
+        // bounding box of the opaque pixels
+        simd::uint8x16 vmin = simd::uint8x16_set1(0xff);
+        simd::uint8x16 vmax = simd::uint8x16_zero();
+
+        for (int i = 0; i < 4; ++i)
+        {
+            int32x4 lo = pixels[i];
+            int32x4 hi = pixels[i];
+            if (transparent)
+            {
+                const mask32x4 mask = int32x4(simd::srli<24>(pixels[i])) < int32x4(128);
+                lo = select(mask, int32x4(-1), lo);
+                hi = select(mask, int32x4(0), hi);
+            }
+            vmin = simd::min(vmin, simd::reinterpret<simd::uint8x16>(simd::int32x4(lo)));
+            vmax = simd::max(vmax, simd::reinterpret<simd::uint8x16>(simd::int32x4(hi)));
+        }
+
+        const uint32 cmin = reduce_min(vmin);
+        const uint32 cmax = reduce_max(vmax);
+
+        Color c0 = { int(cmax >> 0) & 0xff, int(cmax >> 8) & 0xff, int(cmax >> 16) & 0xff };
+        Color c1 = { int(cmin >> 0) & 0xff, int(cmin >> 8) & 0xff, int(cmin >> 16) & 0xff };
+
+        // pick the bounding box diagonal using the covariance signs relative to green
+        const int32x4 mask(0xff);
+        const int32x4 center_r((c0.r + c1.r) >> 1);
+        const int32x4 center_g((c0.g + c1.g) >> 1);
+        const int32x4 center_b((c0.b + c1.b) >> 1);
+
+        int32x4 cov_rg(0);
+        int32x4 cov_gb(0);
+        int32x4 cov_rb(0);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            int32x4 r = ((pixels[i] >> 0) & mask) - center_r;
+            int32x4 g = ((pixels[i] >> 8) & mask) - center_g;
+            int32x4 b = ((pixels[i] >> 16) & mask) - center_b;
+            if (transparent)
+            {
+                const mask32x4 skip = int32x4(simd::srli<24>(pixels[i])) < int32x4(128);
+                r = select(skip, int32x4(0), r);
+                g = select(skip, int32x4(0), g);
+                b = select(skip, int32x4(0), b);
+            }
+            cov_rg += int32x4(simd::mullo(r, g));
+            cov_gb += int32x4(simd::mullo(g, b));
+            cov_rb += int32x4(simd::mullo(r, b));
+        }
+
+        if (c0.g != c1.g)
+        {
+            if (reduce_add(cov_rg) < 0)
+                std::swap(c0.r, c1.r);
+            if (reduce_add(cov_gb) < 0)
+                std::swap(c0.b, c1.b);
+        }
+        else if (reduce_add(cov_rb) < 0)
+        {
+            std::swap(c0.b, c1.b);
+        }
+
+        // inset
+        const int ir = (c0.r - c1.r) / 16;
+        const int ig = (c0.g - c1.g) / 16;
+        const int ib = (c0.b - c1.b) / 16;
+        c0 = Color { c0.r - ir, c0.g - ig, c0.b - ib };
+        c1 = Color { c1.r + ir, c1.g + ig, c1.b + ib };
+
+        uint16 color0 = c0.pack();
+        uint16 color1 = c1.pack();
+
+        int32x4 projection[4];
+        int total;
+        uint32 lo = 0;
+        uint32 hi = 0;
+
+        if (!transparent)
+        {
+            // four color mode requires color0 > color1
+            if (color0 < color1)
+            {
+                std::swap(color0, color1);
+            }
+
+            if (color0 != color1)
+            {
+                // palette: 0 = color0, 1 = color1, 2 = (2 * color0 + color1) / 3, 3 = (color0 + 2 * color1) / 3
+                projectRows(projection, total, pixels, Color::unpack(color1), Color::unpack(color0));
+
+                const int32x4 t1(total * 1);
+                const int32x4 t3(total * 3);
+                const int32x4 t5(total * 5);
+
+                for (int i = 0; i < 4; ++i)
+                {
+                    const int32x4 s = int32x4(simd::mullo(projection[i], int32x4(6)));
+                    const uint32 m1 = maskToInt(s < t1);
+                    const uint32 m3 = maskToInt(s < t3);
+                    const uint32 m5 = maskToInt(s < t5);
+                    lo |= m3 << (i * 4);
+                    hi |= (m5 & ~m1) << (i * 4);
+                }
+            }
+        }
+        else
+        {
+            // three color mode requires color0 <= color1
+            if (color0 > color1)
+            {
+                std::swap(color0, color1);
+            }
+
+            // palette: 0 = color0, 1 = color1, 2 = (color0 + color1) / 2, 3 = transparent
+            projectRows(projection, total, pixels, Color::unpack(color0), Color::unpack(color1));
+
+            const int32x4 t1(total * 1);
+            const int32x4 t3(total * 3);
+
+            for (int i = 0; i < 4; ++i)
+            {
+                const int32x4 s = projection[i] << 2;
+                const uint32 m1 = maskToInt(s < t1);
+                const uint32 m3 = maskToInt(s < t3);
+                lo |= (~m3 & 0xf) << (i * 4);
+                hi |= (m3 & ~m1) << (i * 4);
+            }
+
+            lo |= transparent;
+            hi |= transparent;
+        }
+
+        ustore16le(output + 0, color0);
+        ustore16le(output + 2, color1);
+        ustore32le(output + 4, u32_interleave_bits(lo, hi));
+    }
+
+    // ------------------------------------------------------------
+    // alpha
+    // ------------------------------------------------------------
+
+    // Encodes 16 values in range [0, 255], or [-127, 127] for the signed BC4/BC5 variant,
+    // using the eight value mode which requires endpoint0 > endpoint1.
+    void encodeAlphaBlock(uint8* output, const int32x4* value)
+    {
+        const int32x4 vmin = min(min(value[0], value[1]), min(value[2], value[3]));
+        const int32x4 vmax = max(max(value[0], value[1]), max(value[2], value[3]));
+        const int amin = std::min(std::min(vmin[0], vmin[1]), std::min(vmin[2], vmin[3]));
+        const int amax = std::max(std::max(vmax[0], vmax[1]), std::max(vmax[2], vmax[3]));
+
+        output[0] = uint8(amax);
+        output[1] = uint8(amin);
+
+        const int range = amax - amin;
+        if (!range)
+        {
+            ustore16le(output + 2, 0);
+            ustore32le(output + 4, 0);
+            return;
+        }
+
+        // k = round(7 * (value - amin) / range) in 16.16 fixed point
+        const int32x4 scale(((7 << 16) + range / 2) / range);
+        const int32x4 bias(amin);
+        const int32x4 half(0x8000);
+        const int32x4 seven(7);
+        const int32x4 one(1);
+
+        uint64 indices = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const int32x4 k = (int32x4(simd::mullo(value[i] - bias, scale)) + half) >> 16;
+
+            // k = 7 -> 0 (endpoint0), k = 0 -> 1 (endpoint1), others -> 8 - k
+            const int32x4 t = (int32x4(8) - k) & seven;
+            const int32x4 index = t ^ select(t < int32x4(2), one, int32x4(0));
+
+            indices |= uint64(index[0]) << (i * 12 + 0);
+            indices |= uint64(index[1]) << (i * 12 + 3);
+            indices |= uint64(index[2]) << (i * 12 + 6);
+            indices |= uint64(index[3]) << (i * 12 + 9);
+        }
+
+        ustore16le(output + 2, uint16(indices));
+        ustore32le(output + 4, uint32(indices >> 16));
+    }
+
+    void loadAlpha(int32x4* value, const uint8* input, int stride)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            const int32x4 pixels = simd::int32x4_uload(reinterpret_cast<const int32*>(input + i * stride));
+            value[i] = int32x4(simd::srli<24>(pixels));
+        }
+    }
+
+    // load the channel at the given float offset of the FP32 RGBA block
+    void loadChannel(int32x4* value, const uint8* input, int stride, int channel, bool isSigned)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            const float* image = reinterpret_cast<const float*>(input + i * stride) + channel;
+            float32x4 v(image[0], image[4], image[8], image[12]);
+            if (isSigned)
+            {
+                v = clamp(v, -1.0f, 1.0f) * 127.0f;
+            }
+            else
+            {
+                v = clamp(v, 0.0f, 1.0f) * 255.0f;
+            }
+            value[i] = simd::convert<simd::int32x4>(simd::float32x4(v));
+        }
+    }
+
+    // ------------------------------------------------------------
+    // blocks
+    // ------------------------------------------------------------
+
+    void encodeBC1(uint8* output, const uint8* input, int stride)
+    {
+        encodeColorBlock(output, input, stride, false);
+    }
+
+    void encodeBC1A(uint8* output, const uint8* input, int stride)
+    {
+        encodeColorBlock(output, input, stride, true);
+    }
+
+    void encodeBC3(uint8* output, const uint8* input, int stride)
+    {
+        int32x4 alpha[4];
+        loadAlpha(alpha, input, stride);
+        encodeAlphaBlock(output + 0, alpha);
+        encodeColorBlock(output + 8, input, stride, false);
+    }
+
+    void encodeBC4U(uint8* output, const uint8* input, int stride)
+    {
+        int32x4 red[4];
+        loadChannel(red, input, stride, 0, false);
+        encodeAlphaBlock(output, red);
+    }
+
+    void encodeBC4S(uint8* output, const uint8* input, int stride)
+    {
+        int32x4 red[4];
+        loadChannel(red, input, stride, 0, true);
+        encodeAlphaBlock(output, red);
+    }
+
+    void encodeBC5U(uint8* output, const uint8* input, int stride)
+    {
+        int32x4 value[4];
+        loadChannel(value, input, stride, 0, false);
+        encodeAlphaBlock(output + 0, value);
+        loadChannel(value, input, stride, 1, false);
+        encodeAlphaBlock(output + 8, value);
+    }
+
+    void encodeBC5S(uint8* output, const uint8* input, int stride)
+    {
+        int32x4 value[4];
+        loadChannel(value, input, stride, 0, true);
+        encodeAlphaBlock(output + 0, value);
+        loadChannel(value, input, stride, 1, true);
+        encodeAlphaBlock(output + 8, value);
+    }
+
+    using BlockFunc = void (*)(uint8* output, const uint8* input, int stride);
+
+    // the block encoder is a template parameter so that it is inlined into the loop
+    template <BlockFunc func>
+    void encodeBlocks(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count)
+    {
+        const int blockImageSize = info.width * info.format.bytes();
+
+        for (int x = 0; x < count; ++x)
+        {
+            func(output, input, stride);
+            output += info.bytes;
+            input += blockImageSize;
+        }
+    }
+
+} // namespace
+
+namespace mango
+{
+
+#define ENCODE_BLOCK_FAST(name, func) \
+    void encode_block_##name##_fast(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality) \
+    { \
+        MANGO_UNREFERENCED_PARAMETER(info); \
+        MANGO_UNREFERENCED_PARAMETER(quality); \
+        func(output, input, stride); \
+    } \
+    \
+    void encode_blocks_##name##_fast(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, int count, float quality) \
+    { \
+        MANGO_UNREFERENCED_PARAMETER(quality); \
+        encodeBlocks<func>(info, output, input, stride, count); \
+    }
+
+    ENCODE_BLOCK_FAST(bc1, encodeBC1)
+    ENCODE_BLOCK_FAST(bc1a, encodeBC1A)
+    ENCODE_BLOCK_FAST(bc3, encodeBC3)
+    ENCODE_BLOCK_FAST(bc4u, encodeBC4U)
+    ENCODE_BLOCK_FAST(bc4s, encodeBC4S)
+    ENCODE_BLOCK_FAST(bc5u, encodeBC5U)
+    ENCODE_BLOCK_FAST(bc5s, encodeBC5S)
+
+#undef ENCODE_BLOCK_FAST
+
+} // namespace mango
@@ -3,6 +3,7 @@
     Copyright (C) 2012-2016 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <mango/core/endian.hpp>
+#include <mango/simd/simd.hpp>
 #include <mango/image/compression.hpp>
 
 #define LOAD16(x) uload16le(reinterpret_cast<const uint8*>(&x))
@@ -94,6 +95,53 @@ namespace
         }
     }
 
+#if defined(MANGO_ENABLE_SSSE3)
+
+    // shuffle masks which expand four 2 bit indices into 32 bit palette entries
+    struct ColorShuffleTable
+    {
+        __m128i mask[256];
+
+        ColorShuffleTable()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                uint8 temp[16];
+                for (int j = 0; j < 4; ++j)
+                {
+                    const int index = (i >> (j * 2)) & 3;
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        temp[j * 4 + k] = uint8(index * 4 + k);
+                    }
+                }
+
+                mask[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(temp));
+            }
+        }
+    };
+
+    const ColorShuffleTable g_colorShuffle;
+
+    void DecodeColorBlock(uint8* dest, int stride, const DXTColBlock* colorBlock, uint8 alpha)
+    {
+        uint32 color[4];
+        GetColorBlockColors(color, colorBlock, alpha);
+
+        const __m128i palette = _mm_loadu_si128(reinterpret_cast<const __m128i*>(color));
+        uint32 data = LOAD32(colorBlock->data);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            const __m128i row = _mm_shuffle_epi8(palette, g_colorShuffle.mask[data & 0xff]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), row);
+            data >>= 8;
+            dest += stride;
+        }
+    }
+
+#else
+
     void DecodeColorBlock(uint8* dest, int stride, const DXTColBlock* colorBlock, uint8 alpha)
     {
         uint32 color[4];
@@ -113,6 +161,8 @@ namespace
         }
     }
 
+#endif
+
     void DecodeAlphaTable(uint8* alpha, const DXTAlphaBlock3BitLinear* alphaBlock)
     {
         alpha[0] = alphaBlock->alpha[0];
@@ -276,4 +326,69 @@ namespace mango
         Decode3BitLinear(out + 1, 2, stride, greenBlock);
     }
 
+    // ------------------------------------------------------------
+    // batch decoders
+    // ------------------------------------------------------------
+
+    // Decode a run of horizontally adjacent blocks with one call; the per-block work is
+    // inlined into the loop instead of going through the decode function pointer.
+
+    void decode_blocks_dxt1(const TextureCompressionInfo& info, uint8* out, const uint8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+        for (int i = 0; i < count; ++i)
+        {
+            DecodeColorBlock(out, stride, reinterpret_cast<const DXTColBlock*>(in), 0xff);
+            out += 16;
+            in += 8;
+        }
+    }
+
+    void decode_blocks_dxt3(const TextureCompressionInfo& info, uint8* out, const uint8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+        for (int i = 0; i < count; ++i)
+        {
+            DecodeColorBlock(out + 0, stride, reinterpret_cast<const DXTColBlock*>(in + 8), 0);
+            DecodeAlphaExplicit(out + 3, stride, reinterpret_cast<const DXTAlphaBlockExplicit*>(in + 0));
+            out += 16;
+            in += 16;
+        }
+    }
+
+    void decode_blocks_dxt5(const TextureCompressionInfo& info, uint8* out, const uint8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+        for (int i = 0; i < count; ++i)
+        {
+            DecodeColorBlock(out + 0, stride, reinterpret_cast<const DXTColBlock*>(in + 8), 0);
+            Decode3BitLinear(out + 3, 4, stride, reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0));
+            out += 16;
+            in += 16;
+        }
+    }
+
+    void decode_blocks_3dc_x(const TextureCompressionInfo& info, uint8* out, const uint8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+        for (int i = 0; i < count; ++i)
+        {
+            Decode3BitLinear(out, 1, stride, reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in));
+            out += 4;
+            in += 8;
+        }
+    }
+
+    void decode_blocks_3dc_xy(const TextureCompressionInfo& info, uint8* out, const uint8* in, int stride, int count)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+        for (int i = 0; i < count; ++i)
+        {
+            Decode3BitLinear(out + 0, 2, stride, reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 0));
+            Decode3BitLinear(out + 1, 2, stride, reinterpret_cast<const DXTAlphaBlock3BitLinear*>(in + 8));
+            out += 8;
+            in += 16;
+        }
+    }
+
 } // namespace mango
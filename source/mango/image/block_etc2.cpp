@@ -0,0 +1,1280 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+#include <mango/core/endian.hpp>
+#include <mango/math/math.hpp>
+#include <mango/image/compression.hpp>
+
+namespace
+{
+    using namespace mango;
+
+    // ------------------------------------------------------------
+    // ETC2 / EAC encoder
+    // ------------------------------------------------------------
+
+    // The encoder evaluates candidate endpoints for every mode the format allows and keeps
+    // the one with the smallest squared error. The per-pixel nearest color search is done
+    // for four pixels at a time. The effort decides how far around the initial endpoints
+    // the search goes.
+
+    enum Effort
+    {
+        EFFORT_FAST,    // ETC1 modes and planar with rounded endpoints
+        EFFORT_NORMAL,  // adds T and H modes and a small endpoint neighbourhood
+        EFFORT_HIGH     // exhaustive neighbourhood and iterative planar refinement
+    };
+
+    Effort getEffort(float quality)
+    {
+        // same tiers as TextureCompressionInfo::compress() uses to select the BC encoders
+        if (quality < 1.0f / 3.0f)
+            return EFFORT_FAST;
+        if (quality < 2.0f / 3.0f)
+            return EFFORT_NORMAL;
+        return EFFORT_HIGH;
+    }
+
+    const int etcModifierTable[8][4] =
+    {
+        {  2,   8,  -2,   -8 },
+        {  5,  17,  -5,  -17 },
+        {  9,  29,  -9,  -29 },
+        { 13,  42, -13,  -42 },
+        { 18,  60, -18,  -60 },
+        { 24,  80, -24,  -80 },
+        { 33, 106, -33, -106 },
+        { 47, 183, -47, -183 }
+    };
+
+    const int etcDistanceTable[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+    const int eacModifierTable[16][8] =
+    {
+        {-3,  -6,  -9, -15,  2,  5,  8, 14},
+        {-3,  -7, -10, -13,  2,  6,  9, 12},
+        {-2,  -5,  -8, -13,  1,  4,  7, 12},
+        {-2,  -4,  -6, -13,  1,  3,  5, 12},
+        {-3,  -6,  -8, -12,  2,  5,  7, 11},
+        {-3,  -7,  -9, -11,  2,  6,  8, 10},
+        {-4,  -7,  -8, -11,  3,  6,  7, 10},
+        {-3,  -5,  -8, -11,  2,  4,  7, 10},
+        {-2,  -6,  -8, -10,  1,  5,  7,  9},
+        {-2,  -5,  -8, -10,  1,  4,  7,  9},
+        {-2,  -4,  -8, -10,  1,  3,  7,  9},
+        {-2,  -5,  -7, -10,  1,  4,  6,  9},
+        {-3,  -4,  -7, -10,  2,  3,  6,  9},
+        {-1,  -2,  -3, -10,  0,  1,  2,  9},
+        {-4,  -6,  -8,  -9,  3,  5,  7,  8},
+        {-3,  -5,  -7,  -9,  2,  4,  6,  8}
+    };
+
+    inline int clamp255(int value)
+    {
+        return std::max(0, std::min(255, value));
+    }
+
+    inline int expand4(int v) { return (v << 4) | v; }
+    inline int expand5(int v) { return (v << 3) | (v >> 2); }
+    inline int expand6(int v) { return (v << 2) | (v >> 4); }
+    inline int expand7(int v) { return (v << 1) | (v >> 6); }
+
+    inline int quantize(float value, int bits)
+    {
+        const int vmax = (1 << bits) - 1;
+        return std::max(0, std::min(vmax, int(value * vmax / 255.0f + 0.5f)));
+    }
+
+    inline int expand(int value, int bits)
+    {
+        switch (bits)
+        {
+            case 4: return expand4(value);
+            case 5: return expand5(value);
+            case 6: return expand6(value);
+            default: return expand7(value);
+        }
+    }
+
+    inline float hsum(float32x4 v)
+    {
+        return float(v.x) + float(v.y) + float(v.z) + float(v.w);
+    }
+
+    // ------------------------------------------------------------
+    // nearest color search
+    // ------------------------------------------------------------
+
+    struct Paints
+    {
+        float32x4 r[4];
+        float32x4 g[4];
+        float32x4 b[4];
+
+        void set(int index, int red, int green, int blue)
+        {
+            r[index] = float32x4(float(clamp255(red)));
+            g[index] = float32x4(float(clamp255(green)));
+            b[index] = float32x4(float(clamp255(blue)));
+        }
+
+        void disable(int index)
+        {
+            // too far away to be selected for any pixel
+            r[index] = float32x4(100000.0f);
+            g[index] = float32x4(100000.0f);
+            b[index] = float32x4(100000.0f);
+        }
+    };
+
+    // Squared distance from four pixels to the nearest paint and the index of the paint.
+    inline float32x4 nearestPaint(const Paints& paints, float32x4 r, float32x4 g, float32x4 b, float32x4& index)
+    {
+        float32x4 dr = r - paints.r[0];
+        float32x4 dg = g - paints.g[0];
+        float32x4 db = b - paints.b[0];
+        float32x4 best = dr * dr + dg * dg + db * db;
+        index = float32x4(0.0f);
+
+        for (int i = 1; i < 4; ++i)
+        {
+            dr = r - paints.r[i];
+            dg = g - paints.g[i];
+            db = b - paints.b[i];
+            const float32x4 d = dr * dr + dg * dg + db * db;
+            const mask32x4 mask = d < best;
+            best = select(mask, d, best);
+            index = select(mask, float32x4(float(i)), index);
+        }
+
+        return best;
+    }
+
+    // ------------------------------------------------------------
+    // color block
+    // ------------------------------------------------------------
+
+    struct PixelPlanes
+    {
+        float32x4 r[4];
+        float32x4 g[4];
+        float32x4 b[4];
+        float32x4 weight[4]; // zero for transparent pixels
+    };
+
+    struct ColorBlock
+    {
+        PixelPlanes column; // vector i holds the column x = i
+        PixelPlanes row;    // vector i holds the row y = i
+        int color[16][3];   // pixels in the ETC order (x * 4 + y)
+        bool transparent[16];
+        bool punchthrough;  // ETC2 punchthrough alpha format
+        bool opaque;        // no transparent pixels
+
+        ColorBlock(const uint8* input, int stride, bool alpha)
+        {
+            punchthrough = alpha;
+            opaque = true;
+
+            float c[4][16];
+
+            for (int y = 0; y < 4; ++y)
+            {
+                const uint8* scan = input + y * stride;
+
+                for (int x = 0; x < 4; ++x)
+                {
+                    const int p = x * 4 + y;
+                    const uint8* s = scan + x * 4;
+
+                    color[p][0] = s[0];
+                    color[p][1] = s[1];
+                    color[p][2] = s[2];
+                    transparent[p] = alpha && s[3] < 128;
+                    opaque &= !transparent[p];
+
+                    c[0][p] = s[0];
+                    c[1][p] = s[1];
+                    c[2][p] = s[2];
+                    c[3][p] = transparent[p] ? 0.0f : 1.0f;
+                }
+            }
+
+            for (int i = 0; i < 4; ++i)
+            {
+                const int p = i * 4;
+                column.r[i] = float32x4(c[0][p + 0], c[0][p + 1], c[0][p + 2], c[0][p + 3]);
+                column.g[i] = float32x4(c[1][p + 0], c[1][p + 1], c[1][p + 2], c[1][p + 3]);
+                column.b[i] = float32x4(c[2][p + 0], c[2][p + 1], c[2][p + 2], c[2][p + 3]);
+                column.weight[i] = float32x4(c[3][p + 0], c[3][p + 1], c[3][p + 2], c[3][p + 3]);
+
+                row.r[i] = float32x4(c[0][i + 0], c[0][i + 4], c[0][i + 8], c[0][i + 12]);
+                row.g[i] = float32x4(c[1][i + 0], c[1][i + 4], c[1][i + 8], c[1][i + 12]);
+                row.b[i] = float32x4(c[2][i + 0], c[2][i + 4], c[2][i + 8], c[2][i + 12]);
+                row.weight[i] = float32x4(c[3][i + 0], c[3][i + 4], c[3][i + 8], c[3][i + 12]);
+            }
+        }
+
+        // transparency is signaled with the paint index 2 when the opaque bit is clear
+        bool transparentMode() const
+        {
+            return punchthrough && !opaque;
+        }
+
+        float evaluate(const PixelPlanes& planes, int first, int count, const Paints& paints) const
+        {
+            float32x4 error(0.0f);
+
+            for (int i = first; i < first + count; ++i)
+            {
+                float32x4 index;
+                const float32x4 d = nearestPaint(paints, planes.r[i], planes.g[i], planes.b[i], index);
+                error = error + d * planes.weight[i];
+            }
+
+            return hsum(error);
+        }
+
+        void storeIndices(uint64& bits, const PixelPlanes& planes, bool rowLayout, int first, int count, const Paints& paints) const
+        {
+            for (int i = first; i < first + count; ++i)
+            {
+                float32x4 index;
+                nearestPaint(paints, planes.r[i], planes.g[i], planes.b[i], index);
+
+                const float lane[] = { float(index.x), float(index.y), float(index.z), float(index.w) };
+
+                for (int j = 0; j < 4; ++j)
+                {
+                    const int p = rowLayout ? j * 4 + i : i * 4 + j;
+                    const int k = transparent[p] ? 2 : int(lane[j]);
+                    bits |= uint64(k & 1) << p;
+                    bits |= uint64(k >> 1) << (16 + p);
+                }
+            }
+        }
+    };
+
+    // ------------------------------------------------------------
+    // overflow control bits
+    // ------------------------------------------------------------
+
+    // The T, H and planar modes are signaled with overflowing differential components. The
+    // base is formed from three free bits and two payload bits and the delta from one free
+    // bit and two payload bits; the free bits are set so that the sum is out of range.
+    inline uint64 forceOverflow(int low, int delta, int baseShift, int deltaShift)
+    {
+        if (low + delta < 4)
+        {
+            // small base with a negative delta
+            return uint64(1) << (deltaShift + 2);
+        }
+        else
+        {
+            // large base with a positive delta
+            return uint64(7) << (baseShift + 2);
+        }
+    }
+
+    // The free bit is the most significant bit of the base; flipping it moves the base
+    // by 16 which always brings the sum back in range.
+    inline uint64 preventOverflow(uint64 bits, int baseShift, int deltaShift)
+    {
+        const int base = int((bits >> baseShift) & 31);
+        int delta = int((bits >> deltaShift) & 7);
+        delta = delta >= 4 ? delta - 8 : delta;
+
+        if (base + delta < 0 || base + delta > 31)
+            bits ^= uint64(1) << (baseShift + 4);
+
+        return bits;
+    }
+
+    // ------------------------------------------------------------
+    // ETC2 color encoder
+    // ------------------------------------------------------------
+
+    class ColorEncoder
+    {
+    protected:
+        const ColorBlock& block;
+        Effort effort;
+
+        float bestError;
+        uint64 bestBits;
+
+        struct Subblock
+        {
+            int color[3]; // quantized
+            int table;
+            float error;
+        };
+
+        void candidate(float error, uint64 bits)
+        {
+            if (error < bestError)
+            {
+                bestError = error;
+                bestBits = bits;
+            }
+        }
+
+        void setTablePaints(Paints& paints, int r, int g, int b, int table) const
+        {
+            const int* modifier = etcModifierTable[table];
+
+            if (block.transparentMode())
+            {
+                // index 0 has no modifier and index 2 is transparent
+                paints.set(0, r, g, b);
+                paints.set(1, r + modifier[1], g + modifier[1], b + modifier[1]);
+                paints.disable(2);
+                paints.set(3, r + modifier[3], g + modifier[3], b + modifier[3]);
+            }
+            else
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    paints.set(i, r + modifier[i], g + modifier[i], b + modifier[i]);
+                }
+            }
+        }
+
+        void evaluateSubblock(Subblock& sub, const PixelPlanes& planes, int first, int bits) const
+        {
+            const int r = expand(sub.color[0], bits);
+            const int g = expand(sub.color[1], bits);
+            const int b = expand(sub.color[2], bits);
+
+            sub.error = 1e30f;
+            sub.table = 0;
+
+            for (int table = 0; table < 8; ++table)
+            {
+                Paints paints;
+                setTablePaints(paints, r, g, b, table);
+
+                const float error = block.evaluate(planes, first, 2, paints);
+                if (error < sub.error)
+                {
+                    sub.error = error;
+                    sub.table = table;
+                }
+            }
+        }
+
+        void averageColor(float* average, const PixelPlanes& planes, int first) const
+        {
+            float32x4 r(0.0f);
+            float32x4 g(0.0f);
+            float32x4 b(0.0f);
+            float32x4 w(0.0f);
+
+            for (int i = first; i < first + 2; ++i)
+            {
+                r = r + planes.r[i] * planes.weight[i];
+                g = g + planes.g[i] * planes.weight[i];
+                b = b + planes.b[i] * planes.weight[i];
+                w = w + planes.weight[i];
+            }
+
+            const float weight = std::max(1.0f, hsum(w));
+            average[0] = hsum(r) / weight;
+            average[1] = hsum(g) / weight;
+            average[2] = hsum(b) / weight;
+        }
+
+        void subblockCandidates(std::vector<Subblock>& candidates, const PixelPlanes& planes, int first, int bits) const
+        {
+            float average[3];
+            averageColor(average, planes, first);
+
+            int center[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                center[i] = quantize(average[i], bits);
+            }
+
+            const int vmax = (1 << bits) - 1;
+
+            auto add = [&] (int dr, int dg, int db)
+            {
+                Subblock sub;
+                sub.color[0] = center[0] + dr;
+                sub.color[1] = center[1] + dg;
+                sub.color[2] = center[2] + db;
+
+                for (int i = 0; i < 3; ++i)
+                {
+                    if (sub.color[i] < 0 || sub.color[i] > vmax)
+                        return;
+                }
+
+                evaluateSubblock(sub, planes, first, bits);
+                candidates.push_back(sub);
+            };
+
+            switch (effort)
+            {
+                case EFFORT_FAST:
+                    add(0, 0, 0);
+                    break;
+
+                case EFFORT_NORMAL:
+                    // along the intensity axis, which the modifiers move on
+                    add(0, 0, 0);
+                    add(1, 1, 1);
+                    add(-1, -1, -1);
+                    break;
+
+                case EFFORT_HIGH:
+                    for (int dr = -1; dr <= 1; ++dr)
+                    {
+                        for (int dg = -1; dg <= 1; ++dg)
+                        {
+                            for (int db = -1; db <= 1; ++db)
+                            {
+                                add(dr, dg, db);
+                            }
+                        }
+                    }
+                    break;
+            }
+        }
+
+        uint64 packSubblocks(const Subblock& s0, const Subblock& s1, bool differential, int flip) const
+        {
+            uint64 bits = 0;
+
+            if (differential)
+            {
+                bits |= uint64(s0.color[0]) << 59;
+                bits |= uint64((s1.color[0] - s0.color[0]) & 7) << 56;
+                bits |= uint64(s0.color[1]) << 51;
+                bits |= uint64((s1.color[1] - s0.color[1]) & 7) << 48;
+                bits |= uint64(s0.color[2]) << 43;
+                bits |= uint64((s1.color[2] - s0.color[2]) & 7) << 40;
+            }
+            else
+            {
+                bits |= uint64(s0.color[0]) << 60;
+                bits |= uint64(s1.color[0]) << 56;
+                bits |= uint64(s0.color[1]) << 52;
+                bits |= uint64(s1.color[1]) << 48;
+                bits |= uint64(s0.color[2]) << 44;
+                bits |= uint64(s1.color[2]) << 40;
+            }
+
+            bits |= uint64(s0.table) << 37;
+            bits |= uint64(s1.table) << 34;
+            // the punchthrough formats use the differential bit for opacity
+            bits |= uint64(block.punchthrough ? block.opaque : differential) << 33;
+            bits |= uint64(flip) << 32;
+
+            const PixelPlanes& planes = flip ? block.row : block.column;
+            const int colorBits = differential ? 5 : 4;
+
+            for (int i = 0; i < 2; ++i)
+            {
+                const Subblock& sub = i ? s1 : s0;
+
+                Paints paints;
+                setTablePaints(paints, expand(sub.color[0], colorBits), expand(sub.color[1], colorBits),
+                               expand(sub.color[2], colorBits), sub.table);
+                block.storeIndices(bits, planes, flip != 0, i * 2, 2, paints);
+            }
+
+            return bits;
+        }
+
+        void encodeSubblockModes()
+        {
+            for (int flip = 0; flip < 2; ++flip)
+            {
+                const PixelPlanes& planes = flip ? block.row : block.column;
+
+                // individual mode; the punchthrough formats use the bit for opacity
+                if (!block.punchthrough)
+                {
+                    std::vector<Subblock> c0;
+                    std::vector<Subblock> c1;
+                    subblockCandidates(c0, planes, 0, 4);
+                    subblockCandidates(c1, planes, 2, 4);
+
+                    auto compare = [] (const Subblock& a, const Subblock& b)
+                    {
+                        return a.error < b.error;
+                    };
+
+                    const Subblock& s0 = *std::min_element(c0.begin(), c0.end(), compare);
+                    const Subblock& s1 = *std::min_element(c1.begin(), c1.end(), compare);
+
+                    const float error = s0.error + s1.error;
+                    if (error < bestError)
+                    {
+                        candidate(error, packSubblocks(s0, s1, false, flip));
+                    }
+                }
+
+                // differential mode
+                std::vector<Subblock> c0;
+                std::vector<Subblock> c1;
+                subblockCandidates(c0, planes, 0, 5);
+                subblockCandidates(c1, planes, 2, 5);
+
+                float error = 1e30f;
+                Subblock s0;
+                Subblock s1;
+
+                for (const Subblock& a : c0)
+                {
+                    bool valid = false;
+
+                    for (const Subblock& b : c1)
+                    {
+                        bool inside = true;
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            const int delta = b.color[i] - a.color[i];
+                            inside &= delta >= -4 && delta <= 3;
+                        }
+
+                        if (inside)
+                        {
+                            valid = true;
+                            if (a.error + b.error < error)
+                            {
+                                error = a.error + b.error;
+                                s0 = a;
+                                s1 = b;
+                            }
+                        }
+                    }
+
+                    if (!valid)
+                    {
+                        // clamp the second color into the range of the delta
+                        Subblock b = c1[0];
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            b.color[i] = std::max(a.color[i] - 4, std::min(a.color[i] + 3, b.color[i]));
+                        }
+
+                        evaluateSubblock(b, planes, 2, 5);
+
+                        if (a.error + b.error < error)
+                        {
+                            error = a.error + b.error;
+                            s0 = a;
+                            s1 = b;
+                        }
+                    }
+                }
+
+                if (error < bestError)
+                {
+                    candidate(error, packSubblocks(s0, s1, true, flip));
+                }
+            }
+        }
+
+        // ------------------------------------------------------------
+        // planar mode
+        // ------------------------------------------------------------
+
+        float evaluatePlanar(const int* o, const int* h, const int* v) const
+        {
+            int error = 0;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                const int bits = c == 1 ? 7 : 6;
+                const int O = expand(o[c], bits);
+                const int H = expand(h[c], bits);
+                const int V = expand(v[c], bits);
+
+                for (int y = 0; y < 4; ++y)
+                {
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        const int value = clamp255((x * (H - O) + y * (V - O) + 4 * O + 2) >> 2);
+                        const int delta = value - block.color[x * 4 + y][c];
+                        error += delta * delta;
+                    }
+                }
+            }
+
+            return float(error);
+        }
+
+        void encodePlanar()
+        {
+            // least squares fit of c = a + b * x + c * y
+            int o[3];
+            int h[3];
+            int v[3];
+
+            for (int c = 0; c < 3; ++c)
+            {
+                float sum = 0.0f;
+                float sx = 0.0f;
+                float sy = 0.0f;
+
+                for (int y = 0; y < 4; ++y)
+                {
+                    for (int x = 0; x < 4; ++x)
+                    {
+                        const float value = float(block.color[x * 4 + y][c]);
+                        sum += value;
+                        sx += (x - 1.5f) * value;
+                        sy += (y - 1.5f) * value;
+                    }
+                }
+
+                const float dx = sx / 20.0f;
+                const float dy = sy / 20.0f;
+                const float a = sum / 16.0f - 1.5f * dx - 1.5f * dy;
+
+                const int bits = c == 1 ? 7 : 6;
+                o[c] = quantize(a, bits);
+                h[c] = quantize(a + 4.0f * dx, bits);
+                v[c] = quantize(a + 4.0f * dy, bits);
+            }
+
+            float error = evaluatePlanar(o, h, v);
+
+            if (effort == EFFORT_HIGH)
+            {
+                // coordinate descent on the quantized endpoints
+                int* values[] = { o, h, v };
+
+                for (int pass = 0; pass < 2; ++pass)
+                {
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            const int vmax = c == 1 ? 127 : 63;
+
+                            for (int step = -1; step <= 1; step += 2)
+                            {
+                                int& value = values[i][c];
+                                const int previous = value;
+                                value = std::max(0, std::min(vmax, value + step));
+
+                                const float e = evaluatePlanar(o, h, v);
+                                if (e < error)
+                                    error = e;
+                                else
+                                    value = previous;
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (error >= bestError)
+                return;
+
+            uint64 bits = 0;
+            bits |= uint64(o[0]) << 57;
+            bits |= uint64(o[1] >> 6) << 56;
+            bits |= uint64(o[1] & 63) << 49;
+            bits |= uint64(o[2] >> 5) << 48;
+            bits |= uint64((o[2] >> 3) & 3) << 43;
+            bits |= uint64(o[2] & 7) << 39;
+            bits |= uint64(h[0] >> 1) << 34;
+            bits |= uint64(h[0] & 1) << 32;
+            bits |= uint64(h[1]) << 25;
+            bits |= uint64(h[2]) << 19;
+            bits |= uint64(v[0]) << 13;
+            bits |= uint64(v[1]) << 6;
+            bits |= uint64(v[2]) << 0;
+            bits |= uint64(1) << 33;
+
+            // red and green in range, blue overflows
+            bits = preventOverflow(bits, 59, 56);
+            bits = preventOverflow(bits, 51, 48);
+            bits |= forceOverflow((o[2] >> 3) & 3, (o[2] >> 1) & 3, 43, 40);
+
+            candidate(error, bits);
+        }
+
+        // ------------------------------------------------------------
+        // T and H modes
+        // ------------------------------------------------------------
+
+        void clusterColors(float* c0, float* c1) const
+        {
+            // split along the axis with the largest range and refine with k-means
+            int lo[3] = { 255, 255, 255 };
+            int hi[3] = { 0, 0, 0 };
+
+            for (int p = 0; p < 16; ++p)
+            {
+                if (block.transparent[p])
+                    continue;
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    lo[c] = std::min(lo[c], block.color[p][c]);
+                    hi[c] = std::max(hi[c], block.color[p][c]);
+                }
+            }
+
+            for (int c = 0; c < 3; ++c)
+            {
+                c0[c] = float(lo[c]);
+                c1[c] = float(hi[c]);
+            }
+
+            for (int iteration = 0; iteration < 4; ++iteration)
+            {
+                float sum[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+                int count[2] = { 0, 0 };
+
+                for (int p = 0; p < 16; ++p)
+                {
+                    if (block.transparent[p])
+                        continue;
+
+                    float d0 = 0.0f;
+                    float d1 = 0.0f;
+
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        const float value = float(block.color[p][c]);
+                        d0 += (value - c0[c]) * (value - c0[c]);
+                        d1 += (value - c1[c]) * (value - c1[c]);
+                    }
+
+                    const int k = d1 < d0 ? 1 : 0;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        sum[k][c] += float(block.color[p][c]);
+                    }
+                    ++count[k];
+                }
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    if (count[0]) c0[c] = sum[0][c] / count[0];
+                    if (count[1]) c1[c] = sum[1][c] / count[1];
+                }
+            }
+        }
+
+        void colorNeighbours(std::vector<std::array<int, 3>>& colors, const float* center) const
+        {
+            int q[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                q[c] = quantize(center[c], 4);
+            }
+
+            colors.push_back({ q[0], q[1], q[2] });
+
+            if (effort == EFFORT_HIGH)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    for (int step = -1; step <= 1; step += 2)
+                    {
+                        std::array<int, 3> color = { q[0], q[1], q[2] };
+                        color[c] += step;
+                        if (color[c] >= 0 && color[c] <= 15)
+                            colors.push_back(color);
+                    }
+                }
+            }
+        }
+
+        void setPaint(Paints& paints, int index, const std::array<int, 3>& color, int offset) const
+        {
+            paints.set(index, expand4(color[0]) + offset, expand4(color[1]) + offset, expand4(color[2]) + offset);
+        }
+
+        void encodeT(const std::vector<std::array<int, 3>>& single, const std::vector<std::array<int, 3>>& spread)
+        {
+            float error = bestError;
+            int best[3] = { -1, 0, 0 };
+
+            for (int i = 0; i < int(single.size()); ++i)
+            {
+                for (int j = 0; j < int(spread.size()); ++j)
+                {
+                    for (int d = 0; d < 8; ++d)
+                    {
+                        const int distance = etcDistanceTable[d];
+
+                        Paints paints;
+                        setPaint(paints, 0, single[i], 0);
+                        setPaint(paints, 1, spread[j], distance);
+                        setPaint(paints, 2, spread[j], 0);
+                        setPaint(paints, 3, spread[j], -distance);
+
+                        if (block.transparentMode())
+                            paints.disable(2);
+
+                        const float e = block.evaluate(block.column, 0, 4, paints);
+                        if (e < error)
+                        {
+                            error = e;
+                            best[0] = i;
+                            best[1] = j;
+                            best[2] = d;
+                        }
+                    }
+                }
+            }
+
+            if (best[0] < 0)
+                return;
+
+            const std::array<int, 3>& c1 = single[best[0]];
+            const std::array<int, 3>& c2 = spread[best[1]];
+            const int d = best[2];
+
+            uint64 bits = 0;
+            bits |= uint64(c1[0] >> 2) << 59;
+            bits |= uint64(c1[0] & 3) << 56;
+            bits |= uint64(c1[1]) << 52;
+            bits |= uint64(c1[2]) << 48;
+            bits |= uint64(c2[0]) << 44;
+            bits |= uint64(c2[1]) << 40;
+            bits |= uint64(c2[2]) << 36;
+            bits |= uint64(d >> 1) << 34;
+            bits |= uint64(d & 1) << 32;
+            bits |= uint64(!block.transparentMode()) << 33;
+            bits |= forceOverflow(c1[0] >> 2, c1[0] & 3, 59, 56);
+
+            Paints paints;
+            setPaint(paints, 0, c1, 0);
+            setPaint(paints, 1, c2, etcDistanceTable[d]);
+            setPaint(paints, 2, c2, 0);
+            setPaint(paints, 3, c2, -etcDistanceTable[d]);
+            if (block.transparentMode())
+                paints.disable(2);
+
+            block.storeIndices(bits, block.column, false, 0, 4, paints);
+            candidate(error, bits);
+        }
+
+        void encodeH(const std::vector<std::array<int, 3>>& colors0, const std::vector<std::array<int, 3>>& colors1)
+        {
+            float error = bestError;
+            int best[3] = { -1, 0, 0 };
+
+            for (int i = 0; i < int(colors0.size()); ++i)
+            {
+                for (int j = 0; j < int(colors1.size()); ++j)
+                {
+                    const std::array<int, 3>& a = colors0[i];
+                    const std::array<int, 3>& b = colors1[j];
+
+                    const int va = (a[0] << 8) | (a[1] << 4) | a[2];
+                    const int vb = (b[0] << 8) | (b[1] << 4) | b[2];
+
+                    for (int d = 0; d < 8; ++d)
+                    {
+                        // the lowest bit of the distance is the order of the colors
+                        if (va == vb && !(d & 1))
+                            continue;
+
+                        const int distance = etcDistanceTable[d];
+
+                        Paints paints;
+                        setPaint(paints, 0, a, distance);
+                        setPaint(paints, 1, a, -distance);
+                        setPaint(paints, 2, b, distance);
+                        setPaint(paints, 3, b, -distance);
+
+                        if (block.transparentMode())
+                            paints.disable(2);
+
+                        const float e = block.evaluate(block.column, 0, 4, paints);
+                        if (e < error)
+                        {
+                            error = e;
+                            best[0] = i;
+                            best[1] = j;
+                            best[2] = d;
+                        }
+                    }
+                }
+            }
+
+            if (best[0] < 0)
+                return;
+
+            std::array<int, 3> c1 = colors0[best[0]];
+            std::array<int, 3> c2 = colors1[best[1]];
+            const int d = best[2];
+
+            const int v1 = (c1[0] << 8) | (c1[1] << 4) | c1[2];
+            const int v2 = (c2[0] << 8) | (c2[1] << 4) | c2[2];
+
+            if ((v1 >= v2) != ((d & 1) != 0))
+            {
+                // the transparent paint belongs to the second color; the swap is only
+                // allowed when it keeps the same colors in the same slots
+                if (block.transparentMode())
+                    return;
+
+                std::swap(c1, c2);
+            }
+
+            uint64 bits = 0;
+            bits |= uint64(c1[0]) << 59;
+            bits |= uint64(c1[1] >> 1) << 56;
+            bits |= uint64(c1[1] & 1) << 52;
+            bits |= uint64(c1[2] >> 3) << 51;
+            bits |= uint64(c1[2] & 7) << 47;
+            bits |= uint64(c2[0]) << 43;
+            bits |= uint64(c2[1]) << 39;
+            bits |= uint64(c2[2]) << 35;
+            bits |= uint64(d >> 2) << 34;
+            bits |= uint64((d >> 1) & 1) << 32;
+            bits |= uint64(!block.transparentMode()) << 33;
+
+            // red in range, green overflows
+            bits = preventOverflow(bits, 59, 56);
+            bits |= forceOverflow(((c1[1] & 1) << 1) | (c1[2] >> 3), (c1[2] >> 1) & 3, 51, 48);
+
+            Paints paints;
+            setPaint(paints, 0, c1, etcDistanceTable[d]);
+            setPaint(paints, 1, c1, -etcDistanceTable[d]);
+            setPaint(paints, 2, c2, etcDistanceTable[d]);
+            setPaint(paints, 3, c2, -etcDistanceTable[d]);
+            if (block.transparentMode())
+                paints.disable(2);
+
+            block.storeIndices(bits, block.column, false, 0, 4, paints);
+            candidate(block.evaluate(block.column, 0, 4, paints), bits);
+        }
+
+        void encodeTH()
+        {
+            float c0[3];
+            float c1[3];
+            clusterColors(c0, c1);
+
+            std::vector<std::array<int, 3>> colors0;
+            std::vector<std::array<int, 3>> colors1;
+            colorNeighbours(colors0, c0);
+            colorNeighbours(colors1, c1);
+
+            encodeT(colors0, colors1);
+            encodeT(colors1, colors0);
+            encodeH(colors0, colors1);
+            encodeH(colors1, colors0);
+        }
+
+    public:
+        ColorEncoder(const ColorBlock& block, Effort effort)
+            : block(block)
+            , effort(effort)
+            , bestError(1e30f)
+            , bestBits(0)
+        {
+        }
+
+        uint64 encode()
+        {
+            encodeSubblockModes();
+
+            if (bestError > 0.0f && !block.transparentMode())
+                encodePlanar();
+
+            if (bestError > 0.0f && effort != EFFORT_FAST)
+                encodeTH();
+
+            return bestBits;
+        }
+    };
+
+    uint64 encodeColor(const uint8* input, int stride, bool punchthrough, Effort effort)
+    {
+        ColorBlock block(input, stride, punchthrough);
+        ColorEncoder encoder(block, effort);
+        return encoder.encode();
+    }
+
+    // ------------------------------------------------------------
+    // EAC encoder
+    // ------------------------------------------------------------
+
+    enum EacMode
+    {
+        EAC_ALPHA8,   // 8 bit alpha of ETC2_RGBA
+        EAC_UNSIGNED, // 11 bit unsigned
+        EAC_SIGNED    // 11 bit signed
+    };
+
+    struct EacEncoder
+    {
+        EacMode mode;
+        float32x4 value[4]; // pixels in the ETC order
+        int vmin;
+        int vmax;
+
+        float bestError;
+        int bestBase;
+        int bestMultiplier;
+        int bestTable;
+
+        EacEncoder(EacMode mode, const int* values)
+            : mode(mode)
+        {
+            vmin = values[0];
+            vmax = values[0];
+
+            for (int i = 0; i < 16; ++i)
+            {
+                vmin = std::min(vmin, values[i]);
+                vmax = std::max(vmax, values[i]);
+            }
+
+            for (int i = 0; i < 4; ++i)
+            {
+                const int* v = values + i * 4;
+                value[i] = float32x4(float(v[0]), float(v[1]), float(v[2]), float(v[3]));
+            }
+
+            bestError = 1e30f;
+            bestBase = 0;
+            bestMultiplier = 1;
+            bestTable = 0;
+        }
+
+        int decode(int base, int multiplier, int modifier) const
+        {
+            switch (mode)
+            {
+                case EAC_ALPHA8:
+                    return clamp255(base + multiplier * modifier);
+
+                case EAC_UNSIGNED:
+                    if (multiplier)
+                        return std::max(0, std::min(2047, base * 8 + 4 + multiplier * modifier * 8));
+                    else
+                        return std::max(0, std::min(2047, base * 8 + 4 + modifier));
+
+                case EAC_SIGNED:
+                default:
+                    if (multiplier)
+                        return std::max(-1023, std::min(1023, base * 8 + multiplier * modifier * 8));
+                    else
+                        return std::max(-1023, std::min(1023, base * 8 + modifier));
+            }
+        }
+
+        float evaluate(int base, int multiplier, int table, uint64* indices) const
+        {
+            float32x4 sample[8];
+            for (int i = 0; i < 8; ++i)
+            {
+                sample[i] = float32x4(float(decode(base, multiplier, eacModifierTable[table][i])));
+            }
+
+            float32x4 error(0.0f);
+
+            for (int j = 0; j < 4; ++j)
+            {
+                float32x4 d = value[j] - sample[0];
+                float32x4 best = d * d;
+                float32x4 index(0.0f);
+
+                for (int i = 1; i < 8; ++i)
+                {
+                    d = value[j] - sample[i];
+                    const float32x4 e = d * d;
+                    const mask32x4 mask = e < best;
+                    best = select(mask, e, best);
+                    index = select(mask, float32x4(float(i)), index);
+                }
+
+                error = error + best;
+
+                if (indices)
+                {
+                    const float lane[] = { float(index.x), float(index.y), float(index.z), float(index.w) };
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        const int p = j * 4 + k;
+                        *indices |= uint64(int(lane[k])) << (45 - 3 * p);
+                    }
+                }
+            }
+
+            return hsum(error);
+        }
+
+        void search(int base0, int multiplier0, int table, int baseRadius, int multiplierRadius)
+        {
+            const int baseMin = mode == EAC_SIGNED ? -127 : 0;
+            const int baseMax = mode == EAC_SIGNED ? 127 : 255;
+
+            for (int m = multiplier0 - multiplierRadius; m <= multiplier0 + multiplierRadius; ++m)
+            {
+                if (m < 1 || m > 15)
+                    continue;
+
+                for (int b = base0 - baseRadius; b <= base0 + baseRadius; ++b)
+                {
+                    const int base = std::max(baseMin, std::min(baseMax, b));
+                    const float error = evaluate(base, m, table, nullptr);
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        bestBase = base;
+                        bestMultiplier = m;
+                        bestTable = table;
+                    }
+                }
+            }
+        }
+
+        uint64 encode(Effort effort)
+        {
+            const int baseRadius = effort == EFFORT_FAST ? 0 : effort == EFFORT_NORMAL ? 1 : 3;
+            const int multiplierRadius = effort == EFFORT_FAST ? 0 : effort == EFFORT_NORMAL ? 1 : 2;
+            const float scale = mode == EAC_ALPHA8 ? 1.0f : 8.0f;
+            const float bias = mode == EAC_UNSIGNED ? 4.0f : 0.0f;
+
+            for (int table = 0; table < 16; ++table)
+            {
+                const int* modifier = eacModifierTable[table];
+                const float low = float(modifier[3]);
+                const float high = float(modifier[7]);
+
+                // fit the table range over the value range
+                const float range = float(vmax - vmin);
+                const int multiplier = std::max(1, std::min(15, int(range / ((high - low) * scale) + 0.5f)));
+                const float center = (vmin + vmax) * 0.5f - multiplier * scale * (high + low) * 0.5f;
+                const int base = int(std::floor((center - bias) / scale + 0.5f));
+
+                search(base, multiplier, table, baseRadius, multiplierRadius);
+
+                if (bestError == 0.0f)
+                    break;
+            }
+
+            if (mode != EAC_ALPHA8 && vmax - vmin < 32)
+            {
+                // the zero multiplier gives the finest steps for smooth blocks
+                const int base = int(std::floor(((vmin + vmax) * 0.5f - bias) / 8.0f + 0.5f));
+                const int baseMin = mode == EAC_SIGNED ? -127 : 0;
+                const int baseMax = mode == EAC_SIGNED ? 127 : 255;
+
+                for (int table = 0; table < 16; ++table)
+                {
+                    for (int b = base - 1; b <= base + 1; ++b)
+                    {
+                        const int c = std::max(baseMin, std::min(baseMax, b));
+                        const float error = evaluate(c, 0, table, nullptr);
+                        if (error < bestError)
+                        {
+                            bestError = error;
+                            bestBase = c;
+                            bestMultiplier = 0;
+                            bestTable = table;
+                        }
+                    }
+                }
+            }
+
+            uint64 bits = 0;
+            bits |= uint64(bestBase & 0xff) << 56;
+            bits |= uint64(bestMultiplier) << 52;
+            bits |= uint64(bestTable) << 48;
+            evaluate(bestBase, bestMultiplier, bestTable, &bits);
+            return bits;
+        }
+    };
+
+    void encodeAlpha(uint8* output, const uint8* input, int stride, Effort effort)
+    {
+        int values[16];
+
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                values[x * 4 + y] = input[y * stride + x * 4 + 3];
+            }
+        }
+
+        EacEncoder encoder(EAC_ALPHA8, values);
+        ustore64be(output, encoder.encode(effort));
+    }
+
+    void encodeChannel11(uint8* output, const uint8* input, int stride, int step, bool isSigned, Effort effort)
+    {
+        int values[16];
+
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                const uint8* s = input + y * stride + x * step;
+                int v;
+
+                if (isSigned)
+                {
+                    const int sample = int16(uload16le(s));
+                    v = (std::max(-32767, sample) * 1023 + (sample < 0 ? -16383 : 16383)) / 32767;
+                }
+                else
+                {
+                    v = (int(uload16le(s)) * 2047 + 32767) / 65535;
+                }
+
+                values[x * 4 + y] = v;
+            }
+        }
+
+        EacEncoder encoder(isSigned ? EAC_SIGNED : EAC_UNSIGNED, values);
+        ustore64be(output, encoder.encode(effort));
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void encode_block_etc2(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
+    {
+        const bool punchthrough = info.compression == TextureCompression::ETC2_RGB_ALPHA1 ||
+                                  info.compression == TextureCompression::ETC2_SRGB_ALPHA1;
+        ustore64be(output, encodeColor(input, stride, punchthrough, getEffort(quality)));
+    }
+
+    void encode_block_etc2_eac(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
+    {
+        MANGO_UNREFERENCED_PARAMETER(info);
+        const Effort effort = getEffort(quality);
+        encodeAlpha(output + 0, input, stride, effort);
+        ustore64be(output + 8, encodeColor(input, stride, false, effort));
+    }
+
+    void encode_block_eac_r11(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
+    {
+        const bool isSigned = info.compression == TextureCompression::EAC_SIGNED_R11;
+        encodeChannel11(output, input, stride, 2, isSigned, getEffort(quality));
+    }
+
+    void encode_block_eac_rg11(const TextureCompressionInfo& info, uint8* output, const uint8* input, int stride, float quality)
+    {
+        const bool isSigned = info.compression == TextureCompression::EAC_SIGNED_RG11;
+        const Effort effort = getEffort(quality);
+        encodeChannel11(output + 0, input + 0, stride, 4, isSigned, effort);
+        encodeChannel11(output + 8, input + 2, stride, 4, isSigned, effort);
+    }
+
+} // namespace mango
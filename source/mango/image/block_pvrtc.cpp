@@ -1,7 +1,12 @@
 /*
     MANGO Multimedia Development Platform
-    Copyright (C) 2012-2016 Twilight Finland 3D Oy Ltd. All rights reserved.
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
+#include <vector>
+#include <mango/core/bits.hpp>
+#include <mango/core/exception.hpp>
+#include <mango/core/thread.hpp>
+#include <mango/math/vector.hpp>
 #include <mango/image/compression.hpp>
 
 namespace
@@ -20,174 +25,157 @@ namespace
     // PVRTC decompressor (C) Imagination Technologies Limited.
     // Adapted and optimized for MANGO in December 2016.
 
-    struct Pixel32
-    {
-        uint8 red, green, blue, alpha;
-    };
-    
-    struct Pixel128S
-    {
-        int32 red, green, blue, alpha;
-    };
-    
+    // The colors are upscaled and modulated one pixel (RGBA) per int32x4 and the rows of words
+    // are decoded in bands on the ThreadPool. The results are identical to the reference decoder,
+    // which decodes PVRTC1.
+
     struct PVRTCWord
     {
         uint32 u32ModulationData;
         uint32 u32ColorData;
     };
-    
-    static Pixel32 getColorA(uint32 u32ColorData)
+
+    struct PVRTCFormat
+    {
+        uint8 ui8Bpp;   // 2 or 4
+        bool alpha;     // encoder: the alpha is encoded
+    };
+
+    PVRTCFormat getFormat(const TextureCompressionInfo& info)
+    {
+        PVRTCFormat format;
+
+        format.ui8Bpp = 4;
+        format.alpha = (info.getCompressionFlags() & TextureCompressionInfo::ALPHA) != 0;
+
+        switch (info.compression)
+        {
+            case TextureCompression::PVRTC_RGB_2BPP:
+            case TextureCompression::PVRTC_RGBA_2BPP:
+            case TextureCompression::PVRTC_SRGB_2BPP:
+            case TextureCompression::PVRTC_SRGB_ALPHA_2BPP:
+                format.ui8Bpp = 2;
+                break;
+
+            default:
+                break;
+        }
+
+        return format;
+    }
+
+    static int32x4 getColorA(uint32 u32ColorData)
     {
-        Pixel32 color;
-        
         if ((u32ColorData & 0x8000) != 0)
         {
             // Opaque Color Mode - RGB 554
-            color.red   = (uint8)((u32ColorData & 0x7c00) >> 10); // 5->5 bits
-            color.green = (uint8)((u32ColorData & 0x3e0)  >> 5); // 5->5 bits
-            color.blue  = (uint8)(u32ColorData  & 0x1e) | ((u32ColorData & 0x1e) >> 4); // 4->5 bits
-            color.alpha = (uint8)0xf;// 0->4 bits
+            const int red   = (u32ColorData & 0x7c00) >> 10; // 5->5 bits
+            const int green = (u32ColorData & 0x3e0)  >> 5; // 5->5 bits
+            const int blue  = (u32ColorData & 0x1e) | ((u32ColorData & 0x1e) >> 4); // 4->5 bits
+            return int32x4(red, green, blue, 0xf); // 0->4 bits
         }
         else
         {
             // Transparent Color Mode - ARGB 3443
-            color.red   = (uint8)((u32ColorData & 0xf00)  >> 7) | ((u32ColorData & 0xf00) >> 11); // 4->5 bits
-            color.green = (uint8)((u32ColorData & 0xf0)   >> 3) | ((u32ColorData & 0xf0)  >> 7); // 4->5 bits
-            color.blue  = (uint8)((u32ColorData & 0xe)    << 1) | ((u32ColorData & 0xe)   >> 2); // 3->5 bits
-            color.alpha = (uint8)((u32ColorData & 0x7000) >> 11);// 3->4 bits - note 0 at right
+            const int red   = ((u32ColorData & 0xf00)  >> 7) | ((u32ColorData & 0xf00) >> 11); // 4->5 bits
+            const int green = ((u32ColorData & 0xf0)   >> 3) | ((u32ColorData & 0xf0)  >> 7); // 4->5 bits
+            const int blue  = ((u32ColorData & 0xe)    << 1) | ((u32ColorData & 0xe)   >> 2); // 3->5 bits
+            const int alpha = (u32ColorData & 0x7000) >> 11; // 3->4 bits - note 0 at right
+            return int32x4(red, green, blue, alpha);
         }
-        
-        return color;
     }
-    
-    static Pixel32 getColorB(uint32 u32ColorData)
+
+    static int32x4 getColorB(uint32 u32ColorData)
     {
-        Pixel32 color;
-        
         if (u32ColorData & 0x80000000)
         {
             // Opaque Color Mode - RGB 555
-            color.red   = (uint8)((u32ColorData & 0x7c000000) >> 26); // 5->5 bits
-            color.green = (uint8)((u32ColorData & 0x3e00000)  >> 21); // 5->5 bits
-            color.blue  = (uint8)((u32ColorData & 0x1f0000)   >> 16); // 5->5 bits
-            color.alpha = (uint8)0xf;// 0 bits
+            const int red   = (u32ColorData & 0x7c000000) >> 26; // 5->5 bits
+            const int green = (u32ColorData & 0x3e00000)  >> 21; // 5->5 bits
+            const int blue  = (u32ColorData & 0x1f0000)   >> 16; // 5->5 bits
+            return int32x4(red, green, blue, 0xf); // 0 bits
         }
         else
         {
             // Transparent Color Mode - ARGB 3444
-            color.red   = (uint8)(((u32ColorData & 0xf000000)  >> 23) | ((u32ColorData & 0xf000000) >> 27)); // 4->5 bits
-            color.green = (uint8)(((u32ColorData & 0xf00000)   >> 19) | ((u32ColorData & 0xf00000)  >> 23)); // 4->5 bits
-            color.blue  = (uint8)(((u32ColorData & 0xf0000)    >> 15) | ((u32ColorData & 0xf0000)   >> 19)); // 4->5 bits
-            color.alpha = (uint8)((u32ColorData & 0x70000000) >> 27);// 3->4 bits - note 0 at right
+            const int red   = ((u32ColorData & 0xf000000)  >> 23) | ((u32ColorData & 0xf000000) >> 27); // 4->5 bits
+            const int green = ((u32ColorData & 0xf00000)   >> 19) | ((u32ColorData & 0xf00000)  >> 23); // 4->5 bits
+            const int blue  = ((u32ColorData & 0xf0000)    >> 15) | ((u32ColorData & 0xf0000)   >> 19); // 4->5 bits
+            const int alpha = (u32ColorData & 0x70000000) >> 27; // 3->4 bits - note 0 at right
+            return int32x4(red, green, blue, alpha);
         }
-        
-        return color;
     }
-    
-    static void interpolateColors(Pixel32 color[4], Pixel128S* pPixel, uint8 ui8Bpp)
+
+    // Bilinear upscale of the colors of four words (P, Q, R, S) into the wordWidth x 4 pixels
+    // between the word centers. The weights sum to 16 (4bpp) or 32 (2bpp) and the result is
+    // expanded to 8 bits with the shifts of the reference decoder.
+    template <typename Func>
+    void upscaleColors(const int32x4 colorA[4], const int32x4 colorB[4], uint8 ui8Bpp, Func func)
     {
-        const uint32 ui32WordWidth = (ui8Bpp == 2) ? 8 : 4;
-        const uint32 ui32WordHeight = 4;
-        
-        //Convert to int 32.
-        Pixel128S hP = { (int32)color[0].red, (int32)color[0].green, (int32)color[0].blue, (int32)color[0].alpha };
-        Pixel128S hQ = { (int32)color[1].red, (int32)color[1].green, (int32)color[1].blue, (int32)color[1].alpha };
-        Pixel128S hR = { (int32)color[2].red, (int32)color[2].green, (int32)color[2].blue, (int32)color[2].alpha };
-        Pixel128S hS = { (int32)color[3].red, (int32)color[3].green, (int32)color[3].blue, (int32)color[3].alpha };
-        
-        //Get vectors.
-        Pixel128S QminusP = {hQ.red - hP.red, hQ.green - hP.green, hQ.blue - hP.blue, hQ.alpha - hP.alpha};
-        Pixel128S SminusR = {hS.red - hR.red, hS.green - hR.green, hS.blue - hR.blue, hS.alpha - hR.alpha};
-        
-        //Multiply colors.
-        hP.red		*=	ui32WordWidth;
-        hP.green	*=	ui32WordWidth;
-        hP.blue		*=	ui32WordWidth;
-        hP.alpha	*=	ui32WordWidth;
-        hR.red		*=	ui32WordWidth;
-        hR.green	*=	ui32WordWidth;
-        hR.blue		*=	ui32WordWidth;
-        hR.alpha	*=	ui32WordWidth;
-        
-        if (ui8Bpp == 2)
+        const int wordWidth = (ui8Bpp == 2) ? 8 : 4;
+        const int scale = (ui8Bpp == 2) ? 3 : 2; // log2(wordWidth)
+        const int shift = (ui8Bpp == 2) ? 1 : 0;
+
+        const mask32x4 alpha = int32x4(0, 0, 0, 1) > int32x4(0);
+
+        auto expand = [=] (int32x4 v) -> int32x4
         {
-            //Loop through pixels to achieve results.
-            for (unsigned int x = 0; x < ui32WordWidth; x++)
-            {
-                Pixel128S result = {4 * hP.red, 4 * hP.green, 4 * hP.blue, 4 * hP.alpha};
-                Pixel128S dY = {hR.red - hP.red, hR.green - hP.green, hR.blue - hP.blue, hR.alpha - hP.alpha};
-                
-                for (unsigned int y = 0; y < ui32WordHeight; y++)
-                {
-                    pPixel[y * ui32WordWidth + x].red   = (int32)((result.red   >> 7) + (result.red   >> 2));
-                    pPixel[y * ui32WordWidth + x].green = (int32)((result.green >> 7) + (result.green >> 2));
-                    pPixel[y * ui32WordWidth + x].blue  = (int32)((result.blue  >> 7) + (result.blue  >> 2));
-                    pPixel[y * ui32WordWidth + x].alpha = (int32)((result.alpha >> 5) + (result.alpha >> 1));
-                    
-                    result.red   += dY.red;
-                    result.green += dY.green;
-                    result.blue  += dY.blue;
-                    result.alpha += dY.alpha;
-                }
-                
-                hP.red		+= QminusP.red;
-                hP.green	+= QminusP.green;
-                hP.blue		+= QminusP.blue;
-                hP.alpha	+= QminusP.alpha;
-                
-                hR.red		+= SminusR.red;
-                hR.green	+= SminusR.green;
-                hR.blue		+= SminusR.blue;
-                hR.alpha	+= SminusR.alpha;
-            }
-        }
-        else
+            v = v >> shift;
+            return select(alpha, (v >> 4) + v, (v >> 6) + (v >> 1));
+        };
+
+        int32x4 leftA = colorA[0] << 2;
+        int32x4 leftB = colorB[0] << 2;
+        int32x4 rightA = colorA[1] << 2;
+        int32x4 rightB = colorB[1] << 2;
+        const int32x4 stepLeftA = colorA[2] - colorA[0];
+        const int32x4 stepLeftB = colorB[2] - colorB[0];
+        const int32x4 stepRightA = colorA[3] - colorA[1];
+        const int32x4 stepRightB = colorB[3] - colorB[1];
+
+        for (int y = 0; y < 4; ++y)
         {
-            //Loop through pixels to achieve results.
-            for (unsigned int y = 0; y < ui32WordHeight; y++)
+            int32x4 a = leftA << scale;
+            int32x4 b = leftB << scale;
+            const int32x4 stepA = rightA - leftA;
+            const int32x4 stepB = rightB - leftB;
+
+            for (int x = 0; x < wordWidth; ++x)
             {
-                Pixel128S result = {4 * hP.red, 4 * hP.green, 4 * hP.blue, 4 * hP.alpha};
-                Pixel128S dY = {hR.red - hP.red, hR.green - hP.green, hR.blue - hP.blue, hR.alpha - hP.alpha};
-                
-                for (unsigned int x = 0; x < ui32WordWidth; x++)
-                {
-                    pPixel[x * ui32WordWidth + y].red   = (int32)((result.red   >> 6) + (result.red   >> 1));
-                    pPixel[x * ui32WordWidth + y].green = (int32)((result.green >> 6) + (result.green >> 1));
-                    pPixel[x * ui32WordWidth + y].blue  = (int32)((result.blue  >> 6) + (result.blue  >> 1));
-                    pPixel[x * ui32WordWidth + y].alpha = (int32)((result.alpha >> 4) + (result.alpha));
-                    
-                    result.red   += dY.red;
-                    result.green += dY.green;
-                    result.blue  += dY.blue;
-                    result.alpha += dY.alpha;
-                }
-                
-                hP.red   += QminusP.red;
-                hP.green += QminusP.green;
-                hP.blue  += QminusP.blue;
-                hP.alpha += QminusP.alpha;
-                
-                hR.red   += SminusR.red;
-                hR.green += SminusR.green;
-                hR.blue  += SminusR.blue;
-                hR.alpha += SminusR.alpha;
+                func(x, y, expand(a), expand(b));
+
+                a = a + stepA;
+                b = b + stepB;
             }
+
+            leftA = leftA + stepLeftA;
+            leftB = leftB + stepLeftB;
+            rightA = rightA + stepRightA;
+            rightB = rightB + stepRightB;
         }
     }
-    
+
+    static inline int32x4 lerp(int32x4 a, int32x4 b, int mod)
+    {
+        // a + ((b - a) * mod) / 8 with the division rounding towards zero
+        int32x4 t = simd::mullo(b - a, int32x4(mod));
+        t = t + ((t >> 31) & int32x4(7));
+        return a + (t >> 3);
+    }
+
 #define PUNCHTHROUGH_ALPHA 0x10
-    
+
     static void unpackModulations(const PVRTCWord& word, int offsetX, int offsetY, uint8 i32ModulationValues[8][16], uint8 ui8Bpp)
     {
         uint32 WordModMode = word.u32ColorData & 0x1;
         uint32 ModulationBits = word.u32ModulationData;
-        
+
         const uint8 modulation_table[] =
         {
             0, 3, 5, 8,
             0, 4, 4 | PUNCHTHROUGH_ALPHA, 8
         };
-        
+
         // Unpack differently depending on 2bpp or 4bpp modes.
         if (ui8Bpp == 2)
         {
@@ -199,12 +187,12 @@ namespace
                     WordModMode += ((ModulationBits >> 20) & 1) + 1;
                     ModulationBits = (ModulationBits & ~0x00100000) | ((ModulationBits & 0x00200000) >> 1);
                 }
-                
+
                 ModulationBits = (ModulationBits & ~0x00000001) | ((ModulationBits & 0x00000002) >> 1);
-                
+
                 // Store mode in 2 MSB
                 WordModMode <<= 6;
-                
+
                 for (int y = 0; y < 4; y++)
                 {
                     uint8* dest = &i32ModulationValues[y + offsetY][0 + offsetX];
@@ -246,7 +234,7 @@ namespace
             }
         }
     }
-    
+
     static int32 getModulationValues(uint8 i32ModulationValues[8][16], uint32 xPos, uint32 yPos, uint8 ui8Bpp)
     {
         int value = i32ModulationValues[yPos][xPos];
@@ -286,68 +274,75 @@ namespace
                 }
             }
         }
-        
+
         return value;
     }
-    
-    constexpr int lerp(int a, int b, int mod)
-    {
-        return a + ((b - a) * mod) / 8;
-    }
-    
+
     static void pvrtcGetDecompressedPixels(uint8 i32ModulationValues[8][16],
-                                           Pixel128S upscaledColorA[32],
-                                           Pixel128S upscaledColorB[32],
+                                           const int32x4 colorA[4],
+                                           const int32x4 colorB[4],
                                            uint8* pColorData, int stride,
                                            int xoffset, int yoffset, int width, int height,
                                            uint8 ui8Bpp)
     {
         const uint32 ui32WordWidth = (ui8Bpp == 2) ? 8 : 4;
         const uint32 ui32WordHeight = 4;
-        
+
         xoffset = xoffset * ui32WordWidth - ui32WordWidth / 2;
         yoffset = yoffset * ui32WordHeight - ui32WordHeight / 2;
         const int xmask = width - 1;
         const int ymask = height - 1;
-        
-        for (unsigned int y = 0; y < ui32WordHeight; y++)
+
+        const mask32x4 alpha = int32x4(0, 0, 0, 1) > int32x4(0);
+
+        upscaleColors(colorA, colorB, ui8Bpp, [&] (int x, int y, int32x4 a, int32x4 b)
         {
-            const Pixel128S* colorA = upscaledColorA + y * ui32WordWidth;
-            const Pixel128S* colorB = upscaledColorB + y * ui32WordWidth;
-            
-            const int sy = ((yoffset + y) & ymask) * stride;
-            Pixel32* dest = reinterpret_cast<Pixel32 *>(pColorData + sy);
+            int32 mod = getModulationValues(i32ModulationValues, x + ui32WordWidth / 2, y + ui32WordHeight / 2, ui8Bpp);
+            bool punchthrough_alpha = (mod & PUNCHTHROUGH_ALPHA) != 0;
+            mod &= 0xf;
 
-            for (unsigned int x = 0; x < ui32WordWidth; x++)
-            {
-                int32 mod = getModulationValues(i32ModulationValues, x + ui32WordWidth / 2, y + ui32WordHeight / 2, ui8Bpp);
-                bool punchthrough_alpha = (mod & PUNCHTHROUGH_ALPHA) != 0;
-                mod &= 0xf;
-                
-                Pixel128S result;
-                result.red   = lerp(colorA[x].red,   colorB[x].red,   mod);
-                result.green = lerp(colorA[x].green, colorB[x].green, mod);
-                result.blue  = lerp(colorA[x].blue,  colorB[x].blue,  mod);
-                if (punchthrough_alpha)
-                    result.alpha = 0;
-                else
-                    result.alpha = lerp(colorA[x].alpha, colorB[x].alpha, mod);
-                
-                const int offset = (xoffset + x) & xmask;
-                dest[offset].red   = (uint8)result.red;
-                dest[offset].green = (uint8)result.green;
-                dest[offset].blue  = (uint8)result.blue;
-                dest[offset].alpha = (uint8)result.alpha;
-            }
-        }
+            int32x4 result = lerp(a, b, mod);
+            if (punchthrough_alpha)
+                result = select(alpha, int32x4(0), result);
+
+            uint32* dest = reinterpret_cast<uint32 *>(pColorData + ((yoffset + y) & ymask) * stride);
+            dest[(xoffset + x) & xmask] = result.pack();
+        });
     }
-    
+
     constexpr unsigned int wrapWordIndex(unsigned int numWords, int word)
     {
         //return ((word + numWords) % numWords);
         return word & (numWords - 1); // numWords must be power of two
     }
-    
+
+    // The words are twiddled (Morton order with y in the lower bit) in square tiles of the
+    // shorter side; the tiles of rectangular textures follow each other along the longer side.
+    struct PVRTCWordOrder
+    {
+        uint32 mask;
+        int shift;
+
+        PVRTCWordOrder(int xwords, int ywords)
+        {
+            const uint32 size = uint32(std::min(xwords, ywords));
+            mask = size - 1;
+            shift = u32_log2(size);
+        }
+
+        uint32 operator () (uint32 x, uint32 y) const
+        {
+            return u32_interleave_bits(y & mask, x & mask) | (((x | y) & ~mask) << shift);
+        }
+    };
+
+    static bool isValidSize(int width, int height, int wordWidth)
+    {
+        // the texture is at least one word and the word grid wraps around
+        return width >= wordWidth && height >= 4 &&
+               u32_is_power_of_two(width) && u32_is_power_of_two(height);
+    }
+
     static void moveModulationValues(uint8 i32ModulationValues[8][16], uint32 ui32WordWidth, uint8 ui8Bpp)
     {
         uint32* d = (uint32*) &i32ModulationValues[0][0];
@@ -361,91 +356,483 @@ namespace
             s += 4;
         }
     }
-    
+
     static void pvrtcDecompress(const uint8* pCompressedData,
                                uint8* pDecompressedData,
                                int stride,
                                uint32 ui32Width,
                                uint32 ui32Height,
-                               uint8 ui8Bpp)
+                               const PVRTCFormat& format)
     {
+        const uint8 ui8Bpp = format.ui8Bpp;
         const uint32 ui32WordWidth = (ui8Bpp == 2) ? 8 : 4;
         const uint32 ui32WordHeight = 4;
-        
-        PVRTCWord* pWordMembers = (PVRTCWord*)pCompressedData;
-        
+
+        const PVRTCWord* pWordMembers = reinterpret_cast<const PVRTCWord*>(pCompressedData);
+
         // Calculate number of words
         int i32NumXWords = (int)(ui32Width / ui32WordWidth);
         int i32NumYWords = (int)(ui32Height / ui32WordHeight);
-        
-        // For each row of words
-        for (int wordY = 0; wordY < i32NumYWords; wordY++)
-        {
-            int x0 = i32NumXWords - 1;
-            int x1 = 0;
-            int y0 = wrapWordIndex(i32NumYWords, wordY - 1);
-            int y1 = wrapWordIndex(i32NumYWords, wordY);
-            
-            PVRTCWord* P = pWordMembers + u32_interleave_bits(y0, x0);
-            PVRTCWord* Q = pWordMembers + u32_interleave_bits(y0, x1);
-            PVRTCWord* R = pWordMembers + u32_interleave_bits(y1, x0);
-            PVRTCWord* S = pWordMembers + u32_interleave_bits(y1, x1);
-            
-            uint8 i32ModulationValues[8][16];
-            
-            unpackModulations(*P, 0, 0,                          i32ModulationValues, ui8Bpp);
-            unpackModulations(*Q, ui32WordWidth, 0,              i32ModulationValues, ui8Bpp);
-            unpackModulations(*R, 0, ui32WordHeight,             i32ModulationValues, ui8Bpp);
-            unpackModulations(*S, ui32WordWidth, ui32WordHeight, i32ModulationValues, ui8Bpp);
-            
-            Pixel32 colorA[4];
-            Pixel32 colorB[4];
-            
-            colorA[0] = getColorA(P->u32ColorData);
-            colorA[1] = getColorA(Q->u32ColorData);
-            colorA[2] = getColorA(R->u32ColorData);
-            colorA[3] = getColorA(S->u32ColorData);
-            colorB[0] = getColorB(P->u32ColorData);
-            colorB[1] = getColorB(Q->u32ColorData);
-            colorB[2] = getColorB(R->u32ColorData);
-            colorB[3] = getColorB(S->u32ColorData);
-            
-            // for each column of words
-            for (int wordX = 0; wordX < i32NumXWords; wordX++)
+
+        const PVRTCWordOrder order(i32NumXWords, i32NumYWords);
+
+        // Each row of words writes the image rows between the word centers of it and
+        // the previous row so the bands write disjoint rows.
+        processBands(i32NumYWords, size_t(i32NumXWords) * i32NumYWords, 256, [=] (int first, int last)
+        {
+            // For each row of words
+            for (int wordY = first; wordY < last; wordY++)
             {
-                Pixel128S upscaledColorA[32];
-                Pixel128S upscaledColorB[32];
-                
-                // Bilinear upscale image data from 2x2 -> 4x4
-                interpolateColors(colorA, upscaledColorA, ui8Bpp);
-                interpolateColors(colorB, upscaledColorB, ui8Bpp);
-                
-                // assemble 4 words into struct to get decompressed pixels from
-                pvrtcGetDecompressedPixels(i32ModulationValues, upscaledColorA, upscaledColorB,
-                                           pDecompressedData, stride, wordX, wordY, ui32Width, ui32Height, ui8Bpp);
-                
-                x1 = wrapWordIndex(i32NumXWords, wordX + 1);
-                
-                P = Q;
-                R = S;
-                Q = pWordMembers + u32_interleave_bits(y0, x1);
-                S = pWordMembers + u32_interleave_bits(y1, x1);
-                
-                moveModulationValues(i32ModulationValues, ui32WordWidth, ui8Bpp);
+                int x0 = i32NumXWords - 1;
+                int x1 = 0;
+                int y0 = wrapWordIndex(i32NumYWords, wordY - 1);
+                int y1 = wrapWordIndex(i32NumYWords, wordY);
+
+                const PVRTCWord* P = pWordMembers + order(x0, y0);
+                const PVRTCWord* Q = pWordMembers + order(x1, y0);
+                const PVRTCWord* R = pWordMembers + order(x0, y1);
+                const PVRTCWord* S = pWordMembers + order(x1, y1);
+
+                uint8 i32ModulationValues[8][16];
+
+                unpackModulations(*P, 0, 0,                          i32ModulationValues, ui8Bpp);
                 unpackModulations(*Q, ui32WordWidth, 0,              i32ModulationValues, ui8Bpp);
+                unpackModulations(*R, 0, ui32WordHeight,             i32ModulationValues, ui8Bpp);
                 unpackModulations(*S, ui32WordWidth, ui32WordHeight, i32ModulationValues, ui8Bpp);
-                
-                colorA[0] = colorA[1];
+
+                int32x4 colorA[4];
+                int32x4 colorB[4];
+
+                colorA[0] = getColorA(P->u32ColorData);
                 colorA[1] = getColorA(Q->u32ColorData);
-                colorA[2] = colorA[3];
+                colorA[2] = getColorA(R->u32ColorData);
                 colorA[3] = getColorA(S->u32ColorData);
-                
-                colorB[0] = colorB[1];
+                colorB[0] = getColorB(P->u32ColorData);
                 colorB[1] = getColorB(Q->u32ColorData);
-                colorB[2] = colorB[3];
+                colorB[2] = getColorB(R->u32ColorData);
                 colorB[3] = getColorB(S->u32ColorData);
+
+                // for each column of words
+                for (int wordX = 0; wordX < i32NumXWords; wordX++)
+                {
+                    // Bilinear upscale image data from 2x2 -> 4x4 and modulate
+                    pvrtcGetDecompressedPixels(i32ModulationValues, colorA, colorB,
+                                               pDecompressedData, stride, wordX, wordY, ui32Width, ui32Height, ui8Bpp);
+
+                    x1 = wrapWordIndex(i32NumXWords, wordX + 1);
+
+                    P = Q;
+                    R = S;
+                    Q = pWordMembers + order(x1, y0);
+                    S = pWordMembers + order(x1, y1);
+
+                    moveModulationValues(i32ModulationValues, ui32WordWidth, ui8Bpp);
+                    unpackModulations(*Q, ui32WordWidth, 0,              i32ModulationValues, ui8Bpp);
+                    unpackModulations(*S, ui32WordWidth, ui32WordHeight, i32ModulationValues, ui8Bpp);
+
+                    colorA[0] = colorA[1];
+                    colorA[1] = getColorA(Q->u32ColorData);
+                    colorA[2] = colorA[3];
+                    colorA[3] = getColorA(S->u32ColorData);
+
+                    colorB[0] = colorB[1];
+                    colorB[1] = getColorB(Q->u32ColorData);
+                    colorB[2] = colorB[3];
+                    colorB[3] = getColorB(S->u32ColorData);
+                }
+            }
+        });
+    }
+
+    // ----------------------------------------------------------------------------
+    // encoder
+    // ----------------------------------------------------------------------------
+
+    // The first pass picks the colors of each word from the extent of its pixels along the
+    // dominant axis. The colors are upscaled exactly like in the decoder and the modulation of
+    // every pixel is the one closest to the source. The refinement passes solve the colors of
+    // each word which minimize the error of the pixels it contributes to, with the modulation
+    // and the colors of the other words fixed, and modulate again. The words are modulated with
+    // the standard (non-punchthrough) mode.
+
+    struct PVRTCEncoder
+    {
+        PVRTCFormat format;
+        PVRTCWordOrder order;
+        PVRTCWord* words;
+        const uint8* image;
+        int stride;
+        int width;
+        int height;
+        int wordWidth;
+        int xwords;
+        int ywords;
+        std::vector<uint32> colorA; // upscaled colors
+        std::vector<uint32> colorB;
+        std::vector<uint32> refined; // color data of the refinement pass
+
+        PVRTCWord& getWord(int x, int y)
+        {
+            return words[order(wrapWordIndex(xwords, x), wrapWordIndex(ywords, y))];
+        }
+
+        int32x4 getPixel(int x, int y) const
+        {
+            const uint32* scan = reinterpret_cast<const uint32*>(image + y * stride);
+            int32x4 color;
+            color.unpack(scan[x]);
+            if (!format.alpha)
+                color[3] = 255;
+            return color;
+        }
+
+        int getModulation(int x, int y)
+        {
+            const PVRTCWord& word = getWord(x / wordWidth, y / 4);
+            const int offset = (y & 3) * wordWidth + (x & (wordWidth - 1));
+
+            if (format.ui8Bpp == 2)
+                return ((word.u32ModulationData >> offset) & 1) * 8;
+
+            static const int table[] = { 0, 3, 5, 8 };
+            return table[(word.u32ModulationData >> (offset * 2)) & 3];
+        }
+    };
+
+    static inline int quantize(int value, int bits)
+    {
+        return (value * ((1 << bits) - 1) + 127) / 255;
+    }
+
+    static uint32 packColors(int32x4 low, int32x4 high, bool opaque)
+    {
+        uint32 color = 0;
+
+        if (opaque)
+        {
+            color |= quantize(low[0], 5) << 10;
+            color |= quantize(low[1], 5) << 5;
+            color |= quantize(low[2], 4) << 1;
+            color |= quantize(high[0], 5) << 26;
+            color |= quantize(high[1], 5) << 21;
+            color |= quantize(high[2], 5) << 16;
+            color |= 0x80008000;
+        }
+        else
+        {
+            color |= quantize(low[3], 3) << 12;
+            color |= quantize(low[0], 4) << 8;
+            color |= quantize(low[1], 4) << 4;
+            color |= quantize(low[2], 3) << 1;
+            color |= quantize(high[3], 3) << 28;
+            color |= quantize(high[0], 4) << 24;
+            color |= quantize(high[1], 4) << 20;
+            color |= quantize(high[2], 4) << 16;
+        }
+
+        return color;
+    }
+
+    static void encodeColors(PVRTCEncoder& encoder, int wordX, int wordY)
+    {
+        const int wordWidth = encoder.wordWidth;
+        const int count = wordWidth * 4;
+
+        int32x4 pixels[32];
+        int32x4 vmin(255);
+        int32x4 vmax(0);
+        int32x4 sum(0);
+
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < wordWidth; ++x)
+            {
+                const int32x4 color = encoder.getPixel(wordX * wordWidth + x, wordY * 4 + y);
+                pixels[y * wordWidth + x] = color;
+                vmin = min(vmin, color);
+                vmax = max(vmax, color);
+                sum = sum + color;
+            }
+        }
+
+        // the variance of each channel; the widest channel is the reference for the axis
+        const int32x4 mean = int32x4(sum[0] / count, sum[1] / count, sum[2] / count, sum[3] / count);
+        int32x4 variance(0);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const int32x4 d = pixels[i] - mean;
+            variance = variance + int32x4(simd::mullo(d, d));
+        }
+
+        int axis = 0;
+        for (int i = 1; i < 4; ++i)
+        {
+            if (variance[i] > variance[axis])
+                axis = i;
+        }
+
+        // channels which decrease along the axis swap their extents
+        int32x4 covariance(0);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const int32x4 d = pixels[i] - mean;
+            covariance = covariance + int32x4(simd::mullo(d, int32x4(d[axis])));
+        }
+
+        const mask32x4 negative = covariance < int32x4(0);
+        const int32x4 low = select(negative, vmax, vmin);
+        const int32x4 high = select(negative, vmin, vmax);
+
+        const bool opaque = vmin[3] == 255;
+
+        PVRTCWord& word = encoder.getWord(wordX, wordY);
+        word.u32ColorData = packColors(low, high, opaque);
+        word.u32ModulationData = 0;
+    }
+
+    static void upscaleRegion(PVRTCEncoder& encoder, int regionX, int regionY)
+    {
+        const PVRTCWord& P = encoder.getWord(regionX - 1, regionY - 1);
+        const PVRTCWord& Q = encoder.getWord(regionX, regionY - 1);
+        const PVRTCWord& R = encoder.getWord(regionX - 1, regionY);
+        const PVRTCWord& S = encoder.getWord(regionX, regionY);
+
+        int32x4 colorA[4];
+        int32x4 colorB[4];
+
+        colorA[0] = getColorA(P.u32ColorData);
+        colorA[1] = getColorA(Q.u32ColorData);
+        colorA[2] = getColorA(R.u32ColorData);
+        colorA[3] = getColorA(S.u32ColorData);
+        colorB[0] = getColorB(P.u32ColorData);
+        colorB[1] = getColorB(Q.u32ColorData);
+        colorB[2] = getColorB(R.u32ColorData);
+        colorB[3] = getColorB(S.u32ColorData);
+
+        const int xoffset = regionX * encoder.wordWidth - encoder.wordWidth / 2;
+        const int yoffset = regionY * 4 - 2;
+        const int xmask = encoder.width - 1;
+        const int ymask = encoder.height - 1;
+
+        upscaleColors(colorA, colorB, encoder.format.ui8Bpp, [&] (int x, int y, int32x4 a, int32x4 b)
+        {
+            const int offset = ((yoffset + y) & ymask) * encoder.width + ((xoffset + x) & xmask);
+            encoder.colorA[offset] = a.pack();
+            encoder.colorB[offset] = b.pack();
+        });
+    }
+
+    static void encodeModulation(PVRTCEncoder& encoder, int wordX, int wordY)
+    {
+        const int wordWidth = encoder.wordWidth;
+        const int32x4 mask = encoder.format.alpha ? int32x4(-1) : int32x4(-1, -1, -1, 0);
+
+        uint32 modulation = 0;
+
+        for (int y = 0; y < 4; ++y)
+        {
+            const int py = wordY * 4 + y;
+
+            for (int x = 0; x < wordWidth; ++x)
+            {
+                const int px = wordX * wordWidth + x;
+                const int offset = py * encoder.width + px;
+
+                const int32x4 color = encoder.getPixel(px, py);
+                int32x4 a;
+                int32x4 b;
+                a.unpack(encoder.colorA[offset]);
+                b.unpack(encoder.colorB[offset]);
+
+                if (encoder.format.ui8Bpp == 2)
+                {
+                    // direct 1 bit per pixel mode
+                    const int32x4 da = (a - color) & mask;
+                    const int32x4 db = (b - color) & mask;
+                    const int32x4 ea = simd::mullo(da, da);
+                    const int32x4 eb = simd::mullo(db, db);
+                    const int errorA = ea[0] + ea[1] + ea[2] + ea[3];
+                    const int errorB = eb[0] + eb[1] + eb[2] + eb[3];
+                    modulation |= uint32(errorB < errorA) << (y * 8 + x);
+                }
+                else
+                {
+                    static const int table[] = { 0, 3, 5, 8 };
+
+                    int bestError = 0x7fffffff;
+                    uint32 bestIndex = 0;
+
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        const int32x4 d = (lerp(a, b, table[i]) - color) & mask;
+                        const int32x4 e = simd::mullo(d, d);
+                        const int error = e[0] + e[1] + e[2] + e[3];
+                        if (error < bestError)
+                        {
+                            bestError = error;
+                            bestIndex = i;
+                        }
+                    }
+
+                    modulation |= bestIndex << (y * 8 + x * 2);
+                }
+            }
+        }
+
+        encoder.getWord(wordX, wordY).u32ModulationData = modulation;
+    }
+
+    static void refineColors(PVRTCEncoder& encoder, int wordX, int wordY)
+    {
+        const int wordWidth = encoder.wordWidth;
+
+        const PVRTCWord& word = encoder.getWord(wordX, wordY);
+
+        // the colors of the word in the scale of the upscaled colors
+        const float32x4 expand(255.0f / 31.0f, 255.0f / 31.0f, 255.0f / 31.0f, 255.0f / 15.0f);
+        const float32x4 colorA = convert<float32x4>(getColorA(word.u32ColorData)) * expand;
+        const float32x4 colorB = convert<float32x4>(getColorB(word.u32ColorData)) * expand;
+
+        float s11 = 0.0f;
+        float s12 = 0.0f;
+        float s22 = 0.0f;
+        float32x4 t1(0.0f);
+        float32x4 t2(0.0f);
+
+        // the pixels between the centers of the neighbouring words
+        const int cx = wordX * wordWidth + wordWidth / 2;
+        const int cy = wordY * 4 + 2;
+        const int xmask = encoder.width - 1;
+        const int ymask = encoder.height - 1;
+
+        for (int dy = -3; dy <= 3; ++dy)
+        {
+            const int py = (cy + dy) & ymask;
+            const float wy = float(4 - std::abs(dy)) / 4.0f;
+
+            for (int dx = 1 - wordWidth; dx < wordWidth; ++dx)
+            {
+                const int px = (cx + dx) & xmask;
+                const float w = wy * float(wordWidth - std::abs(dx)) / float(wordWidth);
+                const float m = float(encoder.getModulation(px, py)) / 8.0f;
+
+                const int offset = py * encoder.width + px;
+                int32x4 a;
+                int32x4 b;
+                a.unpack(encoder.colorA[offset]);
+                b.unpack(encoder.colorB[offset]);
+
+                // the source minus the contribution of the other words
+                const float32x4 otherA = convert<float32x4>(a) - colorA * w;
+                const float32x4 otherB = convert<float32x4>(b) - colorB * w;
+                const float32x4 r = convert<float32x4>(encoder.getPixel(px, py)) - otherA * (1.0f - m) - otherB * m;
+
+                const float ua = w * (1.0f - m);
+                const float ub = w * m;
+                s11 += ua * ua;
+                s12 += ua * ub;
+                s22 += ub * ub;
+                t1 = t1 + r * ua;
+                t2 = t2 + r * ub;
             }
         }
+
+        float32x4 low = colorA;
+        float32x4 high = colorB;
+
+        const float det = s11 * s22 - s12 * s12;
+        if (det > 1e-6f * s11 * s22)
+        {
+            low = (t1 * s22 - t2 * s12) / det;
+            high = (t2 * s11 - t1 * s12) / det;
+        }
+        else if (s22 < 1e-6f)
+        {
+            // only the first color is used
+            low = t1 / s11;
+        }
+        else if (s11 < 1e-6f)
+        {
+            // only the second color is used
+            high = t2 / s22;
+        }
+
+        const float32x4 zero(0.0f);
+        const float32x4 one(255.0f);
+        const int32x4 ilow = convert<int32x4>(clamp(low, zero, one));
+        const int32x4 ihigh = convert<int32x4>(clamp(high, zero, one));
+
+        const bool opaque = (word.u32ColorData & 0x80000000) != 0;
+        encoder.refined[wordY * encoder.xwords + wordX] = packColors(ilow, ihigh, opaque);
+    }
+
+    static void pvrtcCompress(uint8* pCompressedData,
+                              const uint8* pImage,
+                              int stride,
+                              uint32 ui32Width,
+                              uint32 ui32Height,
+                              const PVRTCFormat& format,
+                              int iterations)
+    {
+        const int wordWidth = (format.ui8Bpp == 2) ? 8 : 4;
+
+        PVRTCEncoder encoder { format, PVRTCWordOrder(ui32Width / wordWidth, ui32Height / 4) };
+
+        encoder.words = reinterpret_cast<PVRTCWord*>(pCompressedData);
+        encoder.image = pImage;
+        encoder.stride = stride;
+        encoder.width = int(ui32Width);
+        encoder.height = int(ui32Height);
+        encoder.wordWidth = wordWidth;
+        encoder.xwords = encoder.width / encoder.wordWidth;
+        encoder.ywords = encoder.height / 4;
+        encoder.colorA.resize(encoder.width * encoder.height);
+        encoder.colorB.resize(encoder.width * encoder.height);
+
+        const int xwords = encoder.xwords;
+        const int ywords = encoder.ywords;
+
+        auto forEachWord = [&] (void (*func)(PVRTCEncoder& encoder, int x, int y))
+        {
+            // a row of words (or regions) writes only its own rows
+            processBands(ywords, size_t(xwords) * ywords, 256, [&] (int y0, int y1)
+            {
+                for (int y = y0; y < y1; ++y)
+                {
+                    for (int x = 0; x < xwords; ++x)
+                    {
+                        func(encoder, x, y);
+                    }
+                }
+            });
+        };
+
+        forEachWord(encodeColors);
+        forEachWord(upscaleRegion);
+        forEachWord(encodeModulation);
+
+        if (iterations > 0)
+        {
+            encoder.refined.resize(xwords * ywords);
+        }
+
+        for (int i = 0; i < iterations; ++i)
+        {
+            forEachWord(refineColors);
+
+            for (int y = 0; y < ywords; ++y)
+            {
+                for (int x = 0; x < xwords; ++x)
+                {
+                    encoder.getWord(x, y).u32ColorData = encoder.refined[y * xwords + x];
+                }
+            }
+
+            forEachWord(upscaleRegion);
+            forEachWord(encodeModulation);
+        }
     }
 
 } // namespace
@@ -455,32 +842,25 @@ namespace mango
 
     void decode_block_pvrtc(const TextureCompressionInfo& info, uint8* out, const uint8* in, int stride)
     {
-        bool is2bpp = false;
+        const PVRTCFormat format = getFormat(info);
 
-        switch (info.compression) {
-            case TextureCompression::PVRTC_RGB_4BPP:
-            case TextureCompression::PVRTC_RGBA_4BPP:
-            case TextureCompression::PVRTC_SRGB_4BPP:
-            case TextureCompression::PVRTC_SRGB_ALPHA_4BPP:
-                break;
+        if (!isValidSize(info.width, info.height, format.ui8Bpp == 2 ? 8 : 4))
+            return;
 
-            case TextureCompression::PVRTC_RGB_2BPP:
-            case TextureCompression::PVRTC_RGBA_2BPP:
-            case TextureCompression::PVRTC_SRGB_2BPP:
-            case TextureCompression::PVRTC_SRGB_ALPHA_2BPP:
-                is2bpp = true;
-                break;
+        pvrtcDecompress(in, out, stride, info.width, info.height, format);
+    }
 
-            default:
-                // TODO: unsupported compression
-                break;
-        }
+    void encode_block_pvrtc(const TextureCompressionInfo& info, uint8* out, const uint8* in, int stride, float quality)
+    {
+        // endpoint refinement passes for the real-time, normal and high quality tiers
+        const int iterations = quality < 1.0f / 3.0f ? 0 : quality < 2.0f / 3.0f ? 1 : 3;
+
+        const PVRTCFormat format = getFormat(info);
 
-        // TODO: check that width and height are powers of two
-        // TODO: check that width and height are at least 8x8 or 16x8
-        // TODO: check that width and height are identical (pvrtc textures are square)
+        if (!isValidSize(info.width, info.height, format.ui8Bpp == 2 ? 8 : 4))
+            MANGO_EXCEPTION("PVRTC: the width and height must be a power of two and at least one word.");
 
-        pvrtcDecompress(in, out, stride, info.width, info.height, is2bpp ? 2 : 4);
+        pvrtcCompress(out, in, stride, info.width, info.height, format, iterations);
     }
 
 } // namespace mango
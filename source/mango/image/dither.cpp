@@ -0,0 +1,462 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mango/core/thread.hpp>
+#include <mango/image/image.hpp>
+#include "scan.hpp"
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // threshold maps
+    // ----------------------------------------------------------------------------
+
+    // The ordered dither adds a threshold from a tiled map, scaled to one quantization step of
+    // each destination component, before the components are rounded to the destination
+    // precision. The maps store the thresholds centered on zero.
+
+    struct ThresholdMap
+    {
+        int size;
+        const float* data;
+    };
+
+    struct BayerMatrix
+    {
+        enum { SIZE = 8 };
+        float data[SIZE * SIZE];
+
+        BayerMatrix()
+        {
+            for (int y = 0; y < SIZE; ++y)
+            {
+                for (int x = 0; x < SIZE; ++x)
+                {
+                    // reversed interleave of (x ^ y, y)
+                    int v = 0;
+                    for (int bit = 0; bit < 3; ++bit)
+                    {
+                        v = (v << 2) | ((((x ^ y) >> bit) & 1) << 1) | ((y >> bit) & 1);
+                    }
+
+                    data[y * SIZE + x] = (v + 0.5f) / (SIZE * SIZE) - 0.5f;
+                }
+            }
+        }
+    };
+
+    struct BlueNoise
+    {
+        enum { SIZE = 64, MASK = SIZE - 1, COUNT = SIZE * SIZE };
+        float data[COUNT];
+
+        float kernel[COUNT];
+        float energy[COUNT];
+        bool pattern[COUNT];
+
+        void update(int p, float sign)
+        {
+            const int px = p & MASK;
+            const int py = p / SIZE;
+
+            for (int y = 0; y < SIZE; ++y)
+            {
+                const float* k = kernel + ((y - py) & MASK) * SIZE;
+                float* e = energy + y * SIZE;
+
+                for (int x = 0; x < SIZE; ++x)
+                {
+                    e[x] += sign * k[(x - px) & MASK];
+                }
+            }
+        }
+
+        void set(int p, bool value)
+        {
+            pattern[p] = value;
+            update(p, value ? 1.0f : -1.0f);
+        }
+
+        int tightestCluster() const
+        {
+            int index = -1;
+            for (int i = 0; i < COUNT; ++i)
+            {
+                if (pattern[i] && (index < 0 || energy[i] > energy[index]))
+                    index = i;
+            }
+            return index;
+        }
+
+        int largestVoid() const
+        {
+            int index = -1;
+            for (int i = 0; i < COUNT; ++i)
+            {
+                if (!pattern[i] && (index < 0 || energy[i] < energy[index]))
+                    index = i;
+            }
+            return index;
+        }
+
+        BlueNoise()
+        {
+            // void-and-cluster (Ulichney 1993) with a toroidal gaussian filter
+            const float sigma = 1.5f;
+
+            for (int y = 0; y < SIZE; ++y)
+            {
+                for (int x = 0; x < SIZE; ++x)
+                {
+                    const float dx = float(std::min(x, SIZE - x));
+                    const float dy = float(std::min(y, SIZE - y));
+                    kernel[y * SIZE + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+                }
+            }
+
+            std::fill(energy, energy + COUNT, 0.0f);
+            std::fill(pattern, pattern + COUNT, false);
+
+            // initial random pattern
+            const int ones = COUNT / 10;
+            uint32 seed = 0x1234567;
+
+            for (int count = 0; count < ones; )
+            {
+                seed = seed * 1664525 + 1013904223;
+                const int p = int(seed >> 20) & (COUNT - 1);
+                if (!pattern[p])
+                {
+                    set(p, true);
+                    ++count;
+                }
+            }
+
+            // move points from the tightest clusters into the largest voids until stable
+            for (;;)
+            {
+                const int cluster = tightestCluster();
+                set(cluster, false);
+
+                const int hole = largestVoid();
+                if (hole == cluster)
+                {
+                    set(cluster, true);
+                    break;
+                }
+
+                set(hole, true);
+            }
+
+            bool prototype[COUNT];
+            float prototypeEnergy[COUNT];
+            std::copy(pattern, pattern + COUNT, prototype);
+            std::copy(energy, energy + COUNT, prototypeEnergy);
+
+            int rank[COUNT];
+
+            // rank the initial points by removing the tightest clusters
+            for (int r = ones - 1; r >= 0; --r)
+            {
+                const int p = tightestCluster();
+                set(p, false);
+                rank[p] = r;
+            }
+
+            // rank the remaining points by filling the largest voids
+            std::copy(prototype, prototype + COUNT, pattern);
+            std::copy(prototypeEnergy, prototypeEnergy + COUNT, energy);
+
+            for (int r = ones; r < COUNT; ++r)
+            {
+                const int p = largestVoid();
+                set(p, true);
+                rank[p] = r;
+            }
+
+            for (int i = 0; i < COUNT; ++i)
+            {
+                data[i] = (rank[i] + 0.5f) / COUNT - 0.5f;
+            }
+        }
+    };
+
+    ThresholdMap getThresholdMap(Dither dither)
+    {
+        if (dither == Dither::BLUE_NOISE)
+        {
+            static const BlueNoise* noise = new BlueNoise();
+            return ThresholdMap { BlueNoise::SIZE, noise->data };
+        }
+
+        static const BayerMatrix bayer;
+        return ThresholdMap { BayerMatrix::SIZE, bayer.data };
+    }
+
+    void ordered_dither(float32x4* scan, int count, const float* threshold, int mask, int x0, float32x4 step)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            scan[x] = scan[x] + step * threshold[(x0 + x) & mask];
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // error diffusion
+    // ----------------------------------------------------------------------------
+
+    // Floyd-Steinberg cannot be split into independent bands without seams, but a row only
+    // depends on the errors from the row above. The rows are divided into segments and the
+    // workers claim rows in order; a segment is processed as soon as the row above has
+    // completed the segment to the right of it, so the rows advance as a diagonal wavefront.
+    // The scan direction alternates between rows inside each segment. The forward error of
+    // a segment which is scanned right to left is pushed down instead, as the segment to
+    // the left has already been completed.
+
+    class ErrorDiffusion
+    {
+    protected:
+        enum { SEGMENT = 64 };
+
+        const Surface& dest;
+        const Surface& source;
+        const ScanConverter& reader;
+        const ScanConverter& writer;
+
+        int width;
+        int height;
+        int segments;
+        int ringsize;
+
+        float32x4 levels;
+        float32x4 rcp;
+
+        ScanBuffer ring;
+        std::unique_ptr<std::atomic<int>[]> progress;
+        std::atomic<int> nextRow { 0 };
+
+        float32x4* getErrorRow(int y)
+        {
+            // the rows are padded with one sample on both sides
+            return ring.data() + (y % ringsize) * (width + 2) + 1;
+        }
+
+        void waitProgress(int y, int count) const
+        {
+            while (progress[y].load(std::memory_order_acquire) < count)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void diffuse(float32x4* scan, const float32x4* error, float32x4* next, int x0, int x1, bool reverse, float32x4& carry) const
+        {
+            const float32x4 zero(0.0f);
+            const float32x4 one(1.0f);
+
+            const int step = reverse ? -1 : 1;
+            const int first = reverse ? x1 - 1 : x0;
+            const int last = reverse ? x0 - 1 : x1;
+
+            for (int x = first; x != last; x += step)
+            {
+                const float32x4 v = clamp(scan[x] + error[x] + carry, zero, one);
+                const float32x4 q = round(v * levels) * rcp;
+                const float32x4 e = v - q;
+                scan[x] = q;
+
+                carry = e * (7.0f / 16.0f);
+                next[x - step] += e * (3.0f / 16.0f);
+                next[x] += e * (5.0f / 16.0f);
+                next[x + step] += e * (1.0f / 16.0f);
+            }
+        }
+
+        void processRow(int y, ScanBuffer& scan)
+        {
+            // the error row written by this row was last read by row (y + 1 - ringsize)
+            if (y + 1 >= ringsize)
+            {
+                waitProgress(y + 1 - ringsize, segments);
+            }
+
+            const float32x4* error = getErrorRow(y);
+            float32x4* next = getErrorRow(y + 1);
+            std::fill(next - 1, next + width + 1, float32x4(0.0f));
+
+            reader.read(scan.data(), source.address<uint8>(0, y), width);
+
+            const bool reverse = (y & 1) != 0;
+            float32x4 carry(0.0f);
+
+            for (int s = 0; s < segments; ++s)
+            {
+                if (y > 0)
+                {
+                    waitProgress(y - 1, std::min(s + 2, segments));
+                }
+
+                const int x0 = s * SEGMENT;
+                const int x1 = std::min(x0 + SEGMENT, width);
+
+                if (reverse)
+                {
+                    carry = float32x4(0.0f);
+                    diffuse(scan.data(), error, next, x0, x1, true, carry);
+                    next[x0] += carry;
+                }
+                else
+                {
+                    diffuse(scan.data(), error, next, x0, x1, false, carry);
+                }
+
+                progress[y].store(s + 1, std::memory_order_release);
+            }
+
+            writer.write(dest.address<uint8>(0, y), scan.data(), width);
+        }
+
+    public:
+        ErrorDiffusion(const Surface& dest, const Surface& source, const ScanConverter& reader, const ScanConverter& writer, int threads)
+            : dest(dest)
+            , source(source)
+            , reader(reader)
+            , writer(writer)
+            , width(dest.width)
+            , height(dest.height)
+            , segments((dest.width + SEGMENT - 1) / SEGMENT)
+            , ringsize(threads + 2)
+            , ring((dest.width + 2) * (threads + 2), float32x4(0.0f))
+            , progress(new std::atomic<int>[dest.height])
+        {
+            float l[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                // missing components are quantized finely enough not to leave residual error
+                const int size = dest.format.size[i];
+                l[i] = size ? float((1ull << size) - 1) : 65535.0f;
+            }
+
+            levels = float32x4(l[0], l[1], l[2], l[3]);
+            rcp = float32x4(1.0f) / levels;
+
+            for (int y = 0; y < height; ++y)
+            {
+                progress[y].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void process()
+        {
+            ScanBuffer scan(width);
+
+            // the rows are claimed in order; the row above is always owned by a running worker
+            for (;;)
+            {
+                const int y = nextRow.fetch_add(1);
+                if (y >= height)
+                    break;
+
+                processRow(y, scan);
+            }
+        }
+    };
+
+} // namespace
+
+namespace mango
+{
+
+    void Surface::blit(int x, int y, const Surface& source, Dither dither)
+    {
+        if (dither == Dither::NONE || format.type != Format::UNORM)
+        {
+            // float and integer formats are not quantized to fewer levels
+            blit(x, y, source);
+            return;
+        }
+
+        if (!source.width || !source.height || !source.format.bits || !format.bits)
+            return;
+
+        Surface dest(*this, x, y, source.width, source.height);
+
+        if (!dest.width || !dest.height)
+            return;
+
+        // clipped source origin
+        const int sx = std::max(0, -x);
+        const int sy = std::max(0, -y);
+        const Surface src(source, sx, sy, dest.width, dest.height);
+
+        const ScanConverter reader(src.format);
+        const ScanConverter writer(dest.format);
+
+        if (dither == Dither::FLOYD_STEINBERG)
+        {
+            const int threads = ThreadPool::getInstanceSize();
+            const int tasksize = (dest.width * dest.height) / threads;
+
+            // the wavefront needs a few segments per row to keep the workers busy
+            const int N = (tasksize < 8192 || dest.width < 256) ? 1 : std::min(threads, dest.height);
+
+            ErrorDiffusion diffusion(dest, src, reader, writer, N);
+
+            if (N == 1)
+            {
+                diffusion.process();
+            }
+            else
+            {
+                ConcurrentQueue queue("dither", Priority::HIGH);
+
+                for (int i = 0; i < N; ++i)
+                {
+                    queue.enqueue([&] { diffusion.process(); });
+                }
+
+                queue.wait();
+            }
+
+            return;
+        }
+
+        const ThresholdMap map = getThresholdMap(dither);
+        const int mapmask = map.size - 1;
+
+        // one quantization step of each destination component
+        float step[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            const int size = dest.format.size[i];
+            step[i] = size ? 1.0f / float((1ull << size) - 1) : 0.0f;
+        }
+
+        const float32x4 scale(step[0], step[1], step[2], step[3]);
+
+        // the map is anchored to the destination surface
+        const int ox = std::max(0, x);
+        const int oy = std::max(0, y);
+
+        processBands(dest.height, size_t(dest.width) * dest.height, 8192, [&] (int y0, int y1)
+        {
+            ScanBuffer scan(dest.width);
+
+            for (int i = y0; i < y1; ++i)
+            {
+                const float* threshold = map.data + ((oy + i) & mapmask) * map.size;
+
+                reader.read(scan.data(), src.address<uint8>(0, i), dest.width);
+                ordered_dither(scan.data(), dest.width, threshold, mapmask, ox, scale);
+                writer.write(dest.address<uint8>(0, i), scan.data(), dest.width);
+            }
+        });
+    }
+
+} // namespace mango
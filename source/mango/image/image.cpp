@@ -3,6 +3,7 @@
     Copyright (C) 2012-2017 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <map>
+#include <algorithm>
 #include <mango/core/string.hpp>
 #include <mango/core/timer.hpp>
 #include <mango/image/image.hpp>
@@ -28,6 +29,7 @@ namespace mango
     void registerPVR();
     void registerASTC();
     void register_zpng();
+    void registerUTEX();
 
     class ImageServer
     {
@@ -53,6 +55,7 @@ namespace mango
             registerPVR();
             registerASTC();
             register_zpng();
+            registerUTEX();
         }
 
         ~ImageServer()
@@ -160,12 +163,35 @@ namespace mango
         return Memory();
     }
 
+    YCbCrHeader ImageDecoderInterface::ycbcr()
+    {
+        return YCbCrHeader();
+    }
+
+    bool ImageDecoderInterface::decodeYCbCr(Surface* planes, YCbCrLayout layout)
+    {
+        MANGO_UNREFERENCED_PARAMETER(planes);
+        MANGO_UNREFERENCED_PARAMETER(layout);
+        return false;
+    }
+
+    void ImageDecoderInterface::setCallback(ImageDecodeCallback callback)
+    {
+        MANGO_UNREFERENCED_PARAMETER(callback);
+    }
+
+    bool ImageDecoderInterface::setCompression(TextureCompression compression)
+    {
+        return compression == TextureCompression::NONE;
+    }
+
 
     // ----------------------------------------------------------------------------
     // ImageDecoder
     // ----------------------------------------------------------------------------
 
     ImageDecoder::ImageDecoder(Memory memory, const std::string& filename)
+        : m_orientation(false)
     {
         m_interface = g_imageServer.createImageDecoder(memory, filename);
     }
@@ -182,7 +208,17 @@ namespace mango
 
     ImageHeader ImageDecoder::header()
     {
-        return m_interface ? m_interface->header() : ImageHeader();
+        if (!m_interface)
+            return ImageHeader();
+
+        ImageHeader header = m_interface->header();
+
+        if (m_orientation && isOrientationTransposed(m_interface->exif().Orientation))
+        {
+            std::swap(header.width, header.height);
+        }
+
+        return header;
     }
 
     Exif ImageDecoder::exif()
@@ -197,12 +233,55 @@ namespace mango
 
     void ImageDecoder::decode(Surface& dest, Palette* palette, int level, int depth, int face)
     {
-        if (m_interface)
+        if (!m_interface)
+            return;
+
+        const int orientation = m_orientation ? m_interface->exif().Orientation : 1;
+
+        if (orientation > 1 && orientation <= 8 && !palette)
+        {
+            // decode in the native format; the conversion is done with the transform
+            const ImageHeader header = m_interface->header();
+            const int width = std::max(1, header.width >> level);
+            const int height = std::max(1, header.height >> level);
+            Bitmap temp(width, height, header.format);
+            m_interface->decode(temp, palette, level, depth, face);
+            applyOrientation(dest, temp, orientation);
+        }
+        else
         {
             m_interface->decode(dest, palette, level, depth, face);
         }
     }
 
+    YCbCrHeader ImageDecoder::ycbcr()
+    {
+        return m_interface ? m_interface->ycbcr() : YCbCrHeader();
+    }
+
+    bool ImageDecoder::decodeYCbCr(Surface* planes, YCbCrLayout layout)
+    {
+        return m_interface ? m_interface->decodeYCbCr(planes, layout) : false;
+    }
+
+    void ImageDecoder::setCallback(ImageDecodeCallback callback)
+    {
+        if (m_interface)
+        {
+            m_interface->setCallback(callback);
+        }
+    }
+
+    void ImageDecoder::setOrientation(bool enable)
+    {
+        m_orientation = enable;
+    }
+
+    bool ImageDecoder::setCompression(TextureCompression compression)
+    {
+        return m_interface ? m_interface->setCompression(compression) : false;
+    }
+
     // ----------------------------------------------------------------------------
     // ImageEncoder
     // ----------------------------------------------------------------------------
@@ -222,10 +301,17 @@ namespace mango
     }
 
     void ImageEncoder::encode(Stream& output, const Surface& source, float quality)
+    {
+        ImageEncodeOptions options;
+        options.quality = quality;
+        encode(output, source, options);
+    }
+
+    void ImageEncoder::encode(Stream& output, const Surface& source, const ImageEncodeOptions& options)
     {
         if (m_encode)
         {
-            m_encode(output, source,quality);
+            m_encode(output, source, options);
         }
     }
 
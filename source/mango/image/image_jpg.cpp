@@ -66,6 +66,37 @@ namespace
             jpeg::Status s = m_parser.decode(dest);
             MANGO_UNREFERENCED_PARAMETER(s);
         }
+
+        YCbCrHeader ycbcr() override
+        {
+            YCbCrHeader header;
+
+            const int planes = m_parser.header.planes;
+
+            if (planes == 1 || planes == 3)
+            {
+                header.planes = planes;
+
+                for (int i = 0; i < planes; ++i)
+                {
+                    header.width[i] = m_parser.header.planeWidth[i];
+                    header.height[i] = m_parser.header.planeHeight[i];
+                }
+            }
+
+            return header;
+        }
+
+        bool decodeYCbCr(Surface* planes, YCbCrLayout layout) override
+        {
+            jpeg::Status s = m_parser.decode(planes, layout);
+            return s.success;
+        }
+
+        void setCallback(ImageDecodeCallback callback) override
+        {
+            m_parser.callback = callback;
+        }
     };
 
     ImageDecoderInterface* createInterface(Memory memory)
@@ -78,9 +109,9 @@ namespace
     // ImageEncoder
     // ------------------------------------------------------------
 
-    void imageEncode(Stream& stream, const Surface& surface, float quality)
+    void imageEncode(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
     {
-        jpeg::EncodeImage(stream, surface, quality);
+        jpeg::EncodeImage(stream, surface, options);
     }
 
 } // namespace
@@ -88,6 +119,16 @@ namespace
 namespace mango
 {
 
+    bool transcodeJPEG(Stream& output, Memory input, const JPEGTranscodeOptions& options)
+    {
+        return jpeg::TranscodeImage(output, input, options);
+    }
+
+    bool decodeJPEG(const std::vector<Memory>& inputs, const std::vector<Surface*>& outputs, JPEGBatchCallback callback)
+    {
+        return jpeg::DecodeBatch(inputs, outputs, callback);
+    }
+
     void registerJPG()
     {
         registerImageDecoder(createInterface, "jpg");
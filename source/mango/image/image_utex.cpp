@@ -0,0 +1,749 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <mango/core/core.hpp>
+#include <mango/image/image.hpp>
+
+#define ID "ImageStream.UTEX: "
+
+#ifdef MANGO_ENABLE_LICENSE_BSD
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // universal texture
+    // ----------------------------------------------------------------------------
+
+    // The universal texture stores one intermediate block for each 4x4 pixels: two RGB565
+    // color endpoints with 2 bit selectors and two 8 bit alpha endpoints with 3 bit selectors.
+    // The selectors are linear; the weight of the second endpoint is s/3 (color) or s/7 (alpha).
+    // This is a superset of the BC1/BC3 four color and eight alpha modes so BC1 and BC3 are
+    // transcoded by repacking the bits. BC7 mode 5 is transcoded without search but it is lossy:
+    // the color endpoints are requantized to 7 bits and the alpha selectors to 2 bits. The other
+    // formats are encoded from the decoded blocks with the real-time encoders.
+    //
+    // The fields of the blocks are stored in separate planes, which compress much better than
+    // the interleaved blocks, and each mipmap level is supercompressed with zstd.
+    //
+    // header:
+    //     uint32 magic ('UTEX')
+    //     uint32 width
+    //     uint32 height
+    //     uint32 levels
+    //     uint32 flags
+    //     uint32 compressed size of each level
+    //
+    // level (zstd):
+    //     color endpoints   4 bytes per block
+    //     color selectors   4 bytes per block
+    //     alpha endpoints   2 bytes per block (UTEX_ALPHA)
+    //     alpha selectors   6 bytes per block (UTEX_ALPHA)
+
+    enum : uint32
+    {
+        UTEX_ALPHA = 0x0001
+    };
+
+    struct LevelInfo
+    {
+        int width;
+        int height;
+        int xblocks;
+        int yblocks;
+
+        LevelInfo(int width0, int height0, int level)
+        {
+            width = std::max(1, width0 >> level);
+            height = std::max(1, height0 >> level);
+            xblocks = (width + 3) / 4;
+            yblocks = (height + 3) / 4;
+        }
+
+        int blocks() const
+        {
+            return xblocks * yblocks;
+        }
+    };
+
+    static inline size_t getPlaneBytes(bool alpha)
+    {
+        return alpha ? 16 : 8;
+    }
+
+    struct UniversalPlanes
+    {
+        uint8* color;
+        uint8* colorSelectors;
+        uint8* alpha;
+        uint8* alphaSelectors;
+
+        UniversalPlanes(uint8* data, int blocks, bool hasAlpha)
+        {
+            color = data;
+            colorSelectors = color + blocks * 4;
+            alpha = hasAlpha ? colorSelectors + blocks * 4 : nullptr;
+            alphaSelectors = hasAlpha ? alpha + blocks * 2 : nullptr;
+        }
+    };
+
+    struct UniversalBlock
+    {
+        uint16 color0;
+        uint16 color1;
+        uint32 colorSelectors; // 2 bits per pixel
+        uint8 alpha0;
+        uint8 alpha1;
+        uint64 alphaSelectors; // 3 bits per pixel
+
+        void load(const UniversalPlanes& planes, int index)
+        {
+            color0 = uload16le(planes.color + index * 4 + 0);
+            color1 = uload16le(planes.color + index * 4 + 2);
+            colorSelectors = uload32le(planes.colorSelectors + index * 4);
+
+            if (planes.alpha)
+            {
+                const uint8* selectors = planes.alphaSelectors + index * 6;
+                alpha0 = planes.alpha[index * 2 + 0];
+                alpha1 = planes.alpha[index * 2 + 1];
+                alphaSelectors = uint64(uload32le(selectors)) | (uint64(uload16le(selectors + 4)) << 32);
+            }
+            else
+            {
+                alpha0 = 0xff;
+                alpha1 = 0xff;
+                alphaSelectors = 0;
+            }
+        }
+
+        void store(const UniversalPlanes& planes, int index) const
+        {
+            ustore16le(planes.color + index * 4 + 0, color0);
+            ustore16le(planes.color + index * 4 + 2, color1);
+            ustore32le(planes.colorSelectors + index * 4, colorSelectors);
+
+            if (planes.alpha)
+            {
+                uint8* selectors = planes.alphaSelectors + index * 6;
+                planes.alpha[index * 2 + 0] = alpha0;
+                planes.alpha[index * 2 + 1] = alpha1;
+                ustore32le(selectors + 0, uint32(alphaSelectors));
+                ustore16le(selectors + 4, uint16(alphaSelectors >> 32));
+            }
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // decoding
+    // ----------------------------------------------------------------------------
+
+    static inline void unpack565(uint8* dest, uint16 packed)
+    {
+        const uint32 r = (packed >> 11) & 0x1f;
+        const uint32 g = (packed >>  5) & 0x3f;
+        const uint32 b = (packed >>  0) & 0x1f;
+        dest[0] = uint8((r << 3) | (r >> 2));
+        dest[1] = uint8((g << 2) | (g >> 4));
+        dest[2] = uint8((b << 3) | (b >> 2));
+    }
+
+    void decodeBlock(uint8* out, int stride, const UniversalBlock& block)
+    {
+        // the palettes are rounded exactly like the BC1 and BC3 decoders
+        uint8 color[4][4];
+        unpack565(color[0], block.color0);
+        unpack565(color[3], block.color1);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            color[1][i] = uint8((color[0][i] * 2 + color[3][i]) / 3);
+            color[2][i] = uint8((color[0][i] + color[3][i] * 2) / 3);
+        }
+
+        uint8 alpha[8];
+        for (int s = 0; s < 8; ++s)
+        {
+            alpha[s] = uint8((block.alpha0 * (7 - s) + block.alpha1 * s) / 7);
+        }
+
+        for (int y = 0; y < 4; ++y)
+        {
+            uint8* dest = out + y * stride;
+
+            for (int x = 0; x < 4; ++x)
+            {
+                const int i = y * 4 + x;
+                const uint8* c = color[(block.colorSelectors >> (i * 2)) & 3];
+                dest[0] = c[0];
+                dest[1] = c[1];
+                dest[2] = c[2];
+                dest[3] = alpha[(block.alphaSelectors >> (i * 3)) & 7];
+                dest += 4;
+            }
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // transcoding
+    // ----------------------------------------------------------------------------
+
+    void transcodeColorBC1(uint8* output, const UniversalBlock& block)
+    {
+        uint16 color0 = block.color0;
+        uint16 color1 = block.color1;
+        uint32 selectors = block.colorSelectors;
+
+        // four color mode requires color0 > color1
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+            selectors = ~selectors; // s -> 3 - s
+        }
+
+        uint32 indices = 0;
+
+        if (color0 != color1)
+        {
+            // linear selector to BC1 index: 0 -> 0, 1 -> 2, 2 -> 3, 3 -> 1
+            const uint32 hi = (selectors >> 1) & 0x55555555;
+            const uint32 lo = selectors & 0x55555555;
+            indices = hi | ((hi ^ lo) << 1);
+        }
+
+        ustore16le(output + 0, color0);
+        ustore16le(output + 2, color1);
+        ustore32le(output + 4, indices);
+    }
+
+    void transcodeAlphaBC4(uint8* output, const UniversalBlock& block)
+    {
+        // linear selector to BC4 index in the eight alpha mode (alpha0 > alpha1)
+        static const uint8 table[] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+        static const uint8 swapped[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+
+        uint8 alpha0 = block.alpha0;
+        uint8 alpha1 = block.alpha1;
+        const uint8* mapping = table;
+
+        if (alpha0 < alpha1)
+        {
+            std::swap(alpha0, alpha1);
+            mapping = swapped;
+        }
+
+        uint64 indices = 0;
+
+        if (alpha0 != alpha1)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                const int s = (block.alphaSelectors >> (i * 3)) & 7;
+                indices |= uint64(mapping[s]) << (i * 3);
+            }
+        }
+
+        output[0] = alpha0;
+        output[1] = alpha1;
+        ustore16le(output + 2, uint16(indices));
+        ustore32le(output + 4, uint32(indices >> 16));
+    }
+
+    struct BitWriter
+    {
+        uint64 data[2] = { 0, 0 };
+        int offset = 0;
+
+        void write(uint32 value, int bits)
+        {
+            const uint64 v = value;
+            if (offset < 64)
+            {
+                data[0] |= v << offset;
+                if (offset + bits > 64)
+                    data[1] |= v >> (64 - offset);
+            }
+            else
+            {
+                data[1] |= v << (offset - 64);
+            }
+            offset += bits;
+        }
+    };
+
+    void transcodeBC7(uint8* output, const UniversalBlock& block)
+    {
+        // mode 5: 7 bit color and 8 bit alpha endpoints with separate 2 bit indices;
+        // the 2 bit weights (0, 21, 43, 64) / 64 are the color selector weights.
+        uint8 color[2][4];
+        unpack565(color[0], block.color0);
+        unpack565(color[1], block.color1);
+
+        int colorIndex[16];
+        int alphaIndex[16];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            colorIndex[i] = (block.colorSelectors >> (i * 2)) & 3;
+            const int s = (block.alphaSelectors >> (i * 3)) & 7;
+            alphaIndex[i] = (s * 3 + 3) / 7;
+        }
+
+        uint8 alpha[2] = { block.alpha0, block.alpha1 };
+
+        // the most significant bit of the anchor index is implicitly zero
+        if (colorIndex[0] & 2)
+        {
+            for (int i = 0; i < 3; ++i)
+                std::swap(color[0][i], color[1][i]);
+            for (int i = 0; i < 16; ++i)
+                colorIndex[i] = 3 - colorIndex[i];
+        }
+
+        if (alphaIndex[0] & 2)
+        {
+            std::swap(alpha[0], alpha[1]);
+            for (int i = 0; i < 16; ++i)
+                alphaIndex[i] = 3 - alphaIndex[i];
+        }
+
+        BitWriter writer;
+
+        writer.write(1 << 5, 6); // mode
+        writer.write(0, 2); // rotation
+
+        for (int i = 0; i < 3; ++i)
+        {
+            writer.write(color[0][i] >> 1, 7);
+            writer.write(color[1][i] >> 1, 7);
+        }
+
+        writer.write(alpha[0], 8);
+        writer.write(alpha[1], 8);
+
+        for (int i = 0; i < 16; ++i)
+            writer.write(colorIndex[i], i ? 2 : 1);
+
+        for (int i = 0; i < 16; ++i)
+            writer.write(alphaIndex[i], i ? 2 : 1);
+
+        ustore64le(output + 0, writer.data[0]);
+        ustore64le(output + 8, writer.data[1]);
+    }
+
+    using TranscodeFunc = void (*)(uint8* output, const UniversalBlock& block);
+
+    void transcodeBC1(uint8* output, const UniversalBlock& block)
+    {
+        transcodeColorBC1(output, block);
+    }
+
+    void transcodeBC3(uint8* output, const UniversalBlock& block)
+    {
+        transcodeAlphaBC4(output + 0, block);
+        transcodeColorBC1(output + 8, block);
+    }
+
+    TranscodeFunc getTranscodeFunc(TextureCompression compression)
+    {
+        switch (compression)
+        {
+            case TextureCompression::BC1_UNORM:
+            case TextureCompression::BC1_UNORM_SRGB:
+                return transcodeBC1;
+            case TextureCompression::BC3_UNORM:
+            case TextureCompression::BC3_UNORM_SRGB:
+                return transcodeBC3;
+            case TextureCompression::BC7_UNORM:
+            case TextureCompression::BC7_UNORM_SRGB:
+                return transcodeBC7;
+            default:
+                return nullptr;
+        }
+    }
+
+    void decodeLevel(const Surface& surface, const UniversalPlanes& planes, const LevelInfo& level)
+    {
+        processBands(level.yblocks, size_t(level.xblocks) * level.yblocks, 256, [&] (int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                uint8* image = surface.image + y * 4 * surface.stride;
+
+                for (int x = 0; x < level.xblocks; ++x)
+                {
+                    UniversalBlock block;
+                    block.load(planes, y * level.xblocks + x);
+                    decodeBlock(image + x * 16, surface.stride, block);
+                }
+            }
+        });
+    }
+
+    void transcodeLevel(Memory output, const UniversalPlanes& planes, const LevelInfo& level, TextureCompression compression)
+    {
+        TranscodeFunc transcode = getTranscodeFunc(compression);
+        if (transcode)
+        {
+            const TextureCompressionInfo info(compression);
+
+            processBands(level.yblocks, size_t(level.xblocks) * level.yblocks, 256, [&] (int y0, int y1)
+            {
+                for (int i = y0 * level.xblocks; i < y1 * level.xblocks; ++i)
+                {
+                    UniversalBlock block;
+                    block.load(planes, i);
+                    transcode(output.address + i * info.bytes, block);
+                }
+            });
+        }
+        else
+        {
+            // no compatible endpoint representation; encode the decoded blocks
+            const TextureCompressionInfo info(compression);
+
+            Bitmap temp(level.xblocks * 4, level.yblocks * 4, FORMAT_R8G8B8A8);
+            decodeLevel(temp, planes, level);
+
+            Surface source(temp, 0, 0, level.width, level.height);
+            info.compress(output, source, 0.0f);
+        }
+    }
+
+    size_t getTranscodedSize(TextureCompression compression, const LevelInfo& level)
+    {
+        const TextureCompressionInfo info(compression);
+        const int xsize = (level.width + info.width - 1) / info.width;
+        const int ysize = (level.height + info.height - 1) / info.height;
+        return size_t(xsize) * ysize * info.bytes;
+    }
+
+    // ------------------------------------------------------------
+    // ImageDecoder
+    // ------------------------------------------------------------
+
+    struct Interface : ImageDecoderInterface
+    {
+        int m_width;
+        int m_height;
+        uint32 m_flags;
+        std::vector<Memory> m_levels;
+
+        TextureCompression m_compression;
+        std::vector<std::unique_ptr<Buffer>> m_transcoded;
+
+        Interface(Memory memory)
+            : m_compression(TextureCompression::NONE)
+        {
+            LittleEndianPointer p = memory.address;
+
+            if (memory.size < 20 || p.read32() != makeFourCC('U', 'T', 'E', 'X'))
+            {
+                MANGO_EXCEPTION(ID"Incorrect identifier.");
+            }
+
+            const uint32 width = p.read32();
+            const uint32 height = p.read32();
+            const uint32 levels = p.read32();
+            m_flags = p.read32();
+
+            if (width < 1 || height < 1 || width > 0x8000 || height > 0x8000 || levels < 1 || levels > 16)
+            {
+                MANGO_EXCEPTION(ID"Incorrect header.");
+            }
+
+            m_width = int(width);
+            m_height = int(height);
+
+            // the level sizes follow the header
+            size_t offset = 20 + levels * 4;
+
+            if (offset > memory.size)
+            {
+                MANGO_EXCEPTION(ID"Incorrect header.");
+            }
+
+            for (uint32 i = 0; i < levels; ++i)
+            {
+                const uint32 size = p.read32();
+                if (size > memory.size - offset)
+                {
+                    MANGO_EXCEPTION(ID"Incorrect level size.");
+                }
+
+                m_levels.push_back(Memory(memory.address + offset, size));
+                offset += size;
+            }
+
+            m_transcoded.resize(levels);
+        }
+
+        ~Interface()
+        {
+        }
+
+        ImageHeader header() override
+        {
+            ImageHeader header;
+
+            header.width   = m_width;
+            header.height  = m_height;
+            header.depth   = 0;
+            header.levels  = int(m_levels.size());
+            header.faces   = 0;
+            header.palette = false;
+            header.format  = FORMAT_R8G8B8A8;
+            header.compression = m_compression;
+
+            return header;
+        }
+
+        bool setCompression(TextureCompression compression) override
+        {
+            if (compression != TextureCompression::NONE)
+            {
+                const TextureCompressionInfo info(compression);
+                if (!info.encode && !getTranscodeFunc(compression))
+                    return false;
+                if (info.getCompressionFlags() & (TextureCompressionInfo::FLOAT | TextureCompressionInfo::SIGNED))
+                    return false;
+
+                // PVRTC is encoded only for power of two dimensions
+                const bool pow2 = u32_is_power_of_two(m_width) && u32_is_power_of_two(m_height);
+                if ((info.getCompressionFlags() & TextureCompressionInfo::PVR) && !pow2)
+                    return false;
+            }
+
+            if (compression != m_compression)
+            {
+                m_compression = compression;
+                for (auto& buffer : m_transcoded)
+                {
+                    buffer.reset();
+                }
+            }
+
+            return true;
+        }
+
+        Memory memory(int level, int depth, int face) override
+        {
+            MANGO_UNREFERENCED_PARAMETER(depth);
+            MANGO_UNREFERENCED_PARAMETER(face);
+
+            if (m_compression == TextureCompression::NONE || level < 0 || level >= int(m_levels.size()))
+                return Memory();
+
+            if (!m_transcoded[level])
+            {
+                const LevelInfo info(m_width, m_height, level);
+                Buffer planes;
+                decompress(planes, level);
+
+                Buffer* buffer = new Buffer(getTranscodedSize(m_compression, info));
+                transcodeLevel(*buffer, UniversalPlanes(planes, info.blocks(), hasAlpha()), info, m_compression);
+                m_transcoded[level].reset(buffer);
+            }
+
+            return *m_transcoded[level];
+        }
+
+        void decode(Surface& dest, Palette* palette, int level, int depth, int face) override
+        {
+            MANGO_UNREFERENCED_PARAMETER(palette);
+            MANGO_UNREFERENCED_PARAMETER(depth);
+            MANGO_UNREFERENCED_PARAMETER(face);
+
+            if (level < 0 || level >= int(m_levels.size()))
+                return;
+
+            const LevelInfo info(m_width, m_height, level);
+            Buffer planes;
+            decompress(planes, level);
+
+            Bitmap temp(info.xblocks * 4, info.yblocks * 4, FORMAT_R8G8B8A8);
+            decodeLevel(temp, UniversalPlanes(planes, info.blocks(), hasAlpha()), info);
+
+            dest.blit(0, 0, Surface(temp, 0, 0, info.width, info.height));
+        }
+
+        bool hasAlpha() const
+        {
+            return (m_flags & UTEX_ALPHA) != 0;
+        }
+
+        void decompress(Buffer& buffer, int level) const
+        {
+            const LevelInfo info(m_width, m_height, level);
+            buffer.resize(info.blocks() * getPlaneBytes(hasAlpha()));
+            zstd::decompress(buffer, m_levels[level]);
+        }
+    };
+
+    ImageDecoderInterface* createInterface(Memory memory)
+    {
+        ImageDecoderInterface* x = new Interface(memory);
+        return x;
+    }
+
+    // ------------------------------------------------------------
+    // ImageEncoder
+    // ------------------------------------------------------------
+
+    void encodeBlocks(const UniversalPlanes& planes, const uint8* bc3, const Surface& surface, int xblocks, int yblocks)
+    {
+        processBands(yblocks, size_t(xblocks) * yblocks, 256, [&] (int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                for (int x = 0; x < xblocks; ++x)
+                {
+                    const int index = y * xblocks + x;
+                    const uint8* input = bc3 + index * 16;
+
+                    UniversalBlock block;
+
+                    // BC3 color is always in the four color mode
+                    block.color0 = uload16le(input + 8);
+                    block.color1 = uload16le(input + 10);
+
+                    // BC1 index to linear selector: 0 -> 0, 1 -> 3, 2 -> 1, 3 -> 2
+                    const uint32 indices = uload32le(input + 12);
+                    const uint32 lo = indices & 0x55555555;
+                    const uint32 hi = (indices >> 1) & 0x55555555;
+                    block.colorSelectors = (lo << 1) | (lo ^ hi);
+
+                    block.alpha0 = input[0];
+                    block.alpha1 = input[1];
+                    block.alphaSelectors = 0;
+
+                    const uint64 alphaIndices = uint64(uload16le(input + 2)) | (uint64(uload32le(input + 4)) << 16);
+
+                    if (block.alpha0 > block.alpha1)
+                    {
+                        // eight alpha mode: index i > 1 has the weight (i - 1) / 7 of alpha1
+                        static const uint8 table[] = { 0, 7, 1, 2, 3, 4, 5, 6 };
+
+                        for (int i = 0; i < 16; ++i)
+                        {
+                            const int s = table[(alphaIndices >> (i * 3)) & 7];
+                            block.alphaSelectors |= uint64(s) << (i * 3);
+                        }
+                    }
+                    else
+                    {
+                        // the six alpha mode has no linear equivalent; fit the source alpha range
+                        const uint8* image = surface.image + y * 4 * surface.stride + x * 16 + 3;
+
+                        int amin = 255;
+                        int amax = 0;
+
+                        for (int i = 0; i < 16; ++i)
+                        {
+                            const int a = image[(i >> 2) * surface.stride + (i & 3) * 4];
+                            amin = std::min(amin, a);
+                            amax = std::max(amax, a);
+                        }
+
+                        block.alpha0 = uint8(amin);
+                        block.alpha1 = uint8(amax);
+
+                        const int range = std::max(1, amax - amin);
+
+                        for (int i = 0; i < 16; ++i)
+                        {
+                            const int a = image[(i >> 2) * surface.stride + (i & 3) * 4];
+                            const int s = ((a - amin) * 7 + range / 2) / range;
+                            block.alphaSelectors |= uint64(s) << (i * 3);
+                        }
+                    }
+
+                    block.store(planes, index);
+                }
+            }
+        });
+    }
+
+    void imageEncode(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
+    {
+        const LevelInfo level(surface.width, surface.height, 0);
+
+        // pad the image to full blocks with the edge pixels
+        Bitmap temp(level.xblocks * 4, level.yblocks * 4, FORMAT_R8G8B8A8);
+        temp.blit(0, 0, surface);
+
+        for (int y = 0; y < temp.height; ++y)
+        {
+            uint32* scan = temp.address<uint32>(0, y);
+            const uint32* source = temp.address<uint32>(0, std::min(y, surface.height - 1));
+
+            for (int x = 0; x < temp.width; ++x)
+            {
+                scan[x] = source[std::min(x, surface.width - 1)];
+            }
+        }
+
+        bool alpha = false;
+
+        for (int y = 0; y < temp.height && !alpha; ++y)
+        {
+            const uint8* scan = temp.address<uint8>(0, y);
+            for (int x = 0; x < temp.width; ++x)
+            {
+                alpha |= scan[x * 4 + 3] != 0xff;
+            }
+        }
+
+        // the endpoints and selectors are searched with the BC3 encoder
+        const TextureCompressionInfo info(TextureCompression::BC3_UNORM);
+        Buffer bc3(level.blocks() * info.bytes);
+        info.compress(bc3, temp, options.quality);
+
+        Buffer planes(level.blocks() * getPlaneBytes(alpha));
+        encodeBlocks(UniversalPlanes(planes, level.blocks(), alpha), bc3, temp, level.xblocks, level.yblocks);
+
+        // supercompression
+        Buffer compressed(zstd::bound(planes.size()));
+        const size_t bytes = zstd::compress(compressed, planes, options.optimize ? 10 : 6);
+
+        LittleEndianStream s(stream);
+
+        s.write32(makeFourCC('U', 'T', 'E', 'X'));
+        s.write32(surface.width);
+        s.write32(surface.height);
+        s.write32(1); // levels
+        s.write32(alpha ? UTEX_ALPHA : 0);
+        s.write32(uint32(bytes));
+        s.write(compressed, bytes);
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void registerUTEX()
+    {
+        registerImageDecoder(createInterface, "utex");
+        registerImageEncoder(imageEncode, "utex");
+    }
+
+} // namespace mango
+
+#else
+
+namespace mango
+{
+
+    void registerUTEX()
+    {
+    }
+
+} // namespace mango
+
+#endif // MANGO_ENABLE_LICENSE_BSD
@@ -0,0 +1,487 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mango/core/thread.hpp>
+#include <mango/image/image.hpp>
+#include "scan.hpp"
+
+namespace
+{
+    using namespace mango;
+
+    // The quantizer works on BGRA samples; the float vectors hold the components in memory
+    // order (b, g, r, a) in the 0..255 range.
+
+    inline float32x4 unpackColor(uint32 color)
+    {
+        float32x4 v;
+        v.unpack(color);
+        return v;
+    }
+
+    // ----------------------------------------------------------------------------
+    // nearest color search
+    // ----------------------------------------------------------------------------
+
+    // The palette is stored as component planes so that four entries are compared at a time.
+    // The padding repeats the last entry so it never wins over the real one.
+
+    class PaletteSearch
+    {
+    protected:
+        float32x4 b[64];
+        float32x4 g[64];
+        float32x4 r[64];
+        float32x4 a[64];
+        int groups;
+
+    public:
+        PaletteSearch(const Palette& palette)
+        {
+            const int size = std::max(1, int(palette.size));
+            groups = (size + 3) / 4;
+
+            for (int i = 0; i < groups; ++i)
+            {
+                float c[4][4];
+
+                for (int j = 0; j < 4; ++j)
+                {
+                    const BGRA color = palette[std::min(i * 4 + j, size - 1)];
+                    c[0][j] = color.b;
+                    c[1][j] = color.g;
+                    c[2][j] = color.r;
+                    c[3][j] = color.a;
+                }
+
+                b[i] = float32x4(c[0][0], c[0][1], c[0][2], c[0][3]);
+                g[i] = float32x4(c[1][0], c[1][1], c[1][2], c[1][3]);
+                r[i] = float32x4(c[2][0], c[2][1], c[2][2], c[2][3]);
+                a[i] = float32x4(c[3][0], c[3][1], c[3][2], c[3][3]);
+            }
+        }
+
+        int find(float32x4 color) const
+        {
+            const float32x4 cb = color.xxxx;
+            const float32x4 cg = color.yyyy;
+            const float32x4 cr = color.zzzz;
+            const float32x4 ca = color.wwww;
+
+            float32x4 best(std::numeric_limits<float>::max());
+            float32x4 bestIndex(0.0f);
+            float32x4 index(0.0f, 1.0f, 2.0f, 3.0f);
+
+            for (int i = 0; i < groups; ++i)
+            {
+                const float32x4 db = b[i] - cb;
+                const float32x4 dg = g[i] - cg;
+                const float32x4 dr = r[i] - cr;
+                const float32x4 da = a[i] - ca;
+                const float32x4 d = db * db + dg * dg + dr * dr + da * da;
+
+                const mask32x4 mask = d < best;
+                best = select(mask, d, best);
+                bestIndex = select(mask, index, bestIndex);
+                index = index + 4.0f;
+            }
+
+            const float distance[] = { float(best.x), float(best.y), float(best.z), float(best.w) };
+            const float indices[] = { float(bestIndex.x), float(bestIndex.y), float(bestIndex.z), float(bestIndex.w) };
+
+            int lane = 0;
+            for (int i = 1; i < 4; ++i)
+            {
+                if (distance[i] < distance[lane] || (distance[i] == distance[lane] && indices[i] < indices[lane]))
+                    lane = i;
+            }
+
+            return int(indices[lane]);
+        }
+    };
+
+    // Images have a lot of repeated colors; the searches are cached in a direct mapped table.
+
+    class ColorCache
+    {
+    protected:
+        enum { SIZE = 4096 };
+
+        const PaletteSearch& search;
+        std::vector<uint32> color;
+        std::vector<int> index;
+
+    public:
+        ColorCache(const PaletteSearch& search)
+            : search(search)
+            , color(SIZE, 0)
+            , index(SIZE, -1)
+        {
+        }
+
+        int find(uint32 c)
+        {
+            const uint32 h = (c * 2654435761u) >> 20;
+            if (index[h] < 0 || color[h] != c)
+            {
+                color[h] = c;
+                index[h] = search.find(unpackColor(c));
+            }
+            return index[h];
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // median cut
+    // ----------------------------------------------------------------------------
+
+    struct ColorBox
+    {
+        int begin;
+        int end;
+        int channel; // component with the widest range
+        int range;
+        uint64 score;
+    };
+
+    void computeBox(ColorBox& box, const uint32* samples)
+    {
+        uint32 lo[4] = { 255, 255, 255, 255 };
+        uint32 hi[4] = { 0, 0, 0, 0 };
+
+        for (int i = box.begin; i < box.end; ++i)
+        {
+            const uint32 s = samples[i];
+            for (int c = 0; c < 4; ++c)
+            {
+                const uint32 v = (s >> (c * 8)) & 0xff;
+                lo[c] = std::min(lo[c], v);
+                hi[c] = std::max(hi[c], v);
+            }
+        }
+
+        box.channel = 0;
+        box.range = 0;
+
+        for (int c = 0; c < 4; ++c)
+        {
+            const int range = int(hi[c] - lo[c]);
+            if (range > box.range)
+            {
+                box.channel = c;
+                box.range = range;
+            }
+        }
+
+        // the boxes with most error are split first
+        box.score = uint64(box.range) * box.range * (box.end - box.begin);
+    }
+
+    void medianCut(Palette& palette, std::vector<uint32>& samples, int colors)
+    {
+        std::vector<ColorBox> boxes;
+
+        ColorBox root;
+        root.begin = 0;
+        root.end = int(samples.size());
+        computeBox(root, samples.data());
+        boxes.push_back(root);
+
+        while (int(boxes.size()) < colors)
+        {
+            int select = -1;
+            for (int i = 0; i < int(boxes.size()); ++i)
+            {
+                if (boxes[i].range > 0 && (select < 0 || boxes[i].score > boxes[select].score))
+                    select = i;
+            }
+
+            if (select < 0)
+                break;
+
+            ColorBox box = boxes[select];
+            const int shift = box.channel * 8;
+
+            auto first = samples.begin() + box.begin;
+            auto last = samples.begin() + box.end;
+
+            std::nth_element(first, first + (box.end - box.begin) / 2, last, [=] (uint32 a, uint32 b)
+            {
+                return ((a >> shift) & 0xff) < ((b >> shift) & 0xff);
+            });
+
+            // split on a value boundary so that the same color does not end up in both boxes
+            const uint32 median = (first[(box.end - box.begin) / 2] >> shift) & 0xff;
+            auto middle = std::partition(first, last, [=] (uint32 a)
+            {
+                return ((a >> shift) & 0xff) < median;
+            });
+
+            if (middle == first)
+            {
+                middle = std::partition(first, last, [=] (uint32 a)
+                {
+                    return ((a >> shift) & 0xff) <= median;
+                });
+            }
+
+            ColorBox upper = box;
+            box.end = int(middle - samples.begin());
+            upper.begin = box.end;
+
+            computeBox(box, samples.data());
+            computeBox(upper, samples.data());
+
+            boxes[select] = box;
+            boxes.push_back(upper);
+        }
+
+        palette.size = uint32(boxes.size());
+
+        for (int i = 0; i < int(boxes.size()); ++i)
+        {
+            const ColorBox& box = boxes[i];
+
+            uint64 sum[4] = { 0, 0, 0, 0 };
+            for (int j = box.begin; j < box.end; ++j)
+            {
+                const uint32 s = samples[j];
+                for (int c = 0; c < 4; ++c)
+                {
+                    sum[c] += (s >> (c * 8)) & 0xff;
+                }
+            }
+
+            const uint64 count = box.end - box.begin;
+            const uint64 bias = count / 2;
+
+            palette[i] = BGRA(uint8((sum[2] + bias) / count), uint8((sum[1] + bias) / count),
+                              uint8((sum[0] + bias) / count), uint8((sum[3] + bias) / count));
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // k-means
+    // ----------------------------------------------------------------------------
+
+    struct ClusterSum
+    {
+        uint64 sum[256][4];
+        uint32 count[256];
+    };
+
+    void refinePalette(Palette& palette, const std::vector<uint32>& samples, int iterations)
+    {
+        const int count = int(samples.size());
+        const int threads = ThreadPool::getInstanceSize();
+
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            const PaletteSearch search(palette);
+            std::vector<ClusterSum> clusters(threads); // zero initialized
+            std::atomic<int> band { 0 };
+
+            // there are at most as many bands as threads
+            processBands(count, size_t(count) * 16, 8192, [&] (int begin, int end)
+            {
+                ClusterSum& cluster = clusters[band++];
+                ColorCache cache(search);
+
+                for (int i = begin; i < end; ++i)
+                {
+                    const uint32 s = samples[i];
+                    const int index = cache.find(s);
+
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        cluster.sum[index][c] += (s >> (c * 8)) & 0xff;
+                    }
+
+                    ++cluster.count[index];
+                }
+            });
+
+            bool changed = false;
+
+            for (uint32 i = 0; i < palette.size; ++i)
+            {
+                uint64 sum[4] = { 0, 0, 0, 0 };
+                uint64 total = 0;
+
+                for (int task = 0; task < threads; ++task)
+                {
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        sum[c] += clusters[task].sum[i][c];
+                    }
+                    total += clusters[task].count[i];
+                }
+
+                // empty clusters keep their color
+                if (!total)
+                    continue;
+
+                const uint64 bias = total / 2;
+                const BGRA color(uint8((sum[2] + bias) / total), uint8((sum[1] + bias) / total),
+                                 uint8((sum[0] + bias) / total), uint8((sum[3] + bias) / total));
+
+                changed |= uint32(color) != uint32(palette[i]);
+                palette[i] = color;
+            }
+
+            if (!changed)
+                break;
+        }
+    }
+
+    // ----------------------------------------------------------------------------
+    // index mapping
+    // ----------------------------------------------------------------------------
+
+    void mapIndices(Surface& dest, const Palette& palette, const Surface& source, bool dither)
+    {
+        const int width = std::min(dest.width, source.width);
+        const int height = std::min(dest.height, source.height);
+
+        const PaletteSearch search(palette);
+
+        if (!dither)
+        {
+            processBands(height, size_t(width) * height, 8192, [&] (int y0, int y1)
+            {
+                ColorCache cache(search);
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    const uint32* src = source.address<uint32>(0, y);
+                    uint8* dst = dest.address<uint8>(0, y);
+
+                    for (int x = 0; x < width; ++x)
+                    {
+                        dst[x] = uint8(cache.find(src[x]));
+                    }
+                }
+            });
+
+            return;
+        }
+
+        // serpentine Floyd-Steinberg; the rows are padded with one sample on both sides
+        ScanBuffer colors(256);
+        for (uint32 i = 0; i < palette.size; ++i)
+        {
+            colors[i] = unpackColor(palette[i]);
+        }
+
+        ColorCache cache(search);
+
+        ScanBuffer error0(width + 2, float32x4(0.0f));
+        ScanBuffer error1(width + 2, float32x4(0.0f));
+
+        const float32x4 zero(0.0f);
+        const float32x4 limit(255.0f);
+
+        for (int y = 0; y < height; ++y)
+        {
+            const uint32* src = source.address<uint32>(0, y);
+            uint8* dst = dest.address<uint8>(0, y);
+
+            float32x4* error = (y & 1 ? error1.data() : error0.data()) + 1;
+            float32x4* next = (y & 1 ? error0.data() : error1.data()) + 1;
+            std::fill(next - 1, next + width + 1, zero);
+
+            const int step = y & 1 ? -1 : 1;
+            const int first = y & 1 ? width - 1 : 0;
+
+            for (int x = first; x >= 0 && x < width; x += step)
+            {
+                // the search is done with the color rounded to 8 bits so that it can be cached
+                const float32x4 v = clamp(unpackColor(src[x]) + error[x], zero, limit);
+                const int index = cache.find(v.pack());
+                const float32x4 e = v - colors[index];
+                dst[x] = uint8(index);
+
+                error[x + step] += e * (7.0f / 16.0f);
+                next[x - step] += e * (3.0f / 16.0f);
+                next[x] += e * (5.0f / 16.0f);
+                next[x + step] += e * (1.0f / 16.0f);
+            }
+        }
+    }
+
+    void quantizeColors(Surface& dest, Palette& palette, const Surface& source, const QuantizeOptions& options)
+    {
+        const int colors = std::max(2, std::min(256, options.colors));
+
+        // the palette is computed from a regular subset of the pixels
+        const int64 pixels = int64(source.width) * source.height;
+        const int64 step = std::max(int64(1), pixels / (1 << 18));
+
+        std::vector<uint32> samples;
+        samples.reserve(size_t(pixels / step + 1));
+
+        for (int64 i = 0; i < pixels; i += step)
+        {
+            const int x = int(i % source.width);
+            const int y = int(i / source.width);
+            samples.push_back(source.address<uint32>(0, y)[x]);
+        }
+
+        medianCut(palette, samples, colors);
+        refinePalette(palette, samples, options.iterations);
+
+        mapIndices(dest, palette, source, options.dither);
+    }
+
+} // namespace
+
+namespace mango
+{
+
+    void quantize(Surface& dest, Palette& palette, const Surface& source, const QuantizeOptions& options)
+    {
+        if (dest.format.bytes() != 1)
+            MANGO_EXCEPTION("quantize: Destination must have 8 bit samples.");
+
+        palette.size = 0;
+
+        if (!source.width || !source.height || !source.format.bits)
+            return;
+
+        if (source.format == FORMAT_B8G8R8A8)
+        {
+            quantizeColors(dest, palette, source, options);
+        }
+        else
+        {
+            Bitmap temp(source.width, source.height, FORMAT_B8G8R8A8);
+            temp.blit(0, 0, source);
+            quantizeColors(dest, palette, temp, options);
+        }
+    }
+
+    void quantize(Surface& dest, const Palette& palette, const Surface& source, bool dither)
+    {
+        if (dest.format.bytes() != 1)
+            MANGO_EXCEPTION("quantize: Destination must have 8 bit samples.");
+
+        if (!palette.size || !source.width || !source.height || !source.format.bits)
+            return;
+
+        if (source.format == FORMAT_B8G8R8A8)
+        {
+            mapIndices(dest, palette, source, dither);
+        }
+        else
+        {
+            Bitmap temp(source.width, source.height, FORMAT_B8G8R8A8);
+            temp.blit(0, 0, source);
+            mapIndices(dest, palette, temp, dither);
+        }
+    }
+
+} // namespace mango
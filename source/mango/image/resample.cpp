@@ -0,0 +1,681 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mango/core/thread.hpp>
+#include <mango/core/bits.hpp>
+#include <mango/core/memory.hpp>
+#include <mango/core/exception.hpp>
+#include <mango/math/math.hpp>
+#include <mango/math/srgb.hpp>
+#include <mango/image/image.hpp>
+#include "scan.hpp"
+
+namespace
+{
+    using namespace mango;
+
+    // ----------------------------------------------------------------------------
+    // filters
+    // ----------------------------------------------------------------------------
+
+    float filter_box(float x)
+    {
+        return (x > -0.5f && x <= 0.5f) ? 1.0f : 0.0f;
+    }
+
+    float filter_bilinear(float x)
+    {
+        x = std::abs(x);
+        return x < 1.0f ? 1.0f - x : 0.0f;
+    }
+
+    float filter_mitchell(float x)
+    {
+        // Mitchell-Netravali with B = C = 1/3
+        const float B = 1.0f / 3.0f;
+        const float C = 1.0f / 3.0f;
+
+        x = std::abs(x);
+        const float x2 = x * x;
+        const float x3 = x2 * x;
+
+        if (x < 1.0f)
+        {
+            return ((12 - 9 * B - 6 * C) * x3 + (-18 + 12 * B + 6 * C) * x2 + (6 - 2 * B)) / 6.0f;
+        }
+        else if (x < 2.0f)
+        {
+            return ((-B - 6 * C) * x3 + (6 * B + 30 * C) * x2 + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6.0f;
+        }
+
+        return 0.0f;
+    }
+
+    float sinc(float x)
+    {
+        if (x == 0.0f)
+            return 1.0f;
+        x *= 3.14159265358979f;
+        return std::sin(x) / x;
+    }
+
+    float filter_lanczos(float x)
+    {
+        const float a = 3.0f;
+        return std::abs(x) < a ? sinc(x) * sinc(x / a) : 0.0f;
+    }
+
+    struct Filter
+    {
+        float (*func)(float);
+        float support;
+    };
+
+    Filter getFilter(ResampleFilter filter)
+    {
+        switch (filter)
+        {
+            case ResampleFilter::BOX:      return { filter_box, 0.5f };
+            case ResampleFilter::BILINEAR: return { filter_bilinear, 1.0f };
+            case ResampleFilter::MITCHELL: return { filter_mitchell, 2.0f };
+            case ResampleFilter::LANCZOS:  break;
+        }
+        return { filter_lanczos, 3.0f };
+    }
+
+    // ----------------------------------------------------------------------------
+    // FilterTable
+    // ----------------------------------------------------------------------------
+
+    // Precomputed contributions of the source samples to each destination sample. When
+    // minifying, the filter is widened by the scaling factor to avoid aliasing.
+
+    struct FilterTable
+    {
+        struct Contribution
+        {
+            int start;
+            int count;
+            int offset; // index of first weight
+        };
+
+        std::vector<Contribution> contributions;
+        std::vector<float> weights;
+
+        FilterTable(const Filter& filter, int destSize, int sourceSize)
+        {
+            const float scale = float(destSize) / float(sourceSize);
+            const float width = std::max(1.0f, 1.0f / scale);
+            const float radius = std::max(0.5f, filter.support * width);
+
+            contributions.resize(destSize);
+
+            for (int i = 0; i < destSize; ++i)
+            {
+                const float center = (i + 0.5f) / scale;
+                const int start = std::max(0, int(std::floor(center - radius)));
+                const int end = std::min(sourceSize, int(std::ceil(center + radius)));
+
+                Contribution& c = contributions[i];
+                c.start = start;
+                c.count = 0;
+                c.offset = int(weights.size());
+
+                float sum = 0.0f;
+
+                for (int j = start; j < end; ++j)
+                {
+                    const float weight = filter.func((j + 0.5f - center) / width);
+                    weights.push_back(weight);
+                    sum += weight;
+                    ++c.count;
+                }
+
+                if (sum == 0.0f)
+                {
+                    // the filter missed every sample; use the nearest one
+                    weights.resize(c.offset);
+                    weights.push_back(1.0f);
+                    c.start = clamp(int(center), 0, sourceSize - 1);
+                    c.count = 1;
+                    sum = 1.0f;
+                }
+
+                // normalize
+                const float rcp = 1.0f / sum;
+                for (int j = 0; j < c.count; ++j)
+                {
+                    weights[c.offset + j] *= rcp;
+                }
+            }
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // resample
+    // ----------------------------------------------------------------------------
+
+    // ----------------------------------------------------------------------------
+    // mipmaps
+    // ----------------------------------------------------------------------------
+
+    // The mipmap chain is computed in tiles which are small enough to stay in the L2 cache.
+    // Each tile is reduced from the base level through a few levels of the chain and the
+    // finished regions are handed to the target (surface or block encoder) immediately. Only
+    // the last tile level is stored for the whole image and the remaining levels are computed
+    // from it in the same way, so no full size intermediate levels are materialized.
+
+    inline int getLevelSize(int size, int level)
+    {
+        return std::max(1, size >> level);
+    }
+
+    class MipmapTarget
+    {
+    public:
+        virtual ~MipmapTarget() = default;
+
+        // image is in the work format: linear, premultiplied float RGBA
+        virtual void store(int level, int x, int y, int width, int height, const float32x4* image, int stride) = 0;
+    };
+
+    void storeScans(Surface& surface, const ScanConverter& writer, int x, int y, int width, int height,
+                    const float32x4* image, int stride, bool linear, bool premultiply)
+    {
+        width = std::min(width, surface.width - x);
+        height = std::min(height, surface.height - y);
+
+        ScanBuffer scan(std::max(width, 0));
+
+        for (int i = 0; i < height; ++i)
+        {
+            std::copy(image, image + width, scan.begin());
+            encodeScan(scan.data(), width, linear, premultiply);
+            writer.write(surface.address<uint8>(x, y + i), scan.data(), width);
+            image += stride;
+        }
+    }
+
+    class SurfaceTarget : public MipmapTarget
+    {
+    protected:
+        Surface* dest;
+        std::vector<ScanConverter> writers;
+        bool linear;
+        bool premultiply;
+
+    public:
+        SurfaceTarget(Surface* dest, int levels, bool linear, bool premultiply)
+            : dest(dest)
+            , linear(linear)
+            , premultiply(premultiply)
+        {
+            for (int i = 0; i < levels; ++i)
+            {
+                writers.emplace_back(dest[i].format);
+            }
+        }
+
+        void store(int level, int x, int y, int width, int height, const float32x4* image, int stride) override
+        {
+            // level 0 is the source surface
+            storeScans(dest[level - 1], writers[level - 1], x, y, width, height, image, stride, linear, premultiply);
+        }
+    };
+
+    class BlockTarget : public MipmapTarget
+    {
+    protected:
+        const TextureCompressionInfo& info;
+        const ScanConverter writer;
+        const TextureCompressionInfo::EncodeFunc encode;
+        Memory* output;
+        int width;
+        int height;
+        bool linear;
+        bool premultiply;
+        bool origin;
+        float quality;
+
+        // The blocks of bottom-left origin formats are in bottom-up order. The tiles are aligned
+        // to the top-down block grid, so the levels with partial block rows are staged in the
+        // block format and compressed when the chain is finished.
+        std::vector<std::unique_ptr<Bitmap>> staging;
+
+    public:
+        BlockTarget(Memory* output, const TextureCompressionInfo& info, int width, int height, int levels,
+                    bool linear, bool premultiply, float quality)
+            : info(info)
+            , writer(info.format)
+            , encode(info.getEncodeFunc(quality))
+            , output(output)
+            , width(width)
+            , height(height)
+            , linear(linear)
+            , premultiply(premultiply)
+            , origin((info.getCompressionFlags() & TextureCompressionInfo::ORIGIN) != 0)
+            , quality(quality)
+            , staging(levels)
+        {
+            for (int level = 0; level < levels; ++level)
+            {
+                const int w = getLevelSize(width, level);
+                const int h = getLevelSize(height, level);
+                const int xblocks = round_to_next(w, info.width);
+                const int yblocks = round_to_next(h, info.height);
+
+                // the tiles are encoded on the ThreadPool; reject the output before any work is queued
+                if (output[level].size < size_t(xblocks) * yblocks * info.bytes)
+                {
+                    MANGO_EXCEPTION("compressMipmaps: output level is too small.");
+                }
+
+                if (origin && h % info.height)
+                {
+                    staging[level].reset(new Bitmap(w, h, info.format));
+                }
+            }
+        }
+
+        void store(int level, int x, int y, int xsize, int ysize, const float32x4* image, int stride) override
+        {
+            if (staging[level])
+            {
+                storeScans(*staging[level], writer, x, y, xsize, ysize, image, stride, linear, premultiply);
+                return;
+            }
+
+            const int xblocks = round_to_next(getLevelSize(width, level), info.width);
+            const int yblocks = round_to_next(getLevelSize(height, level), info.height);
+
+            const int bytesPerPixel = info.format.bytes();
+            const int blockStride = info.width * bytesPerPixel;
+
+            ScanBuffer scan(info.width);
+            std::vector<uint8> block(info.height * blockStride);
+
+            // the tile regions are aligned to the block grid; partial blocks on the right and
+            // bottom edge of the level are padded by repeating the edge pixels
+            for (int by = 0; by < ysize; by += info.height)
+            {
+                // the level height is aligned to the block grid with the bottom-left origin
+                const int row = (y + by) / info.height;
+                uint8* data = output[level].address + ((origin ? yblocks - 1 - row : row) * xblocks + x / info.width) * info.bytes;
+
+                for (int bx = 0; bx < xsize; bx += info.width)
+                {
+                    for (int i = 0; i < info.height; ++i)
+                    {
+                        const int line = origin ? info.height - 1 - i : i;
+                        const float32x4* s = image + std::min(by + line, ysize - 1) * stride;
+
+                        for (int j = 0; j < info.width; ++j)
+                        {
+                            scan[j] = s[std::min(bx + j, xsize - 1)];
+                        }
+
+                        encodeScan(scan.data(), info.width, linear, premultiply);
+                        writer.write(block.data() + i * blockStride, scan.data(), info.width);
+                    }
+
+                    encode(info, data, block.data(), blockStride, quality);
+                    data += info.bytes;
+                }
+            }
+        }
+
+        void finish()
+        {
+            for (size_t level = 0; level < staging.size(); ++level)
+            {
+                if (staging[level])
+                {
+                    info.compress(output[level], *staging[level], quality);
+                }
+            }
+        }
+    };
+
+    class MipmapGenerator
+    {
+    protected:
+        MipmapTarget& target;
+        int width;
+        int height;
+        int levels; // including the base level
+        int tileLevels;
+        int tileWidth;
+        int tileHeight;
+        bool linear;
+        bool premultiply;
+
+        struct Source
+        {
+            // either the source surface or a work format image from the previous pass
+            const Surface* surface;
+            const float32x4* image;
+            int level;
+            int first; // first level to store
+        };
+
+        void processTile(const Source& source, float32x4* next, int x0, int y0) const
+        {
+            const int count = std::min(tileLevels, levels - 1 - source.level);
+
+            // the tile and its reduced levels are stored back to back
+            ScanBuffer buffer(tileWidth * tileHeight * 2);
+            float32x4* image = buffer.data();
+
+            const int base = source.level;
+            const int baseWidth = getLevelSize(width, base);
+            int xsize = std::min(tileWidth, baseWidth - x0);
+            int ysize = std::min(tileHeight, getLevelSize(height, base) - y0);
+
+            if (source.surface)
+            {
+                const ScanConverter reader(source.surface->format);
+
+                for (int y = 0; y < ysize; ++y)
+                {
+                    float32x4* scan = image + y * tileWidth;
+                    reader.read(scan, source.surface->address<uint8>(x0, y0 + y), xsize);
+                    decodeScan(scan, xsize, linear, premultiply);
+                }
+            }
+            else
+            {
+                for (int y = 0; y < ysize; ++y)
+                {
+                    const float32x4* s = source.image + size_t(y0 + y) * baseWidth + x0;
+                    std::copy(s, s + xsize, image + y * tileWidth);
+                }
+            }
+
+            if (source.first == base)
+            {
+                target.store(base, x0, y0, xsize, ysize, image, tileWidth);
+            }
+
+            int stride = tileWidth;
+
+            for (int level = 1; level <= count; ++level)
+            {
+                const int x = x0 >> level;
+                const int y = y0 >> level;
+                const int w = std::min(tileWidth >> level, getLevelSize(width, base + level) - x);
+                const int h = std::min(tileHeight >> level, getLevelSize(height, base + level) - y);
+
+                if (w <= 0 || h <= 0)
+                {
+                    // the tile is past the edge of the level
+                    return;
+                }
+
+                const float32x4* s = image;
+                float32x4* d = image + stride * ysize;
+                const int dstride = stride >> 1;
+
+                for (int i = 0; i < h; ++i)
+                {
+                    // edges of odd sized levels are clamped
+                    const float32x4* s0 = s + std::min(i * 2 + 0, ysize - 1) * stride;
+                    const float32x4* s1 = s + std::min(i * 2 + 1, ysize - 1) * stride;
+
+                    for (int j = 0; j < w; ++j)
+                    {
+                        const int j0 = std::min(j * 2 + 0, xsize - 1);
+                        const int j1 = std::min(j * 2 + 1, xsize - 1);
+                        d[i * dstride + j] = (s0[j0] + s0[j1] + s1[j0] + s1[j1]) * 0.25f;
+                    }
+                }
+
+                image = d;
+                stride = dstride;
+                xsize = w;
+                ysize = h;
+
+                target.store(base + level, x, y, w, h, image, stride);
+            }
+
+            if (next)
+            {
+                const int nextWidth = getLevelSize(width, base + count);
+                const int x = x0 >> count;
+                const int y = y0 >> count;
+
+                for (int i = 0; i < ysize; ++i)
+                {
+                    std::copy(image + i * stride, image + i * stride + xsize, next + size_t(y + i) * nextWidth + x);
+                }
+            }
+        }
+
+        void process(const Source& source) const
+        {
+            const int count = std::min(tileLevels, levels - 1 - source.level);
+            const int level = source.level + count;
+
+            ScanBuffer next;
+
+            if (level < levels - 1)
+            {
+                next.resize(size_t(getLevelSize(width, level)) * getLevelSize(height, level));
+            }
+
+            const int w = getLevelSize(width, source.level);
+            const int h = getLevelSize(height, source.level);
+
+            ConcurrentQueue queue("mipmap", Priority::HIGH);
+
+            for (int y = 0; y < h; y += tileHeight)
+            {
+                for (int x = 0; x < w; x += tileWidth)
+                {
+                    float32x4* image = next.empty() ? nullptr : next.data();
+                    queue.enqueue([this, &source, image, x, y]
+                    {
+                        processTile(source, image, x, y);
+                    });
+                }
+            }
+
+            queue.wait();
+
+            if (!next.empty())
+            {
+                Source temp = { nullptr, next.data(), level, level + 1 };
+                process(temp);
+            }
+        }
+
+    public:
+        MipmapGenerator(MipmapTarget& target, int width, int height, int levels,
+                        int blockWidth, int blockHeight, bool linear, bool premultiply)
+            : target(target)
+            , width(width)
+            , height(height)
+            , levels(levels)
+            , linear(linear)
+            , premultiply(premultiply)
+        {
+            // tiles are multiples of the block size on every level they produce; 64 x 64 pixels
+            // of work format (64 KB) leaves room for the reduced levels in L2
+            tileLevels = 1;
+            while (std::max(blockWidth, blockHeight) << (tileLevels + 1) <= 64)
+                ++tileLevels;
+
+            tileWidth = blockWidth << tileLevels;
+            tileHeight = blockHeight << tileLevels;
+        }
+
+        void generate(const Surface& source, int first)
+        {
+            Source temp = { &source, nullptr, 0, first };
+            process(temp);
+        }
+    };
+
+} // namespace
+
+namespace mango
+{
+
+    void resample(Surface& dest, const Surface& source, const ResampleOptions& options)
+    {
+        if (!dest.width || !dest.height || !source.width || !source.height)
+            return;
+
+        const Filter filter = getFilter(options.filter);
+        const FilterTable xtable(filter, dest.width, source.width);
+        const FilterTable ytable(filter, dest.height, source.height);
+
+        const ScanConverter reader(source.format);
+        const ScanConverter writer(dest.format);
+
+        const bool premultiply = source.format.alpha() && !options.premultiplied;
+
+        const int width = dest.width;
+
+        // the source rows contributing to a destination row are consecutive and move forward
+        // with it, so each band keeps only the horizontally filtered rows in the filter support
+        int capacity = 1;
+        for (const FilterTable::Contribution& c : ytable.contributions)
+        {
+            capacity = std::max(capacity, c.count);
+        }
+
+        processBands(dest.height, size_t(width) * dest.height, 8192, [&] (int y0, int y1)
+        {
+            ScanBuffer line(source.width);
+            ScanBuffer scan(width);
+            ScanBuffer ring(size_t(width) * capacity);
+
+            // horizontal pass: filtered source row y is stored in ring row y % capacity
+            auto filterRow = [&] (int y)
+            {
+                reader.read(line.data(), source.address<uint8>(0, y), source.width);
+                decodeScan(line.data(), source.width, options.linear, premultiply);
+
+                float32x4* d = ring.data() + size_t(y % capacity) * width;
+
+                for (int x = 0; x < width; ++x)
+                {
+                    const FilterTable::Contribution& c = xtable.contributions[x];
+                    const float* w = xtable.weights.data() + c.offset;
+                    const float32x4* s = line.data() + c.start;
+
+                    float32x4 sum(0.0f);
+                    for (int i = 0; i < c.count; ++i)
+                    {
+                        sum += s[i] * w[i];
+                    }
+
+                    d[x] = sum;
+                }
+            };
+
+            int first = 0; // oldest row in the ring
+            int next = 0; // next row to filter
+
+            // vertical pass
+            for (int y = y0; y < y1; ++y)
+            {
+                const FilterTable::Contribution& c = ytable.contributions[y];
+                const float* w = ytable.weights.data() + c.offset;
+
+                if (c.start < first || c.start > next)
+                {
+                    first = c.start;
+                    next = c.start;
+                }
+
+                for ( ; next < c.start + c.count; ++next)
+                {
+                    filterRow(next);
+                }
+
+                first = std::max(first, next - capacity);
+
+                std::fill(scan.begin(), scan.end(), float32x4(0.0f));
+
+                for (int i = 0; i < c.count; ++i)
+                {
+                    const float32x4* s = ring.data() + size_t((c.start + i) % capacity) * width;
+                    const float32x4 weight(w[i]);
+
+                    for (int x = 0; x < width; ++x)
+                    {
+                        scan[x] += s[x] * weight;
+                    }
+                }
+
+                encodeScan(scan.data(), width, options.linear, premultiply);
+                writer.write(dest.address<uint8>(0, y), scan.data(), width);
+            }
+        });
+    }
+
+    // ----------------------------------------------------------------------------
+    // mipmaps
+    // ----------------------------------------------------------------------------
+
+    int getMipmapLevels(int width, int height)
+    {
+        return width > 0 && height > 0 ? u32_log2(std::max(width, height)) + 1 : 0;
+    }
+
+    void generateMipmaps(Surface* dest, int levels, const Surface& source, const MipmapOptions& options)
+    {
+        if (!dest || levels < 1 || !source.width || !source.height)
+            return;
+
+        const bool premultiply = source.format.alpha() && !options.premultiplied;
+
+        SurfaceTarget target(dest, levels, options.linear, premultiply);
+        MipmapGenerator generator(target, source.width, source.height, levels + 1, 1, 1, options.linear, premultiply);
+        generator.generate(source, 1);
+    }
+
+    void compressMipmaps(Memory* output, int levels, const TextureCompressionInfo& info, const Surface& source, const MipmapOptions& options)
+    {
+        if (!output || levels < 1 || !info.encode || !source.width || !source.height)
+            return;
+
+        if (info.getCompressionFlags() & TextureCompressionInfo::SURFACE)
+        {
+            // surface compression needs the whole level at once
+            std::vector<Bitmap> bitmaps;
+            std::vector<Surface> dest;
+
+            for (int level = 1; level < levels; ++level)
+            {
+                bitmaps.emplace_back(getLevelSize(source.width, level), getLevelSize(source.height, level), info.format);
+                dest.push_back(bitmaps.back());
+            }
+
+            generateMipmaps(dest.data(), levels - 1, source, options);
+
+            info.compress(output[0], source, options.quality);
+
+            for (int level = 1; level < levels; ++level)
+            {
+                info.compress(output[level], dest[level - 1], options.quality);
+            }
+
+            return;
+        }
+
+        const bool premultiply = source.format.alpha() && !options.premultiplied;
+
+        BlockTarget target(output, info, source.width, source.height, levels, options.linear, premultiply, options.quality);
+        MipmapGenerator generator(target, source.width, source.height, levels, info.width, info.height, options.linear, premultiply);
+        generator.generate(source, 0);
+        target.finish();
+    }
+
+} // namespace mango
@@ -0,0 +1,460 @@
+/*
+    MANGO Multimedia Development Platform
+    Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
+*/
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <mango/core/memory.hpp>
+#include <mango/math/math.hpp>
+#include <mango/math/srgb.hpp>
+#include <mango/image/image.hpp>
+
+namespace mango
+{
+
+    using ScanBuffer = std::vector<float32x4, AlignedAllocator<float32x4>>;
+
+    // ----------------------------------------------------------------------------
+    // ScanConverter
+    // ----------------------------------------------------------------------------
+
+    // Converts scanlines between the surface format and the float RGBA work format. The packed
+    // UNORM formats, 16 bit UNORM and SNORM components and float components are handled
+    // directly; the remaining formats go through the Blitter.
+
+    class ScanConverter
+    {
+    protected:
+        enum Mode
+        {
+            FLOAT,
+            HALF,
+            UNORM_PACKED,
+            UNORM16,
+            SNORM16,
+            FP16,
+            FP32,
+            BLITTER
+        };
+
+        Mode mode;
+        Format format;
+        int bytes;
+        uint32 mask[4];
+        int offset[4];
+        float scale[4];
+        bool shared[4];
+
+        uint32x4 packedMask;
+        float32x4 packedScale;
+        float32x4 packedBias;
+
+        template <typename SampleType>
+        void readPacked(float32x4* dest, const uint8* src, int count) const
+        {
+            const SampleType* s = reinterpret_cast<const SampleType*>(src);
+            for (int x = 0; x < count; ++x)
+            {
+                // missing alpha defaults to 1.0
+                const uint32x4 v = uint32x4(uint32(s[x])) & packedMask;
+                dest[x] = convert<float32x4>(v) * packedScale + packedBias;
+            }
+        }
+
+        template <typename SampleType>
+        void writePacked(uint8* dest, const float32x4* src, int count) const
+        {
+            SampleType* d = reinterpret_cast<SampleType*>(dest);
+            for (int x = 0; x < count; ++x)
+            {
+                const float32x4 v = clamp(src[x], float32x4(0.0f), float32x4(1.0f));
+                const float c[] = { v.x, v.y, v.z, v.w };
+
+                uint32 s = 0;
+                for (int i = 0; i < 4; ++i)
+                {
+                    if (!shared[i])
+                        s |= uint32(c[i] * mask[i] + 0.5f) << offset[i];
+                }
+
+                d[x] = SampleType(s);
+            }
+        }
+
+        template <typename SampleType>
+        void readFloat(float32x4* dest, const uint8* src, int count) const
+        {
+            const SampleType* s = reinterpret_cast<const SampleType*>(src);
+            const int bits = sizeof(SampleType) * 8;
+            const int step = bytes / sizeof(SampleType);
+
+            for (int x = 0; x < count; ++x)
+            {
+                float v[4];
+                for (int i = 0; i < 4; ++i)
+                {
+                    v[i] = mask[i] ? float(s[offset[i] / bits]) : 0.0f;
+                }
+
+                dest[x] = float32x4(v[0], v[1], v[2], mask[3] ? v[3] : 1.0f);
+                s += step;
+            }
+        }
+
+        template <typename SampleType>
+        void writeFloat(uint8* dest, const float32x4* src, int count) const
+        {
+            SampleType* d = reinterpret_cast<SampleType*>(dest);
+            const int bits = sizeof(SampleType) * 8;
+            const int step = bytes / sizeof(SampleType);
+
+            for (int x = 0; x < count; ++x)
+            {
+                // the range is not clamped
+                const float32x4 v = src[x];
+                const float c[] = { v.x, v.y, v.z, v.w };
+
+                for (int i = 0; i < 4; ++i)
+                {
+                    if (mask[i] && !shared[i])
+                        d[offset[i] / bits] = SampleType(c[i]);
+                }
+
+                d += step;
+            }
+        }
+
+    public:
+        ScanConverter(const Format& format)
+            : format(format)
+            , bytes(format.bytes())
+        {
+            mode = BLITTER;
+
+            // components which are 16 bit words or (for FP32) 32 bit words
+            bool words = true;
+
+            for (int i = 0; i < 4; ++i)
+            {
+                const int size = format.size[i];
+                mask[i] = size ? uint32((1ull << size) - 1) : 0;
+                offset[i] = format.offset[i];
+                scale[i] = size ? 1.0f / float(mask[i]) : 0.0f;
+                shared[i] = false;
+
+                for (int j = 0; j < i; ++j)
+                {
+                    if (size && size == format.size[j] && offset[i] == format.offset[j])
+                        shared[i] = true;
+                }
+
+                const int wordSize = format.type == Format::FP32 ? 32 : 16;
+                if (size && (size != wordSize || (offset[i] % wordSize)))
+                    words = false;
+            }
+
+            if (format == FORMAT_RGBA32F)
+            {
+                mode = FLOAT;
+            }
+            else if (format == FORMAT_RGBA16F)
+            {
+                mode = HALF;
+            }
+            else if (format.type == Format::FP32 && words)
+            {
+                mode = FP32;
+            }
+            else if (format.type == Format::FP16 && words)
+            {
+                mode = FP16;
+            }
+            else if (format.type == Format::UNORM)
+            {
+                if (format.bits <= 32)
+                {
+                    // the components are scaled in-place; the float conversion is exact as
+                    // long as the components have at most 24 significant bits
+                    mode = UNORM_PACKED;
+                    packedMask = uint32x4(format.mask(0), format.mask(1), format.mask(2), format.mask(3));
+                    packedScale = float32x4(scale[0], scale[1], scale[2], scale[3]) /
+                                  float32x4(float(1u << offset[0]), float(1u << offset[1]),
+                                            float(1u << offset[2]), float(1u << offset[3]));
+                    packedBias = float32x4(0.0f, 0.0f, 0.0f, mask[3] ? 0.0f : 1.0f);
+                }
+                else if (words)
+                    mode = UNORM16;
+            }
+            else if (format.type == Format::SNORM && words)
+            {
+                mode = SNORM16;
+            }
+        }
+
+        void read(float32x4* dest, const uint8* src, int count) const
+        {
+            switch (mode)
+            {
+                case FLOAT:
+                {
+                    const float* s = reinterpret_cast<const float*>(src);
+                    for (int x = 0; x < count; ++x)
+                    {
+                        dest[x] = float32x4(s[0], s[1], s[2], s[3]);
+                        s += 4;
+                    }
+                    break;
+                }
+
+                case HALF:
+                {
+                    const float16x4* s = reinterpret_cast<const float16x4*>(src);
+                    for (int x = 0; x < count; ++x)
+                    {
+                        dest[x] = convert<float32x4>(s[x]);
+                    }
+                    break;
+                }
+
+                case UNORM_PACKED:
+                {
+                    switch (bytes)
+                    {
+                        case 1: readPacked<uint8>(dest, src, count); break;
+                        case 2: readPacked<uint16>(dest, src, count); break;
+                        case 3: readPacked<uint24>(dest, src, count); break;
+                        case 4: readPacked<uint32>(dest, src, count); break;
+                    }
+                    break;
+                }
+
+                case UNORM16:
+                {
+                    const uint16* s = reinterpret_cast<const uint16*>(src);
+                    const int step = bytes / 2;
+
+                    for (int x = 0; x < count; ++x)
+                    {
+                        float v[4];
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            v[i] = mask[i] ? float(s[offset[i] >> 4]) * scale[i] : 0.0f;
+                        }
+
+                        dest[x] = float32x4(v[0], v[1], v[2], mask[3] ? v[3] : 1.0f);
+                        s += step;
+                    }
+                    break;
+                }
+
+                case SNORM16:
+                {
+                    const int16* s = reinterpret_cast<const int16*>(src);
+                    const int step = bytes / 2;
+
+                    for (int x = 0; x < count; ++x)
+                    {
+                        // both -32768 and -32767 map to -1.0
+                        float v[4];
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            v[i] = mask[i] ? std::max(-1.0f, float(s[offset[i] >> 4]) / 32767.0f) : 0.0f;
+                        }
+
+                        dest[x] = float32x4(v[0], v[1], v[2], mask[3] ? v[3] : 1.0f);
+                        s += step;
+                    }
+                    break;
+                }
+
+                case FP16:
+                {
+                    readFloat<half>(dest, src, count);
+                    break;
+                }
+
+                case FP32:
+                {
+                    readFloat<float>(dest, src, count);
+                    break;
+                }
+
+                case BLITTER:
+                {
+                    Surface source(count, 1, format, 0, const_cast<uint8*>(src));
+                    Surface temp(count, 1, FORMAT_R8G8B8A8, count * 4, reinterpret_cast<uint8*>(dest));
+                    temp.blit(0, 0, source);
+
+                    // expand in-place from the end
+                    const uint32* s = reinterpret_cast<const uint32*>(dest);
+                    for (int x = count - 1; x >= 0; --x)
+                    {
+                        float32x4 v;
+                        v.unpack(s[x]);
+                        dest[x] = v * (1.0f / 255.0f);
+                    }
+                    break;
+                }
+            }
+        }
+
+        void write(uint8* dest, float32x4* src, int count) const
+        {
+            switch (mode)
+            {
+                case FLOAT:
+                {
+                    float* d = reinterpret_cast<float*>(dest);
+                    for (int x = 0; x < count; ++x)
+                    {
+                        const float32x4 v = src[x];
+                        d[0] = v.x;
+                        d[1] = v.y;
+                        d[2] = v.z;
+                        d[3] = v.w;
+                        d += 4;
+                    }
+                    break;
+                }
+
+                case HALF:
+                {
+                    float16x4* d = reinterpret_cast<float16x4*>(dest);
+                    for (int x = 0; x < count; ++x)
+                    {
+                        d[x] = convert<float16x4>(src[x]);
+                    }
+                    break;
+                }
+
+                case UNORM_PACKED:
+                {
+                    switch (bytes)
+                    {
+                        case 1: writePacked<uint8>(dest, src, count); break;
+                        case 2: writePacked<uint16>(dest, src, count); break;
+                        case 3: writePacked<uint24>(dest, src, count); break;
+                        case 4: writePacked<uint32>(dest, src, count); break;
+                    }
+                    break;
+                }
+
+                case UNORM16:
+                {
+                    uint16* d = reinterpret_cast<uint16*>(dest);
+                    const int step = bytes / 2;
+
+                    for (int x = 0; x < count; ++x)
+                    {
+                        const float32x4 v = clamp(src[x], float32x4(0.0f), float32x4(1.0f));
+                        const float c[] = { v.x, v.y, v.z, v.w };
+
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            if (mask[i] && !shared[i])
+                                d[offset[i] >> 4] = uint16(c[i] * 65535.0f + 0.5f);
+                        }
+
+                        d += step;
+                    }
+                    break;
+                }
+
+                case SNORM16:
+                {
+                    int16* d = reinterpret_cast<int16*>(dest);
+                    const int step = bytes / 2;
+
+                    for (int x = 0; x < count; ++x)
+                    {
+                        const float32x4 v = clamp(src[x], float32x4(-1.0f), float32x4(1.0f));
+                        const float c[] = { v.x, v.y, v.z, v.w };
+
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            if (mask[i] && !shared[i])
+                                d[offset[i] >> 4] = int16(c[i] * 32767.0f + (c[i] < 0.0f ? -0.5f : 0.5f));
+                        }
+
+                        d += step;
+                    }
+                    break;
+                }
+
+                case FP16:
+                {
+                    writeFloat<half>(dest, src, count);
+                    break;
+                }
+
+                case FP32:
+                {
+                    writeFloat<float>(dest, src, count);
+                    break;
+                }
+
+                case BLITTER:
+                {
+                    Surface source(count, 1, FORMAT_RGBA32F, 0, reinterpret_cast<uint8*>(src));
+                    Surface target(count, 1, format, 0, dest);
+                    target.blit(0, 0, source);
+                    break;
+                }
+            }
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // scanline processing
+    // ----------------------------------------------------------------------------
+
+    inline void decodeScan(float32x4* scan, int count, bool linear, bool premultiply)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            float32x4 v = scan[x];
+
+            if (linear)
+            {
+                const float a = v.w;
+                v = srgb_to_linear(v);
+                v.w = a;
+            }
+
+            if (premultiply)
+            {
+                // multiply color with alpha and alpha with 1.0
+                v = v * (v.wwww * float32x4(1.0f, 1.0f, 1.0f, 0.0f) + float32x4(0.0f, 0.0f, 0.0f, 1.0f));
+            }
+
+            scan[x] = v;
+        }
+    }
+
+    inline void encodeScan(float32x4* scan, int count, bool linear, bool premultiply)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            float32x4 v = scan[x];
+
+            if (premultiply)
+            {
+                const float a = clamp(float(v.w), 0.0f, 1.0f);
+                v = a > 0.0f ? v / a : float32x4(0.0f);
+                v.w = a;
+            }
+
+            if (linear)
+            {
+                const float a = v.w;
+                v = linear_to_srgb(max(v, float32x4(0.0f)));
+                v.w = a;
+            }
+
+            scan[x] = v;
+        }
+    }
+
+} // namespace mango
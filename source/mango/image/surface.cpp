@@ -17,159 +17,634 @@ namespace
     using namespace mango;
 
     // ----------------------------------------------------------------------------
-	// fill_aligned
+    // fill
     // ----------------------------------------------------------------------------
 
+    // The scanlines are filled with a repeating byte pattern. The pattern buffer holds two
+    // periods of the pattern so that a 16 byte vector can be loaded from any phase without
+    // wrapping; the period is the least common multiple of the pattern size and 16 bytes.
+    // Patterns with a longer period are copied as they are with memcpy.
+
+    // Fills larger than this bypass the caches with non-temporal stores
+    constexpr size_t streamingThreshold = 8 * 1024 * 1024;
+
+    // Longest period which is expanded for the vector stores
+    constexpr size_t maxVectorPeriod = 4096;
+
+    class FillPattern
+    {
+    protected:
+        std::vector<uint8> buffer;
+        size_t period;
+        bool vectorized;
+
+#if defined(MANGO_ENABLE_SSE2)
+
+        template <bool Stream>
+        static inline void store(uint8* dest, __m128i value)
+        {
+            if (Stream)
+                _mm_stream_si128(reinterpret_cast<__m128i*>(dest), value);
+            else
+                _mm_store_si128(reinterpret_cast<__m128i*>(dest), value);
+        }
+
+        static inline __m128i load(const uint8* pattern)
+        {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern));
+        }
+
+        template <bool Stream>
+        void fill_sse2(uint8*& dest, size_t& bytes, size_t& phase, const uint8* pattern) const
+        {
+            if (period == 16)
+            {
+                // 8, 16, 32, 64 and 128 bit samples
+                const __m128i v0 = load(pattern + phase);
+                for ( ; bytes >= 64; bytes -= 64)
+                {
+                    store<Stream>(dest +  0, v0);
+                    store<Stream>(dest + 16, v0);
+                    store<Stream>(dest + 32, v0);
+                    store<Stream>(dest + 48, v0);
+                    dest += 64;
+                }
+            }
+            else if (period == 48)
+            {
+                // 24, 48 and 96 bit samples
+                const __m128i v0 = load(pattern + phase +  0);
+                const __m128i v1 = load(pattern + phase + 16);
+                const __m128i v2 = load(pattern + phase + 32);
+                for ( ; bytes >= 48; bytes -= 48)
+                {
+                    store<Stream>(dest +  0, v0);
+                    store<Stream>(dest + 16, v1);
+                    store<Stream>(dest + 32, v2);
+                    dest += 48;
+                }
+            }
+
+            for ( ; bytes >= 16; bytes -= 16)
+            {
+                store<Stream>(dest, load(pattern + phase));
+                dest += 16;
+                phase += 16;
+                if (phase >= period)
+                    phase -= period;
+            }
+        }
+
+#endif
+
+    public:
+        FillPattern(const uint8* pattern, size_t size)
+        {
+            size_t a = size;
+            size_t b = 16;
+            while (b)
+            {
+                const size_t t = a % b;
+                a = b;
+                b = t;
+            }
+
+            period = size * 16 / a;
+            vectorized = period <= maxVectorPeriod;
+
+            if (!vectorized)
+            {
+                period = size;
+                buffer.assign(pattern, pattern + size);
+                return;
+            }
+
+            buffer.resize(period * 2);
+
+            for (size_t i = 0; i < period * 2; ++i)
+            {
+                buffer[i] = pattern[i % size];
+            }
+        }
+
+        void fill(uint8* dest, size_t bytes, bool stream) const
+        {
+            const uint8* pattern = buffer.data();
+
+            if (!vectorized)
+            {
+                for ( ; bytes > period; bytes -= period)
+                {
+                    std::memcpy(dest, pattern, period);
+                    dest += period;
+                }
+
+                std::memcpy(dest, pattern, bytes);
+                return;
+            }
+
+            // align the dest pointer
+            const size_t address = size_t(dest - reinterpret_cast<uint8*>(0));
+            const size_t head = std::min(bytes, (0 - address) & 15);
+            std::memcpy(dest, pattern, head);
+
+            size_t phase = head;
+            dest += head;
+            bytes -= head;
+
+#if defined(MANGO_ENABLE_SSE2)
+
+            if (stream)
+            {
+                fill_sse2<true>(dest, bytes, phase, pattern);
+                _mm_sfence();
+            }
+            else
+            {
+                fill_sse2<false>(dest, bytes, phase, pattern);
+            }
+
+#elif defined(MANGO_ENABLE_NEON)
+
+            MANGO_UNREFERENCED_PARAMETER(stream);
+
+            for ( ; bytes >= 16; bytes -= 16)
+            {
+                vst1q_u8(dest, vld1q_u8(pattern + phase));
+                dest += 16;
+                phase += 16;
+                if (phase >= period)
+                    phase -= period;
+            }
+
+#else
+
+            MANGO_UNREFERENCED_PARAMETER(stream);
+
+            for ( ; bytes >= 16; bytes -= 16)
+            {
+                std::memcpy(dest, pattern + phase, 16);
+                dest += 16;
+                phase += 16;
+                if (phase >= period)
+                    phase -= period;
+            }
+
+#endif
+
+            std::memcpy(dest, pattern + phase, bytes);
+        }
+    };
+
+    template <typename T, typename C>
+    bool store_clear_sample(uint8* sample, const Format& format, const C* color)
+    {
+        T* dest = reinterpret_cast<T*>(sample);
+        const int bits = sizeof(T) * 8;
+
+        if (format.bits > 128)
+            return false;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            // every component must be stored in a sample of type T
+            if (format.size[i] && (format.size[i] != bits || format.offset[i] % bits))
+                return false;
+        }
+
+        for (int i = 3; i >= 0; --i)
+        {
+            // the first of the components which share storage is written last
+            if (format.size[i])
+                dest[format.offset[i] / bits] = T(color[i]);
+        }
+
+        return true;
+    }
+
     template <typename T>
-    inline uint8* u8_fill(uint8* dest, int count, T value)
+    void store_packed_sample(uint8* sample, uint32 value)
+    {
+        *reinterpret_cast<T*>(sample) = T(value);
+    }
+
+    bool config_clear_sample(uint8* sample, const Format& format, float red, float green, float blue, float alpha)
     {
-        T* p = reinterpret_cast<T*>(dest);
-        for (int i = 0; i < count; ++i)
+        // make the parameters indexable
+        const float color[] = { red, green, blue, alpha };
+
+        std::memset(sample, 0, 16);
+
+        switch (format.type)
         {
-            p[i] = value;
+            case Format::UNORM:
+                if (format.bits <= 32)
+                {
+                    const uint32 value = format.pack(red, green, blue, alpha);
+                    switch (format.bytes())
+                    {
+                        case 1: store_packed_sample<uint8>(sample, value); break;
+                        case 2: store_packed_sample<uint16>(sample, value); break;
+                        case 3: store_packed_sample<uint24>(sample, value); break;
+                        case 4: store_packed_sample<uint32>(sample, value); break;
+                    }
+                    return true;
+                }
+                else
+                {
+                    // 16 or 32 bit components
+                    float scaled16[4];
+                    double scaled32[4];
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        scaled16[i] = clamp(color[i], 0.0f, 1.0f) * 65535.0f + 0.5f;
+                        scaled32[i] = double(clamp(color[i], 0.0f, 1.0f)) * 4294967295.0 + 0.5;
+                    }
+                    return store_clear_sample<uint16>(sample, format, scaled16) ||
+                           store_clear_sample<uint32>(sample, format, scaled32);
+                }
+
+            case Format::FP16:
+                return store_clear_sample<half>(sample, format, color);
+
+            case Format::FP32:
+                return store_clear_sample<float>(sample, format, color);
+
+            default:
+                break;
         }
-        return dest + count * sizeof(T);
+
+        return false;
     }
 
-	template <typename T, typename E>
-	void fill_aligned(uint8* dest, T value, E expanded_value, int count)
-	{
-		// compute padding required for alignment
-		const ptrdiff_t address = dest - reinterpret_cast<uint8*>(0);
-        const ptrdiff_t mask = sizeof(E) - 1;
-		const int padding_in_bytes = int(-address & mask);
+    // ----------------------------------------------------------------------------
+    // morton
+    // ----------------------------------------------------------------------------
+
+    struct Sample128
+    {
+        uint64 data[2];
+    };
 
-        // fill padding values to align the dest pointer
-		const int padding_count = int(padding_in_bytes / sizeof(T));
-        dest = u8_fill(dest, padding_count, value);
-		count -= padding_count;
+    using MortonFunc = void (*)(uint8* tile, const uint8* scan, int count, uint32 ybits, const uint32* xbits, int bytes);
 
-        // fill expanded value to aligned address
-		const int expand_ratio = sizeof(E) / sizeof(T);
-		const int expand_count = count / expand_ratio;
-        dest = u8_fill(dest, expand_count, expanded_value);
-		count -= expand_count * expand_ratio;
+    template <typename T>
+    void morton_scatter(uint8* tile, const uint8* scan, int count, uint32 ybits, const uint32* xbits, int bytes)
+    {
+        MANGO_UNREFERENCED_PARAMETER(bytes);
+        T* d = reinterpret_cast<T*>(tile);
+        const T* s = reinterpret_cast<const T*>(scan);
+        for (int x = 0; x < count; ++x)
+        {
+            d[xbits[x] | ybits] = s[x];
+        }
+    }
 
-        // fill remaining values
-        u8_fill(dest, count, value);
-	}
+    template <typename T>
+    void morton_gather(uint8* scan, const uint8* tile, int count, uint32 ybits, const uint32* xbits, int bytes)
+    {
+        MANGO_UNREFERENCED_PARAMETER(bytes);
+        T* d = reinterpret_cast<T*>(scan);
+        const T* s = reinterpret_cast<const T*>(tile);
+        for (int x = 0; x < count; ++x)
+        {
+            d[x] = s[xbits[x] | ybits];
+        }
+    }
+
+    void morton_scatter_generic(uint8* tile, const uint8* scan, int count, uint32 ybits, const uint32* xbits, int bytes)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            std::memcpy(tile + (xbits[x] | ybits) * bytes, scan + x * bytes, bytes);
+        }
+    }
+
+    void morton_gather_generic(uint8* scan, const uint8* tile, int count, uint32 ybits, const uint32* xbits, int bytes)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            std::memcpy(scan + x * bytes, tile + (xbits[x] | ybits) * bytes, bytes);
+        }
+    }
+
+    MortonFunc getMortonScatter(int bytes)
+    {
+        switch (bytes)
+        {
+            case 1: return morton_scatter<uint8>;
+            case 2: return morton_scatter<uint16>;
+            case 4: return morton_scatter<uint32>;
+            case 8: return morton_scatter<uint64>;
+            case 16: return morton_scatter<Sample128>;
+        }
+        return morton_scatter_generic;
+    }
+
+    MortonFunc getMortonGather(int bytes)
+    {
+        switch (bytes)
+        {
+            case 1: return morton_gather<uint8>;
+            case 2: return morton_gather<uint16>;
+            case 4: return morton_gather<uint32>;
+            case 8: return morton_gather<uint64>;
+            case 16: return morton_gather<Sample128>;
+        }
+        return morton_gather_generic;
+    }
 
     // ----------------------------------------------------------------------------
-    // clear
+    // transform
     // ----------------------------------------------------------------------------
 
-    void clear_uint8_scan(uint8* dest, int count, uint32 color)
+    // The source pixel (x, y) is stored to base + x * xstep + y * ystep in the destination;
+    // the steps encode the flips and the swap of axes (transpose).
+
+    struct Transform
+    {
+        bool swap;
+        bool xflip; // in destination space
+        bool yflip;
+    };
+
+    struct TransformTile
+    {
+        uint8* base;
+        ptrdiff_t xstep;
+        ptrdiff_t ystep;
+    };
+
+    TransformTile getTransformTile(const Surface& dest, const Transform& transform)
     {
-        const uint8 value = static_cast<uint8>(color);
-		std::memset(dest, value, count);
+        const ptrdiff_t bytes = dest.format.bytes();
+        const ptrdiff_t xstep = transform.xflip ? -bytes : bytes;
+        const ptrdiff_t ystep = transform.yflip ? -ptrdiff_t(dest.stride) : dest.stride;
+
+        const int x = transform.xflip ? dest.width - 1 : 0;
+        const int y = transform.yflip ? dest.height - 1 : 0;
+
+        TransformTile tile;
+        tile.base = dest.address<uint8>(x, y);
+        tile.xstep = transform.swap ? ystep : xstep;
+        tile.ystep = transform.swap ? xstep : ystep;
+        return tile;
     }
 
-    void clear_uint16_scan(uint8* dest, int count, uint32 color)
+    template <typename T>
+    void transform_tile(const TransformTile& tile, const uint8* src, int stride, int x0, int y0, int width, int height, int bytes)
     {
-#if defined(MANGO_ENABLE_SIMD)
-		if (count >= 32)
-		{
-			// 128 bit fill
-			uint16 value16 = static_cast<uint16>(color);
-			uint32 value32 = (color << 16) | color;
-			simd::uint32x4 value128 = simd::uint32x4_set1(value32);
-			fill_aligned(dest, value16, value128, count);
-		}
-#else
-		if (count >= 16)
-		{
-			uint16 value16 = static_cast<uint16>(color);
-			uint32 value32 = (color << 16) | color;
-#ifdef MANGO_CPU_64BIT
-			// 64 bit fill
-			uint64 value64 = (uint64(value32) << 32) | value32;
-			fill_aligned(dest, value16, value64, count);
-#else
-			// 32 bit fill
-			fill_aligned(dest, value16, value32, count);
-#endif
-		}
-#endif
-		else
-		{
-			// 16 bit fill
-			uint16 value16 = static_cast<uint16>(color);
-            u8_fill(dest, count, value16);
-		}
+        MANGO_UNREFERENCED_PARAMETER(bytes);
+
+        for (int y = 0; y < height; ++y)
+        {
+            const T* s = reinterpret_cast<const T*>(src + y * stride);
+            uint8* d = tile.base + (y0 + y) * tile.ystep + x0 * tile.xstep;
+
+            for (int x = 0; x < width; ++x)
+            {
+                *reinterpret_cast<T*>(d) = s[x];
+                d += tile.xstep;
+            }
+        }
     }
 
-    void clear_uint24_scan(uint8* dest, int count, uint32 color)
+    void transform_tile_generic(const TransformTile& tile, const uint8* src, int stride, int x0, int y0, int width, int height, int bytes)
     {
-        uint24 value24 = color;
-        u8_fill(dest, count, value24);
+        for (int y = 0; y < height; ++y)
+        {
+            const uint8* s = src + y * stride;
+            uint8* d = tile.base + (y0 + y) * tile.ystep + x0 * tile.xstep;
+
+            for (int x = 0; x < width; ++x)
+            {
+                std::memcpy(d, s, bytes);
+                s += bytes;
+                d += tile.xstep;
+            }
+        }
     }
 
-    void clear_uint32_scan(uint8* dest, int count, uint32 color)
+#if defined(MANGO_ENABLE_SSE2) || defined(MANGO_ENABLE_NEON)
+
+    // Transposed tiles are processed in 4x4 (32 bit) and 8x8 (8 bit) blocks where the rows of a
+    // block are consecutive in the destination. When the destination rows go backwards, the
+    // source rows are loaded in reverse order so that every store is a forward vector store.
+
+    void transpose_tile_u32(const TransformTile& tile, const uint8* src, int stride, int x0, int y0, int width, int height, int bytes)
     {
-#if defined(MANGO_ENABLE_SIMD)
-		if (count >= 16)
-		{
-			// 128 bit fill
-			simd::uint32x4 value128 = simd::uint32x4_set1(color);
-			fill_aligned(dest, color, value128, count);
-		}
-		else
-#else
+        const int xblocks = width & ~3;
+        const int yblocks = height & ~3;
+        const bool reverse = tile.ystep < 0;
 
-#ifdef MANGO_CPU_64BIT
-		if (count >= 8)
-		{
-			// 64 bit fill
-			uint64 value64 = (uint64(color) << 32) | color;
-			fill_aligned(dest, color, value64, count);
-		}
-		else
-#endif
+        for (int y = 0; y < yblocks; y += 4)
+        {
+            const uint8* s = src + y * stride;
+            const int ylow = reverse ? y + 3 : y;
 
+            for (int x = 0; x < xblocks; x += 4)
+            {
+                uint8* d = tile.base + (y0 + ylow) * tile.ystep + (x0 + x) * tile.xstep;
+
+                const uint8* r0 = s + (reverse ? 3 : 0) * stride + x * 4;
+                const uint8* r1 = s + (reverse ? 2 : 1) * stride + x * 4;
+                const uint8* r2 = s + (reverse ? 1 : 2) * stride + x * 4;
+                const uint8* r3 = s + (reverse ? 0 : 3) * stride + x * 4;
+
+#if defined(MANGO_ENABLE_SSE2)
+                const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0));
+                const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1));
+                const __m128i a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r2));
+                const __m128i a3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r3));
+                const __m128i t0 = _mm_unpacklo_epi32(a0, a1);
+                const __m128i t1 = _mm_unpacklo_epi32(a2, a3);
+                const __m128i t2 = _mm_unpackhi_epi32(a0, a1);
+                const __m128i t3 = _mm_unpackhi_epi32(a2, a3);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d + tile.xstep * 0), _mm_unpacklo_epi64(t0, t1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d + tile.xstep * 1), _mm_unpackhi_epi64(t0, t1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d + tile.xstep * 2), _mm_unpacklo_epi64(t2, t3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d + tile.xstep * 3), _mm_unpackhi_epi64(t2, t3));
+#else
+                const uint32x4x2_t p0 = vtrnq_u32(vld1q_u32(reinterpret_cast<const uint32_t*>(r0)),
+                                                  vld1q_u32(reinterpret_cast<const uint32_t*>(r1)));
+                const uint32x4x2_t p1 = vtrnq_u32(vld1q_u32(reinterpret_cast<const uint32_t*>(r2)),
+                                                  vld1q_u32(reinterpret_cast<const uint32_t*>(r3)));
+                vst1q_u32(reinterpret_cast<uint32_t*>(d + tile.xstep * 0), vcombine_u32(vget_low_u32(p0.val[0]), vget_low_u32(p1.val[0])));
+                vst1q_u32(reinterpret_cast<uint32_t*>(d + tile.xstep * 1), vcombine_u32(vget_low_u32(p0.val[1]), vget_low_u32(p1.val[1])));
+                vst1q_u32(reinterpret_cast<uint32_t*>(d + tile.xstep * 2), vcombine_u32(vget_high_u32(p0.val[0]), vget_high_u32(p1.val[0])));
+                vst1q_u32(reinterpret_cast<uint32_t*>(d + tile.xstep * 3), vcombine_u32(vget_high_u32(p0.val[1]), vget_high_u32(p1.val[1])));
 #endif
-		{
-			// 32 bit fill
-            u8_fill(dest, count, color);
-		}
+            }
+        }
+
+        // remaining columns and rows
+        transform_tile<uint32>(tile, src + xblocks * 4, stride, x0 + xblocks, y0, width - xblocks, yblocks, bytes);
+        transform_tile<uint32>(tile, src + yblocks * stride, stride, x0, y0 + yblocks, width, height - yblocks, bytes);
     }
 
-    template <typename FloatType>
-    void clear_float_scan(uint8* dest, int count, const FloatType* color, const int size)
+    void transpose_tile_u8(const TransformTile& tile, const uint8* src, int stride, int x0, int y0, int width, int height, int bytes)
     {
-        FloatType* d = reinterpret_cast<FloatType*>(dest);
-        for (int i = 0; i < count; ++i)
+        const int xblocks = width & ~7;
+        const int yblocks = height & ~7;
+        const bool reverse = tile.ystep < 0;
+
+        for (int y = 0; y < yblocks; y += 8)
         {
-            switch (size)
+            const uint8* s = src + y * stride;
+            const int ylow = reverse ? y + 7 : y;
+
+            for (int x = 0; x < xblocks; x += 8)
             {
-                case 4: d[3] = color[3];
-                case 3: d[2] = color[2];
-                case 2: d[1] = color[1];
-                case 1: d[0] = color[0];
+                uint8* d = tile.base + (y0 + ylow) * tile.ystep + (x0 + x) * tile.xstep;
+
+                const uint8* r[8];
+                for (int i = 0; i < 8; ++i)
+                {
+                    r[i] = s + (reverse ? 7 - i : i) * stride + x;
+                }
+
+#if defined(MANGO_ENABLE_SSE2)
+                const __m128i t0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r[0])), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(r[1])));
+                const __m128i t1 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r[2])), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(r[3])));
+                const __m128i t2 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r[4])), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(r[5])));
+                const __m128i t3 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r[6])), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(r[7])));
+                const __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+                const __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+                const __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+                const __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+                const __m128i v[] =
+                {
+                    _mm_unpacklo_epi32(u0, u2),
+                    _mm_unpackhi_epi32(u0, u2),
+                    _mm_unpacklo_epi32(u1, u3),
+                    _mm_unpackhi_epi32(u1, u3)
+                };
+
+                for (int i = 0; i < 4; ++i)
+                {
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(d + tile.xstep * (i * 2 + 0)), v[i]);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(d + tile.xstep * (i * 2 + 1)), _mm_srli_si128(v[i], 8));
+                }
+#else
+                const uint8x8x2_t t0 = vtrn_u8(vld1_u8(r[0]), vld1_u8(r[1]));
+                const uint8x8x2_t t1 = vtrn_u8(vld1_u8(r[2]), vld1_u8(r[3]));
+                const uint8x8x2_t t2 = vtrn_u8(vld1_u8(r[4]), vld1_u8(r[5]));
+                const uint8x8x2_t t3 = vtrn_u8(vld1_u8(r[6]), vld1_u8(r[7]));
+                const uint16x4x2_t s0 = vtrn_u16(vreinterpret_u16_u8(t0.val[0]), vreinterpret_u16_u8(t1.val[0]));
+                const uint16x4x2_t s1 = vtrn_u16(vreinterpret_u16_u8(t0.val[1]), vreinterpret_u16_u8(t1.val[1]));
+                const uint16x4x2_t s2 = vtrn_u16(vreinterpret_u16_u8(t2.val[0]), vreinterpret_u16_u8(t3.val[0]));
+                const uint16x4x2_t s3 = vtrn_u16(vreinterpret_u16_u8(t2.val[1]), vreinterpret_u16_u8(t3.val[1]));
+                const uint32x2x2_t q0 = vtrn_u32(vreinterpret_u32_u16(s0.val[0]), vreinterpret_u32_u16(s2.val[0]));
+                const uint32x2x2_t q1 = vtrn_u32(vreinterpret_u32_u16(s1.val[0]), vreinterpret_u32_u16(s3.val[0]));
+                const uint32x2x2_t q2 = vtrn_u32(vreinterpret_u32_u16(s0.val[1]), vreinterpret_u32_u16(s2.val[1]));
+                const uint32x2x2_t q3 = vtrn_u32(vreinterpret_u32_u16(s1.val[1]), vreinterpret_u32_u16(s3.val[1]));
+                vst1_u8(d + tile.xstep * 0, vreinterpret_u8_u32(q0.val[0]));
+                vst1_u8(d + tile.xstep * 1, vreinterpret_u8_u32(q1.val[0]));
+                vst1_u8(d + tile.xstep * 2, vreinterpret_u8_u32(q2.val[0]));
+                vst1_u8(d + tile.xstep * 3, vreinterpret_u8_u32(q3.val[0]));
+                vst1_u8(d + tile.xstep * 4, vreinterpret_u8_u32(q0.val[1]));
+                vst1_u8(d + tile.xstep * 5, vreinterpret_u8_u32(q1.val[1]));
+                vst1_u8(d + tile.xstep * 6, vreinterpret_u8_u32(q2.val[1]));
+                vst1_u8(d + tile.xstep * 7, vreinterpret_u8_u32(q3.val[1]));
+#endif
             }
-            d += size;
         }
+
+        // remaining columns and rows
+        transform_tile<uint8>(tile, src + xblocks, stride, x0 + xblocks, y0, width - xblocks, yblocks, bytes);
+        transform_tile<uint8>(tile, src + yblocks * stride, stride, x0, y0 + yblocks, width, height - yblocks, bytes);
     }
 
-    template <typename FloatType>
-    int config_clear_color(FloatType* color, const Format& format, float red, float green, float blue, float alpha)
+#endif
+
+    using TransformFunc = void (*)(const TransformTile& tile, const uint8* src, int stride, int x0, int y0, int width, int height, int bytes);
+
+    TransformFunc getTransformFunc(int bytes, bool swap)
     {
-        int size = 0;
+#if defined(MANGO_ENABLE_SSE2) || defined(MANGO_ENABLE_NEON)
+        if (swap)
+        {
+            if (bytes == 1)
+                return transpose_tile_u8;
+            if (bytes == 4)
+                return transpose_tile_u32;
+        }
+#else
+        MANGO_UNREFERENCED_PARAMETER(swap);
+#endif
 
-        // make the parameters indexable
-        const float temp[] = { red, green, blue, alpha };
+        switch (bytes)
+        {
+            case 1: return transform_tile<uint8>;
+            case 2: return transform_tile<uint16>;
+            case 4: return transform_tile<uint32>;
+            case 8: return transform_tile<uint64>;
+            case 16: return transform_tile<Sample128>;
+        }
 
-        for (int i = 0; i < 4; ++i)
+        return transform_tile_generic;
+    }
+
+    void transform(Surface& dest, const Surface& source, const Transform& transform)
+    {
+        const int width = transform.swap ? source.height : source.width;
+        const int height = transform.swap ? source.width : source.height;
+
+        if (dest.width != width || dest.height != height || !width || !height)
+            return;
+
+        const int bytes = dest.format.bytes();
+        const bool convert = dest.format != source.format;
+
+        const TransformTile tile = getTransformTile(dest, transform);
+        const TransformFunc func = getTransformFunc(bytes, transform.swap);
+
+        // the tiles are small enough that both source and destination lines stay in cache
+        const int tileSize = 64;
+
+        ConcurrentQueue queue("transform", Priority::HIGH);
+
+        for (int y = 0; y < source.height; y += tileSize)
         {
-            uint32 mask = format.mask(i);
-            if (mask)
+            queue.enqueue([=, &dest, &source]
             {
-                int index = clamp(u32_index_of_lsb(mask), 0, 3);
-                color[index] = FloatType(temp[i]);
-                size = std::max(size, index + 1);
-            }
+                const int ysize = std::min(tileSize, source.height - y);
+                std::vector<uint8> temp;
+
+                if (convert)
+                {
+                    temp.resize(tileSize * tileSize * bytes);
+                }
+
+                for (int x = 0; x < source.width; x += tileSize)
+                {
+                    const int xsize = std::min(tileSize, source.width - x);
+                    const uint8* src = source.address<uint8>(x, y);
+                    int stride = source.stride;
+
+                    if (convert)
+                    {
+                        BlitRect rect;
+                        rect.srcImage = const_cast<uint8*>(src);
+                        rect.srcStride = source.stride;
+                        rect.destImage = temp.data();
+                        rect.destStride = tileSize * bytes;
+                        rect.width = xsize;
+                        rect.height = ysize;
+
+                        Blitter blitter(dest.format, source.format);
+                        blitter.convert(rect);
+
+                        src = temp.data();
+                        stride = rect.destStride;
+                    }
+
+                    func(tile, src, stride, x, y, xsize, ysize, bytes);
+                }
+            });
         }
 
-        return size;
+        queue.wait();
     }
 
     // ----------------------------------------------------------------------------
@@ -293,95 +768,107 @@ namespace mango
     }
 
     void Surface::save(const std::string& filename, float quality)
+    {
+        ImageEncodeOptions options;
+        options.quality = quality;
+        save(filename, options);
+    }
+
+    void Surface::save(const std::string& filename, const ImageEncodeOptions& options)
     {
         ImageEncoder encoder(filename);
         if (encoder.isEncoder())
         {
             FileStream file(filename, Stream::WRITE);
-            encoder.encode(file, *this, quality);
+            encoder.encode(file, *this, options);
         }
     }
 
     void Surface::clear(float red, float green, float blue, float alpha)
     {
-        switch (format.type)
+        if (!width || !height)
+            return;
+
+        uint8 sample[16];
+
+        if (!config_clear_sample(sample, format, red, green, blue, alpha))
         {
-            case Format::UNORM:
-            {
-                void (*func)(uint8 *, int, uint32) = nullptr;
+            // the color is converted with the blitter
+            float color[] = { red, green, blue, alpha };
+            Surface source(1, 1, FORMAT_RGBA32F, 16, reinterpret_cast<uint8*>(color));
 
-                switch (format.bits)
-                {
-                    case 8: func = clear_uint8_scan; break;
-                    case 16: func = clear_uint16_scan; break;
-                    case 24: func = clear_uint24_scan; break;
-                    case 32: func = clear_uint32_scan; break;
-                }
+            Bitmap temp(1, 1, format);
+            std::memset(temp.image, 0, temp.format.bytes());
+            temp.blit(0, 0, source);
 
-                if (func)
-                {
-                    uint32 color = format.pack(red, green, blue, alpha);
-
-#if 1
-                    // super simple multi-threaded buffer clearing
-
-                    std::thread top([=] {
-                        for (int y = 0; y < height / 2; ++y)
-                        {
-                            func(image + y * stride, width, color);
-                        }
-                    });
-
-                    std::thread bottom([=] {
-                        for (int y = height / 2; y < height; ++y)
-                        {
-                            func(image + y * stride, width, color);
-                        }
-                    });
-
-                    top.join();
-                    bottom.join();
-#else
-                    for (int y = 0; y < height; ++y)
-                    {
-                        func(image + y * stride, width, color);
-                    }
-#endif
-                }
+            fill(temp);
+            return;
+        }
 
-                break;
-            }
+        const int bytes = format.bytes();
+        const size_t scan = size_t(width) * bytes;
+        const size_t total = scan * height;
+        const bool stream = total >= streamingThreshold;
 
-            case Format::FP16:
-            {
-                half color[4];
-                int size = config_clear_color<half>(color, format, red, green, blue, alpha);
+        const FillPattern pattern(sample, bytes);
 
-                for (int y = 0; y < height; ++y)
+        processBands(height, total, 512 * 1024, [&] (int y0, int y1)
+        {
+            if (scan == size_t(stride))
+            {
+                // contiguous rows are filled as one scanline
+                pattern.fill(image + y0 * stride, scan * (y1 - y0), stream);
+            }
+            else
+            {
+                for (int y = y0; y < y1; ++y)
                 {
-                    clear_float_scan<half>(image + y * stride, width, color, size);
+                    pattern.fill(image + y * stride, scan, stream);
                 }
-
-                break;
             }
+        });
+    }
 
-            case Format::FP32:
-            {
-                float color[4];
-                int size = config_clear_color<float>(color, format, red, green, blue, alpha);
+    void Surface::clear(int x, int y, int width, int height, float red, float green, float blue, float alpha)
+    {
+        Surface dest(*this, x, y, width, height);
+        dest.clear(red, green, blue, alpha);
+    }
 
-                for (int y = 0; y < height; ++y)
-                {
-                    clear_float_scan<float>(image + y * stride, width, color, size);
-                }
+    void Surface::fill(const Surface& source)
+    {
+        if (!width || !height || !source.width || !source.height)
+            return;
 
-                break;
-            }
+        if (source.format != format)
+        {
+            Bitmap temp(source.width, source.height, format);
+            temp.blit(0, 0, source);
+            fill(temp);
+            return;
+        }
 
-            default:
-                // TODO: not supported?
-                break;
+        const int bytes = format.bytes();
+        const size_t scan = size_t(width) * bytes;
+        const size_t total = scan * height;
+        const bool stream = total >= streamingThreshold;
+
+        // only the pattern rows which are used are configured
+        const int rows = std::min(height, source.height);
+        std::vector<FillPattern> patterns;
+
+        for (int y = 0; y < rows; ++y)
+        {
+            patterns.emplace_back(source.address<uint8>(0, y), size_t(source.width) * bytes);
         }
+
+        processBands(height, total, 512 * 1024, [&] (int y0, int y1)
+        {
+            for (int y = y0; y < y1; ++y)
+            {
+                patterns[y % source.height].fill(image + y * stride, scan, stream);
+            }
+        });
     }
 
     void Surface::blit(int x, int y, const Surface& source)
@@ -588,4 +1075,256 @@ namespace mango
         return *this;
     }
 
+    // ----------------------------------------------------------------------------
+    // transforms
+    // ----------------------------------------------------------------------------
+
+    void transpose(Surface& dest, const Surface& source)
+    {
+        transform(dest, source, { true, false, false });
+    }
+
+    void rotate90(Surface& dest, const Surface& source)
+    {
+        transform(dest, source, { true, true, false });
+    }
+
+    void rotate180(Surface& dest, const Surface& source)
+    {
+        transform(dest, source, { false, true, true });
+    }
+
+    void rotate270(Surface& dest, const Surface& source)
+    {
+        transform(dest, source, { true, false, true });
+    }
+
+    void applyOrientation(Surface& dest, const Surface& source, int orientation)
+    {
+        static const Transform table[] =
+        {
+            { false, false, false }, // 1: normal
+            { false, true,  false }, // 2: mirror horizontal
+            { false, true,  true  }, // 3: rotate 180
+            { false, false, true  }, // 4: mirror vertical
+            { true,  false, false }, // 5: transpose
+            { true,  true,  false }, // 6: rotate 90 clockwise
+            { true,  true,  true  }, // 7: transverse
+            { true,  false, true  }, // 8: rotate 270 clockwise
+        };
+
+        if (orientation < 1 || orientation > 8)
+            orientation = 1;
+
+        transform(dest, source, table[orientation - 1]);
+    }
+
+    bool isOrientationTransposed(int orientation)
+    {
+        return orientation >= 5 && orientation <= 8;
+    }
+
+    // ----------------------------------------------------------------------------
+    // TiledBitmap
+    // ----------------------------------------------------------------------------
+
+    TiledBitmap::TiledBitmap(int _width, int _height, const Format& _format, TileLayout _layout, int _tileSize)
+        : width(_width)
+        , height(_height)
+        , format(_format)
+        , layout(_layout)
+    {
+        tileShift = u32_log2(std::max(1, _tileSize));
+        tileSize = 1 << tileShift;
+        xtiles = (width + tileSize - 1) >> tileShift;
+        ytiles = (height + tileSize - 1) >> tileShift;
+
+        const size_t bytes = (size_t(xtiles * ytiles) << (tileShift * 2)) * format.bytes();
+        image = new uint8[bytes];
+    }
+
+    TiledBitmap::TiledBitmap(TiledBitmap&& bitmap)
+        : tileShift(bitmap.tileShift)
+        , width(bitmap.width)
+        , height(bitmap.height)
+        , format(bitmap.format)
+        , layout(bitmap.layout)
+        , tileSize(bitmap.tileSize)
+        , xtiles(bitmap.xtiles)
+        , ytiles(bitmap.ytiles)
+        , image(bitmap.image)
+    {
+        bitmap.image = nullptr;
+    }
+
+    TiledBitmap::~TiledBitmap()
+    {
+        delete[] image;
+    }
+
+    Surface TiledBitmap::tile(int tx, int ty) const
+    {
+        const int x = tx << tileShift;
+        const int y = ty << tileShift;
+        const int w = std::min(tileSize, width - x);
+        const int h = std::min(tileSize, height - y);
+        return Surface(w, h, format, tileSize * format.bytes(), tileAddress(tx, ty));
+    }
+
+    void TiledBitmap::blit(const Surface& source)
+    {
+        const int w = std::min(width, source.width);
+        const int h = std::min(height, source.height);
+
+        if (w <= 0 || h <= 0)
+            return;
+
+        const int bytes = format.bytes();
+        const bool convert = source.format != format;
+        const MortonFunc scatter = getMortonScatter(bytes);
+
+        std::vector<uint32> xbits(tileSize);
+        std::vector<uint32> ybits(tileSize);
+
+        for (int i = 0; i < tileSize; ++i)
+        {
+            xbits[i] = u32_interleave_bits(i, 0);
+            ybits[i] = u32_interleave_bits(0, i);
+        }
+
+        ConcurrentQueue queue("tiled", Priority::HIGH);
+
+        for (int ty = 0; ty * tileSize < h; ++ty)
+        {
+            queue.enqueue([=, &source, &xbits, &ybits]
+            {
+                const int y0 = ty << tileShift;
+                const int ysize = std::min(tileSize, h - y0);
+
+                const uint8* src = source.address<uint8>(0, y0);
+                int srcStride = source.stride;
+
+                std::vector<uint8> temp;
+
+                if (convert)
+                {
+                    // convert one row of tiles at a time
+                    temp.resize(size_t(w) * bytes * ysize);
+
+                    BlitRect rect;
+                    rect.srcImage = const_cast<uint8*>(src);
+                    rect.srcStride = source.stride;
+                    rect.destImage = temp.data();
+                    rect.destStride = w * bytes;
+                    rect.width = w;
+                    rect.height = ysize;
+
+                    Blitter blitter(format, source.format);
+                    blitter.convert(rect);
+
+                    src = temp.data();
+                    srcStride = rect.destStride;
+                }
+
+                for (int tx = 0; tx * tileSize < w; ++tx)
+                {
+                    const int x0 = tx << tileShift;
+                    const int xsize = std::min(tileSize, w - x0);
+                    uint8* tile = tileAddress(tx, ty);
+
+                    for (int y = 0; y < ysize; ++y)
+                    {
+                        const uint8* s = src + y * srcStride + x0 * bytes;
+
+                        if (layout == TileLayout::MORTON)
+                            scatter(tile, s, xsize, ybits[y], xbits.data(), bytes);
+                        else
+                            std::memcpy(tile + (y << tileShift) * bytes, s, xsize * bytes);
+                    }
+                }
+            });
+        }
+
+        queue.wait();
+    }
+
+    void TiledBitmap::copy(Surface& dest) const
+    {
+        const int w = std::min(width, dest.width);
+        const int h = std::min(height, dest.height);
+
+        if (w <= 0 || h <= 0)
+            return;
+
+        const int bytes = format.bytes();
+        const bool convert = dest.format != format;
+        const MortonFunc gather = getMortonGather(bytes);
+
+        std::vector<uint32> xbits(tileSize);
+        std::vector<uint32> ybits(tileSize);
+
+        for (int i = 0; i < tileSize; ++i)
+        {
+            xbits[i] = u32_interleave_bits(i, 0);
+            ybits[i] = u32_interleave_bits(0, i);
+        }
+
+        ConcurrentQueue queue("tiled", Priority::HIGH);
+
+        for (int ty = 0; ty * tileSize < h; ++ty)
+        {
+            queue.enqueue([=, &dest, &xbits, &ybits]
+            {
+                const int y0 = ty << tileShift;
+                const int ysize = std::min(tileSize, h - y0);
+
+                uint8* dst = dest.address<uint8>(0, y0);
+                int dstStride = dest.stride;
+
+                std::vector<uint8> temp;
+
+                if (convert)
+                {
+                    temp.resize(size_t(w) * bytes * ysize);
+                    dst = temp.data();
+                    dstStride = w * bytes;
+                }
+
+                for (int tx = 0; tx * tileSize < w; ++tx)
+                {
+                    const int x0 = tx << tileShift;
+                    const int xsize = std::min(tileSize, w - x0);
+                    const uint8* tile = tileAddress(tx, ty);
+
+                    for (int y = 0; y < ysize; ++y)
+                    {
+                        uint8* d = dst + y * dstStride + x0 * bytes;
+
+                        if (layout == TileLayout::MORTON)
+                            gather(d, tile, xsize, ybits[y], xbits.data(), bytes);
+                        else
+                            std::memcpy(d, tile + (y << tileShift) * bytes, xsize * bytes);
+                    }
+                }
+
+                if (convert)
+                {
+                    // convert one row of tiles at a time
+                    BlitRect rect;
+                    rect.srcImage = temp.data();
+                    rect.srcStride = dstStride;
+                    rect.destImage = dest.address<uint8>(0, y0);
+                    rect.destStride = dest.stride;
+                    rect.width = w;
+                    rect.height = ysize;
+
+                    Blitter blitter(dest.format, format);
+                    blitter.convert(rect);
+                }
+            });
+        }
+
+        queue.wait();
+    }
+
 } // namespace mango
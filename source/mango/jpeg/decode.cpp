@@ -3,6 +3,9 @@
     Copyright (C) 2012-2018 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
 #include <cmath>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <mango/core/endian.hpp>
 #include <mango/core/cpuinfo.hpp>
 #include <mango/core/thread.hpp>
@@ -183,6 +186,8 @@ namespace jpeg
     Parser::Parser(Memory memory)
         : quantTableVector(64 * JPEG_MAX_COMPS_IN_SCAN)
         , blockVector(nullptr)
+        , blockStorage(nullptr)
+        , blockStorageSize(0)
     {
         // configure default implementation
         decodeState.zigzagTable = g_zigzag_table_variant;
@@ -196,8 +201,7 @@ namespace jpeg
         processState.process_YCbCr_16x8  = process_YCbCr_16x8;
         processState.process_YCbCr_16x16 = process_YCbCr_16x16;
 
-        restartInterval = 0;
-        restartCounter = 0;
+        multithread = true;
 
         uint64 cpuFlags = getCPUFlags();
 
@@ -226,8 +230,27 @@ namespace jpeg
             quantTable[i].table = &quantTableVector[i * 64];
         }
 
+        reset(memory);
+    }
+
+    Parser::~Parser()
+    {
+        aligned_free(blockStorage);
+    }
+
+    void Parser::reset(Memory memory)
+    {
+        // the block storage is retained so that a parser can be recycled without reallocation
+        blockVector = nullptr;
+        frames.clear();
+
+        restartInterval = 0;
+        restartCounter = 0;
+        is_buffered = false;
+
         exif_memory = Memory(nullptr, 0);
         icc_memory = Memory(nullptr, 0);
+        adobe_memory = Memory(nullptr, 0);
         scan_memory = Memory(nullptr, 0);
 
         m_surface = NULL;
@@ -237,6 +260,7 @@ namespace jpeg
         header.xblock = 0;
         header.yblock = 0;
         header.format = Format();
+        header.planes = 0;
 
         if (isJPEG(memory))
         {
@@ -244,11 +268,6 @@ namespace jpeg
         }
     }
 
-    Parser::~Parser()
-    {
-        aligned_free(blockVector);
-    }
-
     bool Parser::isJPEG(Memory memory) const
     {
         if (!memory.address || memory.size < 4)
@@ -455,6 +474,20 @@ namespace jpeg
 
                 break;
             }
+
+            case MARKER_APP14:
+            {
+                const uint8 magicAdobe[] = { 0x41, 0x64, 0x6f, 0x62, 0x65 }; // 'Adobe'
+
+                // the block is not interpreted but it is retained for the transcoder
+                if (size >= 12 && !std::memcmp(p, magicAdobe, 5))
+                {
+                    adobe_memory = Memory(p, size);
+                    jpegPrint("  Adobe: transform %d\n", p[11]);
+                }
+
+                break;
+            }
         }
     }
 
@@ -660,6 +693,15 @@ namespace jpeg
         header.xblock = xblock;
         header.yblock = yblock;
         header.format = comps > 1 ? Format(FORMAT_B8G8R8A8) : Format(FORMAT_L8);
+        header.planes = comps;
+
+        for (int i = 0; i < comps; ++i)
+        {
+            const int hsf = processState.frame[i].Hsf;
+            const int vsf = processState.frame[i].Vsf;
+            header.planeWidth[i] = (xsize + (1 << hsf) - 1) >> hsf;
+            header.planeHeight[i] = (ysize + (1 << vsf) - 1) >> vsf;
+        }
 
         MANGO_UNREFERENCED_PARAMETER(length);
     }
@@ -798,7 +840,11 @@ namespace jpeg
             else
             {
                 decodeState.decode = arith_decode_mcu;
-                decodeSequential();
+
+                if (is_buffered)
+                    decodeProgressive();
+                else
+                    decodeSequential();
             }
 #endif // MANGO_ENABLE_LICENSE_BSD
         }
@@ -847,10 +893,21 @@ namespace jpeg
             else
             {
                 decodeState.decode = huff_decode_mcu;
-                decodeSequential();
+
+                if (is_buffered)
+                    decodeProgressive();
+                else
+                    decodeSequential();
             }
         }
 
+        if (is_progressive && callback && !is_buffered)
+        {
+            // reconstruct the image from coefficients decoded so far
+            finishProgressive();
+            callback(Surface(*m_surface, 0, 0, xsize, ysize));
+        }
+
         // TODO: we should sync here since the decoder has prefetched more bytes that it could consume
         p = decodeState.buffer.ptr;
         p -= 8; // hack
@@ -1272,9 +1329,8 @@ namespace jpeg
             return status;
         }
 
-        // allocate blocks
-        int count = mcus * blocks_in_mcu * 64;
-        blockVector = reinterpret_cast<BlockType*>(aligned_malloc(count * sizeof(BlockType)));
+        // coefficients from previous decode are discarded; they are allocated on demand
+        blockVector = nullptr;
 
         // target surface size has to match (clipping isn't yet supported)
         if (target.width != xsize || target.height != ysize)
@@ -1294,7 +1350,7 @@ namespace jpeg
 
             parse(scan_memory, true);
 
-            if (is_progressive)
+            if (is_progressive && !callback)
 			{
 	            finishProgressive();
 			}
@@ -1306,7 +1362,7 @@ namespace jpeg
 
             parse(scan_memory, true);
 
-            if (is_progressive)
+            if (is_progressive && !callback)
 			{
 	            finishProgressive();
 			}
@@ -1319,10 +1375,179 @@ namespace jpeg
         return status;
     }
 
+    Status Parser::decode(Surface* planes, YCbCrLayout layout)
+    {
+        Status status;
+
+        status.success = false;
+        status.enableDirectDecode = true;
+
+        m_info = "";
+
+        if (!scan_memory.address)
+        {
+            return status;
+        }
+
+        // planar output is only supported for luminance and YCbCr images
+        if (header.planes != 1 && header.planes != 3)
+        {
+            status.info = "Planar decoding is not supported for this color space.";
+            return status;
+        }
+
+        // the MCU position is resolved from the luminance plane so it must not be subsampled
+        if (processState.frame[0].Hsf || processState.frame[0].Vsf)
+        {
+            status.info = "Planar decoding requires full resolution luminance.";
+            return status;
+        }
+
+        const bool interleaved = layout == YCbCrLayout::NV12 && header.planes == 3;
+
+        if (interleaved)
+        {
+            const Frame& cb = processState.frame[1];
+            const Frame& cr = processState.frame[2];
+
+            // NV12 is 4:2:0; the other layouts are decoded with YCbCrLayout::PLANAR
+            if (cb.Hsf != 1 || cb.Vsf != 1 || cr.Hsf != 1 || cr.Vsf != 1)
+            {
+                status.info = "NV12 decoding requires 4:2:0 chroma sampling.";
+                return status;
+            }
+        }
+
+        const int count = interleaved ? 2 : header.planes;
+
+        for (int i = 0; i < count; ++i)
+        {
+            const Surface& plane = planes[i];
+            const int bytes = interleaved && i == 1 ? 2 : 1;
+
+            if (plane.width != header.planeWidth[i] ||
+                plane.height != header.planeHeight[i] ||
+                plane.format.bytes() != bytes)
+            {
+                status.info = "Incompatible plane dimensions or format.";
+                return status;
+            }
+
+            processState.plane[i].image = plane.image;
+            processState.plane[i].stride = plane.stride;
+        }
+
+        blockVector = nullptr;
+
+        // the luminance plane is the decoding target, the processing function resolves the rest
+        ProcessFunc process = processState.process;
+        ProcessFunc clipped = processState.clipped;
+
+        processState.process = interleaved ? process_NV12 : process_planar;
+        processState.clipped = processState.process;
+
+        m_surface = &planes[0];
+
+        parse(scan_memory, true);
+
+        if (is_progressive && !callback)
+        {
+            finishProgressive();
+        }
+
+        processState.process = process;
+        processState.clipped = clipped;
+
+        status.success = true;
+        status.info = m_info;
+
+        return status;
+    }
+
+    Status Parser::decode(std::vector<ComponentCoefficients>& components)
+    {
+        Status status;
+
+        status.success = false;
+        status.enableDirectDecode = false;
+
+        m_info = "";
+
+        if (!scan_memory.address)
+        {
+            return status;
+        }
+
+        if (is_lossless || precision != 8)
+        {
+            status.info = "Only 8 bit DCT images have coefficients.";
+            return status;
+        }
+
+        blockVector = nullptr;
+
+        // sequential scans are decoded into the coefficient buffer like progressive scans
+        is_buffered = true;
+        parse(scan_memory, true);
+        is_buffered = false;
+
+        allocateBlocks();
+
+        const int count = processState.frames;
+        components.resize(count);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const Frame& frame = processState.frame[i];
+            const int first = frame.offset;
+            const int last = i + 1 < count ? processState.frame[i + 1].offset : processState.blocks;
+
+            ComponentCoefficients& component = components[i];
+
+            component.compid = frame.compid;
+            component.Hsf = processState.block[first].stride / 8;
+            component.Vsf = (last - first) / component.Hsf;
+            component.xblocks = xmcu * component.Hsf;
+            component.yblocks = ymcu * component.Vsf;
+
+            const uint16* qt = processState.block[first].qt->table;
+
+            for (int j = 0; j < 64; ++j)
+            {
+                component.qt[j] = qt[decodeState.zigzagTable[j]];
+            }
+
+            component.blocks.resize(size_t(component.xblocks) * component.yblocks * 64);
+
+            // gather the blocks from MCU order into component block grid
+            for (int y = 0; y < component.yblocks; ++y)
+            {
+                for (int x = 0; x < component.xblocks; ++x)
+                {
+                    const int mcu = (y / component.Vsf) * xmcu + x / component.Hsf;
+                    const int block = (y % component.Vsf) * component.Hsf + x % component.Hsf;
+
+                    const BlockType* source = blockVector + (mcu * blocks_in_mcu + first + block) * 64;
+                    BlockType* dest = component.blocks.data() + (y * component.xblocks + x) * 64;
+
+                    for (int j = 0; j < 64; ++j)
+                    {
+                        dest[j] = source[decodeState.zigzagTable[j]];
+                    }
+                }
+            }
+        }
+
+        status.success = true;
+        status.info = m_info;
+
+        return status;
+    }
+
     void Parser::decodeSequential()
     {
 #ifdef JPEG_ENABLE_THREAD
-        const int count = ThreadPool::getInstanceSize();
+        const int count = multithread ? ThreadPool::getInstanceSize() : 1;
 #else
         const int count = 1;
 #endif
@@ -1389,6 +1614,7 @@ namespace jpeg
 
         if (!restartInterval)
         {
+            allocateBlocks();
             BlockType* data = blockVector;
             const int mcu_data_size = blocks_in_mcu * 64;
 
@@ -1505,6 +1731,8 @@ namespace jpeg
 
     void Parser::decodeProgressive()
     {
+        allocateBlocks();
+
         const bool dc_scan = (decodeState.spectralStart == 0);
         BlockType* data = blockVector;
 
@@ -1566,10 +1794,34 @@ namespace jpeg
         }
     }
 
+    void Parser::allocateBlocks()
+    {
+        // Only progressive, buffered and multi-threaded decoding store the coefficients.
+        // Progressive and buffered scans may not cover every block so the storage is cleared
+        // for them; the sequential scans clear each block they decode.
+        if (!blockVector)
+        {
+            const size_t count = size_t(mcus) * blocks_in_mcu * 64;
+            if (count > blockStorageSize)
+            {
+                aligned_free(blockStorage);
+                blockStorage = reinterpret_cast<BlockType*>(aligned_malloc(count * sizeof(BlockType)));
+                blockStorageSize = count;
+            }
+
+            blockVector = blockStorage;
+
+            if (is_progressive || is_buffered)
+            {
+                std::memset(blockVector, 0, count * sizeof(BlockType));
+            }
+        }
+    }
+
     void Parser::finishProgressive()
     {
 #ifdef JPEG_ENABLE_THREAD
-        const int count = ThreadPool::getInstanceSize();
+        const int count = multithread ? ThreadPool::getInstanceSize() : 1;
 #else
         const int count = 1;
 #endif
@@ -1682,4 +1934,105 @@ namespace jpeg
         queue.wait();
     }
 
+    // ----------------------------------------------------------------------------
+    // DecodeBatch()
+    // ----------------------------------------------------------------------------
+
+    bool DecodeBatch(const std::vector<Memory>& inputs, const std::vector<Surface*>& outputs, mango::JPEGBatchCallback callback)
+    {
+        // images up to this size are not worth splitting; they are decoded one per task instead
+        const size_t threshold = 1024 * 1024;
+
+        const int count = int(std::min(inputs.size(), outputs.size()));
+
+        // parsers are recycled between the tasks so that the tables and coefficient storage
+        // are allocated once per thread instead of once per image
+        std::vector<std::unique_ptr<Parser>> pool;
+        std::vector<Parser*> available;
+        std::mutex mutex;
+
+        // the parser which reads the header is handed to the task that decodes the image, so
+        // the number of parsers is bounded by the images waiting in the queue
+        const size_t limit = size_t(ThreadPool::getInstanceSize()) * 2;
+
+        auto acquire = [&] () -> Parser*
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (available.empty())
+            {
+                if (pool.size() >= limit)
+                    return nullptr;
+
+                pool.emplace_back(new Parser(Memory()));
+                return pool.back().get();
+            }
+            Parser* parser = available.back();
+            available.pop_back();
+            return parser;
+        };
+
+        auto release = [&] (Parser* parser)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            available.push_back(parser);
+        };
+
+        std::atomic<bool> success { true };
+
+        auto decode = [&] (Parser* parser, int index)
+        {
+            Status status = parser->decode(*outputs[index]);
+            if (!status.success)
+            {
+                success = false;
+            }
+
+            if (callback)
+            {
+                callback(index, status.success);
+            }
+        };
+
+        ConcurrentQueue queue("jpeg.batch", Priority::HIGH);
+
+        // used on the calling thread when every pooled parser is waiting in the queue
+        std::unique_ptr<Parser> local(new Parser(Memory()));
+
+        // the headers are inspected on the calling thread, which also decodes the large
+        // images with the internal multi-threading while the small ones run in the queue
+        for (int index = 0; index < count; ++index)
+        {
+            Parser* pooled = acquire();
+            Parser* parser = pooled ? pooled : local.get();
+
+            parser->reset(inputs[index]);
+
+            const bool large = size_t(parser->header.width) * parser->header.height > threshold;
+
+            if (large || !pooled)
+            {
+                parser->multithread = large;
+                decode(parser, index);
+
+                if (pooled)
+                {
+                    release(pooled);
+                }
+            }
+            else
+            {
+                queue.enqueue([&, pooled, index]
+                {
+                    pooled->multithread = false;
+                    decode(pooled, index);
+                    release(pooled);
+                });
+            }
+        }
+
+        queue.wait();
+
+        return success;
+    }
+
 } // namespace jpeg
\ No newline at end of file
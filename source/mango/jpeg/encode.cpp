@@ -61,116 +61,66 @@ namespace
     };
     const int g_format_table_size = sizeof(g_format_table) / sizeof(g_format_table[0]);
 
-    const uint16 luminance_dc_code_table [] =
+    // Annex K.3 typical huffman tables
+
+    const uint8 luminance_dc_bits [] =
     {
-        0x0000, 0x0002, 0x0003, 0x0004, 0x0005, 0x0006,
-        0x000E, 0x001E, 0x003E, 0x007E, 0x00FE, 0x01FE
+        0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0
     };
 
-    const uint16 luminance_dc_size_table [] =
+    const uint8 luminance_dc_values [] =
     {
-        0x0002, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003,
-        0x0004, 0x0005, 0x0006, 0x0007, 0x0008, 0x0009
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b
     };
 
-    const uint16 chrominance_dc_code_table [] =
+    const uint8 chrominance_dc_bits [] =
     {
-        0x0000, 0x0001, 0x0002, 0x0006, 0x000E, 0x001E,
-        0x003E, 0x007E, 0x00FE, 0x01FE, 0x03FE, 0x07FE
+        0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0
     };
 
-    const uint16 chrominance_dc_size_table [] =
+    const uint8 chrominance_dc_values [] =
     {
-        0x0002, 0x0002, 0x0002, 0x0003, 0x0004, 0x0005,
-        0x0006, 0x0007, 0x0008, 0x0009, 0x000A, 0x000B
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b
     };
 
-    const uint16 luminance_ac_code_table [] =
+    const uint8 luminance_ac_bits [] =
     {
-        0x000A,
-        0x0000, 0x0001, 0x0004, 0x000B, 0x001A, 0x0078, 0x00F8, 0x03F6, 0xFF82, 0xFF83,
-        0x000C, 0x001B, 0x0079, 0x01F6, 0x07F6, 0xFF84, 0xFF85, 0xFF86, 0xFF87, 0xFF88,
-        0x001C, 0x00F9, 0x03F7, 0x0FF4, 0xFF89, 0xFF8A, 0xFF8b, 0xFF8C, 0xFF8D, 0xFF8E,
-        0x003A, 0x01F7, 0x0FF5, 0xFF8F, 0xFF90, 0xFF91, 0xFF92, 0xFF93, 0xFF94, 0xFF95,
-        0x003B, 0x03F8, 0xFF96, 0xFF97, 0xFF98, 0xFF99, 0xFF9A, 0xFF9B, 0xFF9C, 0xFF9D,
-        0x007A, 0x07F7, 0xFF9E, 0xFF9F, 0xFFA0, 0xFFA1, 0xFFA2, 0xFFA3, 0xFFA4, 0xFFA5,
-        0x007B, 0x0FF6, 0xFFA6, 0xFFA7, 0xFFA8, 0xFFA9, 0xFFAA, 0xFFAB, 0xFFAC, 0xFFAD,
-        0x00FA, 0x0FF7, 0xFFAE, 0xFFAF, 0xFFB0, 0xFFB1, 0xFFB2, 0xFFB3, 0xFFB4, 0xFFB5,
-        0x01F8, 0x7FC0, 0xFFB6, 0xFFB7, 0xFFB8, 0xFFB9, 0xFFBA, 0xFFBB, 0xFFBC, 0xFFBD,
-        0x01F9, 0xFFBE, 0xFFBF, 0xFFC0, 0xFFC1, 0xFFC2, 0xFFC3, 0xFFC4, 0xFFC5, 0xFFC6,
-        0x01FA, 0xFFC7, 0xFFC8, 0xFFC9, 0xFFCA, 0xFFCB, 0xFFCC, 0xFFCD, 0xFFCE, 0xFFCF,
-        0x03F9, 0xFFD0, 0xFFD1, 0xFFD2, 0xFFD3, 0xFFD4, 0xFFD5, 0xFFD6, 0xFFD7, 0xFFD8,
-        0x03FA, 0xFFD9, 0xFFDA, 0xFFDB, 0xFFDC, 0xFFDD, 0xFFDE, 0xFFDF, 0xFFE0, 0xFFE1,
-        0x07F8, 0xFFE2, 0xFFE3, 0xFFE4, 0xFFE5, 0xFFE6, 0xFFE7, 0xFFE8, 0xFFE9, 0xFFEA,
-        0xFFEB, 0xFFEC, 0xFFED, 0xFFEE, 0xFFEF, 0xFFF0, 0xFFF1, 0xFFF2, 0xFFF3, 0xFFF4,
-        0xFFF5, 0xFFF6, 0xFFF7, 0xFFF8, 0xFFF9, 0xFFFA, 0xFFFB, 0xFFFC, 0xFFFD, 0xFFFE,
-        0x07F9
+        0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 125
     };
 
-    const uint16 luminance_ac_size_table [] =
+    const uint8 luminance_ac_values [] =
     {
-        0x0004,
-        0x0002, 0x0002, 0x0003, 0x0004, 0x0005, 0x0007, 0x0008, 0x000A, 0x0010, 0x0010,
-        0x0004, 0x0005, 0x0007, 0x0009, 0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0005, 0x0008, 0x000A, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0006, 0x0009, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0006, 0x000A, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0007, 0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0007, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0008, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x000F, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000A, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000A, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000B
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
     };
 
-    const uint16 chrominance_ac_code_table [] =
+    const uint8 chrominance_ac_bits [] =
     {
-        0x0000,
-        0x0001, 0x0004, 0x000A, 0x0018, 0x0019, 0x0038, 0x0078, 0x01F4, 0x03F6, 0x0FF4,
-        0x000B, 0x0039, 0x00F6, 0x01F5, 0x07F6, 0x0FF5, 0xFF88, 0xFF89, 0xFF8A, 0xFF8B,
-        0x001A, 0x00F7, 0x03F7, 0x0FF6, 0x7FC2, 0xFF8C, 0xFF8D, 0xFF8E, 0xFF8F, 0xFF90,
-        0x001B, 0x00F8, 0x03F8, 0x0FF7, 0xFF91, 0xFF92, 0xFF93, 0xFF94, 0xFF95, 0xFF96,
-        0x003A, 0x01F6, 0xFF97, 0xFF98, 0xFF99, 0xFF9A, 0xFF9B, 0xFF9C, 0xFF9D, 0xFF9E,
-        0x003B, 0x03F9, 0xFF9F, 0xFFA0, 0xFFA1, 0xFFA2, 0xFFA3, 0xFFA4, 0xFFA5, 0xFFA6,
-        0x0079, 0x07F7, 0xFFA7, 0xFFA8, 0xFFA9, 0xFFAA, 0xFFAB, 0xFFAC, 0xFFAD, 0xFFAE,
-        0x007A, 0x07F8, 0xFFAF, 0xFFB0, 0xFFB1, 0xFFB2, 0xFFB3, 0xFFB4, 0xFFB5, 0xFFB6,
-        0x00F9, 0xFFB7, 0xFFB8, 0xFFB9, 0xFFBA, 0xFFBB, 0xFFBC, 0xFFBD, 0xFFBE, 0xFFBF,
-        0x01F7, 0xFFC0, 0xFFC1, 0xFFC2, 0xFFC3, 0xFFC4, 0xFFC5, 0xFFC6, 0xFFC7, 0xFFC8,
-        0x01F8, 0xFFC9, 0xFFCA, 0xFFCB, 0xFFCC, 0xFFCD, 0xFFCE, 0xFFCF, 0xFFD0, 0xFFD1,
-        0x01F9, 0xFFD2, 0xFFD3, 0xFFD4, 0xFFD5, 0xFFD6, 0xFFD7, 0xFFD8, 0xFFD9, 0xFFDA,
-        0x01FA, 0xFFDB, 0xFFDC, 0xFFDD, 0xFFDE, 0xFFDF, 0xFFE0, 0xFFE1, 0xFFE2, 0xFFE3,
-        0x07F9, 0xFFE4, 0xFFE5, 0xFFE6, 0xFFE7, 0xFFE8, 0xFFE9, 0xFFEA, 0xFFEb, 0xFFEC,
-        0x3FE0, 0xFFED, 0xFFEE, 0xFFEF, 0xFFF0, 0xFFF1, 0xFFF2, 0xFFF3, 0xFFF4, 0xFFF5,
-        0x7FC3, 0xFFF6, 0xFFF7, 0xFFF8, 0xFFF9, 0xFFFA, 0xFFFB, 0xFFFC, 0xFFFD, 0xFFFE,
-        0x03FA
+        0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 119
     };
 
-    const uint16 chrominance_ac_size_table [] =
+    const uint8 chrominance_ac_values [] =
     {
-        0x0002,
-        0x0002, 0x0003, 0x0004, 0x0005, 0x0005, 0x0006, 0x0007, 0x0009, 0x000A, 0x000C,
-        0x0004, 0x0006, 0x0008, 0x0009, 0x000B, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0005, 0x0008, 0x000A, 0x000C, 0x000F, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0005, 0x0008, 0x000A, 0x000C, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0006, 0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0006, 0x000A, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0007, 0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0007, 0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0008, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x0009, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000B, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000E, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000F, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010,
-        0x000A
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+        0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+        0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
     };
 
     const uint8 bit_size [] =
@@ -193,24 +143,6 @@ namespace
         8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8
     };
 
-    const uint8 marker_data [] =
-    {
-        0xFF, 0xC4, 0x00, 0x1F, 0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
-        0xFF, 0xC4, 0x00, 0xB5, 0x10, 0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7D, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
-		0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25,
-		0x26, 0x27, 0x28, 0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67,
-		0x68, 0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6,
-		0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
-		0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
-        0xFF, 0xC4, 0x00, 0x1F, 0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B,
-        0xFF, 0xC4, 0x00, 0xB5, 0x11, 0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77, 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
-		0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0, 0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18,
-		0x19, 0x1A, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66,
-		0x67, 0x68, 0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4,
-		0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
-		0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
-    };
-
     const uint8 zigzag_table [] =
     {
         0,  1,   5,  6, 14, 15, 27, 28,
@@ -247,63 +179,331 @@ namespace
         99, 99, 99, 99, 99, 99, 99, 99
     };
 
-    struct jpeg_chan
+    // ----------------------------------------------------------------------------
+    // HuffmanTable
+    // ----------------------------------------------------------------------------
+
+    struct HuffmanTable
     {
-        int         component;
-        uint16*     qtable;
+        uint8   bits[17];     // number of codes of each length (index 0 is not used)
+        uint8   values[256];  // symbols in order of increasing code length
+        uint16  code[256];    // code for each symbol
+        uint8   size[256];    // code length for each symbol
+
+        void configure(const uint8* bits, const uint8* values);
+        void optimize(const uint32* frequency);
+        void write(BigEndianStream& p, int Tc, int Th) const;
     };
 
-    struct jpeg_encode
+    void HuffmanTable::configure(const uint8* codeBits, const uint8* codeValues)
     {
-        int         mcu_width;
-        int         mcu_height;
-        int         horizontal_mcus;
-        int         vertical_mcus;
-        int         cols_in_right_mcus;
-        int         rows_in_bottom_mcus;
+        int count = 0;
 
-        int         length_minus_mcu_width;
-        int         length_minus_width;
-        int         mcu_width_size;
+        bits[0] = 0;
+        for (int i = 1; i <= 16; ++i)
+        {
+            bits[i] = codeBits[i - 1];
+            count += bits[i];
+        }
 
-        uint8       Lqt [BLOCK_SIZE];
-        uint8       Cqt [BLOCK_SIZE];
-        uint16      ILqt [BLOCK_SIZE];
-        uint16      ICqt [BLOCK_SIZE];
+        std::memmove(values, codeValues, count);
+        std::memset(code, 0, sizeof(code));
+        std::memset(size, 0, sizeof(size));
 
-        // MCU configuration
-        jpeg_chan   channel[3];
-        int         channel_count;
+        // Annex C: generate the codes in order of increasing code length
+        uint32 current = 0;
+        int p = 0;
 
-        void (*read_format) (jpeg_encode* jp, BlockType *block, uint8* input, int rows, int cols, int incr);
+        for (int length = 1; length <= 16; ++length)
+        {
+            for (int i = 0; i < bits[length]; ++i)
+            {
+                const int symbol = values[p++];
+                code[symbol] = uint16(current++);
+                size[symbol] = uint8(length);
+            }
 
-        jpeg_encode(uint32 format, uint32 width, uint32 height, uint32 stride, uint32 quality);
-        ~jpeg_encode();
+            current <<= 1;
+        }
+    }
 
-        void init_quantization_tables(uint32 quality);
-        void write_markers(BigEndianStream& p, uint32 format, uint32 width, uint32 height);
+    void HuffmanTable::optimize(const uint32* frequency)
+    {
+        // Annex K.2: generate optimal code lengths from symbol frequencies
+
+        bool empty = true;
+
+        for (int i = 0; i < 256; ++i)
+        {
+            if (frequency[i])
+            {
+                empty = false;
+                break;
+            }
+        }
+
+        if (empty)
+        {
+            // the table is not used by the scan; it has no codes
+            const uint8 zero[16] = { 0 };
+            configure(zero, values);
+            return;
+        }
+
+        uint64 freq[257];
+        int codesize[257];
+        int others[257];
+        int count[258];
+
+        for (int i = 0; i < 256; ++i)
+        {
+            freq[i] = frequency[i];
+        }
+
+        // reserve one code point so that no code is all one bits
+        freq[256] = 1;
+
+        for (int i = 0; i < 257; ++i)
+        {
+            codesize[i] = 0;
+            others[i] = -1;
+            count[i] = 0;
+        }
+
+        count[257] = 0;
+
+        for ( ; ; )
+        {
+            // find the smallest nonzero frequency; ties are broken by the largest symbol
+            int c1 = -1;
+            uint64 v = ~uint64(0);
+
+            for (int i = 0; i < 257; ++i)
+            {
+                if (freq[i] && freq[i] <= v)
+                {
+                    v = freq[i];
+                    c1 = i;
+                }
+            }
+
+            // find the next smallest nonzero frequency
+            int c2 = -1;
+            v = ~uint64(0);
+
+            for (int i = 0; i < 257; ++i)
+            {
+                if (freq[i] && freq[i] <= v && i != c1)
+                {
+                    v = freq[i];
+                    c2 = i;
+                }
+            }
+
+            // done when only one tree is left
+            if (c2 < 0)
+                break;
+
+            // merge the two trees
+            freq[c1] += freq[c2];
+            freq[c2] = 0;
+
+            ++codesize[c1];
+            while (others[c1] >= 0)
+            {
+                c1 = others[c1];
+                ++codesize[c1];
+            }
+
+            others[c1] = c2;
+
+            ++codesize[c2];
+            while (others[c2] >= 0)
+            {
+                c2 = others[c2];
+                ++codesize[c2];
+            }
+        }
+
+        for (int i = 0; i < 257; ++i)
+        {
+            if (codesize[i])
+            {
+                ++count[codesize[i]];
+            }
+        }
+
+        // Figure K.3: limit the code lengths to 16 bits
+        for (int i = 257; i > 16; --i)
+        {
+            while (count[i] > 0)
+            {
+                int j = i - 2;
+                while (!count[j])
+                {
+                    --j;
+                }
+
+                count[i] -= 2;
+                count[i - 1] += 1;
+                count[j + 1] += 2;
+                count[j] -= 1;
+            }
+        }
+
+        // remove the reserved code point from the longest code length
+        int last = 16;
+        while (!count[last])
+        {
+            --last;
+        }
+
+        --count[last];
+
+        bits[0] = 0;
+        for (int i = 1; i <= 16; ++i)
+        {
+            bits[i] = uint8(count[i]);
+        }
+
+        // Figure K.4: sort symbols by code length
+        int p = 0;
+
+        for (int length = 1; length <= 256; ++length)
+        {
+            for (int symbol = 0; symbol < 256; ++symbol)
+            {
+                if (codesize[symbol] == length)
+                {
+                    values[p++] = uint8(symbol);
+                }
+            }
+        }
+
+        configure(bits + 1, values);
+    }
+
+    void HuffmanTable::write(BigEndianStream& p, int Tc, int Th) const
+    {
+        int count = 0;
+
+        for (int i = 1; i <= 16; ++i)
+        {
+            count += bits[i];
+        }
+
+        // Define Huffman Table marker
+        p.write16(0xffc4);
+        p.write16(uint16(3 + 16 + count)); // length
+        p.write8(uint8((Tc << 4) | Th)); // Tc, Th
+        p.write(bits + 1, 16);
+        p.write(values, count);
+    }
+
+    struct HuffmanStatistics
+    {
+        uint32 frequency[2][2][256]; // [class][table][symbol]
+
+        HuffmanStatistics()
+        {
+            std::memset(frequency, 0, sizeof(frequency));
+        }
+
+        void merge(const HuffmanStatistics& statistics)
+        {
+            for (int i = 0; i < 2 * 2 * 256; ++i)
+            {
+                (&frequency[0][0][0])[i] += (&statistics.frequency[0][0][0])[i];
+            }
+        }
     };
 
-    struct HuffmanEncoder
+    // ----------------------------------------------------------------------------
+    // Scan
+    // ----------------------------------------------------------------------------
+
+    struct Scan
+    {
+        int components;    // number of components in the scan
+        int component[3];  // component indices
+        int Ss;            // spectral selection start
+        int Se;            // spectral selection end
+        int Ah;            // successive approximation bit position high
+        int Al;            // successive approximation bit position low
+
+        bool isDC() const
+        {
+            return Ss == 0 && Ah == 0;
+        }
+
+        bool isAC() const
+        {
+            return Se > 0;
+        }
+    };
+
+    // baseline scan
+    const Scan g_scan_sequential_400 [] =
+    {
+        { 1, { 0 }, 0, 63, 0, 0 },
+    };
+
+    const Scan g_scan_sequential_444 [] =
+    {
+        { 3, { 0, 1, 2 }, 0, 63, 0, 0 },
+    };
+
+    // progressive scans; spectral selection and successive approximation
+    const Scan g_scan_progressive_400 [] =
+    {
+        { 1, { 0 },        0,  0, 0, 1 },
+        { 1, { 0 },        1,  5, 0, 2 },
+        { 1, { 0 },        6, 63, 0, 2 },
+        { 1, { 0 },        1, 63, 2, 1 },
+        { 1, { 0 },        0,  0, 1, 0 },
+        { 1, { 0 },        1, 63, 1, 0 },
+    };
+
+    const Scan g_scan_progressive_444 [] =
     {
-        int     ldc1;
-        int     ldc2;
-        int     ldc3;
+        { 3, { 0, 1, 2 },  0,  0, 0, 1 },
+        { 1, { 0 },        1,  5, 0, 2 },
+        { 1, { 2 },        1, 63, 0, 1 },
+        { 1, { 1 },        1, 63, 0, 1 },
+        { 1, { 0 },        6, 63, 0, 2 },
+        { 1, { 0 },        1, 63, 2, 1 },
+        { 3, { 0, 1, 2 },  0,  0, 1, 0 },
+        { 1, { 2 },        1, 63, 1, 0 },
+        { 1, { 1 },        1, 63, 1, 0 },
+        { 1, { 0 },        1, 63, 1, 0 },
+    };
+
+    // ----------------------------------------------------------------------------
+    // HuffmanEncoder
+    // ----------------------------------------------------------------------------
 
+    struct HuffmanEncoder
+    {
 #if defined(MANGO_CPU_64BIT)
         uint64  lcode;
 #else
         uint32  lcode;
 #endif
         int     bitindex;
+        u8*     ptr;
 
-        HuffmanEncoder()
+        const HuffmanTable* table[2][2]; // [class][table]
+
+        HuffmanEncoder(u8* output, const HuffmanTable (&tables)[2][2])
         {
-            ldc1 = 0;
-            ldc2 = 0;
-            ldc3 = 0;
             lcode = 0;
             bitindex = 0;
+            ptr = output;
+
+            table[0][0] = &tables[0][0];
+            table[0][1] = &tables[0][1];
+            table[1][0] = &tables[1][0];
+            table[1][1] = &tables[1][1];
         }
 
         ~HuffmanEncoder()
@@ -389,123 +589,392 @@ namespace
             return p;
         }
 
-        u8* encode(u8* p, int component, BlockType* temp)
+        void symbol(int Tc, int Th, int symbol, uint32 data, int numbits)
+        {
+            const HuffmanTable& h = *table[Tc][Th];
+            ptr = putbits(ptr, (uint32(h.code[symbol]) << numbits) | data, h.size[symbol] + numbits);
+        }
+
+        void bits(uint32 data, int numbits)
+        {
+            ptr = putbits(ptr, data, numbits);
+        }
+
+        void flush()
         {
-            const uint16* DcCodeTable;
-            const uint16* DcSizeTable;
-            const uint16* AcCodeTable;
-            const uint16* AcSizeTable;
+            ptr = flush(ptr);
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // SymbolCounter
+    // ----------------------------------------------------------------------------
+
+    struct SymbolCounter
+    {
+        HuffmanStatistics statistics;
+
+        void symbol(int Tc, int Th, int symbol, uint32 data, int numbits)
+        {
+            MANGO_UNREFERENCED_PARAMETER(data);
+            MANGO_UNREFERENCED_PARAMETER(numbits);
+            ++statistics.frequency[Tc][Th][symbol];
+        }
+
+        void bits(uint32 data, int numbits)
+        {
+            MANGO_UNREFERENCED_PARAMETER(data);
+            MANGO_UNREFERENCED_PARAMETER(numbits);
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // ScanEncoder
+    // ----------------------------------------------------------------------------
+
+    inline int getBitSize(int value)
+    {
+        return (value >> 8) ? bit_size[value >> 8] + 8 : bit_size[value];
+    }
+
+    // The ScanEncoder generates the entropy coded symbols for one restart interval
+    // of a scan. The Coder either writes the bitstream or gathers symbol statistics.
+
+    template <typename Coder>
+    struct ScanEncoder
+    {
+        // maximum number of buffered correction bits; same as in the IJG encoder
+        static constexpr int MAX_CORRECTION_BITS = 1000;
+
+        Coder& coder;
+        const Scan& scan;
 
-            int Coeff = *temp++;
-            int LastDc;
+        int last_dc_value[3];
+        int eobrun;
+        int eobrun_table;
+        int correction_count;
+        uint8 correction[MAX_CORRECTION_BITS];
 
-            if (component == 1)
+        ScanEncoder(Coder& coder, const Scan& scan)
+            : coder(coder)
+            , scan(scan)
+        {
+            last_dc_value[0] = 0;
+            last_dc_value[1] = 0;
+            last_dc_value[2] = 0;
+            eobrun = 0;
+            eobrun_table = 0;
+            correction_count = 0;
+        }
+
+        void encodeDifference(int Tc, int Th, int value)
+        {
+            int absValue = value;
+            if (value < 0)
             {
-                DcCodeTable = luminance_dc_code_table;
-                DcSizeTable = luminance_dc_size_table;
-                AcCodeTable = luminance_ac_code_table;
-                AcSizeTable = luminance_ac_size_table;
+                absValue = -value;
+                --value;
+            }
+
+            const int size = getBitSize(absValue);
+            const uint32 data = value & ((1 << size) - 1);
+            coder.symbol(Tc, Th, size, data, size);
+        }
 
-                LastDc = ldc1;
-                ldc1 = Coeff;
+        void emitCorrectionBits(const uint8* bits, int count)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                coder.bits(bits[i], 1);
             }
-            else
+        }
+
+        void emitEOBRun()
+        {
+            if (eobrun > 0)
             {
-                DcCodeTable = chrominance_dc_code_table;
-                DcSizeTable = chrominance_dc_size_table;
-                AcCodeTable = chrominance_ac_code_table;
-                AcSizeTable = chrominance_ac_size_table;
+                const int size = getBitSize(eobrun) - 1;
+                const uint32 data = eobrun & ((1 << size) - 1);
+                coder.symbol(1, eobrun_table, size << 4, data, size);
+                eobrun = 0;
+
+                emitCorrectionBits(correction, correction_count);
+                correction_count = 0;
+            }
+        }
 
-                if (component == 2)
+        void encodeSequential(int component, const BlockType* block)
+        {
+            const int Th = component ? 1 : 0;
+
+            // DC
+            const int dc = block[0];
+            encodeDifference(0, Th, dc - last_dc_value[component]);
+            last_dc_value[component] = dc;
+
+            // AC
+            int run = 0;
+
+            for (int i = 1; i < 64; ++i)
+            {
+                int coeff = block[i];
+                if (coeff)
                 {
-                    LastDc = ldc2;
-                    ldc2 = Coeff;
+                    while (run > 15)
+                    {
+                        coder.symbol(1, Th, 0xf0, 0, 0);
+                        run -= 16;
+                    }
+
+                    int absCoeff = coeff;
+                    if (coeff < 0)
+                    {
+                        absCoeff = -coeff;
+                        --coeff;
+                    }
+
+                    const int size = getBitSize(absCoeff);
+                    const uint32 data = coeff & ((1 << size) - 1);
+                    coder.symbol(1, Th, (run << 4) | size, data, size);
+
+                    run = 0;
                 }
                 else
                 {
-                    LastDc = ldc3;
-                    ldc3 = Coeff;
+                    ++run;
                 }
             }
 
-            Coeff -= LastDc;
-            int AbsCoeff = (Coeff < 0) ? -Coeff-- : Coeff;
-
-            int DataSize = 0;
-
-            while (AbsCoeff != 0)
+            if (run)
             {
-                AbsCoeff >>= 1;
-                DataSize++;
+                // EOB
+                coder.symbol(1, Th, 0x00, 0, 0);
             }
+        }
+
+        void encodeFirstDC(int component, const BlockType* block)
+        {
+            const int Th = component ? 1 : 0;
 
-            uint16 HuffCode = DcCodeTable [DataSize];
-            uint16 HuffSize = DcSizeTable [DataSize];
+            // arithmetic shift right with sign extension
+            const int dc = block[0] >> scan.Al;
+            encodeDifference(0, Th, dc - last_dc_value[component]);
+            last_dc_value[component] = dc;
+        }
 
-            Coeff &= (1 << DataSize) - 1;
+        void encodeRefineDC(const BlockType* block)
+        {
+            coder.bits((block[0] >> scan.Al) & 1, 1);
+        }
 
-            uint32 data = (HuffCode << DataSize) | Coeff;
-            int numbits = HuffSize + DataSize;
-            p = putbits(p, data, numbits);
+        void encodeFirstAC(int component, const BlockType* block)
+        {
+            eobrun_table = component ? 1 : 0;
 
-            int RunLength = 0;
+            int run = 0;
 
-            for (int i = 0; i < 63; ++i)
+            for (int k = scan.Ss; k <= scan.Se; ++k)
             {
-                BlockType Coeff = *temp++;
-                if (Coeff)
+                int coeff = block[k];
+                if (!coeff)
                 {
-                    while (RunLength > 15)
-                    {
-                        RunLength -= 16;
+                    ++run;
+                    continue;
+                }
 
-                        data = AcCodeTable [161];
-                        numbits = AcSizeTable [161];
-                        p = putbits(p, data, numbits);
-                    }
+                int value;
+                if (coeff < 0)
+                {
+                    coeff = (-coeff) >> scan.Al;
+                    value = ~coeff;
+                }
+                else
+                {
+                    coeff >>= scan.Al;
+                    value = coeff;
+                }
 
-                    AbsCoeff = (Coeff < 0) ? -Coeff-- : Coeff;
-                    if (AbsCoeff >> 8 == 0)
-                        DataSize = bit_size [AbsCoeff];
-                    else
-                        DataSize = bit_size [AbsCoeff >> 8] + 8;
+                if (!coeff)
+                {
+                    ++run;
+                    continue;
+                }
 
-                    int index = RunLength * 10 + DataSize;
-                    HuffCode = AcCodeTable [index];
-                    HuffSize = AcSizeTable [index];
+                emitEOBRun();
 
-                    Coeff &= (1 << DataSize) - 1;
+                while (run > 15)
+                {
+                    coder.symbol(1, eobrun_table, 0xf0, 0, 0);
+                    run -= 16;
+                }
 
-                    data = (HuffCode << DataSize) | Coeff;
-                    numbits = HuffSize + DataSize;
-                    p = putbits(p, data, numbits);
+                const int size = getBitSize(coeff);
+                const uint32 data = value & ((1 << size) - 1);
+                coder.symbol(1, eobrun_table, (run << 4) | size, data, size);
 
-                    RunLength = 0;
-                }
-                else
+                run = 0;
+            }
+
+            if (run > 0)
+            {
+                if (++eobrun == 0x7fff)
                 {
-                    ++RunLength;
+                    emitEOBRun();
                 }
             }
+        }
 
-            if (RunLength != 0)
+        void encodeRefineAC(int component, const BlockType* block)
+        {
+            eobrun_table = component ? 1 : 0;
+
+            int absvalues[64];
+            int eob = 0;
+
+            // absolute values of the coefficients at this bit position
+            for (int k = scan.Ss; k <= scan.Se; ++k)
             {
-                data = AcCodeTable [0];
-                numbits = AcSizeTable [0];
-                p = putbits(p, data, numbits);
+                int value = block[k];
+                value = (value < 0 ? -value : value) >> scan.Al;
+                absvalues[k] = value;
+
+                if (value == 1)
+                {
+                    // index of the last newly-nonzero coefficient
+                    eob = k;
+                }
             }
 
-            return p;
-        }
-    };
+            int run = 0;
+            int count = 0; // correction bits buffered for this block
+            uint8* buffer = correction + correction_count;
 
-    void fdct(BlockType* dest, BlockType* data, const uint16* quant_table)
-    {
-        const uint16 c1 = 1420;  // cos  PI/16 * root(2)
-        const uint16 c2 = 1338;  // cos  PI/8  * root(2)
-        const uint16 c3 = 1204;  // cos 3PI/16 * root(2)
-        const uint16 c5 = 805;   // cos 5PI/16 * root(2)
-        const uint16 c6 = 554;   // cos 3PI/8  * root(2)
+            for (int k = scan.Ss; k <= scan.Se; ++k)
+            {
+                int value = absvalues[k];
+                if (!value)
+                {
+                    ++run;
+                    continue;
+                }
+
+                // emit any required ZRLs, but not if they can be folded into EOB
+                while (run > 15 && k <= eob)
+                {
+                    emitEOBRun();
+                    coder.symbol(1, eobrun_table, 0xf0, 0, 0);
+                    run -= 16;
+
+                    emitCorrectionBits(buffer, count);
+                    buffer = correction;
+                    count = 0;
+                }
+
+                if (value > 1)
+                {
+                    // coefficient was previously nonzero: buffer the correction bit
+                    buffer[count++] = uint8(value & 1);
+                    continue;
+                }
+
+                // coefficient becomes nonzero in this scan
+                emitEOBRun();
+
+                coder.symbol(1, eobrun_table, (run << 4) | 1, block[k] < 0 ? 0 : 1, 1);
+
+                emitCorrectionBits(buffer, count);
+                buffer = correction;
+                count = 0;
+                run = 0;
+            }
+
+            if (run > 0 || count > 0)
+            {
+                ++eobrun;
+                correction_count += count;
+
+                // force out the EOB run before the counter or the correction buffer overflows
+                if (eobrun == 0x7fff || correction_count > MAX_CORRECTION_BITS - 64 + 1)
+                {
+                    emitEOBRun();
+                }
+            }
+        }
+
+        void encode(int component, const BlockType* block)
+        {
+            if (!scan.Ss && scan.Se)
+            {
+                encodeSequential(component, block);
+            }
+            else if (!scan.Ss)
+            {
+                if (!scan.Ah)
+                    encodeFirstDC(component, block);
+                else
+                    encodeRefineDC(block);
+            }
+            else
+            {
+                if (!scan.Ah)
+                    encodeFirstAC(component, block);
+                else
+                    encodeRefineAC(component, block);
+            }
+        }
+
+        void finish()
+        {
+            emitEOBRun();
+        }
+    };
+
+    // ----------------------------------------------------------------------------
+    // jpeg_encode
+    // ----------------------------------------------------------------------------
+
+    struct jpeg_encode
+    {
+        int         mcu_width;
+        int         mcu_height;
+        int         horizontal_mcus;
+        int         vertical_mcus;
+        int         cols_in_right_mcus;
+        int         rows_in_bottom_mcus;
+
+        int         length_minus_mcu_width;
+        int         length_minus_width;
+        int         mcu_width_size;
+
+        uint8       Lqt [BLOCK_SIZE];
+        uint8       Cqt [BLOCK_SIZE];
+        uint16      ILqt [BLOCK_SIZE];
+        uint16      ICqt [BLOCK_SIZE];
+
+        // MCU configuration
+        uint16*     qtable[3];
+        int         channel_count;
+
+        // huffman tables: [class][table]
+        HuffmanTable huffman[2][2];
+
+        void (*read_format) (jpeg_encode* jp, BlockType *block, uint8* input, int rows, int cols, int incr);
+
+        jpeg_encode(uint32 format, uint32 width, uint32 height, uint32 stride, uint32 quality);
+        ~jpeg_encode();
+
+        void init_quantization_tables(uint32 quality);
+        void write_markers(BigEndianStream& p, uint32 width, uint32 height, bool progressive);
+        void write_scan(BigEndianStream& p, const Scan& scan);
+    };
+
+    void fdct(BlockType* dest, BlockType* data, const uint16* quant_table)
+    {
+        const uint16 c1 = 1420;  // cos  PI/16 * root(2)
+        const uint16 c2 = 1338;  // cos  PI/8  * root(2)
+        const uint16 c3 = 1204;  // cos 3PI/16 * root(2)
+        const uint16 c5 = 805;   // cos 5PI/16 * root(2)
+        const uint16 c6 = 554;   // cos 3PI/8  * root(2)
         const uint16 c7 = 283;   // cos 7PI/16 * root(2)
 
         for (int i = 0; i < 8; ++i)
@@ -788,14 +1257,9 @@ namespace
 
         channel_count = 0;
 
-        channel[0].component = 1;
-        channel[0].qtable = ILqt;
-
-        channel[1].component = 2;
-        channel[1].qtable = ICqt;
-
-        channel[2].component = 3;
-        channel[2].qtable = ICqt;
+        qtable[0] = ILqt;
+        qtable[1] = ICqt;
+        qtable[2] = ICqt;
 
         switch (format)
         {
@@ -845,6 +1309,12 @@ namespace
         mcu_width_size = mcu_width * bytes_per_pixel;
 
         init_quantization_tables(quality);
+
+        // default huffman tables
+        huffman[0][0].configure(luminance_dc_bits, luminance_dc_values);
+        huffman[0][1].configure(chrominance_dc_bits, chrominance_dc_values);
+        huffman[1][0].configure(luminance_ac_bits, luminance_ac_values);
+        huffman[1][1].configure(chrominance_ac_bits, chrominance_ac_values);
     }
 
     jpeg_encode::~jpeg_encode()
@@ -886,7 +1356,7 @@ namespace
         }
     }
 
-    void jpeg_encode::write_markers(BigEndianStream& p, uint32 format, uint32 width, uint32 height)
+    void jpeg_encode::write_markers(BigEndianStream& p, uint32 width, uint32 height, bool progressive)
     {
         // Start of image marker
         p.write16(0xffd8);
@@ -908,23 +1378,9 @@ namespace
         p.write(Cqt, 64);
 
         // Start of frame marker
-        p.write16(0xffc0);
-
-        uint8 number_of_components = 0;
-
-        switch (format)
-        {
-            case JPEG_FORMAT_YUV400:
-                number_of_components = 1;
-                break;
-
-            case JPEG_FORMAT_BGR888:
-            case JPEG_FORMAT_BGRA8888:
-            case JPEG_FORMAT_RGBA8888:
-                number_of_components = 3;
-                break;
-        }
+        p.write16(progressive ? 0xffc2 : 0xffc0);
 
+        uint8 number_of_components = uint8(channel_count);
         uint16 header_length = 8 + 3 * number_of_components;
 
         p.write16(header_length); // frame header length
@@ -935,55 +1391,93 @@ namespace
 
         const uint8 nfdata[] =
         {
-            0x01, 0x11, 0x00, // component 1
-            0x00, 0x00, 0x00, // padding
             0x01, 0x11, 0x00, // component 1
             0x02, 0x11, 0x01, // component 2
             0x03, 0x11, 0x01, // component 3
         };
 
-        p.write(nfdata + (number_of_components - 1) * 3, number_of_components * 3);
-
-        // huffman table(DHT)
-        p.write(marker_data, sizeof(marker_data));
+        p.write(nfdata, number_of_components * 3);
 
         // Define Restart Interval marker
         p.write16(0xffdd);
         p.write16(4);
         p.write16(horizontal_mcus);
+    }
 
+    void jpeg_encode::write_scan(BigEndianStream& p, const Scan& scan)
+    {
         // Start of scan marker
         p.write16(0xffda);
-        p.write16(6 + number_of_components * 2); // header length
-        p.write8(number_of_components); // Ns
+        p.write16(6 + scan.components * 2); // header length
+        p.write8(scan.components); // Ns
 
-        const uint8 nsdata[] =
+        for (int i = 0; i < scan.components; ++i)
         {
-            0x01, 0x00,
-            0x02, 0x11,
-            0x03, 0x11,
-        };
+            const int component = scan.component[i];
+            p.write8(component + 1); // Cs
+            p.write8(component ? 0x11 : 0x00); // Td, Ta
+        }
 
-        p.write(nsdata, number_of_components * 2);
-        p.write8(0x00);
-        p.write8(0x3f);
-        p.write8(0x00);
+        p.write8(scan.Ss);
+        p.write8(scan.Se);
+        p.write8((scan.Ah << 4) | scan.Al);
     }
 
     // ----------------------------------------------------------------------------
     // encodeJPEG()
     // ----------------------------------------------------------------------------
 
-    void encodeJPEG(const Surface& surface, Stream& stream, int quality, uint32 image_format)
+    constexpr int huffman_buffer_size = 4096;
+    constexpr int huffman_flush_threshold = huffman_buffer_size - 1536;
+
+    void writeHuffmanTables(BigEndianStream& s, jpeg_encode& jp, const Scan& scan)
     {
-        u8* input = surface.image;
+        bool used[2] = { false, false };
 
-        jpeg_encode jp(image_format, surface.width, surface.height, surface.stride, quality);
+        for (int i = 0; i < scan.components; ++i)
+        {
+            used[scan.component[i] ? 1 : 0] = true;
+        }
 
-        BigEndianStream s(stream);
+        for (int Th = 0; Th < 2; ++Th)
+        {
+            if (used[Th])
+            {
+                if (scan.isDC())
+                    jp.huffman[0][Th].write(s, 0, Th);
+                if (scan.isAC())
+                    jp.huffman[1][Th].write(s, 1, Th);
+            }
+        }
+    }
+
+    void writeScanBuffers(BigEndianStream& s, Buffer* buffers, int count)
+    {
+        for (int y = 0; y < count; ++y)
+        {
+            Buffer& buffer = buffers[y];
+
+            // write huffman bitstream
+            s.write(buffer, buffer.size());
+
+            // write restart marker
+            if (y < count - 1)
+            {
+                int index = y & 7;
+                s.write16(0xffd0 + index);
+            }
+        }
+    }
+
+    void encodeSequential(const Surface& surface, BigEndianStream& s, jpeg_encode& jp)
+    {
+        u8* input = surface.image;
+
+        const Scan& scan = jp.channel_count == 1 ? g_scan_sequential_400[0] : g_scan_sequential_444[0];
 
-        // writing marker data
-        jp.write_markers(s, image_format, surface.width, surface.height);
+        jp.write_markers(s, surface.width, surface.height, false);
+        writeHuffmanTables(s, jp, scan);
+        jp.write_scan(s, scan);
 
         ConcurrentQueue queue;
 
@@ -1007,16 +1501,13 @@ namespace
                 rows = jp.rows_in_bottom_mcus;
             }
 
-            queue.enqueue([&jp, y, buffers, input, rows] {
+            queue.enqueue([&jp, &scan, y, buffers, input, rows] {
                 u8* image = input;
 
-                HuffmanEncoder huffman;
+                u8 huff_temp[huffman_buffer_size]; // encoding buffer
 
-                constexpr int buffer_size = 2048;
-                constexpr int flush_threshold = buffer_size - 512;
-
-                u8 huff_temp[buffer_size]; // encoding buffer
-                u8* ptr = huff_temp;
+                HuffmanEncoder huffman(huff_temp, jp.huffman);
+                ScanEncoder<HuffmanEncoder> encoder(huffman, scan);
 
                 const int right_mcu = jp.horizontal_mcus - 1;
 
@@ -1046,23 +1537,23 @@ namespace
                     for (int i = 0; i < jp.channel_count; ++i)
                     {
                         BlockType temp[BLOCK_SIZE];
-                        fdct(temp, block + i * BLOCK_SIZE, jp.channel[i].qtable);
-                        ptr = huffman.encode(ptr, jp.channel[i].component, temp);
+                        fdct(temp, block + i * BLOCK_SIZE, jp.qtable[i]);
+                        encoder.encodeSequential(i, temp);
                     }
 
                     // flush encoding buffer
-                    if (ptr - huff_temp > flush_threshold)
+                    if (huffman.ptr - huff_temp > huffman_flush_threshold)
                     {
-                        buffers[y].write(huff_temp, ptr - huff_temp);
-                        ptr = huff_temp;
+                        buffers[y].write(huff_temp, huffman.ptr - huff_temp);
+                        huffman.ptr = huff_temp;
                     }
 
                     image += jp.mcu_width_size;
                 }
 
                 // flush encoding buffer
-                ptr = huffman.flush(ptr);
-                buffers[y].write(huff_temp, ptr - huff_temp);
+                huffman.flush();
+                buffers[y].write(huff_temp, huffman.ptr - huff_temp);
             });
 
             input += surface.stride * jp.mcu_height;
@@ -1070,22 +1561,621 @@ namespace
 
         queue.wait();
 
+        writeScanBuffers(s, buffers, jp.vertical_mcus);
+
+        delete[] buffers;
+    }
+
+    void encodeMultiPass(const Surface& surface, BigEndianStream& s, jpeg_encode& jp, bool progressive)
+    {
+        // The quantized coefficients are computed once and stored so that the scans can be
+        // entropy coded in multiple passes; first pass gathers the symbol statistics for
+        // optimal huffman tables and the second pass writes the bitstream. Every MCU row
+        // is a restart interval so both passes run one task per row.
+
+        const int blocks_in_row = jp.horizontal_mcus * jp.channel_count * BLOCK_SIZE;
+        AlignedVector<BlockType> coefficients(size_t(blocks_in_row) * jp.vertical_mcus);
+
+        ConcurrentQueue queue;
+
+        // forward DCT and quantization
+        const int bottom_mcu = jp.vertical_mcus - 1;
+        u8* input = surface.image;
+
         for (int y = 0; y < jp.vertical_mcus; ++y)
         {
-            Buffer& buffer = buffers[y];
+            const int rows = y < bottom_mcu ? jp.mcu_height : jp.rows_in_bottom_mcus;
+            BlockType* output = coefficients.data() + y * blocks_in_row;
 
-            // write huffman bitstream
-            s.write(buffer, buffer.size());
+            queue.enqueue([&jp, output, input, rows] {
+                u8* image = input;
+                BlockType* dest = output;
 
-            // write restart marker
-            int index = y & 7;
-            s.write16(0xffd0 + index);
+                const int right_mcu = jp.horizontal_mcus - 1;
+
+                for (int x = 0; x < jp.horizontal_mcus; ++x)
+                {
+                    const bool clip = x == right_mcu;
+                    const int cols = clip ? jp.cols_in_right_mcus : jp.mcu_width;
+                    const int incr = clip ? jp.length_minus_width : jp.length_minus_mcu_width;
+
+                    BlockType block[BLOCK_SIZE * 3];
+
+                    // read MCU data
+                    jp.read_format(&jp, block, image, rows, cols, incr);
+
+                    for (int i = 0; i < jp.channel_count; ++i)
+                    {
+                        fdct(dest, block + i * BLOCK_SIZE, jp.qtable[i]);
+                        dest += BLOCK_SIZE;
+                    }
+
+                    image += jp.mcu_width_size;
+                }
+            });
+
+            input += surface.stride * jp.mcu_height;
         }
 
+        queue.wait();
+
+        const Scan* scans;
+        int scan_count;
+
+        if (progressive)
+        {
+            scans = jp.channel_count == 1 ? g_scan_progressive_400 : g_scan_progressive_444;
+            scan_count = jp.channel_count == 1 ? int(sizeof(g_scan_progressive_400) / sizeof(Scan))
+                                               : int(sizeof(g_scan_progressive_444) / sizeof(Scan));
+        }
+        else
+        {
+            scans = jp.channel_count == 1 ? g_scan_sequential_400 : g_scan_sequential_444;
+            scan_count = 1;
+        }
+
+        jp.write_markers(s, surface.width, surface.height, progressive);
+
+        for (int i = 0; i < scan_count; ++i)
+        {
+            const Scan& scan = scans[i];
+
+            if (scan.isDC() || scan.isAC())
+            {
+                // gather symbol statistics
+                HuffmanStatistics statistics;
+                std::mutex mutex;
+
+                for (int y = 0; y < jp.vertical_mcus; ++y)
+                {
+                    const BlockType* data = coefficients.data() + y * blocks_in_row;
+
+                    queue.enqueue([&jp, &scan, &statistics, &mutex, data] {
+                        SymbolCounter counter;
+                        ScanEncoder<SymbolCounter> encoder(counter, scan);
+
+                        for (int x = 0; x < jp.horizontal_mcus; ++x)
+                        {
+                            const BlockType* mcu = data + x * jp.channel_count * BLOCK_SIZE;
+                            for (int j = 0; j < scan.components; ++j)
+                            {
+                                const int component = scan.component[j];
+                                encoder.encode(component, mcu + component * BLOCK_SIZE);
+                            }
+                        }
+
+                        encoder.finish();
+
+                        std::lock_guard<std::mutex> lock(mutex);
+                        statistics.merge(counter.statistics);
+                    });
+                }
+
+                queue.wait();
+
+                // compute optimal huffman tables
+                for (int Tc = 0; Tc < 2; ++Tc)
+                {
+                    for (int Th = 0; Th < 2; ++Th)
+                    {
+                        jp.huffman[Tc][Th].optimize(statistics.frequency[Tc][Th]);
+                    }
+                }
+
+                writeHuffmanTables(s, jp, scan);
+            }
+
+            jp.write_scan(s, scan);
+
+            // bitstream for each MCU scan
+            Buffer* buffers = new Buffer[jp.vertical_mcus];
+
+            // encode scan
+            for (int y = 0; y < jp.vertical_mcus; ++y)
+            {
+                const BlockType* data = coefficients.data() + y * blocks_in_row;
+                Buffer* buffer = buffers + y;
+
+                queue.enqueue([&jp, &scan, data, buffer] {
+                    u8 huff_temp[huffman_buffer_size]; // encoding buffer
+
+                    HuffmanEncoder huffman(huff_temp, jp.huffman);
+                    ScanEncoder<HuffmanEncoder> encoder(huffman, scan);
+
+                    for (int x = 0; x < jp.horizontal_mcus; ++x)
+                    {
+                        const BlockType* mcu = data + x * jp.channel_count * BLOCK_SIZE;
+                        for (int j = 0; j < scan.components; ++j)
+                        {
+                            const int component = scan.component[j];
+                            encoder.encode(component, mcu + component * BLOCK_SIZE);
+                        }
+
+                        // flush encoding buffer
+                        if (huffman.ptr - huff_temp > huffman_flush_threshold)
+                        {
+                            buffer->write(huff_temp, huffman.ptr - huff_temp);
+                            huffman.ptr = huff_temp;
+                        }
+                    }
+
+                    encoder.finish();
+
+                    // flush encoding buffer
+                    huffman.flush();
+                    buffer->write(huff_temp, huffman.ptr - huff_temp);
+                });
+            }
+
+            queue.wait();
+
+            writeScanBuffers(s, buffers, jp.vertical_mcus);
+
+            delete[] buffers;
+        }
+    }
+
+    void encodeJPEG(const Surface& surface, Stream& stream, int quality, uint32 image_format, bool optimize, bool progressive)
+    {
+        jpeg_encode jp(image_format, surface.width, surface.height, surface.stride, quality);
+
+        BigEndianStream s(stream);
+
+        if (optimize || progressive)
+        {
+            // progressive scans use EOB runs which are not in the default huffman tables
+            // so they are always encoded with optimized tables.
+            encodeMultiPass(surface, s, jp, progressive);
+        }
+        else
+        {
+            encodeSequential(surface, s, jp);
+        }
+
+        // EOI marker
+        s.write16(0xffd9);
+    }
+
+    // ----------------------------------------------------------------------------
+    // transcodeCoefficients()
+    // ----------------------------------------------------------------------------
+
+    // Geometric transformations in the DCT domain: transpose swaps the horizontal
+    // and vertical frequencies and mirroring negates the odd frequencies.
+    template <typename T>
+    void transformBlock(T* dest, const T* source, bool transpose, bool xflip, bool yflip, bool sign)
+    {
+        for (int n = 0; n < 64; ++n)
+        {
+            const int u = transpose ? n >> 3 : n & 7;
+            const int v = transpose ? n & 7 : n >> 3;
+
+            T value = source[zigzag_table[v * 8 + u]];
+
+            if (sign && (((u & xflip) ^ (v & yflip)) & 1))
+            {
+                value = -value;
+            }
+
+            dest[zigzag_table[n]] = value;
+        }
+    }
+
+    // Sets the Exif orientation tag of the first IFD to 1 (top-left) in-place
+    void resetExifOrientation(uint8* data, size_t size)
+    {
+        if (size < 8)
+            return;
+
+        const bool le = data[0] == 0x49 && data[1] == 0x49; // 'II'
+        const bool be = data[0] == 0x4d && data[1] == 0x4d; // 'MM'
+        if (!le && !be)
+            return;
+
+        auto load16 = [le] (const uint8* p) { return le ? uload16le(p) : uload16be(p); };
+        auto load32 = [le] (const uint8* p) { return le ? uload32le(p) : uload32be(p); };
+
+        const size_t offset = load32(data + 4);
+        if (offset > size - 2)
+            return;
+
+        const size_t count = load16(data + offset);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint8* entry = data + offset + 2 + i * 12;
+            if (entry + 12 > data + size)
+                break;
+
+            // Orientation, SHORT
+            if (load16(entry) == 0x0112 && load16(entry + 2) == 3)
+            {
+                if (le)
+                    ustore16le(entry + 8, 1);
+                else
+                    ustore16be(entry + 8, 1);
+            }
+        }
+    }
+
+    template <typename Encoder>
+    void encodeTranscodeMCU(Encoder& encoder, const std::vector<ComponentCoefficients>& components, int x, int y)
+    {
+        const int count = int(components.size());
+
+        for (int i = 0; i < count; ++i)
+        {
+            const ComponentCoefficients& component = components[i];
+
+            for (int by = 0; by < component.Vsf; ++by)
+            {
+                const int row = (y * component.Vsf + by) * component.xblocks;
+
+                for (int bx = 0; bx < component.Hsf; ++bx)
+                {
+                    const int column = x * component.Hsf + bx;
+                    encoder.encodeSequential(i, component.blocks.data() + (row + column) * BLOCK_SIZE);
+                }
+            }
+        }
+    }
+
+    bool transcodeCoefficients(Stream& stream, Memory memory, const JPEGTranscodeOptions& options)
+    {
+        Parser parser(memory);
+
+        std::vector<ComponentCoefficients> source;
+
+        Status status = parser.decode(source);
+        if (!status.success)
+        {
+            return false;
+        }
+
+        // the scan encoder supports luminance and three component images
+        const int count = int(source.size());
+        if (count != 1 && count != 3)
+        {
+            return false;
+        }
+
+        const int width = parser.header.width;
+        const int height = parser.header.height;
+        const int xblock = parser.header.xblock;
+        const int yblock = parser.header.yblock;
+
+        // crop rectangle
+        int x0 = 0;
+        int y0 = 0;
+        int x1 = width;
+        int y1 = height;
+
+        if (options.width > 0 && options.height > 0)
+        {
+            x0 = clamp(options.x, 0, width) / xblock * xblock;
+            y0 = clamp(options.y, 0, height) / yblock * yblock;
+            x1 = clamp(options.x + options.width, 0, width);
+            y1 = clamp(options.y + options.height, 0, height);
+        }
+
+        bool transpose = false;
+        bool xflip = false;
+        bool yflip = false;
+
+        switch (options.transform)
+        {
+            case JPEGTransform::NONE:
+                break;
+            case JPEGTransform::FLIP_HORIZONTAL:
+                xflip = true;
+                break;
+            case JPEGTransform::FLIP_VERTICAL:
+                yflip = true;
+                break;
+            case JPEGTransform::TRANSPOSE:
+                transpose = true;
+                break;
+            case JPEGTransform::TRANSVERSE:
+                transpose = true;
+                xflip = true;
+                yflip = true;
+                break;
+            case JPEGTransform::ROTATE_90:
+                transpose = true;
+                yflip = true;
+                break;
+            case JPEGTransform::ROTATE_180:
+                xflip = true;
+                yflip = true;
+                break;
+            case JPEGTransform::ROTATE_270:
+                transpose = true;
+                xflip = true;
+                break;
+        }
+
+        // partial MCUs cannot be moved to the opposite edge
+        if (xflip)
+        {
+            x1 = x0 + (x1 - x0) / xblock * xblock;
+        }
+
+        if (yflip)
+        {
+            y1 = y0 + (y1 - y0) / yblock * yblock;
+        }
+
+        if (x1 <= x0 || y1 <= y0)
+        {
+            return false;
+        }
+
+        // source MCUs
+        const int mcu_x0 = x0 / xblock;
+        const int mcu_y0 = y0 / yblock;
+        const int mcu_xs = (x1 - x0 + xblock - 1) / xblock;
+        const int mcu_ys = (y1 - y0 + yblock - 1) / yblock;
+
+        // transformed image
+        const int output_width = transpose ? y1 - y0 : x1 - x0;
+        const int output_height = transpose ? x1 - x0 : y1 - y0;
+        const int xmcu = transpose ? mcu_ys : mcu_xs;
+        const int ymcu = transpose ? mcu_xs : mcu_ys;
+
+        std::vector<ComponentCoefficients> components(count);
+
+        ConcurrentQueue queue;
+
+        for (int i = 0; i < count; ++i)
+        {
+            const ComponentCoefficients& src = source[i];
+            ComponentCoefficients& dest = components[i];
+
+            const int xblocks = mcu_xs * src.Hsf;
+            const int yblocks = mcu_ys * src.Vsf;
+            const int xoffset = mcu_x0 * src.Hsf;
+            const int yoffset = mcu_y0 * src.Vsf;
+
+            dest.compid = src.compid;
+            dest.Hsf = transpose ? src.Vsf : src.Hsf;
+            dest.Vsf = transpose ? src.Hsf : src.Vsf;
+            dest.xblocks = transpose ? yblocks : xblocks;
+            dest.yblocks = transpose ? xblocks : yblocks;
+            dest.blocks.resize(size_t(dest.xblocks) * dest.yblocks * BLOCK_SIZE);
+
+            transformBlock(dest.qt, src.qt, transpose, false, false, false);
+
+            for (int y = 0; y < dest.yblocks; ++y)
+            {
+                queue.enqueue([&src, &dest, y, xblocks, yblocks, xoffset, yoffset, transpose, xflip, yflip] {
+                    BlockType* output = dest.blocks.data() + y * dest.xblocks * BLOCK_SIZE;
+
+                    for (int x = 0; x < dest.xblocks; ++x)
+                    {
+                        const int a = transpose ? y : x;
+                        const int b = transpose ? x : y;
+                        const int sx = xoffset + (xflip ? xblocks - 1 - a : a);
+                        const int sy = yoffset + (yflip ? yblocks - 1 - b : b);
+
+                        const BlockType* input = src.blocks.data() + (sy * src.xblocks + sx) * BLOCK_SIZE;
+                        transformBlock(output, input, transpose, xflip, yflip, true);
+                        output += BLOCK_SIZE;
+                    }
+                });
+            }
+        }
+
+        queue.wait();
+
+        // gather symbol statistics; every MCU row is a restart interval
+        const Scan scan = { count, { 0, 1, 2 }, 0, 63, 0, 0 };
+
+        HuffmanStatistics statistics;
+        std::mutex mutex;
+
+        for (int y = 0; y < ymcu; ++y)
+        {
+            queue.enqueue([&components, &scan, &statistics, &mutex, y, xmcu] {
+                SymbolCounter counter;
+                ScanEncoder<SymbolCounter> encoder(counter, scan);
+
+                for (int x = 0; x < xmcu; ++x)
+                {
+                    encodeTranscodeMCU(encoder, components, x, y);
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                statistics.merge(counter.statistics);
+            });
+        }
+
+        queue.wait();
+
+        HuffmanTable huffman[2][2];
+
+        // the chroma tables are only used with more than one component
+        const int tables = count > 1 ? 2 : 1;
+
+        for (int Tc = 0; Tc < 2; ++Tc)
+        {
+            for (int Th = 0; Th < tables; ++Th)
+            {
+                huffman[Tc][Th].optimize(statistics.frequency[Tc][Th]);
+            }
+        }
+
+        // encode scan
+        Buffer* buffers = new Buffer[ymcu];
+
+        for (int y = 0; y < ymcu; ++y)
+        {
+            Buffer* buffer = buffers + y;
+
+            queue.enqueue([&components, &scan, &huffman, buffer, y, xmcu] {
+                // the MCU can have up to ten blocks so the flush margin is larger than in the encoder
+                constexpr int buffer_size = 16384;
+                constexpr int flush_threshold = buffer_size - 8192;
+
+                u8 huff_temp[buffer_size]; // encoding buffer
+
+                HuffmanEncoder coder(huff_temp, huffman);
+                ScanEncoder<HuffmanEncoder> encoder(coder, scan);
+
+                for (int x = 0; x < xmcu; ++x)
+                {
+                    encodeTranscodeMCU(encoder, components, x, y);
+
+                    // flush encoding buffer
+                    if (coder.ptr - huff_temp > flush_threshold)
+                    {
+                        buffer->write(huff_temp, coder.ptr - huff_temp);
+                        coder.ptr = huff_temp;
+                    }
+                }
+
+                coder.flush();
+                buffer->write(huff_temp, coder.ptr - huff_temp);
+            });
+        }
+
+        queue.wait();
+
+        BigEndianStream s(stream);
+
+        // Start of image marker
+        s.write16(0xffd8);
+
+        // Exif block; the transformed image is stored in the top-left orientation
+        if (parser.exif_memory.address && parser.exif_memory.size < 65000)
+        {
+            std::vector<uint8> exif(parser.exif_memory.address, parser.exif_memory.address + parser.exif_memory.size);
+
+            if (options.transform != JPEGTransform::NONE)
+            {
+                resetExifOrientation(exif.data(), exif.size());
+            }
+
+            const uint8 magicExif[] = { 0x45, 0x78, 0x69, 0x66, 0, 0 }; // 'Exif', 0, 0
+            s.write16(0xffe1);
+            s.write16(uint16(2 + 6 + exif.size()));
+            s.write(magicExif, 6);
+            s.write(exif.data(), exif.size());
+        }
+
+        // ICC color profile; only single chunk profiles are retained by the parser
+        if (parser.icc_memory.address && parser.icc_memory.size > 2 && parser.icc_memory.size < 65000 &&
+            parser.icc_memory.address[0] == 1 && parser.icc_memory.address[1] == 1)
+        {
+            const uint8 magicICC[] = { 0x49, 0x43, 0x43, 0x5f, 0x50, 0x52, 0x4f, 0x46, 0x49, 0x4c, 0x45, 0 }; // 'ICC_PROFILE', 0
+            s.write16(0xffe2);
+            s.write16(uint16(2 + 12 + parser.icc_memory.size));
+            s.write(magicICC, 12);
+            s.write(parser.icc_memory.address, parser.icc_memory.size);
+        }
+
+        // Adobe block; the color transform flag selects how the components are decoded
+        if (parser.adobe_memory.address)
+        {
+            s.write16(0xffee);
+            s.write16(uint16(2 + parser.adobe_memory.size));
+            s.write(parser.adobe_memory.address, parser.adobe_memory.size);
+        }
+
+        // Quantization table markers
+        for (int i = 0; i < count; ++i)
+        {
+            const uint16* qt = components[i].qt;
+
+            bool precision16 = false;
+            for (int j = 0; j < 64; ++j)
+            {
+                precision16 |= qt[j] > 255;
+            }
+
+            s.write16(0xffdb);
+            s.write16(precision16 ? 2 + 1 + 128 : 2 + 1 + 64);
+            s.write8((precision16 ? 0x10 : 0x00) | i); // Pq, Tq
+
+            for (int j = 0; j < 64; ++j)
+            {
+                if (precision16)
+                    s.write16(qt[j]);
+                else
+                    s.write8(uint8(qt[j]));
+            }
+        }
+
+        // Start of frame marker
+        s.write16(0xffc0);
+        s.write16(uint16(8 + 3 * count)); // frame header length
+        s.write8(8); // precision
+        s.write16(uint16(output_height));
+        s.write16(uint16(output_width));
+        s.write8(uint8(count)); // Nf
+
+        for (int i = 0; i < count; ++i)
+        {
+            const ComponentCoefficients& component = components[i];
+            s.write8(uint8(component.compid)); // Ci
+            s.write8(uint8((component.Hsf << 4) | component.Vsf)); // Hi, Vi
+            s.write8(uint8(i)); // Tqi
+        }
+
+        // Huffman table markers
+        for (int Th = 0; Th < tables; ++Th)
+        {
+            huffman[0][Th].write(s, 0, Th);
+            huffman[1][Th].write(s, 1, Th);
+        }
+
+        // Define Restart Interval marker
+        s.write16(0xffdd);
+        s.write16(4);
+        s.write16(uint16(xmcu));
+
+        // Start of scan marker
+        s.write16(0xffda);
+        s.write16(uint16(6 + count * 2)); // header length
+        s.write8(uint8(count)); // Ns
+
+        for (int i = 0; i < count; ++i)
+        {
+            s.write8(uint8(components[i].compid)); // Cs
+            s.write8(i ? 0x11 : 0x00); // Td, Ta
+        }
+
+        s.write8(0); // Ss
+        s.write8(63); // Se
+        s.write8(0); // Ah, Al
+
+        writeScanBuffers(s, buffers, ymcu);
+
         delete[] buffers;
 
         // EOI marker
         s.write16(0xffd9);
+
+        return true;
     }
 
 } // namespace
@@ -1093,10 +2183,10 @@ namespace
 namespace jpeg
 {
 
-    void EncodeImage(Stream& stream, const Surface& surface, float quality)
+    void EncodeImage(Stream& stream, const Surface& surface, const ImageEncodeOptions& options)
     {
         // configure quality
-        quality = clamp(1.0f - quality, 0.0f, 1.0f);
+        const float quality = clamp(1.0f - options.quality, 0.0f, 1.0f);
         const uint32 iq = uint32(quality * 1024);
 
         // set default format
@@ -1117,15 +2207,20 @@ namespace jpeg
         // encode
         if (surface.format == sourceFormat)
         {
-            encodeJPEG(surface, stream, iq, destFormat);
+            encodeJPEG(surface, stream, iq, destFormat, options.optimize, options.progressive);
         }
         else
         {
             // convert source surface to format supported in the encoder
             Bitmap temp(surface.width, surface.height, sourceFormat);
             temp.blit(0, 0, surface);
-            encodeJPEG(temp, stream, iq, destFormat);
+            encodeJPEG(temp, stream, iq, destFormat, options.optimize, options.progressive);
         }
     }
 
+    bool TranscodeImage(Stream& stream, Memory memory, const JPEGTranscodeOptions& options)
+    {
+        return transcodeCoefficients(stream, memory, options);
+    }
+
 } // namespace jpeg
@@ -80,6 +80,11 @@ namespace jpeg
         int xblock;
         int yblock;
         Format format;
+
+        // native component resolution for planar decoding
+        int planes;
+        int planeWidth[JPEG_MAX_COMPS_IN_SCAN];
+        int planeHeight[JPEG_MAX_COMPS_IN_SCAN];
     };
 
     struct Status
@@ -276,6 +281,12 @@ namespace jpeg
         int stride;
     };
 
+    struct Plane
+    {
+        uint8* image;
+        int stride;
+    };
+
     struct ProcessState
     {
         Block block[JPEG_MAX_BLOCKS_IN_MCU];
@@ -284,6 +295,9 @@ namespace jpeg
         Frame frame[JPEG_MAX_COMPS_IN_SCAN];
         int frames;
 
+        // planar decoding targets; dest is always in the first plane
+        Plane plane[JPEG_MAX_COMPS_IN_SCAN];
+
 	    void (*idct)(uint8* dest, int stride, const BlockType* data, const uint16* qt);
         void (*process)(uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
         void (*clipped)(uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
@@ -297,6 +311,18 @@ namespace jpeg
         void (*process_YCbCr_16x16)(uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
     };
 
+    struct ComponentCoefficients
+    {
+        int     compid;   // Component identifier
+        int     Hsf;      // Horizontal sampling factor
+        int     Vsf;      // Vertical sampling factor
+        int     xblocks;  // Block grid size; covers all MCUs including the padding blocks
+        int     yblocks;
+        uint16  qt[64];   // Quantization table in zigzag order
+
+        AlignedVector<BlockType> blocks; // Quantized coefficients in zigzag order
+    };
+
     // ----------------------------------------------------------------------------
     // Parser
     // ----------------------------------------------------------------------------
@@ -308,7 +334,9 @@ namespace jpeg
         HuffTable huffTable[2][JPEG_MAX_COMPS_IN_SCAN];
 
         AlignedVector<uint16> quantTableVector;
-        BlockType* blockVector;
+        BlockType* blockVector; // coefficients of the current decode, allocated on demand
+        BlockType* blockStorage;
+        size_t blockStorageSize;
 
         std::vector< Frame > frames;
         Frame* scanFrame; // current Progressive AC scan frame
@@ -332,6 +360,7 @@ namespace jpeg
         bool is_progressive;
         bool is_arithmetic;
         bool is_lossless;
+        bool is_buffered; // store coefficients instead of reconstructing the image
         int Hmax;
         int Vmax;
         int blocks_in_mcu;
@@ -373,6 +402,7 @@ namespace jpeg
         void decodeSequentialST();
         void decodeSequentialMT();
         void decodeProgressive();
+        void allocateBlocks();
         void finishProgressive();
         void finishProgressiveST();
         void finishProgressiveMT();
@@ -382,12 +412,24 @@ namespace jpeg
         Header header;
         Memory exif_memory; // Exif block, if one is present
         Memory icc_memory; // ICC color profile block, if one is present
+        Memory adobe_memory; // Adobe APP14 block, if one is present
         Memory scan_memory; // Scan block
 
+        // Progressive decoding preview; the image is reconstructed after every scan
+        mango::ImageDecodeCallback callback;
+
+        // Decode using the ThreadPool; disabled when the caller schedules the parsers itself
+        bool multithread;
+
         Parser(Memory memory);
         ~Parser();
 
+        // Begin parsing a new image, reusing the tables and coefficient storage
+        void reset(Memory memory);
+
         Status decode(Surface& target);
+        Status decode(Surface* planes, mango::YCbCrLayout layout);
+        Status decode(std::vector<ComponentCoefficients>& components);
     };
 
     // ----------------------------------------------------------------------------
@@ -430,6 +472,8 @@ namespace jpeg
     void process_YCbCr_8x16        (uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
     void process_YCbCr_16x8        (uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
     void process_YCbCr_16x16       (uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_planar            (uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
+    void process_NV12              (uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
 
 #if defined(JPEG_ENABLE_SIMD)
     void idct_simd                 (uint8* dest, int stride, const BlockType* data, const uint16* qt);
@@ -443,6 +487,8 @@ namespace jpeg
     void process_YCbCr_16x16_sse2  (uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height);
 #endif
 
-	void EncodeImage(Stream& stream, const Surface& surface, float quality);
+    void EncodeImage(Stream& stream, const Surface& surface, const mango::ImageEncodeOptions& options);
+    bool TranscodeImage(Stream& stream, Memory memory, const mango::JPEGTranscodeOptions& options);
+    bool DecodeBatch(const std::vector<Memory>& inputs, const std::vector<Surface*>& outputs, mango::JPEGBatchCallback callback);
 
 } // namespace jpeg
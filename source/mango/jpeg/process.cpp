@@ -332,6 +332,117 @@ void process_YCbCr_16x16(uint8* dest, int stride, const BlockType* data, Process
     MANGO_UNREFERENCED_PARAMETER(height);
 }
 
+// ----------------------------------------------------------------------------
+// Planar output
+// ----------------------------------------------------------------------------
+
+/*
+    The planar process functions store the IDCT output at native component
+    resolution without color conversion or chroma upsampling. The dest pointer
+    always points into the first (luminance) plane and is used to resolve the
+    MCU position in the other planes.
+*/
+
+static
+void process_component(uint8* dest, int stride, const BlockType* data, ProcessState* state, int index, int width, int height)
+{
+    const Frame& frame = state->frame[index];
+    const int first = frame.offset;
+    const int last = index + 1 < state->frames ? state->frame[index + 1].offset : state->blocks;
+
+    // component width in the MCU
+    const int xsize = state->block[first].stride;
+
+    data += first * 64;
+
+    for (int i = first; i < last; ++i)
+    {
+        const Block& block = state->block[i];
+        const int offset = block.offset - first * 64;
+        const int x = offset % xsize;
+        const int y = offset / xsize;
+
+        const int w = std::min(8, width - x);
+        const int h = std::min(8, height - y);
+
+        if (w > 0 && h > 0)
+        {
+            // NOTE: the idct variants do not all respect stride so we decode into 8x8 block
+            uint8 result[64];
+            state->idct(result, 8, data, block.qt->table);
+
+            uint8* d = dest + y * stride + x;
+
+            for (int j = 0; j < h; ++j)
+            {
+                std::memcpy(d, result + j * 8, w);
+                d += stride;
+            }
+        }
+
+        data += 64;
+    }
+}
+
+void process_planar(uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+{
+    const int offset = int(dest - state->plane[0].image);
+    const int y0 = offset / stride;
+    const int x0 = offset - y0 * stride;
+
+    for (int i = 0; i < state->frames; ++i)
+    {
+        const int hsf = state->frame[i].Hsf;
+        const int vsf = state->frame[i].Vsf;
+        const Plane& plane = state->plane[i];
+
+        uint8* d = plane.image + (y0 >> vsf) * plane.stride + (x0 >> hsf);
+        const int w = (width + (1 << hsf) - 1) >> hsf;
+        const int h = (height + (1 << vsf) - 1) >> vsf;
+        process_component(d, plane.stride, data, state, i, w, h);
+    }
+}
+
+void process_NV12(uint8* dest, int stride, const BlockType* data, ProcessState* state, int width, int height)
+{
+    process_component(dest, stride, data, state, 0, width, height);
+
+    // the decoder accepts only 4:2:0 sampling so the same blocks cover Cb and Cr
+    const int hsf = state->frame[1].Hsf;
+    const int vsf = state->frame[1].Vsf;
+    const int cstride = state->block[state->frame[1].offset].stride;
+    const int cheight = (state->frame[2].offset - state->frame[1].offset) * 64 / cstride;
+
+    uint8 cb[64 * JPEG_MAX_BLOCKS_IN_MCU];
+    uint8 cr[64 * JPEG_MAX_BLOCKS_IN_MCU];
+
+    process_component(cb, cstride, data, state, 1, cstride, cheight);
+    process_component(cr, cstride, data, state, 2, cstride, cheight);
+
+    const int offset = int(dest - state->plane[0].image);
+    const int y0 = offset / stride;
+    const int x0 = offset - y0 * stride;
+
+    const Plane& plane = state->plane[1];
+    uint8* d = plane.image + (y0 >> vsf) * plane.stride + (x0 >> hsf) * 2;
+    const int w = (width + (1 << hsf) - 1) >> hsf;
+    const int h = (height + (1 << vsf) - 1) >> vsf;
+
+    for (int y = 0; y < h; ++y)
+    {
+        const uint8* s0 = cb + y * cstride;
+        const uint8* s1 = cr + y * cstride;
+
+        for (int x = 0; x < w; ++x)
+        {
+            d[x * 2 + 0] = s0[x];
+            d[x * 2 + 1] = s1[x];
+        }
+
+        d += plane.stride;
+    }
+}
+
 #undef COMPUTE_CBCR
 #undef PACK_ARGB
 #undef PACK_CMYK
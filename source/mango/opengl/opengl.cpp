@@ -2,6 +2,8 @@
     MANGO Multimedia Development Platform
     Copyright (C) 2012-2016 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
+#include <algorithm>
+#include <cstring>
 #include <mango/core/exception.hpp>
 #include <mango/opengl/opengl.hpp>
 
@@ -515,5 +517,151 @@ namespace opengl {
         return NULL;
     }
 
+    // -------------------------------------------------------------------
+    // compressed texture upload
+    // -------------------------------------------------------------------
+
+    struct CompressedLevel
+    {
+        GLsizei width;
+        GLsizei height;
+        Memory memory;
+    };
+
+    static bool getCompressedLevels(std::vector<CompressedLevel>& levels, GLenum& internalFormat, ImageDecoder& decoder, int face)
+    {
+        const ImageHeader header = decoder.header();
+
+        if (header.compression == TextureCompression::NONE || !isCompressedTextureSupported(header.compression))
+            return false;
+
+        internalFormat = opengl::getTextureFormat(header.compression);
+        if (!internalFormat)
+            return false;
+
+        const int count = std::max(1, header.levels);
+
+        for (int level = 0; level < count; ++level)
+        {
+            CompressedLevel node;
+
+            node.width = std::max(1, header.width >> level);
+            node.height = std::max(1, header.height >> level);
+            node.memory = decoder.memory(level, 0, face);
+
+            if (!node.memory.address)
+                return false;
+
+            levels.push_back(node);
+        }
+
+        return true;
+    }
+
+    bool uploadCompressedTexture(GLenum target, ImageDecoder& decoder, int face)
+    {
+        std::vector<CompressedLevel> levels;
+        GLenum internalFormat;
+
+        if (!getCompressedLevels(levels, internalFormat, decoder, face))
+            return false;
+
+        for (size_t level = 0; level < levels.size(); ++level)
+        {
+            const CompressedLevel& node = levels[level];
+            glCompressedTexImage2D(target, GLint(level), internalFormat, node.width, node.height, 0,
+                                   GLsizei(node.memory.size), node.memory.address);
+        }
+
+        return true;
+    }
+
+    // -------------------------------------------------------------------
+    // PixelUnpackRing
+    // -------------------------------------------------------------------
+
+    PixelUnpackRing::PixelUnpackRing(size_t size, int count)
+        : m_size(size)
+        , m_next(0)
+    {
+        m_slots.resize(std::max(1, count));
+
+        for (auto& slot : m_slots)
+        {
+            glGenBuffers(1, &slot.buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(size), nullptr, GL_STREAM_DRAW);
+            slot.fence = 0;
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    PixelUnpackRing::~PixelUnpackRing()
+    {
+        for (auto& slot : m_slots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+
+    bool PixelUnpackRing::upload(GLenum target, ImageDecoder& decoder, int face)
+    {
+        std::vector<CompressedLevel> levels;
+        GLenum internalFormat;
+
+        if (!getCompressedLevels(levels, internalFormat, decoder, face))
+            return false;
+
+        for (size_t level = 0; level < levels.size(); ++level)
+        {
+            const CompressedLevel& node = levels[level];
+            const GLsizei size = GLsizei(node.memory.size);
+
+            if (node.memory.size > m_size)
+            {
+                // the level does not fit into a buffer
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                glCompressedTexImage2D(target, GLint(level), internalFormat, node.width, node.height, 0, size, node.memory.address);
+                continue;
+            }
+
+            Slot& slot = m_slots[m_next];
+            m_next = (m_next + 1) % m_slots.size();
+
+            if (slot.fence)
+            {
+                // wait until the driver has consumed the previous upload from this buffer
+                glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(slot.fence);
+                slot.fence = 0;
+            }
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+
+            void* dest = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (!dest)
+            {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                return false;
+            }
+
+            std::memcpy(dest, node.memory.address, node.memory.size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            // the data pointer is an offset into the bound pixel unpack buffer
+            glCompressedTexImage2D(target, GLint(level), internalFormat, node.width, node.height, 0, size, nullptr);
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        return true;
+    }
+
 } // namespace opengl
 } // namespace mango
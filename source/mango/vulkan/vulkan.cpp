@@ -2,6 +2,8 @@
     MANGO Multimedia Development Platform
     Copyright (C) 2012-2016 Twilight Finland 3D Oy Ltd. All rights reserved.
 */
+#include <algorithm>
+#include <cstring>
 #include <mango/vulkan/vulkan.hpp>
 #include <mango/core/exception.hpp>
 
@@ -635,6 +637,273 @@ namespace vulkan {
 			vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
 	}
 
+	// -----------------------------------------------------------------------
+	// TextureUploader
+	// -----------------------------------------------------------------------
+
+	TextureUploader::TextureUploader(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue queue, uint32_t queueFamilyIndex,
+		VkDeviceSize size, uint32_t segments)
+		: m_device(device)
+		, m_queue(queue)
+	{
+		// the constructor releases what it has created if it throws; the destructor is not called
+		try
+		{
+			VkResult result;
+
+			segments = std::max(segments, 1u);
+			m_segmentSize = (size / segments) & ~VkDeviceSize(15);
+
+			// staging buffer
+
+			VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			bufferCreateInfo.size = m_segmentSize * segments;
+			bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			result = vkCreateBuffer(m_device, &bufferCreateInfo, nullptr, &m_buffer);
+			vulkan::checkResult(result, "vkCreateBuffer");
+
+			VkMemoryRequirements memoryRequirements;
+			vkGetBufferMemoryRequirements(m_device, m_buffer, &memoryRequirements);
+
+			// host visible, coherent memory is written without explicit flushes
+
+			VkPhysicalDeviceMemoryProperties memoryProperties;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+			const VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			uint32_t memoryTypeIndex = memoryProperties.memoryTypeCount;
+
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+			{
+				if ((memoryRequirements.memoryTypeBits & (1u << i)) &&
+					(memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+				{
+					memoryTypeIndex = i;
+					break;
+				}
+			}
+
+			if (memoryTypeIndex == memoryProperties.memoryTypeCount)
+			{
+				throw "Host visible memory not available.";
+			}
+
+			VkMemoryAllocateInfo memoryAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+			memoryAllocateInfo.allocationSize = memoryRequirements.size;
+			memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+			result = vkAllocateMemory(m_device, &memoryAllocateInfo, nullptr, &m_memory);
+			vulkan::checkResult(result, "vkAllocateMemory");
+
+			result = vkBindBufferMemory(m_device, m_buffer, m_memory, 0);
+			vulkan::checkResult(result, "vkBindBufferMemory");
+
+			void* address = nullptr;
+			result = vkMapMemory(m_device, m_memory, 0, VK_WHOLE_SIZE, 0, &address);
+			vulkan::checkResult(result, "vkMapMemory");
+			m_address = reinterpret_cast<uint8*>(address);
+
+			// command buffers and fences of the segments
+
+			VkCommandPoolCreateInfo commandPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+			commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+
+			result = vkCreateCommandPool(m_device, &commandPoolCreateInfo, nullptr, &m_commandPool);
+			vulkan::checkResult(result, "vkCreateCommandPool");
+
+			m_segments.resize(segments);
+
+			for (auto& segment : m_segments)
+			{
+				VkCommandBufferAllocateInfo commandBufferAllocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+				commandBufferAllocateInfo.commandPool = m_commandPool;
+				commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+				commandBufferAllocateInfo.commandBufferCount = 1;
+
+				result = vkAllocateCommandBuffers(m_device, &commandBufferAllocateInfo, &segment.commandBuffer);
+				vulkan::checkResult(result, "vkAllocateCommandBuffers");
+
+				VkFenceCreateInfo fenceCreateInfo = { VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+				result = vkCreateFence(m_device, &fenceCreateInfo, nullptr, &segment.fence);
+				vulkan::checkResult(result, "vkCreateFence");
+			}
+		}
+		catch (...)
+		{
+			release();
+			throw;
+		}
+	}
+
+	TextureUploader::~TextureUploader()
+	{
+		wait();
+		release();
+	}
+
+	void TextureUploader::release()
+	{
+		for (auto& segment : m_segments)
+		{
+			if (segment.fence != VK_NULL_HANDLE)
+				vkDestroyFence(m_device, segment.fence, nullptr);
+		}
+
+		m_segments.clear();
+
+		if (m_commandPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+			m_commandPool = VK_NULL_HANDLE;
+		}
+
+		if (m_memory != VK_NULL_HANDLE)
+		{
+			if (m_address)
+				vkUnmapMemory(m_device, m_memory);
+			vkFreeMemory(m_device, m_memory, nullptr);
+			m_memory = VK_NULL_HANDLE;
+			m_address = nullptr;
+		}
+
+		if (m_buffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(m_device, m_buffer, nullptr);
+			m_buffer = VK_NULL_HANDLE;
+		}
+	}
+
+	TextureUploader::Segment& TextureUploader::acquire(VkDeviceSize& offset)
+	{
+		offset = m_next * m_segmentSize;
+		Segment& segment = m_segments[m_next];
+		m_next = (m_next + 1) % m_segments.size();
+
+		if (segment.pending)
+		{
+			// wait until the previous copies from this segment are completed
+			vkWaitForFences(m_device, 1, &segment.fence, VK_TRUE, UINT64_MAX);
+			vkResetFences(m_device, 1, &segment.fence);
+			segment.pending = false;
+		}
+
+		return segment;
+	}
+
+	bool TextureUploader::upload(VkImage image, ImageDecoder& decoder, uint32_t layer)
+	{
+		const ImageHeader header = decoder.header();
+
+		if (header.compression == TextureCompression::NONE || !vulkan::getTextureFormat(header.compression))
+			return false;
+
+		const uint32_t count = std::max(1, header.levels);
+
+		std::vector<Memory> levels;
+
+		for (uint32_t level = 0; level < count; ++level)
+		{
+			Memory memory = decoder.memory(level, 0, layer);
+			if (!memory.address || memory.size > m_segmentSize)
+				return false;
+
+			levels.push_back(memory);
+		}
+
+		VkImageMemoryBarrier imageMemoryBarrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.image = image;
+		imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, count, layer, 1 };
+
+		uint32_t level = 0;
+
+		while (level < count)
+		{
+			VkDeviceSize base;
+			Segment& segment = acquire(base);
+
+			VkCommandBufferBeginInfo commandBufferBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			VkResult result = vkBeginCommandBuffer(segment.commandBuffer, &commandBufferBeginInfo);
+			vulkan::checkResult(result, "vkBeginCommandBuffer");
+
+			if (!level)
+			{
+				imageMemoryBarrier.srcAccessMask = 0;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+				vkCmdPipelineBarrier(segment.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+					0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			}
+
+			// copy as many levels as fit into the segment; offsets are aligned to the block size
+			std::vector<VkBufferImageCopy> regions;
+			VkDeviceSize offset = 0;
+
+			for ( ; level < count && offset + levels[level].size <= m_segmentSize; ++level)
+			{
+				std::memcpy(m_address + base + offset, levels[level].address, levels[level].size);
+
+				VkBufferImageCopy region = {};
+				region.bufferOffset = base + offset;
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, layer, 1 };
+				region.imageExtent.width = std::max(1, header.width >> level);
+				region.imageExtent.height = std::max(1, header.height >> level);
+				region.imageExtent.depth = 1;
+				regions.push_back(region);
+
+				offset = (offset + levels[level].size + 15) & ~VkDeviceSize(15);
+			}
+
+			vkCmdCopyBufferToImage(segment.commandBuffer, m_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				uint32_t(regions.size()), regions.data());
+
+			if (level == count)
+			{
+				imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+				vkCmdPipelineBarrier(segment.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+					0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+			}
+
+			vkEndCommandBuffer(segment.commandBuffer);
+
+			VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &segment.commandBuffer;
+
+			result = vkQueueSubmit(m_queue, 1, &submitInfo, segment.fence);
+			vulkan::checkResult(result, "vkQueueSubmit");
+
+			segment.pending = true;
+		}
+
+		return true;
+	}
+
+	void TextureUploader::wait()
+	{
+		for (auto& segment : m_segments)
+		{
+			if (segment.pending)
+			{
+				vkWaitForFences(m_device, 1, &segment.fence, VK_TRUE, UINT64_MAX);
+				vkResetFences(m_device, 1, &segment.fence);
+				segment.pending = false;
+			}
+		}
+	}
+
     // -----------------------------------------------------------------------
     // Context
     // -----------------------------------------------------------------------